@@ -0,0 +1,371 @@
+/*
+DingusPPC - The Experimental PowerPC Macintosh emulator
+Copyright (C) 2018-23 divingkatae and maximum
+                      (theweirdo)     spatium
+
+(Contact divingkatae#1017 or powermax#2286 on Discord for more info)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file Audio output pipeline benchmark.
+
+    Builds the sound output chain of the MacIO machines (DBDMA channel,
+    Screamer codec and SoundServer) on top of a bare memory controller.
+    A synthetic descriptor program in guest RAM loops over a ring of sample
+    buffers, like the Sound Manager does. The SoundServer runs with the
+    null sink so no sound card is needed, frames are pulled through the
+    same code the host audio callback uses.
+
+    The maximum rate runs pull frames back to back with various buffer
+    and callback sizes and report host ns per audio frame and the cost of
+    processing one descriptor. The real-time run pulls one callback period
+    at a time on a separate thread at the audio rate and reports callback
+    latencies and missed deadlines.
+
+    Usage: audiobench [options]
+ */
+
+#include <cpu/ppc/ppcemu.h>
+#include <devices/common/dbdma.h>
+#include <devices/common/hwinterrupt.h>
+#include <devices/memctrl/memctrlbase.h>
+#include <devices/sound/awacs.h>
+#include <devices/sound/soundserver.h>
+#include <endianswap.h>
+#include <machines/machinebase.h>
+#include <memaccess.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <CLI11.hpp>
+#include <loguru.hpp>
+
+static const uint32_t RAM_SIZE    = 8 << 20;
+static const uint32_t PROG_BASE   = 0x10000;    // descriptor program
+static const uint32_t BUF_BASE    = 0x100000;   // sample buffers
+static const uint32_t BUF_AREA    = 4 << 20;
+static const int      SAMPLE_RATE = 44100;
+
+static inline uint64_t host_time_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/** Interrupt controller counting the DMA interrupts, one per descriptor. */
+class BenchIntCtrl : public InterruptCtrl {
+public:
+    uint32_t register_dev_int(IntSrc src_id) { return 1; };
+    uint32_t register_dma_int(IntSrc src_id) { return 1; };
+
+    void ack_int(uint32_t irq_id, uint8_t irq_line_state) {};
+    void ack_dma_int(uint32_t irq_id, uint8_t irq_line_state) {
+        if (irq_line_state)
+            this->num_dma_ints++;
+    };
+
+    std::atomic<uint64_t> num_dma_ints{0};
+};
+
+/** Sample value of the test tone at the given frame. */
+static inline int16_t tone_sample(uint32_t frame, int channel) {
+    return int16_t(std::sin(frame * (channel ? 660.0 : 440.0) * 2 * M_PI / SAMPLE_RATE) *
+                   12000.0);
+}
+
+/** Write a ring of num_bufs OUTPUT_MORE descriptors, each interrupting on
+    completion, the last one branching back to the first. */
+static uint32_t build_program(MemCtrlBase* mem_ctrl, uint32_t buf_frames)
+{
+    uint32_t buf_bytes = buf_frames * 4;
+    uint32_t num_bufs  = std::min(BUF_AREA / buf_bytes, (BUF_BASE - PROG_BASE) / 16);
+
+    uint8_t* ram = mem_ctrl->find_range(0)->mem_ptr;
+
+    for (uint32_t i = 0; i < num_bufs; i++) {
+        uint8_t* cmd  = ram + PROG_BASE + i * 16;
+        bool     last = i == num_bufs - 1;
+
+        WRITE_WORD_LE_A(&cmd[0], buf_bytes);
+        cmd[2] = 0x30 | (last ? 0x0C : 0); // interrupt always, branch on the last one
+        cmd[3] = DBDMA_Cmd::OUTPUT_MORE << 4;
+        WRITE_DWORD_LE_A(&cmd[4], BUF_BASE + i * buf_bytes);
+        WRITE_DWORD_LE_A(&cmd[8], last ? PROG_BASE : 0);
+        WRITE_DWORD_LE_A(&cmd[12], 0);
+    }
+
+    // big-endian stereo samples as the guest delivers them
+    uint32_t num_frames = num_bufs * buf_frames;
+    for (uint32_t f = 0; f < num_frames; f++) {
+        WRITE_WORD_BE_A(ram + BUF_BASE + f * 4,     tone_sample(f, 0));
+        WRITE_WORD_BE_A(ram + BUF_BASE + f * 4 + 2, tone_sample(f, 1));
+    }
+
+    return num_frames;
+}
+
+static void start_channel(DMAChannel* dma_ch) {
+    dma_ch->reg_write(DMAReg::CMD_PTR_LO, BYTESWAP_32(PROG_BASE), 4);
+    dma_ch->reg_write(DMAReg::CH_CTRL, BYTESWAP_32((CH_STAT_RUN << 16) | CH_STAT_RUN), 4);
+}
+
+static void stop_channel(DMAChannel* dma_ch) {
+    dma_ch->reg_write(DMAReg::CH_CTRL, BYTESWAP_32(CH_STAT_RUN << 16), 4);
+}
+
+/** Check that the first pulled frames carry the test tone in host order. */
+static bool verify_output(SoundServer* snd_server) {
+    std::vector<int16_t> out(4096 * 2);
+
+    if (snd_server->pull_out_frames(out.data(), 4096) != 4096)
+        return false;
+
+    for (uint32_t f = 0; f < 4096; f++) {
+        if (out[f * 2] != tone_sample(f, 0) || out[f * 2 + 1] != tone_sample(f, 1))
+            return false;
+    }
+
+    return true;
+}
+
+typedef struct RateResult {
+    double  ns_per_frame;
+    double  ns_per_desc;
+} RateResult;
+
+static RateResult run_max_rate(SoundServer* snd_server, DMAChannel* dma_ch,
+                               BenchIntCtrl* int_ctrl, MemCtrlBase* mem_ctrl,
+                               uint32_t buf_frames, uint32_t pull_frames,
+                               uint64_t total_frames)
+{
+    build_program(mem_ctrl, buf_frames);
+    start_channel(dma_ch);
+
+    std::vector<int16_t> out(pull_frames * 2);
+
+    // warm up caches and the DMA mapping
+    snd_server->pull_out_frames(out.data(), pull_frames);
+
+    uint64_t descs_before = int_ctrl->num_dma_ints;
+    uint64_t frames       = 0;
+    uint64_t start_ns     = host_time_ns();
+
+    while (frames < total_frames) {
+        long got = snd_server->pull_out_frames(out.data(), pull_frames);
+        if (got <= 0) {
+            LOG_F(ERROR, "Sound output stalled after %llu frames", (unsigned long long)frames);
+            break;
+        }
+        frames += got;
+    }
+
+    uint64_t elapsed = host_time_ns() - start_ns;
+    uint64_t descs   = int_ctrl->num_dma_ints - descs_before;
+
+    stop_channel(dma_ch);
+
+    RateResult res = {double(elapsed) / std::max(frames, uint64_t(1)),
+                      descs ? double(elapsed) / descs : 0.0};
+
+    LOG_F(INFO, "%5u frames/buf %5u frames/pull  %7.2f ns/frame  %8.1f ns/buf  %7.0fx real time",
+          buf_frames, pull_frames, res.ns_per_frame, res.ns_per_desc,
+          1.0e9 / SAMPLE_RATE / res.ns_per_frame);
+
+    return res;
+}
+
+static void report_latencies(const char* name, std::vector<uint64_t>& samples) {
+    if (samples.empty()) {
+        LOG_F(INFO, "%s: no samples", name);
+        return;
+    }
+
+    std::sort(samples.begin(), samples.end());
+
+    auto pct = [&samples](double p) {
+        size_t idx = (size_t)(p * (samples.size() - 1));
+        return samples[idx];
+    };
+
+    uint64_t sum = 0;
+    for (auto s : samples)
+        sum += s;
+
+    LOG_F(INFO, "%s: calls=%zu avg=%.1f p50=%llu p99=%llu p99.9=%llu max=%llu ns",
+          name, samples.size(), (double)sum / samples.size(),
+          (unsigned long long)pct(0.5),  (unsigned long long)pct(0.99),
+          (unsigned long long)pct(0.999), (unsigned long long)samples.back());
+}
+
+/** Pull one period at a time at the audio rate like a host audio thread. */
+static void run_real_time(SoundServer* snd_server, DMAChannel* dma_ch, MemCtrlBase* mem_ctrl,
+                          uint32_t buf_frames, uint32_t period_frames, double seconds,
+                          bool guest_load)
+{
+    uint32_t num_frames = build_program(mem_ctrl, buf_frames);
+    start_channel(dma_ch);
+
+    uint64_t period_ns   = uint64_t(period_frames) * 1000000000ULL / SAMPLE_RATE;
+    uint64_t num_periods = uint64_t(seconds * 1.0e9 / period_ns);
+
+    std::vector<uint64_t> durations, lateness;
+    durations.reserve(num_periods);
+    lateness.reserve(num_periods);
+
+    uint64_t underruns = 0, missed = 0;
+    std::atomic<bool> done{false};
+
+    std::thread audio_thread([&]() {
+        std::vector<int16_t> out(period_frames * 2);
+
+        auto deadline = std::chrono::steady_clock::now();
+
+        for (uint64_t i = 0; i < num_periods; i++) {
+            deadline += std::chrono::nanoseconds(period_ns);
+            std::this_thread::sleep_until(deadline);
+
+            uint64_t due = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                deadline.time_since_epoch()).count();
+            uint64_t t0  = host_time_ns();
+            long     got = snd_server->pull_out_frames(out.data(), period_frames);
+            uint64_t t1  = host_time_ns();
+
+            durations.push_back(t1 - t0);
+            lateness.push_back(t0 > due ? t0 - due : 0);
+
+            if (got < (long)period_frames)
+                underruns++;
+            if (t1 > due + period_ns)
+                missed++;
+        }
+
+        done = true;
+    });
+
+    // keep rewriting the sample buffers like a guest producing audio
+    if (guest_load) {
+        uint8_t* samples = mem_ctrl->find_range(0)->mem_ptr + BUF_BASE;
+        uint32_t frame   = 0;
+        while (!done) {
+            for (int i = 0; i < 4096; i++, frame = (frame + 1) % num_frames)
+                WRITE_DWORD_BE_A(samples + frame * 4, READ_DWORD_BE_A(samples + frame * 4));
+        }
+    }
+
+    audio_thread.join();
+
+    stop_channel(dma_ch);
+
+    LOG_F(INFO, "Real time: %u frames/period (%.2f ms), %u frames/buf, %s",
+          period_frames, period_ns / 1.0e6, buf_frames,
+          guest_load ? "with guest load" : "idle guest");
+    report_latencies("  callback duration", durations);
+    report_latencies("  wakeup lateness  ", lateness);
+    LOG_F(INFO, "  underruns=%llu missed deadlines=%llu",
+          (unsigned long long)underruns, (unsigned long long)missed);
+}
+
+int main(int argc, char** argv) {
+    double   seconds       = 3.0;
+    uint32_t period_frames = 512;
+    uint64_t total_frames  = 1 << 22;
+    bool     guest_load    = false;
+
+    CLI::App app("Audio output pipeline benchmark");
+    app.add_option("-s,--seconds", seconds, "Duration of the real-time run");
+    app.add_option("-p,--period", period_frames, "Frames per host audio callback")
+        ->check(CLI::Range(16, 16384));
+    app.add_option("-f,--frames", total_frames, "Frames pulled by each maximum rate run");
+    app.add_flag("--guest-load", guest_load,
+        "Rewrite the sample buffers while the real-time run is active");
+
+    CLI11_PARSE(app, argc, argv);
+
+    /* initialize logging */
+    loguru::g_preamble_date    = false;
+    loguru::g_preamble_time    = false;
+    loguru::g_preamble_thread  = false;
+
+    loguru::g_stderr_verbosity = 0;
+    loguru::init(argc, argv);
+
+    SoundServer::set_null_sink(true);
+
+    // the codec looks up the sound server when constructed
+    gMachineObj.reset(new MachineBase("Benchmark"));
+    gMachineObj->add_device("SoundServer", std::unique_ptr<SoundServer>(new SoundServer()));
+
+    SoundServer* snd_server = dynamic_cast<SoundServer*>(
+        gMachineObj->get_comp_by_name("SoundServer"));
+
+    MemCtrlBase* mem_ctrl = new MemCtrlBase;
+    if (!mem_ctrl->add_ram_region(0, RAM_SIZE)) {
+        LOG_F(ERROR, "Could not allocate guest RAM");
+        return 1;
+    }
+    mem_ctrl_instance = mem_ctrl;
+
+    BenchIntCtrl  int_ctrl;
+    AwacsScreamer codec;
+    DMAChannel    dma_ch("snd_out");
+
+    codec.set_dma_out(&dma_ch);
+    dma_ch.set_callbacks(std::bind(&AwacsScreamer::dma_out_start, &codec),
+                         std::bind(&AwacsScreamer::dma_out_stop, &codec));
+    dma_ch.register_dma_int(&int_ctrl, 1);
+
+    // 44.1 kHz (sample rate ID 0)
+    codec.snd_ctrl_write(AWAC_SOUND_CTRL_REG, BYTESWAP_32(0 << 8), 4);
+
+    build_program(mem_ctrl, 1024);
+    start_channel(&dma_ch);
+    bool output_ok = verify_output(snd_server);
+    stop_channel(&dma_ch);
+
+    if (!output_ok) {
+        LOG_F(ERROR, "Sound output doesn't match the guest samples");
+        return 1;
+    }
+
+    LOG_F(INFO, "Maximum rate, %llu frames per run:", (unsigned long long)total_frames);
+
+    static const uint32_t buf_sizes[]  = {32, 256, 1024, 8192};
+    static const uint32_t pull_sizes[] = {128, 512, 2048};
+
+    for (uint32_t pull_frames : pull_sizes) {
+        std::vector<RateResult> results;
+
+        for (uint32_t buf_frames : buf_sizes)
+            results.push_back(run_max_rate(snd_server, &dma_ch, &int_ctrl, mem_ctrl,
+                                           buf_frames, pull_frames, total_frames));
+
+        // descriptor overhead: extra cost of the smallest buffers over the largest
+        double desc_ns = (results.front().ns_per_frame - results.back().ns_per_frame) *
+                         buf_sizes[0];
+        LOG_F(INFO, "  descriptor processing: ~%.1f ns/descriptor", std::max(desc_ns, 0.0));
+    }
+
+    run_real_time(snd_server, &dma_ch, mem_ctrl, 1024, period_frames, seconds, guest_load);
+
+    gMachineObj.reset();
+
+    return 0;
+}
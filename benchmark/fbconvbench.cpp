@@ -0,0 +1,295 @@
+/*
+DingusPPC - The Experimental PowerPC Macintosh emulator
+Copyright (C) 2018-23 divingkatae and maximum
+                      (theweirdo)     spatium
+
+(Contact divingkatae#1017 or powermax#2286 on Discord for more info)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file Framebuffer conversion benchmark.
+
+    Runs every framebuffer converter of VideoCtrlBase and PdmOnboardVideo
+    over synthetic VRAM at common Macintosh resolutions and reports the
+    conversion throughput and the per-frame cost relative to the refresh
+    budget. The display runs headless so no host window is created.
+ */
+
+#include <devices/memctrl/hmc.h>
+#include <devices/video/appleramdac.h>
+#include <devices/video/display.h>
+#include <devices/video/pdmonboard.h>
+#include <machines/machinebase.h>
+#include <thirdparty/loguru/loguru.hpp>
+
+#include <chrono>
+#include <cinttypes>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+typedef struct VideoMode {
+    int     width;
+    int     height;
+    float   refresh_rate;
+} VideoMode;
+
+static const VideoMode bench_modes[] = {
+    { 640,  480, 66.67f},
+    { 800,  600, 75.00f},
+    { 832,  624, 74.55f},
+    {1024,  768, 75.00f},
+    {1152,  870, 75.06f},
+    {1280, 1024, 75.00f},
+    {1600, 1200, 60.00f},
+};
+
+/** Video controller that exposes the converters for benchmarking.
+    It derives from PdmOnboardVideo so both the generic converters
+    and the Ariel-specific ones can be reached from here. */
+class BenchVideoCtrl : public PdmOnboardVideo {
+public:
+    BenchVideoCtrl() : PdmOnboardVideo() {};
+
+    void set_mode(const VideoMode& mode, int depth, uint8_t* fb_ptr, int fb_pitch) {
+        this->create_display_window(mode.width, mode.height);
+        this->pixel_depth  = depth;
+        this->refresh_rate = mode.refresh_rate;
+        this->fb_ptr       = fb_ptr;
+        this->fb_pitch     = fb_pitch;
+        this->blank_on     = false;
+        this->crtc_on      = true;
+    };
+
+    void set_converter(std::function<void(BenchVideoCtrl*, uint8_t*, int)> conv) {
+        this->convert_fb_cb = [this, conv](uint8_t *dst_buf, int dst_pitch) {
+            conv(this, dst_buf, dst_pitch);
+        };
+    };
+
+    void set_cursor_overlay(std::function<void(uint8_t *dst_buf, int dst_pitch)> ovl_cb) {
+        this->cursor_ovl_cb = ovl_cb;
+    };
+
+    // Ariel-specific converters are protected in PdmOnboardVideo
+    void pdm_1bpp(uint8_t *dst_buf, int dst_pitch) {
+        PdmOnboardVideo::convert_frame_1bpp_indexed(dst_buf, dst_pitch);
+    };
+    void pdm_2bpp(uint8_t *dst_buf, int dst_pitch) {
+        PdmOnboardVideo::convert_frame_2bpp_indexed(dst_buf, dst_pitch);
+    };
+    void pdm_4bpp(uint8_t *dst_buf, int dst_pitch) {
+        PdmOnboardVideo::convert_frame_4bpp_indexed(dst_buf, dst_pitch);
+    };
+};
+
+typedef struct ConverterDesc {
+    const char* name;
+    int         depth;  // bits per pixel in VRAM
+    std::function<void(BenchVideoCtrl*, uint8_t*, int)> func;
+} ConverterDesc;
+
+static const std::vector<ConverterDesc> converters = {
+    {"1bpp indexed", 1, [](BenchVideoCtrl* v, uint8_t* d, int p) {
+        v->VideoCtrlBase::convert_frame_1bpp_indexed(d, p); }},
+    {"2bpp indexed", 2, [](BenchVideoCtrl* v, uint8_t* d, int p) {
+        v->VideoCtrlBase::convert_frame_2bpp_indexed(d, p); }},
+    {"4bpp indexed", 4, [](BenchVideoCtrl* v, uint8_t* d, int p) {
+        v->VideoCtrlBase::convert_frame_4bpp_indexed(d, p); }},
+    {"8bpp indexed", 8, [](BenchVideoCtrl* v, uint8_t* d, int p) {
+        v->VideoCtrlBase::convert_frame_8bpp_indexed(d, p); }},
+    {"8bpp RGB332", 8, [](BenchVideoCtrl* v, uint8_t* d, int p) {
+        v->VideoCtrlBase::convert_frame_8bpp(d, p); }},
+    {"15bpp", 16, [](BenchVideoCtrl* v, uint8_t* d, int p) {
+        v->VideoCtrlBase::convert_frame_15bpp(d, p); }},
+    {"15bpp BE", 16, [](BenchVideoCtrl* v, uint8_t* d, int p) {
+        v->VideoCtrlBase::convert_frame_15bpp_BE(d, p); }},
+    {"16bpp", 16, [](BenchVideoCtrl* v, uint8_t* d, int p) {
+        v->VideoCtrlBase::convert_frame_16bpp(d, p); }},
+    {"24bpp", 24, [](BenchVideoCtrl* v, uint8_t* d, int p) {
+        v->VideoCtrlBase::convert_frame_24bpp(d, p); }},
+    {"32bpp", 32, [](BenchVideoCtrl* v, uint8_t* d, int p) {
+        v->VideoCtrlBase::convert_frame_32bpp(d, p); }},
+    {"32bpp BE", 32, [](BenchVideoCtrl* v, uint8_t* d, int p) {
+        v->VideoCtrlBase::convert_frame_32bpp_BE(d, p); }},
+    {"PDM 1bpp indexed", 1, [](BenchVideoCtrl* v, uint8_t* d, int p) {
+        v->pdm_1bpp(d, p); }},
+    {"PDM 2bpp indexed", 2, [](BenchVideoCtrl* v, uint8_t* d, int p) {
+        v->pdm_2bpp(d, p); }},
+    {"PDM 4bpp indexed", 4, [](BenchVideoCtrl* v, uint8_t* d, int p) {
+        v->pdm_4bpp(d, p); }},
+};
+
+/** Load the standard Macintosh 8-bit color table into the DAC palette. */
+static void load_mac_palette(VideoCtrlBase* vid) {
+    static const uint8_t ramp[10] = {0xEE, 0xDD, 0xBB, 0xAA, 0x88, 0x77, 0x55, 0x44, 0x22, 0x11};
+
+    // 6x6x6 color cube going from white to black
+    for (int i = 0; i < 215; i++) {
+        vid->set_palette_color(i, (5 - i / 36) * 0x33, (5 - (i / 6) % 6) * 0x33,
+                               (5 - i % 6) * 0x33, 0xFF);
+    }
+
+    // red, green, blue and gray ramps
+    for (int i = 0; i < 10; i++) {
+        vid->set_palette_color(215 + i, ramp[i], 0, 0, 0xFF);
+        vid->set_palette_color(225 + i, 0, ramp[i], 0, 0xFF);
+        vid->set_palette_color(235 + i, 0, 0, ramp[i], 0xFF);
+        vid->set_palette_color(245 + i, ramp[i], ramp[i], ramp[i], 0xFF);
+    }
+
+    vid->set_palette_color(255, 0, 0, 0, 0xFF);
+}
+
+/** Fill VRAM with desktop-like content: a dithered background pattern,
+    solid window areas and noisy "text" regions. */
+static void fill_vram(std::vector<uint8_t>& vram, int pitch, int height) {
+    std::mt19937 rng(0xCAFEBABE);
+
+    for (int y = 0; y < height; y++) {
+        uint8_t* row = &vram[(size_t)y * pitch];
+        for (int x = 0; x < pitch; x++) {
+            int region = ((y / 64) + (x / 96)) & 3;
+            switch (region) {
+            case 0: // desktop pattern
+                row[x] = (y & 1) ? 0xAA : 0x55;
+                break;
+            case 1: // window background
+                row[x] = 0x00;
+                break;
+            default: // window content
+                row[x] = rng() & 0xFF;
+            }
+        }
+    }
+}
+
+static inline uint64_t host_time_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/** Time update_screen() which is what the refresh task runs per frame. */
+static double measure_frame_ns(BenchVideoCtrl* vid, int num_pixels) {
+    // aim for ~100M converted pixels but at least 10 frames
+    int num_frames = std::max(10, 100000000 / num_pixels);
+
+    // warm-up run for cache fill etc.
+    for (int i = 0; i < 3; i++)
+        vid->update_screen();
+
+    uint64_t start_time = host_time_ns();
+    for (int i = 0; i < num_frames; i++)
+        vid->update_screen();
+    uint64_t elapsed = host_time_ns() - start_time;
+
+    return (double)elapsed / num_frames;
+}
+
+static void report(const char* name, const VideoMode& mode, double frame_ns) {
+    double budget_ns = 1e9 / mode.refresh_rate;
+    double mpix_s    = (double)mode.width * mode.height / frame_ns * 1e3;
+
+    LOG_F(INFO, "%-24s %4dx%-4d %8.1f Mpix/s %9.1f us/frame %6.2f%% of %.2f Hz budget",
+          name, mode.width, mode.height, mpix_s, frame_ns * 1e-3,
+          frame_ns * 100.0 / budget_ns, mode.refresh_rate);
+}
+
+int main(int argc, char** argv) {
+    /* initialize logging */
+    loguru::g_preamble_date    = false;
+    loguru::g_preamble_time    = false;
+    loguru::g_preamble_thread  = false;
+
+    loguru::g_stderr_verbosity = 0;
+    loguru::init(argc, argv);
+
+    // no host windows, frames are converted into an off-screen buffer
+    Display::set_headless(true);
+
+    // PdmOnboardVideo looks up the HMC when constructed
+    gMachineObj.reset(new MachineBase("Benchmark"));
+    gMachineObj->add_device("HMC", HMC::create());
+
+    std::unique_ptr<BenchVideoCtrl> vid = std::unique_ptr<BenchVideoCtrl>(new BenchVideoCtrl());
+
+    load_mac_palette(vid.get());
+
+    for (auto& mode : bench_modes) {
+        for (auto& conv : converters) {
+            int pitch = ((mode.width * conv.depth + 7) / 8 + 7) & ~7;
+            std::vector<uint8_t> vram((size_t)pitch * mode.height);
+
+            fill_vram(vram, pitch, mode.height);
+
+            vid->set_mode(mode, conv.depth, vram.data(), pitch);
+            vid->set_converter(conv.func);
+            vid->set_cursor_overlay(nullptr);
+
+            report(conv.name, mode, measure_frame_ns(vid.get(), mode.width * mode.height));
+        }
+    }
+
+    // software cursor compositing done by Platinum/Control via RaDACal/DACula
+    AppleRamdac dac(DacFlavour::DACULA);
+    dac.cursor_ctrl_cb = [](bool cursor_on) {};
+
+    // load cursor colors
+    dac.iodev_write(RamdacRegs::ADDRESS, 0);
+    for (int i = 0; i < 8; i++) {
+        dac.iodev_write(RamdacRegs::CURSOR_CLUT, i & 1 ? 0xFF : 0x00);
+        dac.iodev_write(RamdacRegs::CURSOR_CLUT, i & 2 ? 0xFF : 0x00);
+        dac.iodev_write(RamdacRegs::CURSOR_CLUT, i & 4 ? 0xFF : 0x00);
+    }
+
+    for (auto& mode : bench_modes) {
+        int pitch = mode.width;
+        std::vector<uint8_t> vram((size_t)pitch * mode.height);
+        std::vector<uint8_t> cursor_plane((size_t)pitch * mode.height, 0);
+
+        fill_vram(vram, pitch, mode.height);
+
+        // 32x32 arrow-like cursor with opaque, transparent and inverted pixels
+        int cur_y = mode.height / 2;
+        for (int y = 0; y < 32; y++) {
+            uint8_t* row = &cursor_plane[(size_t)(cur_y + y) * pitch];
+            for (int x = 0; x < 16; x++) {
+                row[x] = (x * 2 < y) ? 0x8F : ((x * 2 == y) ? 0x11 : 0x00);
+            }
+        }
+
+        int cur_x = mode.width / 2;
+        dac.iodev_write(RamdacRegs::ADDRESS, RamdacRegs::CURSOR_POS_LO);
+        dac.iodev_write(RamdacRegs::MULTI, cur_x & 0xFF);
+        dac.iodev_write(RamdacRegs::ADDRESS, RamdacRegs::CURSOR_POS_HI);
+        dac.iodev_write(RamdacRegs::MULTI, cur_x >> 8);
+        dac.set_fb_parameters(mode.width, mode.height, pitch);
+
+        vid->set_mode(mode, 8, vram.data(), pitch);
+        vid->set_converter(converters[3].func);
+        vid->set_cursor_overlay([&dac, &cursor_plane](uint8_t *dst_buf, int dst_pitch) {
+            dac.draw_hw_cursor(cursor_plane.data(), dst_buf, dst_pitch);
+        });
+
+        report("8bpp indexed + cursor", mode, measure_frame_ns(vid.get(), mode.width * mode.height));
+    }
+
+    vid.reset();
+    gMachineObj.reset();
+
+    return 0;
+}
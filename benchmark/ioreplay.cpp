@@ -0,0 +1,265 @@
+/*
+DingusPPC - The Experimental PowerPC Macintosh emulator
+Copyright (C) 2018-23 divingkatae and maximum
+                      (theweirdo)     spatium
+
+(Contact divingkatae#1017 or powermax#2286 on Discord for more info)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file Offline replay of device I/O traces.
+
+    Constructs the traced machine without running the CPU and drives the
+    captured devices with the MMIO accesses from a trace file recorded with
+    --io-trace. Virtual time follows the trace timestamps so that device
+    timers fire as they did during capture. Guest memory read by DBDMA is
+    restored from the trace shortly before it's needed.
+
+    Usage: ioreplay <trace file>
+ */
+
+#include <core/timermanager.h>
+#include <devices/common/hwcomponent.h>
+#include <devices/common/iotrace.h>
+#include <devices/common/mmiodevice.h>
+#include <devices/memctrl/memctrlbase.h>
+#include <devices/video/display.h>
+#include <machines/machinebase.h>
+#include <machines/machinefactory.h>
+#include <loguru.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+static uint64_t replay_time_ns = 0;
+
+static bool read_string(std::ifstream& f, std::string& str) {
+    uint16_t len;
+
+    if (!f.read((char*)&len, sizeof(len)))
+        return false;
+
+    str.resize(len);
+    return !!f.read(str.data(), len);
+}
+
+typedef struct TraceEvent {
+    IoTraceRecord   rec;
+    size_t          payload_offs;
+} TraceEvent;
+
+int main(int argc, char** argv) {
+    /* initialize logging */
+    loguru::g_preamble_date    = false;
+    loguru::g_preamble_time    = false;
+    loguru::g_preamble_thread  = false;
+
+    loguru::g_stderr_verbosity = 0;
+    loguru::init(argc, argv);
+
+    if (argc < 2) {
+        LOG_F(ERROR, "Usage: %s <trace file>", argv[0]);
+        return 1;
+    }
+
+    std::ifstream trace_file(argv[1], std::ios::in | std::ios::binary);
+    if (trace_file.fail()) {
+        LOG_F(ERROR, "Could not open trace file %s", argv[1]);
+        return 1;
+    }
+
+    char     magic[8];
+    uint32_t version, num_settings;
+    std::string machine_id;
+
+    trace_file.read(magic, sizeof(magic));
+    trace_file.read((char*)&version, sizeof(version));
+
+    if (!trace_file || std::memcmp(magic, IO_TRACE_MAGIC, 8) || version != IO_TRACE_VERSION) {
+        LOG_F(ERROR, "%s isn't a supported I/O trace file", argv[1]);
+        return 1;
+    }
+
+    read_string(trace_file, machine_id);
+    trace_file.read((char*)&num_settings, sizeof(num_settings));
+
+    std::map<std::string, std::string> trace_settings;
+
+    for (uint32_t i = 0; i < num_settings; i++) {
+        std::string name, value;
+        read_string(trace_file, name);
+        read_string(trace_file, value);
+        trace_settings[name] = value;
+    }
+
+    // slurp all records so that file I/O doesn't disturb the measurement
+    std::vector<TraceEvent> events;
+    std::vector<uint8_t>    payloads;
+    IoTraceRecord rec;
+
+    while (trace_file.read((char*)&rec, IO_TRACE_REC_SIZE)) {
+        size_t payload_offs = payloads.size();
+
+        if (rec.kind == IOT_SRC_DEF || rec.kind == IOT_DMA_MEM) {
+            payloads.resize(payload_offs + rec.value);
+            trace_file.read((char*)&payloads[payload_offs], rec.value);
+        }
+
+        events.push_back({rec, payload_offs});
+    }
+
+    if (events.empty()) {
+        LOG_F(ERROR, "Trace file contains no events");
+        return 1;
+    }
+
+    // construct the machine with the captured settings, no display needed
+    Display::set_headless(true);
+
+    std::map<std::string, std::string> settings;
+    if (MachineFactory::get_machine_settings(machine_id, settings) < 0)
+        return 1;
+
+    for (auto& s : settings) {
+        if (trace_settings.count(s.first))
+            s.second = trace_settings[s.first];
+    }
+
+    MachineFactory::set_machine_settings(settings);
+
+    if (MachineFactory::create(machine_id) < 0) {
+        LOG_F(ERROR, "Could not create machine %s", machine_id.c_str());
+        return 1;
+    }
+
+    // replace the CPU clock installed by ppc_cpu_init() with the trace clock
+    TimerManager* tm = TimerManager::get_instance();
+    tm->set_time_now_cb([]() { return replay_time_ns; });
+    tm->set_notify_changes_cb([]() {});
+
+    MemCtrlBase* mem_ctrl = dynamic_cast<MemCtrlBase*>(
+        gMachineObj->get_comp_by_type(HWCompType::MEM_CTRL));
+
+    // resolve trace sources to device objects
+    std::map<uint16_t, MMIODevice*> src_devs;
+
+    for (auto& ev : events) {
+        if (ev.rec.kind != IOT_SRC_DEF)
+            continue;
+
+        std::string name((const char*)&payloads[ev.payload_offs], ev.rec.value);
+        MMIODevice* dev = dynamic_cast<MMIODevice*>(gMachineObj->get_comp_by_dev_name(name));
+        if (dev)
+            src_devs[ev.rec.src] = dev;
+    }
+
+    // count the DMA transfers and interrupts the devices produce during replay
+    IoTracer::get_instance()->start("", machine_id, {});
+
+    uint64_t recorded[IOT_NUM_KINDS] = {};
+    uint64_t read_mismatches = 0, skipped = 0, staged_bytes = 0;
+    size_t   next_stage = 0;
+
+    // restore guest memory read by DMA until the next MMIO access in the trace
+    auto stage_dma_mem = [&](size_t from) {
+        for (next_stage = std::max(next_stage, from); next_stage < events.size(); next_stage++) {
+            const IoTraceRecord& r = events[next_stage].rec;
+            if (r.kind == IOT_MMIO_READ || r.kind == IOT_MMIO_WRITE)
+                break;
+            if (r.kind == IOT_DMA_MEM) {
+                mem_ctrl->set_data(r.addr, &payloads[events[next_stage].payload_offs], r.value);
+                staged_bytes += r.value;
+            }
+        }
+    };
+
+    stage_dma_mem(0);
+
+    replay_time_ns = events.front().rec.time_ns;
+
+    auto start_time = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < events.size(); i++) {
+        const IoTraceRecord& r = events[i].rec;
+
+        recorded[r.kind]++;
+
+        if (r.kind != IOT_MMIO_READ && r.kind != IOT_MMIO_WRITE)
+            continue;
+
+        auto dev_it = src_devs.find(r.src);
+        if (dev_it == src_devs.end()) {
+            skipped++;
+            continue;
+        }
+
+        stage_dma_mem(i + 1);
+
+        if (r.time_ns > replay_time_ns) {
+            replay_time_ns = r.time_ns;
+            tm->process_timers(replay_time_ns);
+        }
+
+        if (r.kind == IOT_MMIO_READ) {
+            if (dev_it->second->read(r.addr, r.offset, r.size) != r.value)
+                read_mismatches++;
+        } else {
+            dev_it->second->write(r.addr, r.offset, r.value, r.size);
+        }
+    }
+
+    // let pending device activity complete
+    replay_time_ns = events.back().rec.time_ns;
+    tm->process_timers(replay_time_ns);
+
+    auto end_time = std::chrono::steady_clock::now();
+
+    IoTracer* tracer = IoTracer::get_instance();
+
+    uint64_t host_ns  = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            end_time - start_time).count();
+    uint64_t virt_ns  = events.back().rec.time_ns - events.front().rec.time_ns;
+    uint64_t mmio_ops = recorded[IOT_MMIO_READ] + recorded[IOT_MMIO_WRITE] - skipped;
+
+    LOG_F(INFO, "Replayed %s trace: %zu events, %llu MMIO accesses (%llu skipped)",
+          machine_id.c_str(), events.size(), (unsigned long long)mmio_ops,
+          (unsigned long long)skipped);
+    LOG_F(INFO, "Host time: %.3f ms, %.1f ns per MMIO access, %.1fx faster than captured",
+          host_ns / 1e6, mmio_ops ? (double)host_ns / mmio_ops : 0.0,
+          host_ns ? (double)virt_ns / host_ns : 0.0);
+    LOG_F(INFO, "MMIO read mismatches: %llu", (unsigned long long)read_mismatches);
+    LOG_F(INFO, "DMA memory staged: %llu bytes", (unsigned long long)staged_bytes);
+    LOG_F(INFO, "DMA pulls:      recorded %llu, replayed %llu",
+          (unsigned long long)recorded[IOT_DMA_PULL],
+          (unsigned long long)tracer->get_count(IOT_DMA_PULL));
+    LOG_F(INFO, "DMA pushes:     recorded %llu, replayed %llu",
+          (unsigned long long)recorded[IOT_DMA_PUSH],
+          (unsigned long long)tracer->get_count(IOT_DMA_PUSH));
+    LOG_F(INFO, "Interrupts:     recorded %llu, replayed %llu",
+          (unsigned long long)(recorded[IOT_INT] + recorded[IOT_DMA_INT]),
+          (unsigned long long)(tracer->get_count(IOT_INT) + tracer->get_count(IOT_DMA_INT)));
+
+    tracer->stop();
+
+    delete gMachineObj.release();
+
+    return 0;
+}
@@ -0,0 +1,187 @@
+/*
+DingusPPC - The Experimental PowerPC Macintosh emulator
+Copyright (C) 2018-23 divingkatae and maximum
+                      (theweirdo)     spatium
+
+(Contact divingkatae#1017 or powermax#2286 on Discord for more info)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file Bare-metal kernels bundled with ppcrunner.
+
+    Images built from the sources in benchmark/ppckernels/, see common.inc
+    for the commands used. Every image is loaded and entered at
+    PPC_KERNEL_BASE and expects zero-filled memory past its end.
+ */
+
+#ifndef PPC_KERNELS_H
+#define PPC_KERNELS_H
+
+#include <cinttypes>
+
+#define PPC_KERNEL_BASE 0x10000
+
+static const uint32_t intmix_image[] = {
+    0x7C7C1B78, 0x2C1C0001, 0x40800008, 0x3B800001, 0x48000055, 0x48000099,
+    0x7C7D1B78, 0x48000119, 0x5463383E, 0x7FBD1A78, 0x3C600001, 0x386303C5,
+    0x480001ED, 0x7C7D1A14, 0x3C800001, 0x38841098, 0x38A00400, 0x480002B5,
+    0x7C7E1B78, 0x379CFFFF, 0x4082FFC0, 0x7FC3F378, 0x3C800001, 0x388403BC,
+    0x4800033C, 0x3C600001, 0x38630498, 0x38800000, 0x38A00100, 0x7CA903A6,
+    0x38C40049, 0x54C6063E, 0x54C61838, 0x7CC61A14, 0x54871838, 0x7CC3392E,
+    0x7D0421D6, 0x69085A5A, 0x7CE71A14, 0x91070004, 0x38840001, 0x4200FFD4,
+    0x4E800020, 0x3C600001, 0x38630498, 0x7C6B1B78, 0x38800000, 0x38A00400,
+    0x7CA903A6, 0x80C30004, 0x5484183E, 0x7C843214, 0x70870001, 0x4182000C,
+    0x38C60001, 0x90C30004, 0x80630000, 0x4200FFE0, 0x7D655B78, 0x80CB0000,
+    0x38E00100, 0x7CE903A6, 0x81060000, 0x90A60000, 0x7CC53378, 0x7D064378,
+    0x4200FFF0, 0x7D635B78, 0x38E00100, 0x7CE903A6, 0x80C30004, 0x7C843278,
+    0x5484083E, 0x80630000, 0x4200FFF0, 0x7C832378, 0x4E800020, 0x9421FFE0,
+    0xBF410008, 0x3F400001, 0x3B5A0C98, 0x3F600001, 0x3B7B0E98, 0x38600000,
+    0x38000100, 0x7C0903A6, 0x5464E13E, 0x5465073E, 0x1CC50003, 0x7CC62214,
+    0x38C6FFEC, 0x5467083C, 0x7CDA3B2E, 0x7CC429D6, 0x38C6FFF9, 0x7CDB3B2E,
+    0x38630001, 0x4200FFD4, 0x3F800001, 0x3B9C1098, 0x3BA00000, 0x3BC00000,
+    0x3BE00000, 0x38600000, 0x57C42834, 0x7C84D214, 0x57E5083C, 0x7CA5DA14,
+    0x38000010, 0x7C0903A6, 0xA8C40000, 0xA8E50000, 0x38840002, 0x38A50020,
+    0x7CC639D6, 0x7C633214, 0x4200FFE8, 0x907C0000, 0x3B9C0004, 0x38C0000D,
+    0x7CE333D6, 0x7D0731D6, 0x7D081850, 0x7FBD3A14, 0x7FBD4278, 0x3BFF0001,
+    0x2C1F0010, 0x4180FFA0, 0x3BDE0001, 0x2C1E0010, 0x4180FF90, 0x7FA3EB78,
+    0xBB410008, 0x38210020, 0x4E800020, 0x38800000, 0x38A00000, 0x38C00000,
+    0x38E00000, 0x89030000, 0x38630001, 0x2C080000, 0x418200B4, 0x3928FFD0,
+    0x28090009, 0x40810028, 0x2C08002E, 0x41820044, 0x2C080065, 0x41820050,
+    0x2C08002C, 0x41820070, 0x2C080020, 0x41820068, 0x48000058, 0x2C040004,
+    0x4182FFBC, 0x2C040000, 0x4082000C, 0x38800001, 0x38E70001, 0x1CA5000A,
+    0x7CA54A14, 0x4BFFFFA0, 0x2C040001, 0x4082002C, 0x38800002, 0x38E70001,
+    0x4BFFFF8C, 0x2C040001, 0x4182000C, 0x2C040002, 0x40820010, 0x38800003,
+    0x38E70001, 0x4BFFFF70, 0x38800004, 0x38E70001, 0x4BFFFF64, 0x2C040000,
+    0x4182FF5C, 0x54C6283E, 0x7CC62A14, 0x7CC62278, 0x38800000, 0x38A00000,
+    0x4BFFFF44, 0x54E7801E, 0x7CC33A78, 0x4E800020, 0x7C6318F8, 0x2C050000,
+    0x4182003C, 0x7CA903A6, 0x3CC0EDB8, 0x60C68320, 0x88E40000, 0x38840001,
+    0x7C633A78, 0x39000008, 0x70690001, 0x5463F87E, 0x41820008, 0x7C633278,
+    0x3508FFFF, 0x4082FFEC, 0x4200FFD8, 0x7C6318F8, 0x4E800020, 0x3D20F000,
+    0x89430000, 0x2C0A0000, 0x4D820020, 0x91490000, 0x38630001, 0x4BFFFFEC,
+    0x3D20F000, 0x39600008, 0x7D6903A6, 0x7C6C1B78, 0x558C203E, 0x558A073E,
+    0x280A000A, 0x41800008, 0x394A0027, 0x394A0030, 0x91490000, 0x4200FFE4,
+    0x3940000A, 0x91490000, 0x4E800020, 0x7C7F1B78, 0x7C832378, 0x4BFFFFA1,
+    0x7FE3FB78, 0x4BFFFFB5, 0x3D20F000, 0x93E90004, 0x48000000, 0x696E746D,
+    0x69783A20, 0x00353031, 0x322C312E, 0x3233342C, 0x2D383734, 0x2C2B3132,
+    0x322C3030, 0x302E3031, 0x322C3165, 0x332C392E, 0x3565372C, 0x31327833,
+    0x2C2C3333, 0x2E2C2020, 0x372C3078, 0x37462C31, 0x342E3065, 0x322C3831,
+    0x20322033, 0x20342C31, 0x2E322E33, 0x2C65372C, 0x39393065, 0x2C353535,
+    0x342C3137, 0x2E31372C, 0x3665362C, 0x34303936, 0x2C363535, 0x33362C31,
+    0x2E352C30, 0x2E32352C, 0x302E3132, 0x352C3320, 0x31342031, 0x35392032,
+    0x362C3533, 0x352E3839, 0x37396533, 0x2C782C32, 0x37312E38, 0x32382C31,
+    0x382C3238, 0x2C343539, 0x2C302E30, 0x34352C32, 0x33353336, 0x2C303238,
+    0x372E342C, 0x37313335, 0x2C323665, 0x362C3234, 0x39372000
+};
+
+static const uint32_t fpmix_image[] = {
+    0x7C7C1B78, 0x2C1C0001, 0x40800008, 0x3B800001, 0x3F600001, 0x3B7B0328,
+    0x3BA00000, 0x4800006D, 0x480000E5, 0x48000139, 0xC85B0010, 0x48000041,
+    0x4800015D, 0xC85B0048, 0x48000035, 0x48000199, 0xC85B0050, 0x48000029,
+    0x48000225, 0xC85B0048, 0x4800001D, 0x379CFFFF, 0x4082FFC0, 0x7FA3EB78,
+    0x3C800001, 0x38840380, 0x4800029C, 0xFC2100B2, 0xFC20081E, 0xD821FFF8,
+    0x8061FFFC, 0x57BD483E, 0x7FBD1A78, 0x4E800020, 0x3C604330, 0x9061FFF8,
+    0xC9BB0000, 0xC99B0008, 0xC97B0010, 0xC95B0018, 0x3C800001, 0x38840388,
+    0x3CA00001, 0x38A51388, 0x38C00000, 0x38000200, 0x7C0903A6, 0x6CC78000,
+    0x90E1FFFC, 0xC801FFF8, 0xFC006828, 0xFC205B3A, 0xD8240000, 0x20E60200,
+    0x6CE78000, 0x90E1FFFC, 0xC801FFF8, 0xFC006828, 0xFC005024, 0xD8050000,
+    0x38840008, 0x38A50008, 0x38C60001, 0x4200FFC0, 0x4E800020, 0xC83B0020,
+    0x38C00008, 0x3C800001, 0x38840388, 0x3CA00001, 0x38A51388, 0x38000100,
+    0x7C0903A6, 0xC8440000, 0xC8640008, 0xC8850000, 0xC8A50008, 0xFC8120BA,
+    0xFCA128FA, 0xD8850000, 0xD8A50008, 0x38840010, 0x38A50010, 0x4200FFD8,
+    0x34C6FFFF, 0x4082FFB8, 0x4E800020, 0x3C800001, 0x38840380, 0x3CA00001,
+    0x38A51380, 0xFC210828, 0x38000200, 0x7C0903A6, 0xCC440008, 0xCC650008,
+    0xFC2208FA, 0x4200FFF4, 0x4E800020, 0xC99B0008, 0xFC210828, 0x3CA00001,
+    0x38A51388, 0x38C00080, 0xC8450000, 0xFC62633A, 0x38000008, 0x7C0903A6,
+    0xFC821824, 0xFC84182A, 0xFC640332, 0x4200FFF4, 0xFC21182A, 0x38A50008,
+    0x34C6FFFF, 0x4082FFD4, 0x4E800020, 0xC99B0008, 0xC97B0028, 0x3D400001,
+    0x394A0388, 0x38EA1000, 0x38C00008, 0x7D445378, 0x54C0E8FE, 0x7C0903A6,
+    0x7C882378, 0x7D243214, 0xC8480000, 0xC8690000, 0xFC6302F2, 0xFC82182A,
+    0xFCA21828, 0xFC840332, 0xFCA50332, 0xD8880000, 0xD8A90000, 0x39080008,
+    0x39290008, 0x4200FFD4, 0x54C0083C, 0x7C840214, 0x7C043840, 0x4180FFB4,
+    0x54C6083C, 0x28061000, 0x4180FFA4, 0xFC210828, 0x388AFFF8, 0x38000200,
+    0x7C0903A6, 0xCC440008, 0xFC21102A, 0x4200FFF8, 0x4E800020, 0xC95B0030,
+    0xC97B0038, 0xC99B0040, 0xC9BB0010, 0xFC210828, 0x3CA00001, 0x38A51380,
+    0x38000200, 0x7C0903A6, 0xCC450008, 0xFC6A58BA, 0xFC6360BA, 0xFC6368BA,
+    0xFC21182A, 0x4200FFEC, 0x4E800020, 0x3D20F000, 0x89430000, 0x2C0A0000,
+    0x4D820020, 0x91490000, 0x38630001, 0x4BFFFFEC, 0x3D20F000, 0x39600008,
+    0x7D6903A6, 0x7C6C1B78, 0x558C203E, 0x558A073E, 0x280A000A, 0x41800008,
+    0x394A0027, 0x394A0030, 0x91490000, 0x4200FFE4, 0x3940000A, 0x91490000,
+    0x4E800020, 0x7C7F1B78, 0x7C832378, 0x4BFFFFA1, 0x7FE3FB78, 0x4BFFFFB5,
+    0x3D20F000, 0x93E90004, 0x48000000, 0x00000000, 0x43300000, 0x80000000,
+    0x3FE00000, 0x00000000, 0x3FF00000, 0x00000000, 0x40080000, 0x00000000,
+    0x3FEFF7CE, 0xD916872B, 0x3FE6A09E, 0x667F3BCD, 0x3EB0C6F7, 0xA0B5ED8D,
+    0xBF50624D, 0xD2F1A9FC, 0x3FE00000, 0x00000000, 0x408F4000, 0x00000000,
+    0x412E8480, 0x00000000, 0x66706D69, 0x783A2000
+};
+
+static const uint32_t strmix_image[] = {
+    0x7C7C1B78, 0x2C1C0001, 0x40800008, 0x3B800001, 0x3C600001, 0x38632000,
+    0x38804000, 0x48000099, 0x3B600000, 0x3C600002, 0x38632000, 0x7C63DA14,
+    0x3C800001, 0x38842000, 0x1CBB0003, 0x54A5077E, 0x7C842A14, 0x3CA00000,
+    0x60A5FFF0, 0x48000091, 0x3B7B0004, 0x2C1B0008, 0x4180FFCC, 0x3B7BFFF9,
+    0x2C1B0004, 0x4180FFC0, 0x3C600002, 0x38632000, 0x38804000, 0x480000D5,
+    0x7C7D1B78, 0x3B600008, 0x48000149, 0x57BD583E, 0x7FBD1A78, 0x377BFFFF,
+    0x4082FFF0, 0x480000FD, 0x7FDD1A14, 0x379CFFFF, 0x4082FF70, 0x7FC3F378,
+    0x3C800001, 0x38840304, 0x48000234, 0x7C8903A6, 0x3863FFFC, 0x3CA00123,
+    0x60A54567, 0x3CC09E37, 0x60C679B9, 0x94A30004, 0x7CA53214, 0x4200FFF8,
+    0x4E800020, 0x7C602378, 0x70000003, 0x40820040, 0x54A0E13F, 0x41820034,
+    0x7C0903A6, 0x80C40000, 0x80E40004, 0x81040008, 0x8124000C, 0x90C30000,
+    0x90E30004, 0x91030008, 0x9123000C, 0x38840010, 0x38630010, 0x4200FFD8,
+    0x54A5073E, 0x2C050000, 0x4D820020, 0x7CA903A6, 0x3884FFFF, 0x3863FFFF,
+    0x8CC40001, 0x9CC30001, 0x4200FFF8, 0x4E800020, 0x7C8903A6, 0x3883FFFC,
+    0x38600000, 0x84A40004, 0x5463083E, 0x7C632A14, 0x4200FFF4, 0x4E800020,
+    0x88A30000, 0x88C40000, 0x38630001, 0x38840001, 0x7CE62851, 0x4082000C,
+    0x2C050000, 0x4082FFE4, 0x7CE33B78, 0x4E800020, 0x3C800001, 0x38840490,
+    0x38600000, 0x38000020, 0x7C0903A6, 0x84A40004, 0x38A5FFFF, 0x8CC50001,
+    0x2C060000, 0x4182000C, 0x38630001, 0x4BFFFFF0, 0x4200FFE4, 0x4E800020,
+    0x7C0802A6, 0x9421FFD0, 0x90010034, 0xBF010010, 0x3F000001, 0x3B181000,
+    0x3C600001, 0x38630490, 0x38B8FFFC, 0x38000020, 0x7C0903A6, 0x84C30004,
+    0x94C50004, 0x4200FFF8, 0x3B200001, 0x5720103A, 0x7F58002E, 0x7F3BCB78,
+    0x2C1B0000, 0x41820030, 0x5760103A, 0x7F980214, 0x83DCFFFC, 0x7FC3F378,
+    0x7F44D378, 0x4BFFFF3D, 0x2C030000, 0x40810010, 0x93DC0000, 0x3B7BFFFF,
+    0x4BFFFFD0, 0x5760103A, 0x7F58012E, 0x3B390001, 0x2C190020, 0x4180FFB0,
+    0x38600000, 0x38B8FFFC, 0x38000020, 0x7C0903A6, 0x84C50004, 0x5463283E,
+    0x7C633278, 0x4200FFF4, 0xBB010010, 0x80010034, 0x38210030, 0x7C0803A6,
+    0x4E800020, 0x3D20F000, 0x89430000, 0x2C0A0000, 0x4D820020, 0x91490000,
+    0x38630001, 0x4BFFFFEC, 0x3D20F000, 0x39600008, 0x7D6903A6, 0x7C6C1B78,
+    0x558C203E, 0x558A073E, 0x280A000A, 0x41800008, 0x394A0027, 0x394A0030,
+    0x91490000, 0x4200FFE4, 0x3940000A, 0x91490000, 0x4E800020, 0x7C7F1B78,
+    0x7C832378, 0x4BFFFFA1, 0x7FE3FB78, 0x4BFFFFB5, 0x3D20F000, 0x93E90004,
+    0x48000000, 0x7374726D, 0x69783A20, 0x00717569, 0x636B736F, 0x72740068,
+    0x65617073, 0x6F727400, 0x6D657267, 0x65736F72, 0x7400696E, 0x73657274,
+    0x696F6E00, 0x73656C65, 0x6374696F, 0x6E006275, 0x62626C65, 0x736F7274,
+    0x00717569, 0x636B7365, 0x6C656374, 0x00686561, 0x70696679, 0x006D656D,
+    0x63707900, 0x6D656D6D, 0x6F766500, 0x6D656D73, 0x6574006D, 0x656D636D,
+    0x70007374, 0x72636D70, 0x00737472, 0x6E636D70, 0x00737472, 0x63707900,
+    0x7374726E, 0x63707900, 0x7374726C, 0x656E0073, 0x74726E6C, 0x656E0073,
+    0x74726368, 0x72007374, 0x72726368, 0x7200696E, 0x74657272, 0x7570745F,
+    0x68616E64, 0x6C65725F, 0x3000696E, 0x74657272, 0x7570745F, 0x68616E64,
+    0x6C65725F, 0x3100696E, 0x74657272, 0x7570745F, 0x68616E64, 0x6C65725F,
+    0x31300069, 0x6E746572, 0x72757074, 0x5F636F6E, 0x74726F6C, 0x6C657200,
+    0x506F7765, 0x724D6163, 0x696E746F, 0x73680050, 0x6F776572, 0x426F6F6B,
+    0x00506572, 0x666F726D, 0x6100506F, 0x77657220, 0x4D616369, 0x6E746F73,
+    0x68204733, 0x00506F77, 0x6572204D, 0x6163696E, 0x746F7368, 0x20363130,
+    0x3000506F, 0x77657220, 0x4D616369, 0x6E746F73, 0x68203735, 0x30300050,
+    0x6F776572, 0x204D6163, 0x696E746F, 0x73682037, 0x33303000, 0x506F7765,
+    0x72204D61, 0x63696E74, 0x6F736820, 0x36313030, 0x2F363600, 0x0001030D,
+    0x00010317, 0x00010320, 0x0001032A, 0x00010334, 0x0001033E, 0x00010349,
+    0x00010355, 0x0001035D, 0x00010364, 0x0001036C, 0x00010373, 0x0001037A,
+    0x00010381, 0x00010389, 0x00010390, 0x00010398, 0x0001039F, 0x000103A7,
+    0x000103AE, 0x000103B6, 0x000103CA, 0x000103DE, 0x000103F3, 0x00010408,
+    0x00010417, 0x00010421, 0x0001042A, 0x0001043D, 0x00010452, 0x00010467,
+    0x0001047C
+};
+
+#endif // PPC_KERNELS_H
@@ -0,0 +1,546 @@
+/*
+DingusPPC - The Experimental PowerPC Macintosh emulator
+Copyright (C) 2018-23 divingkatae and maximum
+                      (theweirdo)     spatium
+
+(Contact divingkatae#1017 or powermax#2286 on Discord for more info)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file Bare-metal PowerPC workload runner.
+
+    Loads a statically linked big-endian PowerPC ELF executable or a raw
+    binary into a minimal machine consisting of RAM, a memory controller
+    and a tiny I/O port, and runs it through ppc_exec(). Without a program
+    argument, the kernels bundled in ppckernels.h are run instead and
+    their checksums are verified.
+
+    Programs are entered in supervisor mode with the iteration count in r3
+    and the stack pointer in r1. The I/O port at RUNNER_PORT_BASE provides:
+      +0 CONSOLE  write: print the character in the low byte
+      +4 EXIT     write: stop the program with the given exit code
+      +8 FAULT    written by the exception stubs: exception vector offset
+    Execution stops at the next branch following a write to EXIT.
+
+    Every run reports guest MIPS, host nanoseconds per guest instruction
+    and the rate of SoftTLB refills.
+
+    Usage: ppcrunner [options] [program]
+ */
+
+#include <core/timermanager.h>
+#include <cpu/ppc/ppcemu.h>
+#include <cpu/ppc/ppcmmu.h>
+#include <devices/common/mmiodevice.h>
+#include <devices/memctrl/memctrlbase.h>
+#include <memaccess.h>
+#include "ppckernels.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <CLI11.hpp>
+#include <loguru.hpp>
+
+#define RUNNER_PORT_BASE    0xF0000000
+#define RUNNER_PORT_SIZE    0x1000
+
+enum RunnerPortReg : uint32_t {
+    PORT_CONSOLE    = 0,
+    PORT_EXIT       = 4,
+    PORT_FAULT      = 8,
+};
+
+/** Console and exit port of the runner machine. */
+class RunnerPort : public MMIODevice {
+public:
+    RunnerPort() {
+        this->name = "RunnerPort";
+        supports_types(HWCompType::MMIO_DEV);
+    };
+    ~RunnerPort() = default;
+
+    uint32_t read(uint32_t rgn_start, uint32_t offset, int size) override {
+        return 0;
+    };
+
+    void write(uint32_t rgn_start, uint32_t offset, uint32_t value, int size) override {
+        switch (offset) {
+        case PORT_CONSOLE:
+            if ((value & 0xFF) == '\n') {
+                if (!this->quiet)
+                    LOG_F(INFO, "guest: %s", this->line.c_str());
+                this->line.clear();
+            } else {
+                this->line.push_back(value & 0xFF);
+            }
+            break;
+        case PORT_EXIT:
+            this->exit_code = value;
+            this->stopped = true;
+            power_on = false;
+            break;
+        case PORT_FAULT:
+            this->fault_vec = value;
+            this->stopped = true;
+            power_on = false;
+            break;
+        }
+    };
+
+    void reset() {
+        this->line.clear();
+        this->stopped   = false;
+        this->exit_code = 0;
+        this->fault_vec = 0;
+    };
+
+    bool        quiet     = false;
+    bool        stopped   = false;
+    uint32_t    exit_code = 0;
+    uint32_t    fault_vec = 0;
+
+private:
+    std::string line;
+};
+
+enum class MmuMode { REAL, BAT, PAGE_TABLE };
+
+/** Loadable part of a guest program. */
+typedef struct Segment {
+    uint32_t                addr;
+    std::vector<uint8_t>    data; // zero-padded to the memory size
+} Segment;
+
+typedef struct GuestProgram {
+    std::string             name;
+    std::vector<Segment>    segments;
+    uint32_t                entry = 0;
+} GuestProgram;
+
+/** Kernels bundled with the runner. */
+typedef struct BuiltinKernel {
+    const char*     name;
+    const char*     descr;
+    const uint32_t* image;
+    size_t          image_size;
+    uint32_t        mem_size;   // image plus zero-filled data
+    uint32_t        iterations;
+    uint32_t        checksum;
+} BuiltinKernel;
+
+static const BuiltinKernel builtin_kernels[] = {
+    {"intmix", "CoreMark/Dhrystone-style integer mix", intmix_image,
+        sizeof(intmix_image), 0x1498, 200, 0x62D3DAE1},
+    {"fpmix", "Linpack/FFT-style floating-point mix", fpmix_image,
+        sizeof(fpmix_image), 0x2388, 200, 0xA02ECD5F},
+    {"strmix", "memcpy/strcmp-heavy string mix", strmix_image,
+        sizeof(strmix_image), 0x22010, 20, 0xC4AE0A43},
+};
+
+static GuestProgram load_builtin(const BuiltinKernel& kernel) {
+    GuestProgram prog;
+    Segment      seg;
+
+    prog.name  = kernel.name;
+    prog.entry = PPC_KERNEL_BASE;
+
+    seg.addr = PPC_KERNEL_BASE;
+    seg.data.resize(kernel.mem_size, 0);
+    for (size_t i = 0; i < kernel.image_size / 4; i++) {
+        WRITE_DWORD_BE_A(&seg.data[i * 4], kernel.image[i]);
+    }
+    prog.segments.push_back(std::move(seg));
+
+    return prog;
+}
+
+static bool load_elf(const std::vector<uint8_t>& file, GuestProgram& prog) {
+    const uint8_t* hdr = file.data();
+
+    if (file.size() < 52 || memcmp(hdr, "\x7F" "ELF", 4) != 0) {
+        LOG_F(ERROR, "Not an ELF file, use --raw for raw binaries");
+        return false;
+    }
+
+    if (hdr[4] != 1 || hdr[5] != 2) {
+        LOG_F(ERROR, "Only 32-bit big-endian ELF files are supported");
+        return false;
+    }
+    if (READ_WORD_BE_U(&hdr[16]) != 2 || READ_WORD_BE_U(&hdr[18]) != 20) {
+        LOG_F(ERROR, "Not a statically linked PowerPC executable");
+        return false;
+    }
+
+    prog.entry = READ_DWORD_BE_U(&hdr[24]);
+
+    uint32_t ph_offs  = READ_DWORD_BE_U(&hdr[28]);
+    uint16_t ph_size  = READ_WORD_BE_U(&hdr[42]);
+    uint16_t ph_count = READ_WORD_BE_U(&hdr[44]);
+
+    for (int i = 0; i < ph_count; i++) {
+        uint64_t ph_pos = (uint64_t)ph_offs + i * ph_size;
+        if (ph_pos + 32 > file.size()) {
+            LOG_F(ERROR, "Truncated ELF program header table");
+            return false;
+        }
+        const uint8_t* ph = &file[ph_pos];
+
+        if (READ_DWORD_BE_U(&ph[0]) != 1) // PT_LOAD
+            continue;
+
+        uint32_t offset = READ_DWORD_BE_U(&ph[4]);
+        uint32_t paddr  = READ_DWORD_BE_U(&ph[12]);
+        uint32_t filesz = READ_DWORD_BE_U(&ph[16]);
+        uint32_t memsz  = READ_DWORD_BE_U(&ph[20]);
+
+        if (!memsz)
+            continue;
+        if (filesz > memsz || (uint64_t)offset + filesz > file.size()) {
+            LOG_F(ERROR, "Invalid ELF segment at 0x%08X", paddr);
+            return false;
+        }
+
+        Segment seg;
+        seg.addr = paddr;
+        seg.data.resize(memsz, 0);
+        std::copy_n(file.begin() + offset, filesz, seg.data.begin());
+        prog.segments.push_back(std::move(seg));
+    }
+
+    if (prog.segments.empty()) {
+        LOG_F(ERROR, "ELF file contains no loadable segments");
+        return false;
+    }
+
+    return true;
+}
+
+static bool load_program(const std::string& path, bool is_raw, uint32_t load_addr,
+                         uint32_t entry, GuestProgram& prog) {
+    std::ifstream f(path, std::ios::in | std::ios::binary);
+    if (!f) {
+        LOG_F(ERROR, "Could not open %s", path.c_str());
+        return false;
+    }
+    std::vector<uint8_t> file((std::istreambuf_iterator<char>(f)),
+                              std::istreambuf_iterator<char>());
+
+    prog.name = path;
+
+    if (!is_raw)
+        return load_elf(file, prog);
+
+    Segment seg;
+    seg.addr = load_addr;
+    seg.data = std::move(file);
+    prog.segments.push_back(std::move(seg));
+    prog.entry = entry;
+
+    return true;
+}
+
+/** Set up a BAT pair, 'bl' is the block length mask, 'lower' holds WIMG and PP. */
+static void set_bat_pair(int spr_num, uint32_t ea, uint32_t bl, uint32_t lower) {
+    ppc_state.spr[spr_num]     = ea | (bl << 2) | 3; // Vs = Vp = 1
+    ppc_state.spr[spr_num + 1] = ea | lower;
+}
+
+/** Insert an identity mapping for the page at 'ea' into the hashed page table. */
+static bool map_page(uint8_t* htab, uint32_t htab_size, uint32_t ea, uint32_t wimg) {
+    uint32_t vsid       = ea >> 28; // SR[n] holds VSID n
+    uint32_t page_index = (ea >> 12) & 0xFFFF;
+    uint32_t hash       = vsid ^ page_index;
+
+    for (int h = 0; h < 2; h++, hash = ~hash) {
+        uint8_t* pte = htab + ((hash << 6) & (htab_size - 1));
+        for (int i = 0; i < 8; i++, pte += 8) {
+            if (READ_DWORD_BE_A(pte) & 0x80000000)
+                continue;
+            WRITE_DWORD_BE_A(pte, 0x80000000 | (vsid << 7) | (h << 6) | (page_index >> 10));
+            // R and C set, PP = 2 (read/write)
+            WRITE_DWORD_BE_A(pte + 4, (ea & 0xFFFFF000) | 0x180 | (wimg << 3) | 2);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/** Prepare the address translation mode requested by the user.
+    Returns the upper limit of memory available to the program. */
+static uint32_t setup_mmu(MemCtrlBase* mem_ctrl, MmuMode mode, uint32_t ram_size) {
+    if (mode == MmuMode::BAT) {
+        uint32_t bl = 0;
+        while (((bl << 17) | 0x1FFFF) < ram_size - 1 && bl < 0x7FF)
+            bl = (bl << 1) | 1;
+        set_bat_pair(528, 0, bl, 2);                              // IBAT0: RAM
+        set_bat_pair(536, 0, bl, 2);                              // DBAT0: RAM
+        set_bat_pair(538, RUNNER_PORT_BASE, 0, (0x5 << 3) | 2);  // DBAT1: I/O, I+G
+        for (int i = 528; i < 540; i++)
+            (i < 536 ? ibat_update : dbat_update)(i);
+    } else if (mode == MmuMode::PAGE_TABLE) {
+        // hash table with room for two PTEs per page, 64 KB minimum
+        uint32_t htab_size = 0x10000;
+        while (htab_size < (ram_size >> 12) * 16)
+            htab_size <<= 1;
+        uint32_t htab_base = (ram_size & ~(htab_size - 1)) - htab_size;
+        AddressMapEntry* ram = mem_ctrl->find_range(htab_base);
+        uint8_t* htab = ram->mem_ptr + (htab_base - ram->start);
+
+        for (uint32_t ea = 0; ea < ram_size; ea += 4096) {
+            if (!map_page(htab, htab_size, ea, 0)) {
+                LOG_F(ERROR, "Page table overflow at 0x%08X", ea);
+                return 0;
+            }
+        }
+        map_page(htab, htab_size, RUNNER_PORT_BASE, 0x5); // I+G
+
+        for (int i = 0; i < 16; i++)
+            ppc_state.sr[i] = i;
+        ppc_state.spr[SPR::SDR1] = htab_base | ((htab_size >> 16) - 1);
+        mmu_pat_ctx_changed();
+        ram_size = htab_base;
+    }
+
+    do_ctx_sync();
+    return ram_size;
+}
+
+/** Place stubs reporting the vector offset to the runner port at every
+    exception vector so that faulting programs stop instead of running away. */
+static void install_exception_stubs() {
+    for (uint32_t vec = 0x100; vec <= 0x1700; vec += 0x100) {
+        mmu_write_vmem<uint32_t>(vec +  0, 0x3C600000 | (RUNNER_PORT_BASE >> 16)); // lis r3, port@h
+        mmu_write_vmem<uint32_t>(vec +  4, 0x38800000 | vec);          // li r4, vec
+        mmu_write_vmem<uint32_t>(vec +  8, 0x90830000 | PORT_FAULT);   // stw r4, FAULT(r3)
+        mmu_write_vmem<uint32_t>(vec + 12, 0x48000000);                // b .
+    }
+}
+
+typedef struct RunStats {
+    uint64_t    instrs;
+    uint64_t    host_ns;
+    uint64_t    itlb_refills;
+    uint64_t    dtlb_refills;
+} RunStats;
+
+static bool run_program(MemCtrlBase* mem_ctrl, RunnerPort* port, const GuestProgram& prog,
+                        uint32_t msr, uint32_t stack_top, uint32_t iterations,
+                        RunStats& stats) {
+    for (auto& seg : prog.segments) {
+        AddressMapEntry* ram = mem_ctrl->find_range(seg.addr);
+        if (!ram || !(ram->type & RT_RAM) || seg.addr + seg.data.size() - 1 > ram->end ||
+            seg.addr + seg.data.size() > stack_top) {
+            LOG_F(ERROR, "Segment at 0x%08X doesn't fit into RAM", seg.addr);
+            return false;
+        }
+        std::memcpy(ram->mem_ptr + (seg.addr - ram->start), seg.data.data(), seg.data.size());
+    }
+
+    std::memset(ppc_state.gpr, 0, sizeof(ppc_state.gpr));
+    ppc_state.gpr[1] = stack_top - 64;
+    ppc_state.gpr[3] = iterations;
+    ppc_state.cr     = 0;
+    ppc_state.spr[SPR::LR]  = 0;
+    ppc_state.spr[SPR::XER] = 0;
+    ppc_state.msr    = msr;
+    mmu_change_mode();
+    ppc_state.pc     = prog.entry;
+
+    port->reset();
+    power_on = true;
+
+    uint64_t start_icycles = g_icycles;
+    uint64_t start_itlb    = num_itlb_refills;
+    uint64_t start_dtlb    = num_dtlb_refills;
+    auto     start_time    = std::chrono::steady_clock::now();
+
+    ppc_exec();
+
+    auto end_time = std::chrono::steady_clock::now();
+
+    stats.instrs       = g_icycles - start_icycles;
+    stats.host_ns      = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             end_time - start_time).count();
+    stats.itlb_refills = num_itlb_refills - start_itlb;
+    stats.dtlb_refills = num_dtlb_refills - start_dtlb;
+
+    if (port->fault_vec) {
+        LOG_F(ERROR, "%s: exception 0x%04X at 0x%08X", prog.name.c_str(),
+              port->fault_vec, ppc_state.spr[SPR::SRR0]);
+        return false;
+    }
+    if (!port->stopped) {
+        LOG_F(ERROR, "%s: execution stopped without an exit request", prog.name.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+static void report_stats(const std::string& name, const char* label, const RunStats& stats) {
+    double instrs = stats.instrs ? (double)stats.instrs : 1.0;
+
+    LOG_F(INFO, "%s %s: %llu instrs in %.3f ms, %.1f MIPS, %.2f ns/instr, "
+          "ITLB refills %llu (%.2f per 1M), DTLB refills %llu (%.2f per 1M)",
+          name.c_str(), label, (unsigned long long)stats.instrs,
+          stats.host_ns / 1.0e6, stats.instrs * 1.0e3 / std::max<uint64_t>(stats.host_ns, 1),
+          stats.host_ns / instrs,
+          (unsigned long long)stats.itlb_refills, stats.itlb_refills * 1.0e6 / instrs,
+          (unsigned long long)stats.dtlb_refills, stats.dtlb_refills * 1.0e6 / instrs);
+}
+
+int main(int argc, char** argv) {
+    std::string program_path;
+    std::string mmu_mode_str = "real";
+    std::vector<std::string> kernel_names;
+    bool        is_raw     = false;
+    uint32_t    load_addr  = 0x10000;
+    uint32_t    entry      = 0;
+    uint32_t    ram_mb     = 32;
+    uint32_t    iterations = 0;
+    int         num_runs   = 5;
+
+    CLI::App app("Bare-metal PowerPC workload runner");
+    app.add_option("program", program_path,
+        "ELF executable or raw binary to run instead of the bundled kernels")
+        ->check(CLI::ExistingFile);
+    app.add_flag("--raw", is_raw, "Load the program as a raw binary");
+    app.add_option("--load-addr", load_addr, "Load address of a raw binary");
+    app.add_option("--entry", entry, "Entry point of a raw binary (default: load address)");
+    app.add_option("--mmu", mmu_mode_str, "Address translation: real, bat or pagetable")
+        ->check(CLI::IsMember({"real", "bat", "pagetable"}));
+    app.add_option("--ram", ram_mb, "RAM size in MB")
+        ->check(CLI::Range(1, 2047));
+    app.add_option("-k,--kernel", kernel_names, "Bundled kernels to run (default: all)");
+    app.add_option("-i,--iterations", iterations, "Iteration count passed in r3");
+    app.add_option("-r,--runs", num_runs, "Number of timed runs")
+        ->check(CLI::Range(1, 1000));
+
+    CLI11_PARSE(app, argc, argv);
+
+    /* initialize logging */
+    loguru::g_preamble_date    = false;
+    loguru::g_preamble_time    = false;
+    loguru::g_preamble_thread  = false;
+
+    loguru::g_stderr_verbosity = 0;
+    loguru::init(argc, argv);
+
+    MmuMode mmu_mode = mmu_mode_str == "bat" ? MmuMode::BAT :
+        mmu_mode_str == "pagetable" ? MmuMode::PAGE_TABLE : MmuMode::REAL;
+
+    std::vector<std::pair<GuestProgram, const BuiltinKernel*>> programs;
+
+    if (!program_path.empty()) {
+        GuestProgram prog;
+        if (!load_program(program_path, is_raw, load_addr, entry ? entry : load_addr, prog))
+            return 1;
+        programs.push_back({std::move(prog), nullptr});
+    } else {
+        for (auto& kernel : builtin_kernels) {
+            if (kernel_names.empty() || std::find(kernel_names.begin(),
+                kernel_names.end(), kernel.name) != kernel_names.end())
+                programs.push_back({load_builtin(kernel), &kernel});
+        }
+        if (programs.empty()) {
+            LOG_F(ERROR, "No such bundled kernel");
+            return 1;
+        }
+    }
+
+    uint32_t ram_size = ram_mb << 20;
+
+    MemCtrlBase* mem_ctrl = new MemCtrlBase;
+    RunnerPort*  port     = new RunnerPort;
+
+    if (!mem_ctrl->add_ram_region(0, ram_size) ||
+        !mem_ctrl->add_mmio_region(RUNNER_PORT_BASE, RUNNER_PORT_SIZE, port)) {
+        LOG_F(ERROR, "Could not create the runner machine");
+        return 1;
+    }
+
+    constexpr uint64_t tbr_freq = 16705000;
+
+    ppc_cpu_init(mem_ctrl, PPC_VER::MPC750, tbr_freq);
+
+    install_exception_stubs();
+
+    uint32_t stack_top = setup_mmu(mem_ctrl, mmu_mode, ram_size);
+    if (!stack_top)
+        return 1;
+
+    uint32_t msr = MSR::ME | MSR::FP;
+    if (mmu_mode != MmuMode::REAL)
+        msr |= MSR::IR | MSR::DR;
+
+    LOG_F(INFO, "Runner machine: %u MB RAM, MMU mode %s", ram_mb, mmu_mode_str.c_str());
+
+    int ret_code = 0;
+
+    for (auto& [prog, kernel] : programs) {
+        uint32_t iters = iterations ? iterations : kernel ? kernel->iterations : 1;
+        RunStats stats, total = {};
+        RunStats best = {0, UINT64_MAX, 0, 0};
+
+        if (kernel)
+            LOG_F(INFO, "%s: %s, %u iterations", kernel->name, kernel->descr, iters);
+
+        // run once to warm up host caches and the SoftTLB
+        if (!run_program(mem_ctrl, port, prog, msr, stack_top, iters, stats)) {
+            ret_code = 1;
+            continue;
+        }
+
+        if (kernel && kernel->checksum != port->exit_code) {
+            LOG_F(ERROR, "%s: checksum mismatch, expected 0x%08X, got 0x%08X",
+                  kernel->name, kernel->checksum, port->exit_code);
+            ret_code = 1;
+        } else if (!kernel) {
+            LOG_F(INFO, "%s: exit code 0x%08X", prog.name.c_str(), port->exit_code);
+        }
+
+        port->quiet = true;
+
+        for (int i = 0; i < num_runs; i++) {
+            if (!run_program(mem_ctrl, port, prog, msr, stack_top, iters, stats)) {
+                ret_code = 1;
+                break;
+            }
+            report_stats(prog.name, ("run #" + std::to_string(i)).c_str(), stats);
+
+            total.instrs       += stats.instrs;
+            total.host_ns      += stats.host_ns;
+            total.itlb_refills += stats.itlb_refills;
+            total.dtlb_refills += stats.dtlb_refills;
+            if (stats.host_ns < best.host_ns)
+                best = stats;
+        }
+
+        report_stats(prog.name, "total", total);
+        report_stats(prog.name, "best", best);
+
+        port->quiet = false;
+    }
+
+    delete(mem_ctrl);
+
+    return ret_code;
+}
@@ -0,0 +1,336 @@
+/*
+DingusPPC - The Experimental PowerPC Macintosh emulator
+Copyright (C) 2018-23 divingkatae and maximum
+                      (theweirdo)     spatium
+
+(Contact divingkatae#1017 or powermax#2286 on Discord for more info)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file TimerManager scheduling microbenchmark and stress harness.
+
+    Replays timer mixes resembling those produced by the emulated machines
+    (VBL/refresh cyclic timers, SCSI/Cuda one-shot bursts, cancel churn,
+    deep queues) against the TimerManager singleton using a synthetic
+    virtual clock. Reports host ns per operation, heap allocations per
+    operation and the latency distribution of process_timers().
+ */
+
+#include <core/timermanager.h>
+#include <thirdparty/loguru/loguru.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <vector>
+
+/* Heap allocation accounting for the whole program. */
+static uint64_t num_allocs  = 0;
+static uint64_t alloc_bytes = 0;
+
+void* operator new(size_t size) {
+    num_allocs++;
+    alloc_bytes += size;
+    void* ptr = malloc(size ? size : 1);
+    if (!ptr)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t size) noexcept {
+    free(ptr);
+}
+
+/* Synthetic virtual time source for TimerManager. */
+static uint64_t virt_time_ns = 0;
+static uint64_t num_notifications = 0;
+static uint64_t num_callbacks = 0;
+
+static inline uint64_t host_time_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/** Snapshot of the counters taken before a measured section. */
+typedef struct BenchMark {
+    uint64_t start_ns;
+    uint64_t allocs;
+    uint64_t bytes;
+} BenchMark;
+
+static inline BenchMark bench_start() {
+    return BenchMark{host_time_ns(), num_allocs, alloc_bytes};
+}
+
+static void bench_report(const char* name, const BenchMark& mark, uint64_t num_ops) {
+    uint64_t elapsed = host_time_ns() - mark.start_ns;
+    uint64_t allocs  = num_allocs  - mark.allocs;
+    uint64_t bytes   = alloc_bytes - mark.bytes;
+
+    LOG_F(INFO, "%-40s %9.1f ns/op  %6.2f allocs/op  %8.1f bytes/op",
+          name, (double)elapsed / num_ops, (double)allocs / num_ops,
+          (double)bytes / num_ops);
+}
+
+static void report_latencies(const char* name, std::vector<uint64_t>& samples) {
+    if (samples.empty()) {
+        LOG_F(INFO, "%s: no samples", name);
+        return;
+    }
+
+    std::sort(samples.begin(), samples.end());
+
+    auto pct = [&samples](double p) {
+        size_t idx = (size_t)(p * (samples.size() - 1));
+        return samples[idx];
+    };
+
+    uint64_t sum = 0;
+    for (auto s : samples)
+        sum += s;
+
+    LOG_F(INFO, "%s: calls=%zu avg=%.1f p50=%llu p90=%llu p99=%llu p99.9=%llu max=%llu ns",
+          name, samples.size(), (double)sum / samples.size(),
+          (unsigned long long)pct(0.5),   (unsigned long long)pct(0.9),
+          (unsigned long long)pct(0.99),  (unsigned long long)pct(0.999),
+          (unsigned long long)samples.back());
+}
+
+/** Fire all pending one-shot timers by moving virtual time far ahead.
+    Callbacks may arm further one-shots, so keep going until the queue
+    is empty. No cyclic timers may be left. */
+static void drain_oneshot_timers(TimerManager* tm) {
+    do {
+        virt_time_ns += 1000ULL * NS_PER_SEC;
+    } while (tm->process_timers(virt_time_ns));
+}
+
+/** Insert "depth" one-shot timers that won't expire during a measurement. */
+static void fill_queue(TimerManager* tm, int depth, std::mt19937& rng,
+                       std::vector<uint32_t>* ids = nullptr,
+                       uint64_t min_timeout = MSECS_TO_NSECS(100))
+{
+    std::uniform_int_distribution<uint64_t> dist(min_timeout, min_timeout * 9);
+
+    for (int i = 0; i < depth; i++) {
+        uint32_t id = tm->add_oneshot_timer(dist(rng), [] { num_callbacks++; });
+        if (ids)
+            ids->push_back(id);
+    }
+}
+
+static void bench_add_oneshot(TimerManager* tm, int depth, int num_ops) {
+    std::mt19937 rng(0xCAFEBABE);
+    std::uniform_int_distribution<uint64_t> dist(USECS_TO_NSECS(10), MSECS_TO_NSECS(50));
+    std::vector<uint64_t> timeouts(num_ops);
+    char name[64];
+
+    for (auto& t : timeouts)
+        t = dist(rng);
+
+    fill_queue(tm, depth, rng);
+
+    BenchMark mark = bench_start();
+    for (int i = 0; i < num_ops; i++) {
+        tm->add_oneshot_timer(timeouts[i], [] { num_callbacks++; });
+    }
+    snprintf(name, sizeof(name), "add_oneshot_timer (depth %d)", depth);
+    bench_report(name, mark, num_ops);
+
+    drain_oneshot_timers(tm);
+}
+
+static void bench_immediate(TimerManager* tm, int depth, int num_ops) {
+    std::mt19937 rng(0xCAFEBABE);
+    char name[64];
+
+    fill_queue(tm, depth, rng);
+
+    // immediate timers are typically fired by the very next process_timers()
+    BenchMark mark = bench_start();
+    for (int i = 0; i < num_ops; i++) {
+        tm->add_immediate_timer([] { num_callbacks++; });
+        virt_time_ns += 100;
+        tm->process_timers(virt_time_ns);
+    }
+    snprintf(name, sizeof(name), "add_immediate_timer+process (depth %d)", depth);
+    bench_report(name, mark, num_ops);
+
+    drain_oneshot_timers(tm);
+}
+
+/** Arm a timeout and cancel it shortly after, the common pattern of
+    device models waiting for a completion that usually arrives in time. */
+static void bench_cancel_churn(TimerManager* tm, int depth, int num_ops, bool cancel_random) {
+    std::mt19937 rng(0xDEADBEEF);
+    std::uniform_int_distribution<uint64_t> dist(USECS_TO_NSECS(50), MSECS_TO_NSECS(5));
+    std::vector<uint32_t> pending;
+    char name[64];
+
+    pending.reserve(depth + num_ops);
+
+    fill_queue(tm, depth, rng, &pending);
+
+    std::vector<uint64_t> timeouts(num_ops);
+    std::vector<size_t>   victims(num_ops);
+    for (int i = 0; i < num_ops; i++) {
+        timeouts[i] = dist(rng);
+        // index into the pending list as it exists after push_back
+        victims[i]  = cancel_random ? rng() % (pending.size() + 1) : pending.size();
+    }
+
+    BenchMark mark = bench_start();
+    for (int i = 0; i < num_ops; i++) {
+        pending.push_back(tm->add_oneshot_timer(timeouts[i], [] { num_callbacks++; }));
+        size_t idx = cancel_random ? victims[i] : pending.size() - 1;
+        tm->cancel_timer(pending[idx]);
+        pending[idx] = pending.back();
+        pending.pop_back();
+    }
+    snprintf(name, sizeof(name), "add+cancel %s (depth %d)",
+             cancel_random ? "random" : "newest", depth);
+    bench_report(name, mark, num_ops);
+
+    drain_oneshot_timers(tm);
+}
+
+/** Simulate the timer traffic of a running machine and measure the cost
+    of every process_timers() invocation like the interpreter loop does. */
+static void bench_machine_mix(TimerManager* tm, int extra_pending, uint64_t virt_duration_ns) {
+    std::mt19937 rng(0x1BADB002);
+    std::vector<uint32_t> cyclic_ids;
+    std::vector<uint32_t> scsi_timeouts;
+    std::vector<uint64_t> latencies;
+    uint64_t num_calls = 0;
+    char name[80];
+
+    latencies.reserve(1 << 20);
+
+    // video refresh & VBL end timers as set up by VideoCtrlBase
+    const uint64_t refresh_ns = static_cast<uint64_t>(1.0f / 60.15f * NS_PER_SEC + 0.5);
+    cyclic_ids.push_back(tm->add_cyclic_timer(refresh_ns, [&]() {
+        num_callbacks++;
+        // Cuda autopoll/one second interrupt traffic: a short burst of
+        // byte transfer one-shots every few frames
+        if ((rng() & 3) == 0) {
+            int num_bytes = 3 + rng() % 6;
+            for (int i = 1; i <= num_bytes; i++) {
+                tm->add_oneshot_timer(USECS_TO_NSECS(61) * i, [] { num_callbacks++; });
+            }
+        }
+    }));
+    cyclic_ids.push_back(tm->add_cyclic_timer(refresh_ns, refresh_ns + USECS_TO_NSECS(1200),
+        [] { num_callbacks++; }));
+
+    // host event polling as set up by main()
+    cyclic_ids.push_back(tm->add_cyclic_timer(MSECS_TO_NSECS(11), [] { num_callbacks++; }));
+
+    // pseudo VBL / cursor blink timers of some machines
+    cyclic_ids.push_back(tm->add_cyclic_timer(MSECS_TO_NSECS(16), [] { num_callbacks++; }));
+
+    // SCSI command traffic: phase change one-shots with a watchdog timeout
+    // that is almost always cancelled on completion
+    std::function<void(int)> scsi_phase = [&](int phases_left) {
+        num_callbacks++;
+        if (phases_left) {
+            tm->add_oneshot_timer(USECS_TO_NSECS(5 + rng() % 60),
+                [&, phases_left]() { scsi_phase(phases_left - 1); });
+        } else if (!scsi_timeouts.empty()) {
+            tm->cancel_timer(scsi_timeouts.back());
+            scsi_timeouts.pop_back();
+        }
+    };
+
+    cyclic_ids.push_back(tm->add_cyclic_timer(USECS_TO_NSECS(750), [&]() {
+        num_callbacks++;
+        if (rng() % 3)
+            return;
+        scsi_timeouts.push_back(tm->add_oneshot_timer(MSECS_TO_NSECS(250),
+            [] { num_callbacks++; }));
+        tm->add_immediate_timer([&]() { scsi_phase(4 + rng() % 4); });
+    }));
+
+    // long-running timeouts that stay pending during the whole run
+    fill_queue(tm, extra_pending, rng, nullptr, virt_duration_ns + NS_PER_SEC);
+
+    uint64_t end_time  = virt_time_ns + virt_duration_ns;
+    uint64_t cb_before = num_callbacks;
+
+    BenchMark mark = bench_start();
+    while (virt_time_ns < end_time) {
+        uint64_t t0 = host_time_ns();
+        uint64_t slice_ns = tm->process_timers(virt_time_ns);
+        latencies.push_back(host_time_ns() - t0);
+        num_calls++;
+
+        // advance virtual time like the interpreter does:
+        // up to the next expiry or 10000 cycles if nothing is pending
+        virt_time_ns += slice_ns ? slice_ns : (10000 << 4);
+    }
+
+    snprintf(name, sizeof(name), "machine mix process_timers (extra %d)", extra_pending);
+    bench_report(name, mark, num_calls);
+    LOG_F(INFO, "  callbacks fired: %llu, notifications: %llu",
+          (unsigned long long)(num_callbacks - cb_before),
+          (unsigned long long)num_notifications);
+    report_latencies("  process_timers latency", latencies);
+
+    for (auto id : cyclic_ids)
+        tm->cancel_timer(id);
+
+    drain_oneshot_timers(tm);
+}
+
+int main(int argc, char** argv) {
+    /* initialize logging */
+    loguru::g_preamble_date    = false;
+    loguru::g_preamble_time    = false;
+    loguru::g_preamble_thread  = false;
+
+    loguru::g_stderr_verbosity = 0;
+    loguru::init(argc, argv);
+
+    TimerManager* tm = TimerManager::get_instance();
+
+    tm->set_time_now_cb([]() { return virt_time_ns; });
+    tm->set_notify_changes_cb([]() { num_notifications++; });
+
+    const int depths[] = {0, 16, 256, 4096};
+
+    for (int depth : depths) {
+        bench_add_oneshot(tm, depth, 100000);
+    }
+
+    for (int depth : depths) {
+        bench_immediate(tm, depth, 100000);
+    }
+
+    for (int depth : depths) {
+        bench_cancel_churn(tm, depth, 20000, false);
+        bench_cancel_churn(tm, depth, 20000, true);
+    }
+
+    bench_machine_mix(tm, 0, 30ULL * NS_PER_SEC);
+    bench_machine_mix(tm, 1000, 30ULL * NS_PER_SEC);
+
+    return 0;
+}
@@ -94,6 +94,15 @@ public:
         _post_signal.connect_method(inst, func);
     }
 
+    // inject input from sources other than the host window (e.g. RFB clients)
+    void post_mouse_event(const MouseEvent& event) {
+        _mouse_signal.emit(event);
+    }
+
+    void post_keyboard_event(const KeyboardEvent& event) {
+        _keyboard_signal.emit(event);
+    }
+
 private:
     static EventManager* event_manager;
     EventManager() {}; // private constructor to implement a singleton
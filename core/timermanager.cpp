@@ -108,6 +108,9 @@ uint32_t TimerManager::add_cyclic_timer(uint64_t interval, timer_cb cb) {
 
 void TimerManager::cancel_timer(uint32_t id)
 {
+    if (this->timer_queue.empty())
+        return;
+
     TimerInfo* cur_timer = this->timer_queue.top().get();
     if (cur_timer->id == id) {
         this->timer_queue.pop();
@@ -606,6 +606,9 @@ void opc_bcx(PPCDisasmContext* ctx) {
     cr  = bi >> 2;
     dst = ((ctx->instr_code & 2) ? 0 : ctx->instr_addr) + SIGNEXT(ctx->instr_code & 0xFFFC, 15);
 
+    ctx->has_target  = true;
+    ctx->target_addr = dst;
+
     if (!ctx->simplified || ((bo & 0x10) && bi) || (((bo & 0x14) == 0x14) && (bo & 0xB) && bi)) {
         generic_bcx(ctx, bo, bi, dst);
         return;
@@ -743,6 +746,9 @@ void opc_bx(PPCDisasmContext* ctx) {
     uint32_t dst = ((ctx->instr_code & 2) ? 0 : ctx->instr_addr) +
         SIGNEXT(ctx->instr_code & 0x3FFFFFC, 25);
 
+    ctx->has_target  = true;
+    ctx->target_addr = dst;
+
     ctx->instr_str = my_sprintf("%-8s0x%08X", bx_mnem[ctx->instr_code & 3], dst);
 }
 
@@ -1883,6 +1889,8 @@ string disassemble_single(PPCDisasmContext* ctx) {
         throw std::invalid_argument(string("PPC instruction address must be a multiply of 4!"));
     }
 
+    ctx->has_target = false;
+
     OpcodeDispatchTable[ctx->instr_code >> 26](ctx);
 
     ctx->instr_addr += 4;
@@ -30,6 +30,8 @@ typedef struct PPCDisasmContext {
     uint32_t instr_code;
     std::string instr_str;
     bool simplified; /* true if we should output simplified mnemonics */
+    bool has_target; /* true if instr_str contains a branch destination */
+    uint32_t target_addr; /* destination address of a direct branch */
 } PPCDisasmContext;
 
 std::string disassemble_single(PPCDisasmContext* ctx);
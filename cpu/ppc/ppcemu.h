@@ -26,6 +26,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <endianswap.h>
 #include <memaccess.h>
 
+#include <atomic>
 #include <cinttypes>
 #include <functional>
 #include <setjmp.h>
@@ -311,6 +312,25 @@ extern jmp_buf exc_env;
 extern bool grab_return;
 
 extern bool power_on;
+
+/* CPU power saving modes entered by setting MSR[POW] (603 and later). */
+enum class PowerMode : uint8_t {
+    ACTIVE,
+    DOZE,   // woken by external and decrementer interrupts
+    NAP,    // same as DOZE for emulation purposes
+    SLEEP,  // woken by external interrupts only, display and sound stopped
+};
+
+/* HID0 bits selecting the power saving mode. */
+enum HID0Bits : uint32_t {
+    HID0_DOZE  = 1UL << (31 - 8),
+    HID0_NAP   = 1UL << (31 - 9),
+    HID0_SLEEP = 1UL << (31 - 10),
+};
+
+// written by the CPU thread, also read by the host audio callback
+extern std::atomic<PowerMode> ppc_power_mode;
+
 extern bool int_pin;
 extern bool dec_exception_pending;
 
@@ -326,6 +346,8 @@ extern uint32_t ppc_cur_instruction;
 extern uint32_t ppc_effective_address;
 extern uint32_t ppc_next_instruction_address;
 
+extern uint64_t g_icycles; // number of guest instructions executed so far
+
 inline void ppc_set_cur_instruction(const uint8_t* ptr) {
     ppc_cur_instruction = READ_DWORD_BE_A(ptr);
 }
@@ -341,6 +363,9 @@ extern uint64_t exceptions_processed;
 
 // Function prototypes
 extern void ppc_cpu_init(MemCtrlBase* mem_ctrl, uint32_t cpu_version, uint64_t tb_freq);
+extern void ppc_cpu_reset();
+extern void ppc_timebase_reset();
+extern void ppc_prebuild_opcode_tables();
 extern void ppc_mmu_init();
 
 void ppc_illegalop();
@@ -648,6 +673,7 @@ extern void ppc_exec(void);
 extern void ppc_exec_single(void);
 extern void ppc_exec_until(uint32_t goal_addr);
 extern void ppc_exec_dbg(uint32_t start_addr, uint32_t size);
+extern void ppc_power_save(void);
 
 /* debugging support API */
 void print_fprs(void);                   /* print content of the floating-point registers  */
@@ -20,17 +20,23 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 
 #include <core/timermanager.h>
+#include <debugger/perfmap.h>
+#include <utils/phasetimer.h>
 #include <loguru.hpp>
 #include "ppcemu.h"
+#include "ppchle.h"
 #include "ppcmmu.h"
 
 #include <algorithm>
+#include <chrono>
+#include <future>
 #include <iostream>
 #include <map>
 #include <setjmp.h>
 #include <stdexcept>
 #include <stdio.h>
 #include <string>
+#include <thread>
 
 using namespace std;
 using namespace dppc_interpreter;
@@ -41,6 +47,8 @@ bool is_601 = false;
 
 bool power_on = 1;
 
+std::atomic<PowerMode> ppc_power_mode{PowerMode::ACTIVE};
+
 SetPRS ppc_state;
 
 bool rc_flag = 0; // Record flag
@@ -134,7 +142,7 @@ public:
 /** Primary opcode (bits 0...5) lookup table. */
 static PPCOpcode OpcodeGrabber[] = {
     ppc_illegalop, ppc_illegalop, ppc_illegalop, ppc_twi,       ppc_illegalop, ppc_illegalop,
-    ppc_illegalop, ppc_mulli,     ppc_subfic,    power_dozi,    ppc_cmpli,     ppc_cmpi,
+    ppc_hle_call,  ppc_mulli,     ppc_subfic,    power_dozi,    ppc_cmpli,     ppc_cmpi,
     ppc_addic,     ppc_addicdot,  ppc_addi,      ppc_addis,     ppc_opcode16,  ppc_sc,
     ppc_opcode18,  ppc_opcode19,  ppc_rlwimi,    ppc_rlwinm,    power_rlmi,    ppc_rlwnm,
     ppc_ori,       ppc_oris,      ppc_xori,      ppc_xoris,     ppc_andidot,   ppc_andisdot,
@@ -319,22 +327,38 @@ void force_cycle_counter_reload()
     exec_flags |= EXEF_TIMER;
 }
 
-/** Execute PPC code as long as power is on. */
+// guest address range of the perf region ppc_exec_inner<true>() is confined to
+static uint32_t perf_rgn_first, perf_rgn_last;
+
+// kept across regions so that switching them doesn't process events
+static uint64_t perf_max_cycles;
+
+/** Execute PPC code as long as power is on.
+
+    With confine_to_region set, return as soon as an execution block
+    starts outside the current perf region. Execution blocks end at the
+    region boundary so that falling through into the next region is
+    detected without waiting for a branch.
+ */
 // inner interpreter loop
+template <bool confine_to_region>
 static void ppc_exec_inner()
 {
-    uint64_t max_cycles;
+    uint64_t local_max_cycles = 0;
+    uint64_t& max_cycles = confine_to_region ? perf_max_cycles : local_max_cycles;
     uint32_t page_start, eb_start, eb_end;
     uint8_t* pc_real;
 
-    max_cycles = 0;
-
     while (power_on) {
         // define boundaries of the next execution block
         // max execution block length = one memory page
         eb_start   = ppc_state.pc;
+        if (confine_to_region && (eb_start < perf_rgn_first || eb_start > perf_rgn_last))
+            return;
         page_start = eb_start & PAGE_MASK;
         eb_end     = page_start + PAGE_SIZE - 1;
+        if (confine_to_region)
+            eb_end = min(eb_end, perf_rgn_last);
         exec_flags = 0;
 
         pc_real    = mmu_translate_imem(eb_start);
@@ -362,12 +386,21 @@ static void ppc_exec_inner()
                 }
                 // define next execution block
                 eb_start = ppc_next_instruction_address;
+                if (confine_to_region &&
+                    (eb_start < perf_rgn_first || eb_start > perf_rgn_last)) {
+                    // let the next region's trampoline run it
+                    ppc_state.pc = eb_start;
+                    exec_flags = 0;
+                    return;
+                }
                 if (!(exec_flags & EXEF_RFI) && (eb_start & PAGE_MASK) == page_start) {
                     pc_real += (int)eb_start - (int)ppc_state.pc;
                     ppc_set_cur_instruction(pc_real);
                 } else {
                     page_start = eb_start & PAGE_MASK;
                     eb_end = page_start + PAGE_SIZE - 1;
+                    if (confine_to_region)
+                        eb_end = min(eb_end, perf_rgn_last);
                     pc_real = mmu_translate_imem(eb_start);
                 }
                 ppc_state.pc = eb_start;
@@ -381,6 +414,59 @@ static void ppc_exec_inner()
     }
 }
 
+// longest host sleep in a power saving mode, bounds the latency of
+// wake-up sources that aren't timers (e.g. power_on cleared elsewhere)
+constexpr uint64_t MAX_POWER_SAVE_SLICE_NS = 100000000ULL;
+
+/** Wait in the power saving mode selected by HID0 after MSR[POW] got set.
+
+    Instead of interpreting the guest's idle loop, the host sleeps until
+    the next timer is due and virtual time advances by the time slept.
+    The mode is left as soon as a timer callback raises an interrupt
+    (Cuda/VIA, ADB input, VBL, decrementer) or power gets switched off.
+ */
+void ppc_power_save()
+{
+    uint32_t hid0 = ppc_state.spr[SPR::HID0];
+
+    if (is_601)
+        return;
+
+    if (hid0 & HID0_SLEEP)
+        ppc_power_mode = PowerMode::SLEEP;
+    else if (hid0 & HID0_NAP)
+        ppc_power_mode = PowerMode::NAP;
+    else if (hid0 & HID0_DOZE)
+        ppc_power_mode = PowerMode::DOZE;
+    else
+        return; // MSR[POW] has no effect without a mode selected
+
+    if (ppc_power_mode == PowerMode::SLEEP)
+        LOG_F(INFO, "CPU entered sleep mode");
+
+    while (power_on && !(exec_flags & EXEF_EXCEPTION)) {
+        uint64_t slice_ns = TimerManager::get_instance()->process_timers(get_virt_time_ns());
+        if (!power_on || (exec_flags & EXEF_EXCEPTION))
+            break;
+
+        if (!slice_ns || slice_ns > MAX_POWER_SAVE_SLICE_NS)
+            slice_ns = MAX_POWER_SAVE_SLICE_NS;
+
+        auto start_time = chrono::steady_clock::now();
+        this_thread::sleep_for(chrono::nanoseconds(slice_ns));
+        uint64_t slept_ns = chrono::duration_cast<chrono::nanoseconds>(
+            chrono::steady_clock::now() - start_time).count();
+
+        // let virtual time reach the next timer even if the host woke early
+        g_icycles += (max(slept_ns, slice_ns) + (1ULL << icnt_factor) - 1) >> icnt_factor;
+    }
+
+    if (ppc_power_mode == PowerMode::SLEEP)
+        LOG_F(INFO, "CPU left sleep mode");
+
+    ppc_power_mode = PowerMode::ACTIVE;
+}
+
 // outer interpreter loop
 void ppc_exec()
 {
@@ -390,8 +476,21 @@ void ppc_exec()
         ppc_state.pc = ppc_next_instruction_address;
     }
 
+    if (perf_map_enabled) {
+        // run guest code regions through their host trampolines
+        // so that host profilers can attribute samples to them
+        perf_max_cycles = 0;
+        while (power_on) {
+            const PerfRegion* rgn = PerfMap::get_instance()->get_region(ppc_state.pc);
+            perf_rgn_first = rgn->first;
+            perf_rgn_last  = rgn->last;
+            rgn->thunk(ppc_exec_inner<true>);
+        }
+        return;
+    }
+
     while (power_on) {
-        ppc_exec_inner();
+        ppc_exec_inner<false>();
     }
 }
 
@@ -765,13 +864,27 @@ void ppc_fpu_init() {
     set_host_rounding_mode(0);
 }
 
-void ppc_cpu_init(MemCtrlBase* mem_ctrl, uint32_t cpu_version, uint64_t tb_freq)
+static std::future<void> opcode_tables_ready;
+
+/* Start building the opcode tables in the background so that it overlaps
+   with device construction. ppc_cpu_init() waits for the result. */
+void ppc_prebuild_opcode_tables()
 {
-    int i;
+    opcode_tables_ready = std::async(std::launch::async, [] {
+        PhaseTimer phase("Opcode tables");
+        initialize_ppc_opcode_tables();
+    });
+}
 
+void ppc_cpu_init(MemCtrlBase* mem_ctrl, uint32_t cpu_version, uint64_t tb_freq)
+{
     mem_ctrl_instance = mem_ctrl;
 
-    initialize_ppc_opcode_tables();
+    if (opcode_tables_ready.valid()) {
+        opcode_tables_ready.get();
+    } else {
+        initialize_ppc_opcode_tables();
+    }
 
     if (cpu_version == PPC_VER::MPC601) {
         SubOpcode31Grabber[370] = ppc_illegalop; // tlbia
@@ -796,16 +909,33 @@ void ppc_cpu_init(MemCtrlBase* mem_ctrl, uint32_t cpu_version, uint64_t tb_freq)
     // initialize time base facility
     g_icycles   = 0;
     icnt_factor = 4;
-    tbr_wr_timestamp = 0;
-    rtc_timestamp = 0;
-    tbr_wr_value = 0;
     tbr_freq_ghz = (tb_freq << 32) / NS_PER_SEC;
     tbr_period_ns = ((uint64_t)NS_PER_SEC << 32) / tb_freq;
 
+    ppc_state.spr[SPR::PVR] = cpu_version;
+    is_601 = (cpu_version >> 16) == 1;
+
+    ppc_cpu_reset();
+
+#ifdef CPU_PROFILING
+    gProfilerObj->register_profile("PPC_CPU",
+        std::unique_ptr<BaseProfile>(new CPUProfile()));
+#endif
+}
+
+/** Put the CPU into its hard reset state. PVR and virtual time are kept. */
+void ppc_cpu_reset()
+{
+    int i;
+
+    uint32_t cpu_version = ppc_state.spr[SPR::PVR];
+
+    ppc_timebase_reset();
+
     exec_flags = 0;
+    int_pin    = false;
 
     timebase_counter = 0;
-    dec_wr_value = 0;
 
     /* zero all GPRs as prescribed for MPC601 */
     /* For later PPC CPUs, GPR content is undefined */
@@ -834,7 +964,8 @@ void ppc_cpu_init(MemCtrlBase* mem_ctrl, uint32_t cpu_version, uint64_t tb_freq)
     }
 
     ppc_state.spr[SPR::PVR] = cpu_version;
-    is_601 = (cpu_version >> 16) == 1;
+
+    ppc_state.reserve = false;
 
     if (is_601) {
         /* MPC601 sets MSR[ME] bit during hard reset / Power-On */
@@ -846,13 +977,19 @@ void ppc_cpu_init(MemCtrlBase* mem_ctrl, uint32_t cpu_version, uint64_t tb_freq)
 
     ppc_mmu_init();
 
+    /* drop translations of the BATs zeroed above */
+    for (i = 528; i < 536; i++) {
+        ibat_update(i);
+    }
+    if (!is_601) {
+        for (i = 536; i < 544; i++) {
+            dbat_update(i);
+        }
+    }
+    do_ctx_sync();
+
     /* redirect code execution to reset vector */
     ppc_state.pc = 0xFFF00100;
-
-#ifdef CPU_PROFILING
-    gProfilerObj->register_profile("PPC_CPU",
-        std::unique_ptr<BaseProfile>(new CPUProfile()));
-#endif
 }
 
 void print_fprs() {
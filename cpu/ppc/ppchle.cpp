@@ -0,0 +1,140 @@
+/*
+DingusPPC - The Experimental PowerPC Macintosh emulator
+Copyright (C) 2018-23 divingkatae and maximum
+                      (theweirdo)     spatium
+
+(Contact divingkatae#1017 or powermax#2286 on Discord for more info)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file High-level emulation (HLE) hooks for guest routines. */
+
+#include <devices/memctrl/memctrlbase.h>
+#include <loguru.hpp>
+#include <memaccess.h>
+#include "ppcemu.h"
+#include "ppchle.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+typedef struct HLEHook {
+    uint32_t    addr;
+    uint32_t    orig_insn;  // instruction replaced by the hook
+    uint8_t*    host_ptr;   // host address of the patched instruction
+    std::string name;
+    HLEHandler  handler;
+} HLEHook;
+
+static std::vector<HLEHook> hle_hooks;
+
+static bool     hle_resume = false;
+static uint32_t hle_resume_addr;
+
+int hle_install_hook(uint32_t addr, const std::string& name, HLEHandler handler)
+{
+    AddressMapEntry* rgn = mem_ctrl_instance->find_range(addr);
+
+    // patching RAM would race with the guest rewriting its own code
+    if (!rgn || !(rgn->type & RT_ROM) || (addr & 3)) {
+        LOG_F(ERROR, "HLE: can't hook %s at 0x%08X, not in ROM", name.c_str(), addr);
+        return -1;
+    }
+
+    uint8_t* host_ptr = rgn->mem_ptr + (addr - rgn->start);
+
+    for (auto& hook : hle_hooks) {
+        if (hook.host_ptr == host_ptr) {
+            LOG_F(ERROR, "HLE: 0x%08X is already hooked by %s", addr, hook.name.c_str());
+            return -1;
+        }
+    }
+
+    int hook_id = (int)hle_hooks.size();
+
+    hle_hooks.push_back({addr, READ_DWORD_BE_A(host_ptr), host_ptr, name, handler});
+
+    WRITE_DWORD_BE_A(host_ptr, (HLE_PRIMARY_OPCODE << 26) | hook_id);
+
+    LOG_F(INFO, "HLE: hooked %s at 0x%08X", name.c_str(), addr);
+
+    return hook_id;
+}
+
+void hle_remove_hook(int hook_id)
+{
+    if (hook_id < 0 || hook_id >= (int)hle_hooks.size() || !hle_hooks[hook_id].host_ptr)
+        return;
+
+    HLEHook& hook = hle_hooks[hook_id];
+
+    WRITE_DWORD_BE_A(hook.host_ptr, hook.orig_insn);
+
+    // keep the slot so that other hook IDs remain valid
+    hook.host_ptr = nullptr;
+    hook.handler  = nullptr;
+}
+
+void hle_resume_at(uint32_t addr)
+{
+    hle_resume      = true;
+    hle_resume_addr = addr;
+}
+
+void hle_read_unpatched(uint8_t* dst, const uint8_t* src, uint32_t len)
+{
+    std::memcpy(dst, src, len);
+
+    for (auto& hook : hle_hooks) {
+        if (!hook.host_ptr || hook.host_ptr + 4 <= src || hook.host_ptr >= src + len)
+            continue;
+
+        uint8_t orig[4];
+        WRITE_DWORD_BE_U(orig, hook.orig_insn);
+
+        for (int i = 0; i < 4; i++) {
+            if (hook.host_ptr + i >= src && hook.host_ptr + i < src + len)
+                dst[hook.host_ptr + i - src] = orig[i];
+        }
+    }
+}
+
+void ppc_hle_call()
+{
+    uint32_t hook_id = ppc_cur_instruction & 0x03FFFFFFUL;
+
+    if (hook_id >= hle_hooks.size() || !hle_hooks[hook_id].host_ptr) {
+        ppc_illegalop();
+        return;
+    }
+
+    HLEHook& hook = hle_hooks[hook_id];
+
+    hle_resume = false;
+
+    if (hook.handler()) {
+        if (hle_resume)
+            ppc_next_instruction_address = hle_resume_addr;
+        else // emulate blr
+            ppc_next_instruction_address = ppc_state.spr[SPR::LR] & ~3UL;
+        exec_flags = EXEF_BRANCH;
+        return;
+    }
+
+    // fall back to the guest implementation
+    ppc_cur_instruction = hook.orig_insn;
+    ppc_main_opcode();
+}
@@ -0,0 +1,58 @@
+/*
+DingusPPC - The Experimental PowerPC Macintosh emulator
+Copyright (C) 2018-23 divingkatae and maximum
+                      (theweirdo)     spatium
+
+(Contact divingkatae#1017 or powermax#2286 on Discord for more info)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file High-level emulation (HLE) hooks for guest routines.
+
+    A hook replaces the first instruction of a guest routine in ROM with an
+    instruction from the primary opcode 6, which no PowerPC implements.
+    When the CPU executes it, the hook handler is called. A handler that
+    has done the routine's work natively returns true and the CPU returns
+    to the caller through LR. A handler returning false makes the CPU execute
+    the replaced instruction and continue with the guest implementation.
+ */
+
+#ifndef PPC_HLE_H
+#define PPC_HLE_H
+
+#include <cinttypes>
+#include <functional>
+#include <string>
+
+#define HLE_PRIMARY_OPCODE  6
+
+typedef std::function<bool()> HLEHandler;
+
+/** Install a hook at the given ROM address, returns hook ID or -1 on error. */
+extern int  hle_install_hook(uint32_t addr, const std::string& name, HLEHandler handler);
+
+/** Restore the original instruction of the given hook. */
+extern void hle_remove_hook(int hook_id);
+
+/** Make the running handler continue at addr instead of LR when it returns true. */
+extern void hle_resume_at(uint32_t addr);
+
+/** Copy len bytes from the host address src to dst with all hooks undone. */
+extern void hle_read_unpatched(uint8_t* dst, const uint8_t* src, uint32_t len);
+
+/** Opcode handler for primary opcode 6. */
+extern void ppc_hle_call();
+
+#endif // PPC_HLE_H
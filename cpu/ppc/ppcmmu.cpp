@@ -22,8 +22,11 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 /** @file PowerPC Memory Management Unit emulation. */
 
 #include <devices/memctrl/memctrlbase.h>
+#include <devices/common/iotrace.h>
 #include <devices/common/mmiodevice.h>
 #include <memaccess.h>
+#include <utils/coldpages.h>
+#include <utils/pageheat.h>
 #include "ppcemu.h"
 #include "ppcmmu.h"
 
@@ -68,14 +71,17 @@ uint64_t    unaligned_crossp_w = 0; // counts unaligned crosspage writes
 /* global variables for lightweight SoftTLB profiling */
 uint64_t    num_primary_itlb_hits   = 0; // number of hits in the primary ITLB
 uint64_t    num_secondary_itlb_hits = 0; // number of hits in the secondary ITLB
-uint64_t    num_itlb_refills        = 0; // number of ITLB refills
 uint64_t    num_primary_dtlb_hits   = 0; // number of hits in the primary DTLB
 uint64_t    num_secondary_dtlb_hits = 0; // number of hits in the secondary DTLB
-uint64_t    num_dtlb_refills        = 0; // number of DTLB refills
 uint64_t    num_entry_replacements  = 0; // number of entry replacements
 
 #endif // TLB_PROFILING
 
+/* SoftTLB refills are counted unconditionally because they only occur
+   on the slow path after missing both TLB levels. */
+uint64_t    num_itlb_refills        = 0; // number of ITLB refills
+uint64_t    num_dtlb_refills        = 0; // number of DTLB refills
+
 /** remember recently used physical memory regions for quicker translation. */
 AddressMapEntry last_read_area  = {0xFFFFFFFF, 0xFFFFFFFF, 0, 0, nullptr, nullptr};
 AddressMapEntry last_write_area = {0xFFFFFFFF, 0xFFFFFFFF, 0, 0, nullptr, nullptr};
@@ -326,6 +332,9 @@ MapDmaResult mmu_map_dma_mem(uint32_t addr, uint32_t size, bool allow_mmio) {
     if (cur_dma_rgn->type & (RT_ROM | RT_RAM)) {
         host_va  = cur_dma_rgn->mem_ptr + (addr - cur_dma_rgn->start);
         is_writable = last_dma_area.type & RT_RAM;
+        // DMA buffers may be passed to the OS, which can't restore cold pages
+        if (is_writable)
+            cold_pages_prepare(host_va, size);
     } else { // RT_MMIO
         devobj = cur_dma_rgn->devobj;
         dev_base = cur_dma_rgn->start;
@@ -541,6 +550,9 @@ static TLBEntry* itlb2_refill(uint32_t guest_va)
         tlb_entry->flags = flags | TLBFlags::PAGE_MEM;
         tlb_entry->host_va_offs_r = (int64_t)rgn_desc->mem_ptr - guest_va +
                                     (phys_addr - rgn_desc->start);
+        if (page_heat_enabled)
+            PageHeatTracker::get_instance()->record(
+                rgn_desc->mem_ptr + (phys_addr - rgn_desc->start), HEAT_EXEC);
     } else {
         ABORT_F("Instruction fetch from unmapped memory at 0x%08X!\n", phys_addr);
     }
@@ -620,6 +632,17 @@ static TLBEntry* dtlb2_refill(uint32_t guest_va, int is_write)
             } else {
                 tlb_entry->host_va_offs_w = tlb_entry->host_va_offs_r;
             }
+            if (page_heat_enabled) {
+                PageHeatTracker::get_instance()->record(
+                    rgn_desc->mem_ptr + (phys_addr - rgn_desc->start),
+                    is_write ? HEAT_WRITE : HEAT_READ);
+                // route the first write through the PTE.C path to record it
+                if (!is_write && (flags & TLBFlags::PAGE_WRITABLE) &&
+                    (flags & TLBFlags::PTE_SET_C)) {
+                    tlb_entry->flags = (tlb_entry->flags & ~TLBFlags::PTE_SET_C) |
+                                       TLBFlags::PAGE_HEAT_WR;
+                }
+            }
         }
         return tlb_entry;
     } else {
@@ -702,9 +725,7 @@ uint8_t *mmu_translate_imem(uint32_t vaddr)
         // primary ITLB miss -> look up address in the secondary ITLB
         tlb2_entry = lookup_secondary_tlb<TLBType::ITLB>(vaddr, tag);
         if (tlb2_entry == nullptr) {
-#ifdef TLB_PROFILING
             num_itlb_refills++;
-#endif
             // secondary ITLB miss ->
             // perform full address translation and refill the secondary ITLB
             tlb2_entry = itlb2_refill(vaddr);
@@ -891,6 +912,23 @@ void tlb_flush_all_entries()
     }
 }
 
+// Revoke the entries of all memory pages (including real mode ones)
+void tlb_flush_mem_entries()
+{
+    tlb_flush_entries<TLBType::ITLB>(TLBFlags::PAGE_MEM);
+    tlb_flush_entries<TLBType::DTLB>(TLBFlags::PAGE_MEM);
+}
+
+// The interpreter translates instruction addresses only when leaving
+// a page so the page being executed needs to be refilled explicitly
+void tlb_refill_cur_itlb()
+{
+    const uint32_t tag = ppc_state.pc & ~0xFFFUL;
+
+    if (lookup_secondary_tlb<TLBType::ITLB>(ppc_state.pc, tag) == nullptr)
+        itlb2_refill(ppc_state.pc);
+}
+
 static void mpc601_bat_update(uint32_t bat_reg)
 {
     PPC_BAT_entry *ibat_entry, *dbat_entry;
@@ -1025,6 +1063,28 @@ void mmu_print_regs()
     }
 }
 
+/* MMIO dispatch shared by all memory access paths. */
+static inline uint32_t mmio_dev_read(const AddressMapEntry* rgn, uint32_t offset, int size)
+{
+    uint32_t value = rgn->devobj->read(rgn->start, offset, size);
+
+    if (io_trace_enabled)
+        IoTracer::get_instance()->trace_mmio(rgn->devobj, rgn->start, offset,
+                                             value, size, false);
+
+    return value;
+}
+
+static inline void mmio_dev_write(const AddressMapEntry* rgn, uint32_t offset,
+                                  uint32_t value, int size)
+{
+    if (io_trace_enabled)
+        IoTracer::get_instance()->trace_mmio(rgn->devobj, rgn->start, offset,
+                                             value, size, true);
+
+    rgn->devobj->write(rgn->start, offset, value, size);
+}
+
 // Forward declarations.
 template <class T>
 static T read_unaligned(uint32_t guest_va, uint8_t *host_va);
@@ -1050,9 +1110,7 @@ inline T mmu_read_vmem(uint32_t guest_va)
         // primary TLB miss -> look up address in the secondary TLB
         tlb2_entry = lookup_secondary_tlb<TLBType::DTLB>(guest_va, tag);
         if (tlb2_entry == nullptr) {
-#ifdef TLB_PROFILING
             num_dtlb_refills++;
-#endif
             // secondary TLB miss ->
             // perform full address translation and refill the secondary TLB
             tlb2_entry = dtlb2_refill(guest_va, 0);
@@ -1079,19 +1137,16 @@ inline T mmu_read_vmem(uint32_t guest_va)
                     ppc_alignment_exception(guest_va);
 
                 return (
-                    ((T)tlb2_entry->rgn_desc->devobj->read(tlb2_entry->rgn_desc->start,
-                                                           guest_va - tlb2_entry->dev_base_va,
-                                                           4) << 32) |
-                    tlb2_entry->rgn_desc->devobj->read(tlb2_entry->rgn_desc->start,
-                                                       guest_va + 4 - tlb2_entry->dev_base_va,
-                                                       4)
+                    ((T)mmio_dev_read(tlb2_entry->rgn_desc,
+                                      guest_va - tlb2_entry->dev_base_va, 4) << 32) |
+                    mmio_dev_read(tlb2_entry->rgn_desc,
+                                  guest_va + 4 - tlb2_entry->dev_base_va, 4)
                 );
             }
             else {
                 return (
-                    tlb2_entry->rgn_desc->devobj->read(tlb2_entry->rgn_desc->start,
-                                                       guest_va - tlb2_entry->dev_base_va,
-                                                       sizeof(T))
+                    mmio_dev_read(tlb2_entry->rgn_desc,
+                                  guest_va - tlb2_entry->dev_base_va, sizeof(T))
                 );
             }
         }
@@ -1145,8 +1200,13 @@ inline void mmu_write_vmem(uint32_t guest_va, T value)
             mmu_exception_handler(Except_Type::EXC_DSI, 0);
         }
         if (!(tlb1_entry->flags & TLBFlags::PTE_SET_C)) {
-            // perform full page address translation to update PTE.C bit
-            page_address_translation(guest_va, false, !!(ppc_state.msr & MSR::PR), true);
+            if (!(tlb1_entry->flags & TLBFlags::PAGE_HEAT_WR)) {
+                // perform full page address translation to update PTE.C bit
+                page_address_translation(guest_va, false, !!(ppc_state.msr & MSR::PR), true);
+            }
+            if (page_heat_enabled && (tlb1_entry->flags & TLBFlags::PAGE_MEM))
+                PageHeatTracker::get_instance()->record(
+                    (uint8_t *)(tlb1_entry->host_va_offs_r + guest_va), HEAT_WRITE);
             tlb1_entry->flags |= TLBFlags::PTE_SET_C;
 
             // don't forget to update the secondary TLB as well
@@ -1160,9 +1220,7 @@ inline void mmu_write_vmem(uint32_t guest_va, T value)
         // primary TLB miss -> look up address in the secondary TLB
         tlb2_entry = lookup_secondary_tlb<TLBType::DTLB>(guest_va, tag);
         if (tlb2_entry == nullptr) {
-#ifdef TLB_PROFILING
             num_dtlb_refills++;
-#endif
             // secondary TLB miss ->
             // perform full address translation and refill the secondary TLB
             tlb2_entry = dtlb2_refill(guest_va, 1);
@@ -1183,8 +1241,13 @@ inline void mmu_write_vmem(uint32_t guest_va, T value)
         }
 
         if (!(tlb2_entry->flags & TLBFlags::PTE_SET_C)) {
-            // perform full page address translation to update PTE.C bit
-            page_address_translation(guest_va, false, !!(ppc_state.msr & MSR::PR), true);
+            if (!(tlb2_entry->flags & TLBFlags::PAGE_HEAT_WR)) {
+                // perform full page address translation to update PTE.C bit
+                page_address_translation(guest_va, false, !!(ppc_state.msr & MSR::PR), true);
+            }
+            if (page_heat_enabled && (tlb2_entry->flags & TLBFlags::PAGE_MEM))
+                PageHeatTracker::get_instance()->record(
+                    (uint8_t *)(tlb2_entry->host_va_offs_r + guest_va), HEAT_WRITE);
             tlb2_entry->flags |= TLBFlags::PTE_SET_C;
         }
 
@@ -1200,16 +1263,13 @@ inline void mmu_write_vmem(uint32_t guest_va, T value)
                 if (guest_va & 3)
                     ppc_alignment_exception(guest_va);
 
-                tlb2_entry->rgn_desc->devobj->write(tlb2_entry->rgn_desc->start,
-                                                    guest_va - tlb2_entry->dev_base_va,
-                                                    value >> 32, 4);
-                tlb2_entry->rgn_desc->devobj->write(tlb2_entry->rgn_desc->start,
-                                                    guest_va + 4 - tlb2_entry->dev_base_va,
-                                                    (uint32_t)value, 4);
+                mmio_dev_write(tlb2_entry->rgn_desc,
+                               guest_va - tlb2_entry->dev_base_va, value >> 32, 4);
+                mmio_dev_write(tlb2_entry->rgn_desc,
+                               guest_va + 4 - tlb2_entry->dev_base_va, (uint32_t)value, 4);
             } else {
-                tlb2_entry->rgn_desc->devobj->write(tlb2_entry->rgn_desc->start,
-                                                    guest_va - tlb2_entry->dev_base_va,
-                                                    value, sizeof(T));
+                mmio_dev_write(tlb2_entry->rgn_desc,
+                               guest_va - tlb2_entry->dev_base_va, value, sizeof(T));
             }
             return;
         }
@@ -1510,8 +1570,7 @@ static inline T read_phys_mem(AddressMapEntry *mru_rgn, uint32_t addr)
         iomem_reads_total++;
 #endif
 
-        return (mru_rgn->devobj->read(mru_rgn->start,
-                addr - mru_rgn->start, sizeof(T)));
+        return (mmio_dev_read(mru_rgn, addr - mru_rgn->start, sizeof(T)));
     } else {
         LOG_F(ERROR, "READ_PHYS: invalid region type!");
         return (-1ULL ? sizeof(T) == 8 : -1UL);
@@ -1568,8 +1627,7 @@ static inline void write_phys_mem(AddressMapEntry *mru_rgn, uint32_t addr, T val
         iomem_writes_total++;
 #endif
 
-        mru_rgn->devobj->write(mru_rgn->start, addr - mru_rgn->start, value,
-                               sizeof(T));
+        mmio_dev_write(mru_rgn, addr - mru_rgn->start, value, sizeof(T));
     } else {
         LOG_F(ERROR, "WRITE_PHYS: invalid region type!");
     }
@@ -2011,6 +2069,74 @@ uint64_t mem_read_dbg(uint32_t virt_addr, uint32_t size) {
     return ret_val;
 }
 
+/** Translate a data address without raising guest exceptions.
+    Returns false if the address isn't mapped or access is denied. */
+bool mmu_translate_data(uint32_t guest_va, bool is_write, uint32_t& phys_addr) {
+    uint32_t save_dsisr, save_dar;
+
+    if (!(ppc_state.msr & MSR::DR)) {
+        phys_addr = guest_va;
+        return true;
+    }
+
+    /* save MMU-related CPU state */
+    save_dsisr            = ppc_state.spr[SPR::DSISR];
+    save_dar              = ppc_state.spr[SPR::DAR];
+    mmu_exception_handler = dbg_exception_handler;
+
+    bool result = true;
+
+    try {
+        BATResult bat_res;
+
+        if (is_601) {
+            bat_res = mpc601_block_address_translation(guest_va);
+        } else {
+            bat_res = ppc_block_address_translation<BATType::DBAT>(guest_va);
+        }
+        if (bat_res.hit) {
+            if (!bat_res.prot || ((bat_res.prot & 1) && is_write)) {
+                result = false;
+            } else {
+                phys_addr = bat_res.phys;
+            }
+        } else {
+            PATResult pat_res = page_address_translation(guest_va, false,
+                !!(ppc_state.msr & MSR::PR), is_write);
+            phys_addr = pat_res.phys;
+        }
+    } catch (std::invalid_argument& exc) {
+        result = false;
+    }
+
+    /* restore MMU-related CPU state */
+    mmu_exception_handler     = ppc_exception_handler;
+    ppc_state.spr[SPR::DSISR] = save_dsisr;
+    ppc_state.spr[SPR::DAR]   = save_dar;
+
+    return result;
+}
+
+/** Return the host address of guest_va if the primary DTLB already maps it
+    to host memory for the requested access, nullptr otherwise.
+    Never raises guest exceptions or changes the MMU state. */
+uint8_t* mmu_probe_dtlb(uint32_t guest_va, bool is_write) {
+    TLBEntry* tlb1_entry = &pCurDTLB1[(guest_va >> PAGE_SIZE_BITS) & tlb_size_mask];
+
+    if (tlb1_entry->tag != (guest_va & ~0xFFFUL) || !(tlb1_entry->flags & TLBFlags::PAGE_MEM))
+        return nullptr;
+
+    if (!is_write)
+        return (uint8_t*)(tlb1_entry->host_va_offs_r + guest_va);
+
+    // writes that would need to update PTE.C take the slow path
+    if ((tlb1_entry->flags & (TLBFlags::PAGE_WRITABLE | TLBFlags::PTE_SET_C)) !=
+        (TLBFlags::PAGE_WRITABLE | TLBFlags::PTE_SET_C))
+        return nullptr;
+
+    return (uint8_t*)(tlb1_entry->host_va_offs_w + guest_va);
+}
+
 void ppc_mmu_init()
 {
     mmu_exception_handler = ppc_exception_handler;
@@ -112,18 +112,27 @@ enum TLBFlags : uint16_t {
     TLBE_FROM_PAT = 1 << 4, // TLB entry has been translated with PAT
     PAGE_WRITABLE = 1 << 5, // page is writable
     PTE_SET_C     = 1 << 6, // tells if C bit of the PTE needs to be updated
+    PAGE_HEAT_WR  = 1 << 7, // PTE_SET_C cleared only to catch the first write
 };
 
 extern std::function<void(uint32_t bat_reg)> ibat_update;
 extern std::function<void(uint32_t bat_reg)> dbat_update;
 
+// number of secondary SoftTLB misses that required a full translation
+extern uint64_t num_itlb_refills;
+extern uint64_t num_dtlb_refills;
+
 extern MapDmaResult mmu_map_dma_mem(uint32_t addr, uint32_t size, bool allow_mmio);
 
 extern void mmu_change_mode(void);
 extern void mmu_pat_ctx_changed();
 extern void tlb_flush_entry(uint32_t ea);
+extern void tlb_flush_mem_entries();
+extern void tlb_refill_cur_itlb();
 
 extern uint64_t mem_read_dbg(uint32_t virt_addr, uint32_t size);
+extern bool mmu_translate_data(uint32_t guest_va, bool is_write, uint32_t& phys_addr);
+extern uint8_t* mmu_probe_dtlb(uint32_t guest_va, bool is_write);
 uint8_t *mmu_translate_imem(uint32_t vaddr);
 
 template <class T>
@@ -878,6 +878,9 @@ void dppc_interpreter::ppc_mtmsr() {
         ppc_exception_handler(Except_Type::EXC_DECR, 0);
     } else {
         mmu_change_mode();
+
+        if (ppc_state.msr & MSR::POW)
+            ppc_power_save();
     }
 }
 
@@ -926,7 +929,9 @@ static void trigger_decrementer_exception() {
     decrementer_timer_id = 0;
     dec_wr_value = -1;
     dec_wr_timestamp = get_virt_time_ns();
-    if (ppc_state.msr & MSR::EE) {
+    // the decrementer doesn't wake the CPU from sleep mode,
+    // its exception stays pending until something else does
+    if ((ppc_state.msr & MSR::EE) && ppc_power_mode != PowerMode::SLEEP) {
         dec_exception_pending = false;
         //LOG_F(WARNING, "decrementer exception triggered");
         ppc_exception_handler(Except_Type::EXC_DECR, 0);
@@ -937,6 +942,25 @@ static void trigger_decrementer_exception() {
     }
 }
 
+/** Cancel a pending decrementer exception and restart the time base facility. */
+void ppc_timebase_reset() {
+    if (decrementer_timer_id) {
+        TimerManager::get_instance()->cancel_timer(decrementer_timer_id);
+        decrementer_timer_id = 0;
+    }
+    dec_exception_pending = false;
+
+    uint64_t now_ns = get_virt_time_ns();
+
+    tbr_wr_value     = 0;
+    tbr_wr_timestamp = now_ns;
+    dec_wr_value     = 0;
+    dec_wr_timestamp = now_ns;
+    rtc_lo           = 0;
+    rtc_hi           = 0;
+    rtc_timestamp    = now_ns;
+}
+
 static void update_decrementer(uint32_t val) {
     dec_wr_value = val;
     dec_wr_timestamp = get_virt_time_ns();
@@ -24,7 +24,10 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <cpu/ppc/ppcmmu.h>
 #include <devices/common/hwinterrupt.h>
 #include <devices/common/ofnvram.h>
+#include <debugger/symbols.h>
+#include <machines/machinebase.h>
 #include "memaccess.h"
+#include <utils/pageheat.h>
 #include <utils/profiler.h>
 
 #include <array>
@@ -40,7 +43,6 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <string>
 
 #ifdef DEBUG_CPU_INT
-#include <machines/machinebase.h>
 #include <devices/common/viacuda.h>
 #endif
 
@@ -54,10 +56,25 @@ static uint32_t str2addr(string& addr_str) {
     try {
         return (uint32_t)stoul(addr_str, NULL, 0);
     } catch (invalid_argument& exc) {
+        uint32_t addr;
+
+        /* number conversion failed, trying symbol name */
+        if (SymbolTable::get_instance()->find_by_name(addr_str, addr))
+            return addr;
+
         throw invalid_argument(string("Cannot convert ") + addr_str);
     }
 }
 
+/* print a label line if a symbol starts at the given address */
+static void print_sym_label(uint32_t addr) {
+    const GuestSymbol* sym = SymbolTable::get_instance()->find_symbol(addr);
+
+    if (sym && sym->start == addr) {
+        cout << sym->name << ":" << endl;
+    }
+}
+
 static uint32_t str2num(string& num_str) {
     try {
         return (uint32_t)stol(num_str, NULL, 0);
@@ -94,6 +111,21 @@ static void show_help() {
     cout << "                  X can be any number or a known register name" << endl;
     cout << "                  disas with no arguments defaults to disas 1,pc" << endl;
     cout << "  da N,X       -- shortcut for disas" << endl;
+    cout << "  sym X        -- show the symbol containing address X" << endl;
+    cout << "  symbols C    -- run subcommand C on the symbol table" << endl;
+    cout << "                  supported subcommands:" << endl;
+    cout << "                  'load F' - load symbol map from file F" << endl;
+    cout << "                  'scan N,X' - look for embedded names in" << endl;
+    cout << "                  N bytes of guest memory at address X" << endl;
+    cout << "                  'traps' - add trap table entries" << endl;
+    cout << "                  'count' - show number of known symbols" << endl;
+    cout << "                  Addresses can be given as symbol names." << endl;
+    cout << "  heat C       -- run subcommand C on the page heat tracker" << endl;
+    cout << "                  supported subcommands:" << endl;
+    cout << "                  'show' - show working set sizes" << endl;
+    cout << "                  'map R' - show heat map of region R" << endl;
+    cout << "                  'save F' - write heat report to file F" << endl;
+    cout << "                  'reset' - clear heat and window history" << endl;
 #ifdef ENABLE_68K_DEBUGGER
     cout << "  context X    -- switch to the debugging context X." << endl;
     cout << "                  X can be either 'ppc' (default) or '68k'" << endl;
@@ -121,6 +153,8 @@ static void disasm_68k(uint32_t count, uint32_t address) {
     cs_insn* insn = cs_malloc(cs_handle);
 
     for (; count > 0; count--) {
+        print_sym_label(address);
+
         /* prefetch opcode bytes (a 68k instruction can occupy 2...10 bytes) */
         for (int i = 0; i < sizeof(code); i++) {
             code[i] = mem_read_dbg(address + i, 1);
@@ -336,10 +370,19 @@ static void disasm(uint32_t count, uint32_t address) {
     ctx.instr_addr = address;
     ctx.simplified = true;
 
+    SymbolTable* sym_table = SymbolTable::get_instance();
+
     for (int i = 0; i < count; i++) {
+        print_sym_label(ctx.instr_addr);
         ctx.instr_code = READ_DWORD_BE_A(mmu_translate_imem(ctx.instr_addr));
         cout << uppercase << hex << ctx.instr_addr;
-        cout << "    " << disassemble_single(&ctx) << endl;
+        cout << "    " << disassemble_single(&ctx);
+        if (ctx.has_target) {
+            string target_sym = sym_table->symbolize(ctx.target_addr);
+            if (!target_sym.empty())
+                cout << "    ; " << target_sym;
+        }
+        cout << endl;
     }
 }
 
@@ -530,7 +573,15 @@ void enter_debugger() {
             }
         } else if (cmd == "go") {
             power_on = true;
-            ppc_exec(); // won't return!
+            for (;;) {
+                ppc_exec(); // won't return unless a reset was requested
+                if (!gMachineObj->reset_pending())
+                    break;
+                gMachineObj->reset();
+            }
+            // leave the debugger, the caller handles the power-off
+            if (gMachineObj->power_off_pending())
+                break;
         } else if (cmd == "disas" || cmd == "da") {
             expr_str = "";
             ss >> expr_str;
@@ -595,6 +646,73 @@ void enter_debugger() {
                     cout << exc.what() << endl;
                 }
             }
+        } else if (cmd == "sym") {
+            expr_str = "";
+            ss >> expr_str;
+            try {
+                addr = str2addr(expr_str);
+            } catch (invalid_argument& exc) {
+                try {
+                    /* number conversion failed, trying reg name */
+                    addr = get_reg(expr_str);
+                } catch (invalid_argument& exc) {
+                    cout << exc.what() << endl;
+                    continue;
+                }
+            }
+            inst_string = SymbolTable::get_instance()->symbolize(addr);
+            cout << uppercase << hex << addr << "    "
+                 << (inst_string.empty() ? "<no symbol>" : inst_string) << endl;
+        } else if (cmd == "symbols") {
+            SymbolTable* sym_table = SymbolTable::get_instance();
+
+            sub_cmd = "";
+            expr_str = "";
+            ss >> sub_cmd;
+            ss >> expr_str;
+
+            if (sub_cmd == "load") {
+                sym_table->load_map_file(expr_str);
+            } else if (sub_cmd == "scan") {
+                separator_pos = expr_str.find_first_of(",");
+                if (separator_pos == std::string::npos) {
+                    cout << "symbols scan: not enough arguments specified." << endl;
+                    continue;
+                }
+                inst_num_str = expr_str.substr(0, separator_pos);
+                addr_str     = expr_str.substr(separator_pos + 1);
+                try {
+                    sym_table->scan_guest_memory(str2addr(addr_str), str2num(inst_num_str));
+                } catch (invalid_argument& exc) {
+                    cout << exc.what() << endl;
+                }
+            } else if (sub_cmd == "traps") {
+                sym_table->load_trap_tables();
+            } else if (sub_cmd == "count") {
+                cout << dec << sym_table->num_symbols() << " symbols" << endl;
+            } else {
+                cout << "Unknown/empty subcommand " << sub_cmd << endl;
+            }
+        } else if (cmd == "heat") {
+            PageHeatTracker* heat = PageHeatTracker::get_instance();
+
+            sub_cmd = "";
+            expr_str = "";
+            ss >> sub_cmd;
+            ss >> expr_str;
+
+            if (sub_cmd == "show" || sub_cmd.empty()) {
+                heat->print_summary();
+            } else if (sub_cmd == "map") {
+                heat->print_heat_map(expr_str);
+            } else if (sub_cmd == "save") {
+                if (expr_str.empty() || !heat->write_report(expr_str))
+                    cout << "heat save: could not write report" << endl;
+            } else if (sub_cmd == "reset") {
+                heat->reset();
+            } else {
+                cout << "Unknown subcommand " << sub_cmd << endl;
+            }
         } else if (cmd == "dump") {
             expr_str = "";
             ss >> expr_str;
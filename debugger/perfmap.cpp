@@ -0,0 +1,360 @@
+/*
+DingusPPC - The Experimental PowerPC Macintosh emulator
+Copyright (C) 2018-23 divingkatae and maximum
+                      (theweirdo)     spatium
+
+(Contact divingkatae#1017 or powermax#2286 on Discord for more info)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+/** @file Host perf profiler support for guest code. */
+
+#include <cpu/ppc/ppcmmu.h>
+#include <debugger/perfmap.h>
+#include <debugger/symbols.h>
+#include <devices/common/hwcomponent.h>
+#include <devices/memctrl/memctrlbase.h>
+#include <machines/machinebase.h>
+#include <loguru.hpp>
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstring>
+#include <iterator>
+
+#ifdef __linux__
+#include <cerrno>
+#include <ctime>
+#include <elf.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+PerfMap* PerfMap::perf_map_obj = nullptr;
+
+bool perf_map_enabled = false;
+
+/* Size of the trampoline arena. Regions beyond it share one trampoline. */
+#define PERF_CODE_SIZE      (4 << 20)
+
+/* Trampolines set up a frame for callchain unwinding and call the function
+   passed in the first argument register. */
+#if defined(__x86_64__)
+static const uint8_t thunk_code[] = {
+    0x55,               // push rbp
+    0x48, 0x89, 0xE5,   // mov  rbp, rsp
+    0xFF, 0xD7,         // call rdi
+    0x5D,               // pop  rbp
+    0xC3,               // ret
+};
+#define PERF_THUNK_SLOT     16
+#define PERF_ELF_MACH       EM_X86_64
+#elif defined(__aarch64__)
+static const uint8_t thunk_code[] = {
+    0xFD, 0x7B, 0xBF, 0xA9, // stp x29, x30, [sp, #-16]!
+    0xFD, 0x03, 0x00, 0x91, // mov x29, sp
+    0x00, 0x00, 0x3F, 0xD6, // blr x0
+    0xFD, 0x7B, 0xC1, 0xA8, // ldp x29, x30, [sp], #16
+    0xC0, 0x03, 0x5F, 0xD6, // ret
+};
+#define PERF_THUNK_SLOT     32
+#define PERF_ELF_MACH       EM_AARCH64
+#endif
+
+#if defined(__linux__) && defined(PERF_THUNK_SLOT)
+
+/* jitdump format as described in tools/perf/Documentation/jitdump-specification.txt
+   of the Linux kernel sources. */
+#define JITDUMP_MAGIC       0x4A695444  // 'JiTD'
+#define JITDUMP_VERSION     1
+#define JIT_CODE_LOAD       0
+#define JIT_CODE_CLOSE      3
+
+typedef struct JitHeader {
+    uint32_t    magic;
+    uint32_t    version;
+    uint32_t    total_size;
+    uint32_t    elf_mach;
+    uint32_t    pad1;
+    uint32_t    pid;
+    uint64_t    timestamp;
+    uint64_t    flags;
+} JitHeader;
+
+typedef struct JitRecHeader {
+    uint32_t    id;
+    uint32_t    total_size;
+    uint64_t    timestamp;
+} JitRecHeader;
+
+typedef struct JitCodeLoad {
+    JitRecHeader hdr;
+    uint32_t    pid;
+    uint32_t    tid;
+    uint64_t    vma;
+    uint64_t    code_addr;
+    uint64_t    code_size;
+    uint64_t    code_index;
+    // followed by the NUL-terminated name and the code bytes
+} JitCodeLoad;
+
+/* perf timestamps must be taken from the same clock, see perf record -k */
+static uint64_t jit_timestamp()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return uint64_t(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+bool PerfMap::start(const std::string& dump_dir)
+{
+    if (perf_map_enabled)
+        return true;
+
+    MemCtrlBase* mem_ctrl = dynamic_cast<MemCtrlBase*>(
+        gMachineObj->get_comp_by_type(HWCompType::MEM_CTRL));
+
+    if (AddressMapEntry* rom_entry = mem_ctrl ? mem_ctrl->find_rom_region() : nullptr) {
+        this->rom_first = rom_entry->start;
+        this->rom_last  = rom_entry->end;
+        SymbolTable::get_instance()->get_rom_checksum(this->rom_cksum);
+    }
+
+    this->code_buf = (uint8_t*)mmap(nullptr, PERF_CODE_SIZE,
+        PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (this->code_buf == MAP_FAILED) {
+        LOG_F(ERROR, "PerfMap: could not allocate executable memory: %s",
+              strerror(errno));
+        this->code_buf = nullptr;
+        return false;
+    }
+
+    std::string map_path = "/tmp/perf-" + std::to_string(getpid()) + ".map";
+
+    this->map_file = fopen(map_path.c_str(), "w");
+    if (this->map_file == nullptr) {
+        LOG_F(ERROR, "PerfMap: could not create %s", map_path.c_str());
+        this->stop();
+        return false;
+    }
+
+    // perf may read the map while we're still running
+    setvbuf(this->map_file, nullptr, _IOLBF, 0);
+
+    if (!dump_dir.empty()) {
+        std::string dump_path = dump_dir + "/jit-" + std::to_string(getpid()) + ".dump";
+
+        int fd = open(dump_path.c_str(), O_CREAT | O_TRUNC | O_RDWR, 0666);
+        if (fd < 0) {
+            LOG_F(ERROR, "PerfMap: could not create %s", dump_path.c_str());
+            this->stop();
+            return false;
+        }
+
+        // perf record finds the dump by this executable mapping of the file
+        this->dump_marker = mmap(nullptr, sysconf(_SC_PAGESIZE),
+                                 PROT_READ | PROT_EXEC, MAP_PRIVATE, fd, 0);
+        if (this->dump_marker == MAP_FAILED) {
+            this->dump_marker = nullptr;
+            LOG_F(WARNING, "PerfMap: could not map %s, perf will ignore it",
+                  dump_path.c_str());
+        }
+
+        this->dump_file = fdopen(fd, "wb");
+
+        JitHeader hdr = {};
+        hdr.magic       = JITDUMP_MAGIC;
+        hdr.version     = JITDUMP_VERSION;
+        hdr.total_size  = sizeof(JitHeader);
+        hdr.elf_mach    = PERF_ELF_MACH;
+        hdr.pid         = getpid();
+        hdr.timestamp   = jit_timestamp();
+
+        fwrite(&hdr, sizeof(hdr), 1, this->dump_file);
+        fflush(this->dump_file);
+
+        LOG_F(INFO, "PerfMap: writing jitdump to %s", dump_path.c_str());
+    }
+
+    this->other_thunk = this->emit_thunk("ppc:other");
+
+    perf_map_enabled = true;
+
+    LOG_F(INFO, "PerfMap: describing guest code in %s, ROM checksum 0x%08X",
+          map_path.c_str(), this->rom_cksum);
+
+    return true;
+}
+
+void PerfMap::stop()
+{
+    perf_map_enabled = false;
+
+    if (this->dump_file) {
+        JitRecHeader rec = {JIT_CODE_CLOSE, sizeof(JitRecHeader), jit_timestamp()};
+        fwrite(&rec, sizeof(rec), 1, this->dump_file);
+        fclose(this->dump_file);
+        this->dump_file = nullptr;
+    }
+
+    if (this->dump_marker) {
+        munmap(this->dump_marker, sysconf(_SC_PAGESIZE));
+        this->dump_marker = nullptr;
+    }
+
+    // the map file stays around for perf report
+    if (this->map_file) {
+        fclose(this->map_file);
+        this->map_file = nullptr;
+        LOG_F(INFO, "PerfMap: described %zu guest code regions", this->regions.size());
+    }
+
+    // the trampoline arena is kept as the interpreter may be running in it
+    // when we get stopped from a signal handler
+    this->regions.clear();
+    std::fill(std::begin(this->entry_cache), std::end(this->entry_cache),
+              EntryCacheLine{0, nullptr});
+}
+
+PerfThunk PerfMap::emit_thunk(const std::string& name)
+{
+    if (this->code_used + PERF_THUNK_SLOT > PERF_CODE_SIZE)
+        return nullptr;
+
+    uint8_t* code = &this->code_buf[this->code_used];
+    this->code_used += PERF_THUNK_SLOT;
+
+    std::memcpy(code, thunk_code, sizeof(thunk_code));
+    __builtin___clear_cache((char*)code, (char*)code + sizeof(thunk_code));
+
+    fprintf(this->map_file, "%" PRIxPTR " %zx %s\n", (uintptr_t)code,
+            sizeof(thunk_code), name.c_str());
+
+    if (this->dump_file)
+        this->write_code_load(name, code, sizeof(thunk_code));
+
+    return (PerfThunk)code;
+}
+
+void PerfMap::write_code_load(const std::string& name, const uint8_t* code,
+                              size_t size)
+{
+    JitCodeLoad rec = {};
+
+    rec.hdr.id          = JIT_CODE_LOAD;
+    rec.hdr.total_size  = uint32_t(sizeof(rec) + name.size() + 1 + size);
+    rec.hdr.timestamp   = jit_timestamp();
+    rec.pid             = getpid();
+    rec.tid             = (uint32_t)syscall(SYS_gettid);
+    rec.vma             = (uintptr_t)code;
+    rec.code_addr       = (uintptr_t)code;
+    rec.code_size       = size;
+    rec.code_index      = this->code_index++;
+
+    fwrite(&rec, sizeof(rec), 1, this->dump_file);
+    fwrite(name.c_str(), name.size() + 1, 1, this->dump_file);
+    fwrite(code, size, 1, this->dump_file);
+    fflush(this->dump_file);
+}
+
+#else
+
+bool PerfMap::start(const std::string& dump_dir)
+{
+    LOG_F(ERROR, "PerfMap: only supported on x86-64 and AArch64 Linux hosts");
+    return false;
+}
+
+void PerfMap::stop()
+{
+}
+
+PerfThunk PerfMap::emit_thunk(const std::string& name)
+{
+    return nullptr;
+}
+
+void PerfMap::write_code_load(const std::string& name, const uint8_t* code,
+                              size_t size)
+{
+}
+
+#endif
+
+PerfRegion* PerfMap::find_region(uint32_t pc)
+{
+    auto it = this->regions.upper_bound(pc);
+
+    if (it != this->regions.begin()) {
+        --it;
+        if (pc <= it->second.last)
+            return &it->second;
+    }
+
+    return this->add_region(pc);
+}
+
+/* Create the region for a guest address not covered by any existing region.
+   Code with a symbol makes up one region. Code without one is attributed
+   to the piece of its page between the neighbouring symbols. */
+PerfRegion* PerfMap::add_region(uint32_t pc)
+{
+    SymbolTable* sym_table = SymbolTable::get_instance();
+
+    uint32_t    first, last;
+    std::string name;
+
+    if (const GuestSymbol* sym = sym_table->find_symbol(pc)) {
+        first = sym->start;
+        last  = sym->start + sym->span - 1;
+        name  = "ppc:" + sym->name;
+    } else {
+        uint32_t gap_first, gap_last;
+
+        sym_table->find_gap(pc, gap_first, gap_last);
+
+        first = std::max<uint32_t>(gap_first, pc & PAGE_MASK);
+        last  = std::min<uint32_t>(gap_last, (pc & PAGE_MASK) + PAGE_SIZE - 1);
+    }
+
+    // symbols added after a region was created may overlap it
+    auto next = this->regions.upper_bound(pc);
+    if (next != this->regions.end() && next->first <= last)
+        last = next->first - 1;
+    if (next != this->regions.begin() && std::prev(next)->second.last >= first)
+        first = std::prev(next)->second.last + 1;
+
+    if (name.empty()) {
+        char buf[64];
+        if (this->rom_last && pc >= this->rom_first && pc <= this->rom_last)
+            snprintf(buf, sizeof(buf), "ppc:ROM_%08X+0x%X", this->rom_cksum,
+                     first - this->rom_first);
+        else
+            snprintf(buf, sizeof(buf), "ppc:0x%08X", first);
+        name = buf;
+    }
+
+    PerfThunk thunk = this->emit_thunk(name);
+
+    auto res = this->regions.emplace(first, PerfRegion{first, last,
+                                     thunk ? thunk : this->other_thunk});
+
+    return &res.first->second;
+}
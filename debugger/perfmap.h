@@ -0,0 +1,134 @@
+/*
+DingusPPC - The Experimental PowerPC Macintosh emulator
+Copyright (C) 2018-23 divingkatae and maximum
+                      (theweirdo)     spatium
+
+(Contact divingkatae#1017 or powermax#2286 on Discord for more info)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+/** @file Host perf profiler support for guest code.
+
+    DingusPPC interprets guest code, so samples taken by the Linux perf tool
+    land in the interpreter and say nothing about the guest code being run.
+    To make them attributable, every guest code region gets a tiny host
+    trampoline that calls the interpreter. The interpreter stays inside the
+    trampoline of a region until execution leaves it, either by a branch or
+    by falling through past its last instruction, so the trampoline shows
+    up as the caller of all interpreter frames while the region's code is
+    executing.
+
+    A guest code region is either a routine known to the symbol table or,
+    for code without symbols, the part of a guest page not covered by any
+    symbol. ROM pages are named after the ROM checksum, e.g.
+    "ppc:ROM_96CD923D+0x1F000", so that profiles of the same ROM line up.
+
+    Trampolines are described in /tmp/perf-<pid>.map, which perf report
+    picks up automatically, and optionally in a jitdump file for use with
+    perf inject --jit. Callchains must be recorded, either by walking frame
+    pointers (build with -fno-omit-frame-pointer) or with LBR. The guest
+    region then appears as a caller in perf report --children.
+
+    When disabled, the interpreter runs without trampolines and the only
+    cost is one branch when ppc_exec() is entered.
+ */
+
+#ifndef PERF_MAP_H
+#define PERF_MAP_H
+
+#include <cinttypes>
+#include <cstdio>
+#include <map>
+#include <string>
+
+typedef void (*PerfRegionFunc)();
+typedef void (*PerfThunk)(PerfRegionFunc func);
+
+/** Guest code region with its host trampoline. */
+typedef struct PerfRegion {
+    uint32_t    first;  // guest address range, inclusive
+    uint32_t    last;
+    PerfThunk   thunk;
+} PerfRegion;
+
+class PerfMap {
+public:
+    static PerfMap* get_instance() {
+        if (!perf_map_obj) {
+            perf_map_obj = new PerfMap();
+        }
+        return perf_map_obj;
+    };
+
+    // Create the perf map and, if requested, a jitdump file in dump_dir
+    bool start(const std::string& dump_dir);
+    void stop();
+
+    /** Return the region containing the guest address pc,
+        creating its trampoline on the first call. */
+    const PerfRegion* get_region(uint32_t pc) {
+        EntryCacheLine& line = this->entry_cache[(pc >> 2) & (ENTRY_CACHE_SIZE - 1)];
+        if (line.rgn == nullptr || line.pc != pc) {
+            line.pc  = pc;
+            line.rgn = this->find_region(pc);
+        }
+        return line.rgn;
+    };
+
+    size_t get_num_regions() { return this->regions.size(); };
+
+private:
+    PerfMap() {}; // private constructor to implement a singleton
+
+    static PerfMap* perf_map_obj;
+
+    PerfRegion* find_region(uint32_t pc);
+    PerfRegion* add_region(uint32_t pc);
+    PerfThunk   emit_thunk(const std::string& name);
+    void        write_code_load(const std::string& name, const uint8_t* code,
+                                size_t size);
+
+    std::map<uint32_t, PerfRegion> regions; // keyed by first guest address
+
+    // regions are usually entered at a few addresses (routine entry points
+    // and return sites), remember those to avoid searching the region map
+    static const int ENTRY_CACHE_SIZE = 4096;
+
+    typedef struct EntryCacheLine {
+        uint32_t    pc;
+        PerfRegion* rgn;
+    } EntryCacheLine;
+
+    EntryCacheLine entry_cache[ENTRY_CACHE_SIZE] = {};
+
+    uint8_t*    code_buf    = nullptr;  // trampoline arena
+    size_t      code_used   = 0;
+    PerfThunk   other_thunk = nullptr;  // shared by regions beyond the arena
+    uint64_t    code_index  = 0;
+
+    FILE*       map_file    = nullptr;
+    FILE*       dump_file   = nullptr;
+    void*       dump_marker = nullptr;  // executable mapping perf looks for
+
+    uint32_t    rom_first   = 0;
+    uint32_t    rom_last    = 0;
+    uint32_t    rom_cksum   = 0;
+};
+
+// checked by ppc_exec() to run the interpreter through region trampolines
+extern bool perf_map_enabled;
+
+#endif // PERF_MAP_H
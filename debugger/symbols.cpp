@@ -0,0 +1,820 @@
+/*
+DingusPPC - The Experimental PowerPC Macintosh emulator
+Copyright (C) 2018-23 divingkatae and maximum
+                      (theweirdo)     spatium
+
+(Contact divingkatae#1017 or powermax#2286 on Discord for more info)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file Guest symbol table implementation. */
+
+#include <cpu/ppc/ppcmmu.h>
+#include <debugger/symbols.h>
+#include <devices/common/hwcomponent.h>
+#include <devices/memctrl/memctrlbase.h>
+#include <machines/machinebase.h>
+#include <machines/machinefactory.h>
+#include <memaccess.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cinttypes>
+#include <cstring>
+#include <fstream>
+#include <loguru.hpp>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+SymbolTable* SymbolTable::symbol_table = nullptr;
+
+/* Lookup extent of symbols whose size isn't known. Such a symbol covers
+   everything up to the next symbol but no more than this many bytes. */
+#define SYM_MAX_IMPLICIT_SIZE   0x4000
+
+/* Location and size of the trap dispatch tables in low memory. */
+#define OS_TRAP_TABLE           0x400
+#define OS_TRAP_ENTRIES         256
+#define TB_TRAP_TABLE           0xE00
+#define TB_TRAP_ENTRIES         1024
+
+#define TRAP_UNIMPLEMENTED      0x9F    // Toolbox trap _Unimplemented
+
+void SymbolTable::add_symbol(uint32_t start, uint32_t size, const std::string& name,
+                             SymSource source)
+{
+    this->symbols.push_back({start, size, 0, source, name});
+    this->dirty = true;
+}
+
+void SymbolTable::remove_symbols(SymSource source)
+{
+    std::erase_if(this->symbols, [source](const GuestSymbol& sym) {
+        return sym.source == source;
+    });
+    this->dirty = true;
+}
+
+/* Sort symbols by address and make their extents disjoint.
+   If several sources name the same address, the one with
+   the highest priority wins. */
+void SymbolTable::finalize()
+{
+    std::sort(this->symbols.begin(), this->symbols.end(),
+        [](const GuestSymbol& a, const GuestSymbol& b) {
+            if (a.start != b.start)
+                return a.start < b.start;
+            return a.source > b.source;
+    });
+
+    this->symbols.erase(std::unique(this->symbols.begin(), this->symbols.end(),
+        [](const GuestSymbol& a, const GuestSymbol& b) {
+            return a.start == b.start;
+        }), this->symbols.end());
+
+    for (size_t i = 0; i < this->symbols.size(); i++) {
+        GuestSymbol& sym = this->symbols[i];
+
+        uint64_t limit = (i + 1 < this->symbols.size()) ? this->symbols[i + 1].start
+                                                        : 0x100000000ULL;
+        uint64_t span  = sym.size ? sym.size : SYM_MAX_IMPLICIT_SIZE;
+
+        sym.span = (uint32_t)std::min<uint64_t>(span, limit - sym.start);
+    }
+
+    this->dirty = false;
+}
+
+const GuestSymbol* SymbolTable::find_symbol(uint32_t addr)
+{
+    if (this->dirty)
+        this->finalize();
+
+    auto it = std::upper_bound(this->symbols.begin(), this->symbols.end(), addr,
+        [](uint32_t addr, const GuestSymbol& sym) {
+            return addr < sym.start;
+    });
+
+    if (it == this->symbols.begin())
+        return nullptr;
+
+    --it;
+
+    return (addr - it->start < it->span) ? &(*it) : nullptr;
+}
+
+void SymbolTable::find_gap(uint32_t addr, uint32_t& gap_first, uint32_t& gap_last)
+{
+    if (this->dirty)
+        this->finalize();
+
+    auto it = std::upper_bound(this->symbols.begin(), this->symbols.end(), addr,
+        [](uint32_t addr, const GuestSymbol& sym) {
+            return addr < sym.start;
+    });
+
+    gap_last  = (it == this->symbols.end()) ? 0xFFFFFFFFUL : it->start - 1;
+    gap_first = (it == this->symbols.begin()) ? 0 : (it - 1)->start + (it - 1)->span;
+}
+
+bool SymbolTable::find_by_name(const std::string& name, uint32_t& addr)
+{
+    for (auto& sym : this->symbols) {
+        if (sym.name == name) {
+            addr = sym.start;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+std::string SymbolTable::symbolize(uint32_t addr)
+{
+    const GuestSymbol* sym = this->find_symbol(addr);
+
+    if (sym == nullptr)
+        return "";
+
+    if (addr == sym->start)
+        return sym->name;
+
+    char offset[16];
+    snprintf(offset, sizeof(offset), "+0x%X", addr - sym->start);
+    return sym->name + offset;
+}
+
+/* Read a text symbol map. Each line contains either
+   "<addr> <name>", "<addr> <size> <name>" or "trap <trap word> <name>".
+   Numbers are hexadecimal, '#' starts a comment. */
+int SymbolTable::load_map_file(const std::string& path)
+{
+    std::ifstream map_file(path);
+    std::string   line;
+    int           line_num = 0, count = 0;
+
+    if (!map_file.is_open()) {
+        LOG_F(ERROR, "Could not open symbol map %s", path.c_str());
+        return -1;
+    }
+
+    while (std::getline(map_file, line)) {
+        line_num++;
+
+        size_t comment_pos = line.find('#');
+        if (comment_pos != std::string::npos)
+            line.resize(comment_pos);
+
+        std::istringstream       iss(line);
+        std::vector<std::string> tokens;
+        std::string              tok;
+
+        while (iss >> tok)
+            tokens.push_back(tok);
+
+        if (tokens.empty())
+            continue;
+
+        try {
+            if (tokens[0] == "trap" && tokens.size() == 3) {
+                this->trap_names[(uint16_t)std::stoul(tokens[1], nullptr, 16)] = tokens[2];
+            } else if (tokens.size() == 2) {
+                this->add_symbol((uint32_t)std::stoul(tokens[0], nullptr, 16), 0,
+                                 tokens[1], SymSource::USER_MAP);
+                count++;
+            } else if (tokens.size() == 3) {
+                this->add_symbol((uint32_t)std::stoul(tokens[0], nullptr, 16),
+                                 (uint32_t)std::stoul(tokens[1], nullptr, 16),
+                                 tokens[2], SymSource::USER_MAP);
+                count++;
+            } else {
+                LOG_F(WARNING, "%s:%d: malformed symbol entry", path.c_str(), line_num);
+            }
+        } catch (std::logic_error& exc) {
+            LOG_F(WARNING, "%s:%d: invalid number", path.c_str(), line_num);
+        }
+    }
+
+    LOG_F(INFO, "Loaded %d symbols from %s", count, path.c_str());
+
+    return count;
+}
+
+/* Load the symbol map matching the checksum of the current boot ROM.
+   The map is expected to be named after the checksum, e.g. 96CD923D.map */
+int SymbolTable::load_rom_map(const std::string& map_dir)
+{
+    uint32_t checksum;
+
+    if (!this->get_rom_checksum(checksum))
+        return 0;
+
+    char file_name[16];
+    snprintf(file_name, sizeof(file_name), "%08X.map", checksum);
+
+    std::string map_path = map_dir + "/" + file_name;
+
+    if (!std::ifstream(map_path).good()) {
+        LOG_F(INFO, "No symbol map for ROM checksum 0x%08X", checksum);
+        return 0;
+    }
+
+    return this->load_map_file(map_path);
+}
+
+bool SymbolTable::get_rom_checksum(uint32_t& checksum)
+{
+    MemCtrlBase* mem_ctrl = dynamic_cast<MemCtrlBase*>(
+        gMachineObj->get_comp_by_type(HWCompType::MEM_CTRL));
+
+    AddressMapEntry* rom_entry = mem_ctrl ? mem_ctrl->find_rom_region() : nullptr;
+    if (rom_entry == nullptr || rom_entry->mem_ptr == nullptr)
+        return false;
+
+    checksum = MachineFactory::calc_rom_checksum(rom_entry->mem_ptr,
+                                                 rom_entry->end - rom_entry->start + 1);
+
+    return true;
+}
+
+int SymbolTable::scan_buffer(const uint8_t* buf, uint32_t base, uint32_t size)
+{
+    int count = 0;
+
+    count += this->scan_traceback_tables(buf, base, size);
+    count += this->scan_pef_containers(buf, base, size);
+    count += this->scan_macsbug_names(buf, base, size);
+
+    return count;
+}
+
+int SymbolTable::scan_guest_memory(uint32_t start, uint32_t size)
+{
+    if (!size)
+        return 0;
+
+    MemCtrlBase* mem_ctrl = dynamic_cast<MemCtrlBase*>(
+        gMachineObj->get_comp_by_type(HWCompType::MEM_CTRL));
+
+    AddressMapEntry* entry = mem_ctrl ? mem_ctrl->find_range(start) : nullptr;
+    if (entry == nullptr || !(entry->type & (RT_ROM | RT_RAM)) || !entry->mem_ptr) {
+        LOG_F(ERROR, "No guest memory at 0x%08X", start);
+        return -1;
+    }
+
+    size = std::min(size, entry->end - start + 1);
+
+    int count = this->scan_buffer(entry->mem_ptr + (start - entry->start), start, size);
+
+    LOG_F(INFO, "Found %d symbols in 0x%08X...0x%08X", count, start, start + size - 1);
+
+    return count;
+}
+
+/* Create a symbol for every implemented trap. Trap names come from
+   "trap" entries of previously loaded symbol maps. */
+int SymbolTable::load_trap_tables()
+{
+    int count = 0;
+
+    this->remove_symbols(SymSource::TRAP_TABLE);
+
+    try {
+        uint32_t unimpl_addr = (uint32_t)mem_read_dbg(
+            TB_TRAP_TABLE + TRAP_UNIMPLEMENTED * 4, 4);
+
+        auto add_traps = [&](uint32_t table, int num_entries, uint16_t trap_base) {
+            for (int i = 0; i < num_entries; i++) {
+                uint32_t addr = (uint32_t)mem_read_dbg(table + i * 4, 4);
+                if (!addr || addr == unimpl_addr)
+                    continue;
+
+                uint16_t trap_word = trap_base | i;
+
+                auto name_it = this->trap_names.find(trap_word);
+                if (name_it != this->trap_names.end()) {
+                    this->add_symbol(addr, 0, name_it->second, SymSource::TRAP_TABLE);
+                } else {
+                    char name[16];
+                    snprintf(name, sizeof(name), "Trap_%04X", trap_word);
+                    this->add_symbol(addr, 0, name, SymSource::TRAP_TABLE);
+                }
+                count++;
+            }
+        };
+
+        add_traps(OS_TRAP_TABLE, OS_TRAP_ENTRIES, 0xA000);
+        add_traps(TB_TRAP_TABLE, TB_TRAP_ENTRIES, 0xA800);
+    } catch (std::invalid_argument& exc) {
+        LOG_F(ERROR, "Could not read trap tables: %s", exc.what());
+    }
+
+    LOG_F(INFO, "Loaded %d trap table symbols", count);
+
+    return count;
+}
+
+static bool is_sym_char(char c)
+{
+    return std::isalnum((unsigned char)c) || c == '_' || c == '%' || c == '.';
+}
+
+/* Decode a MacsBug procedure name starting at offset.
+   On success, rec_end receives the offset following the name
+   and the procedure's constant data. */
+static bool parse_macsbug_name(const uint8_t* buf, uint32_t size, uint32_t offset,
+                               std::string& name, uint32_t& rec_end)
+{
+    if (offset + 2 > size)
+        return false;
+
+    uint8_t first = buf[offset];
+
+    if (first >= 0x80 && first < 0xA0) {
+        // variable length format: $80+len or $80 followed by a length byte
+        uint32_t pos = offset + 1;
+        uint32_t len = first & 0x1F;
+        if (!len)
+            len = buf[pos++];
+
+        if (len < 2 || pos + len > size)
+            return false;
+
+        name.assign((const char*)&buf[pos], len);
+        if (!std::all_of(name.begin(), name.end(), is_sym_char))
+            return false;
+
+        // the name is padded to a word boundary and followed by
+        // a word containing the size of the procedure's constants
+        pos = (pos + len + 1) & ~1;
+        if (pos + 2 > size)
+            return false;
+
+        rec_end = pos + 2 + READ_WORD_BE_U(&buf[pos]);
+        if (rec_end > size)
+            return false;
+
+        rec_end = (rec_end + 1) & ~1;
+        return true;
+    }
+
+    if (first > 0xA0) {
+        // fixed length format: the first char has its high bit set,
+        // 16 chars if the second one has it set too, 8 chars otherwise
+        uint32_t len = (buf[offset + 1] & 0x80) ? 16 : 8;
+        if (offset + len > size)
+            return false;
+
+        name.clear();
+        for (uint32_t i = 0; i < len; i++)
+            name.push_back(buf[offset + i] & 0x7F);
+
+        name.erase(name.find_last_not_of(' ') + 1);
+        if (name.length() < 2 || !std::all_of(name.begin(), name.end(), is_sym_char))
+            return false;
+
+        rec_end = offset + len;
+        return true;
+    }
+
+    return false;
+}
+
+/* Find 68k procedures terminated by RTS, RTD or JMP (A0) followed by
+   a MacsBug name. The procedure is assumed to begin with the first
+   LINK A6 after the previous named procedure. */
+int SymbolTable::scan_macsbug_names(const uint8_t* buf, uint32_t base, uint32_t size)
+{
+    uint32_t routine_start = 0, name_offset, rec_end;
+    std::string name;
+    int count = 0;
+
+    for (uint32_t offset = 0; offset + 4 <= size; offset += 2) {
+        uint16_t opcode = READ_WORD_BE_U(&buf[offset]);
+
+        if (opcode == 0x4E75 || opcode == 0x4ED0) { // RTS, JMP (A0)
+            name_offset = offset + 2;
+        } else if (opcode == 0x4E74) { // RTD #n
+            name_offset = offset + 4;
+        } else {
+            continue;
+        }
+
+        if (!parse_macsbug_name(buf, size, name_offset, name, rec_end))
+            continue;
+
+        uint32_t start = routine_start;
+        for (uint32_t i = routine_start; i < offset; i += 2) {
+            if (READ_WORD_BE_U(&buf[i]) == 0x4E56) { // LINK A6,#n
+                start = i;
+                break;
+            }
+        }
+
+        this->add_symbol(base + start, name_offset - start, name, SymSource::MACSBUG);
+        count++;
+
+        routine_start = rec_end;
+        offset        = rec_end - 2;
+    }
+
+    return count;
+}
+
+/* Find PowerPC traceback tables carrying a routine name and the offset
+   to the routine's entry point. A traceback table follows the routine's
+   code and starts with a zero word. */
+int SymbolTable::scan_traceback_tables(const uint8_t* buf, uint32_t base, uint32_t size)
+{
+    int count = 0;
+
+    for (uint32_t offset = 4; offset + 16 <= size; offset += 4) {
+        if (READ_DWORD_BE_A(&buf[offset]))
+            continue;
+
+        const uint8_t* tbt = &buf[offset + 4];
+
+        if (tbt[0] != 0 || tbt[1] > 14)     // version, language
+            continue;
+        if (!(tbt[2] & 0x20) || !(tbt[3] & 0x40)) // has_tboff, name_present
+            continue;
+
+        uint32_t pos = offset + 12;
+
+        if (tbt[6] || (tbt[7] >> 1))        // fixedparms, floatparms
+            pos += 4;                       // skip parminfo
+
+        if (pos + 4 > size)
+            continue;
+        uint32_t tb_offset = READ_DWORD_BE_U(&buf[pos]);
+        pos += 4;
+
+        if (!tb_offset || (tb_offset & 3) || tb_offset > offset)
+            continue;
+
+        if (tbt[3] & 0x80)                  // int_hndl
+            pos += 4;
+
+        if (tbt[2] & 0x08) {                // has_ctl
+            if (pos + 4 > size)
+                continue;
+            uint32_t num_ctl = READ_DWORD_BE_U(&buf[pos]);
+            if (num_ctl > 64)
+                continue;
+            pos += 4 + num_ctl * 4;
+        }
+
+        if (pos + 2 > size)
+            continue;
+        uint32_t name_len = READ_WORD_BE_U(&buf[pos]);
+        pos += 2;
+
+        if (!name_len || name_len > 255 || pos + name_len > size)
+            continue;
+
+        std::string name((const char*)&buf[pos], name_len);
+        if (!std::all_of(name.begin(), name.end(), [](char c) {
+                return std::isgraph((unsigned char)c); }))
+            continue;
+
+        this->add_symbol(base + offset - tb_offset, tb_offset, name,
+                         SymSource::TRACEBACK);
+        count++;
+    }
+
+    return count;
+}
+
+/* PEF container layout. */
+#define PEF_HDR_SIZE            40
+#define PEF_SECT_HDR_SIZE       28
+#define PEF_LOADER_HDR_SIZE     56
+#define PEF_EXPORT_SIZE         10
+
+enum : uint8_t {
+    PEF_SECT_CODE   = 0,
+    PEF_SECT_DATA   = 1,
+    PEF_SECT_PIDATA = 2,    // pattern-initialized data
+    PEF_SECT_LOADER = 4,
+};
+
+enum : uint8_t {
+    PEF_SYM_CODE    = 0,
+    PEF_SYM_TVECT   = 2,
+};
+
+/* Pattern-initialized data opcodes. */
+enum : uint8_t {
+    PID_ZERO            = 0,
+    PID_BLOCK_COPY      = 1,
+    PID_REPEAT_BLOCK    = 2,
+    PID_INTERLEAVE_COPY = 3,
+    PID_INTERLEAVE_ZERO = 4,
+};
+
+/* Expand a pattern-initialized data section into out.
+   Return false if the section is malformed. */
+static bool unpack_pidata(const uint8_t* src, uint32_t src_len, uint32_t unpacked_len,
+                          std::vector<uint8_t>& out)
+{
+    uint32_t pos = 0;
+    bool     err = false;
+
+    // variable length argument, 7 bits per byte with the MSB set on all but the last
+    auto get_arg = [&]() {
+        uint32_t val = 0;
+        for (int i = 0; i < 5 && pos < src_len; i++) {
+            uint8_t b = src[pos++];
+            val = (val << 7) | (b & 0x7F);
+            if (!(b & 0x80))
+                return val;
+        }
+        err = true;
+        return 0U;
+    };
+
+    // append len bytes, either zeros or copied from the section
+    auto put = [&](uint64_t len, bool copy) {
+        if (out.size() + len > unpacked_len || (copy && pos + len > src_len)) {
+            err = true;
+            return;
+        }
+        if (copy) {
+            out.insert(out.end(), &src[pos], &src[pos + len]);
+            pos += len;
+        } else {
+            out.insert(out.end(), len, 0);
+        }
+    };
+
+    out.clear();
+
+    while (pos < src_len && !err) {
+        uint8_t  opcode = src[pos] >> 5;
+        uint32_t count  = src[pos++] & 0x1F;
+
+        if (!count)
+            count = get_arg();
+
+        switch (opcode) {
+        case PID_ZERO:
+            put(count, false);
+            break;
+        case PID_BLOCK_COPY:
+            put(count, true);
+            break;
+        case PID_REPEAT_BLOCK: {
+            uint32_t num_blocks = get_arg() + 1;
+            uint32_t blk_pos    = pos;
+            for (uint32_t i = 0; i < num_blocks && !err; i++) {
+                pos = blk_pos;
+                put(count, true);
+            }
+            break;
+        }
+        case PID_INTERLEAVE_COPY:
+        case PID_INTERLEAVE_ZERO: {
+            // common part of count bytes around each of the custom parts
+            uint32_t custom_size = get_arg();
+            uint32_t num_custom  = get_arg();
+            uint32_t common_pos  = pos;
+            uint32_t custom_pos  = pos + (opcode == PID_INTERLEAVE_COPY ? count : 0);
+            for (uint32_t i = 0; i <= num_custom && !err; i++) {
+                pos = common_pos;
+                put(count, opcode == PID_INTERLEAVE_COPY);
+                if (i < num_custom) {
+                    pos = custom_pos + i * custom_size;
+                    put(custom_size, true);
+                }
+            }
+            pos = custom_pos + num_custom * custom_size;
+            break;
+        }
+        default:
+            err = true;
+        }
+    }
+
+    return !err && out.size() == unpacked_len;
+}
+
+/* Find PEF containers and add their exported code symbols.
+   This only works for containers whose code sections are executed
+   in place, e.g. the ones residing in ROM.
+
+   Routines exported as transition vectors are added under the address
+   of their code. The code pointer of a transition vector is relocated
+   by the first section when the fragment gets prepared, so its unrelocated
+   value is taken as an offset into that section. */
+int SymbolTable::scan_pef_containers(const uint8_t* buf, uint32_t base, uint32_t size)
+{
+    int count = 0;
+
+    for (uint32_t offset = 0; offset + PEF_HDR_SIZE <= size; offset += 4) {
+        const uint8_t* cont = &buf[offset];
+
+        if (memcmp(cont, "Joy!peffpwpc", 12) || READ_DWORD_BE_U(&cont[12]) != 1)
+            continue;
+
+        uint32_t cont_size = size - offset;
+        uint32_t num_sects = READ_WORD_BE_U(&cont[32]);
+
+        if (PEF_HDR_SIZE + num_sects * PEF_SECT_HDR_SIZE > cont_size)
+            continue;
+
+        auto sect_hdr = [&](uint32_t idx) {
+            return &cont[PEF_HDR_SIZE + idx * PEF_SECT_HDR_SIZE];
+        };
+
+        // locate the loader section
+        const uint8_t* loader = nullptr;
+        uint32_t loader_size  = 0;
+        for (uint32_t i = 0; i < num_sects; i++) {
+            const uint8_t* sh = sect_hdr(i);
+            uint32_t sect_offs = READ_DWORD_BE_U(&sh[20]);
+            uint32_t sect_len  = READ_DWORD_BE_U(&sh[16]);
+            if (sh[24] == PEF_SECT_LOADER && sect_offs < cont_size &&
+                sect_len <= cont_size - sect_offs && sect_len >= PEF_LOADER_HDR_SIZE) {
+                loader      = &cont[sect_offs];
+                loader_size = sect_len;
+                break;
+            }
+        }
+
+        if (loader == nullptr)
+            continue;
+
+        uint32_t strings_offs = READ_DWORD_BE_U(&loader[40]);
+        uint32_t hash_offs    = READ_DWORD_BE_U(&loader[44]);
+        uint32_t hash_power   = READ_DWORD_BE_U(&loader[48]);
+        uint32_t num_exports  = READ_DWORD_BE_U(&loader[52]);
+
+        if (hash_power > 16 || num_exports > 0x10000)
+            continue;
+
+        uint64_t keys_offs = hash_offs + (4ULL << hash_power);
+        uint64_t syms_offs = keys_offs + num_exports * 4ULL;
+
+        if (syms_offs + num_exports * PEF_EXPORT_SIZE > loader_size ||
+            strings_offs >= loader_size)
+            continue;
+
+        std::map<int, std::vector<uint8_t>> data_sects; // unpacked on first use
+
+        // return the code offset stored in the transition vector at value
+        auto tvect_code = [&](int sect_idx, uint32_t value, uint32_t& code_offs) {
+            const uint8_t* sh = sect_hdr(sect_idx);
+            uint32_t sect_offs = READ_DWORD_BE_U(&sh[20]);
+            uint32_t sect_len  = READ_DWORD_BE_U(&sh[16]);
+            uint32_t unp_len   = READ_DWORD_BE_U(&sh[12]);
+
+            if (sect_offs >= cont_size || sect_len > cont_size - sect_offs)
+                return false;
+
+            auto it = data_sects.find(sect_idx);
+            if (it == data_sects.end()) {
+                it = data_sects.emplace(sect_idx, std::vector<uint8_t>()).first;
+                if (sh[24] == PEF_SECT_DATA)
+                    it->second.assign(&cont[sect_offs], &cont[sect_offs + sect_len]);
+                else if (sh[24] != PEF_SECT_PIDATA ||
+                         !unpack_pidata(&cont[sect_offs], sect_len, unp_len, it->second))
+                    it->second.clear();
+            }
+
+            if ((uint64_t)value + 8 > it->second.size())
+                return false;
+
+            code_offs = READ_DWORD_BE_U(&it->second[value]);
+            return true;
+        };
+
+        for (uint32_t i = 0; i < num_exports; i++) {
+            const uint8_t* exp = &loader[syms_offs + i * PEF_EXPORT_SIZE];
+
+            uint32_t class_name = READ_DWORD_BE_U(exp);
+            uint32_t value      = READ_DWORD_BE_U(&exp[4]);
+            int16_t  sect_idx   = (int16_t)READ_WORD_BE_U(&exp[8]);
+            uint32_t name_len   = READ_WORD_BE_U(&loader[keys_offs + i * 4]);
+            uint32_t name_offs  = strings_offs + (class_name & 0xFFFFFF);
+
+            uint8_t sym_class = (class_name >> 24) & 0xF;
+
+            if ((sym_class != PEF_SYM_CODE && sym_class != PEF_SYM_TVECT) || sect_idx < 0 ||
+                sect_idx >= (int)num_sects || !name_len ||
+                (uint64_t)name_offs + name_len > loader_size)
+                continue;
+
+            if (sym_class == PEF_SYM_TVECT) {
+                if (!tvect_code(sect_idx, value, value) || (value & 3))
+                    continue;
+                sect_idx = 0;
+            }
+
+            const uint8_t* sh = sect_hdr(sect_idx);
+            uint32_t sect_offs = READ_DWORD_BE_U(&sh[20]);
+            uint32_t sect_len  = READ_DWORD_BE_U(&sh[16]);
+
+            if (sh[24] != PEF_SECT_CODE || value >= sect_len ||
+                sect_offs >= cont_size)
+                continue;
+
+            this->add_symbol(base + offset + sect_offs + value, 0,
+                std::string((const char*)&loader[name_offs], name_len), SymSource::PEF);
+            count++;
+        }
+    }
+
+    return count;
+}
+
+void SymbolTable::record_sample(uint32_t pc)
+{
+    const GuestSymbol* sym = this->find_symbol(pc);
+
+    if (sym)
+        this->sym_hits[sym->start]++;
+    else
+        this->unknown_hits++;
+
+    this->num_samples++;
+}
+
+void SymbolTable::get_hot_symbols(std::vector<std::pair<std::string, uint64_t>>& hot_list,
+                                  size_t max_entries)
+{
+    std::vector<std::pair<uint32_t, uint64_t>> hits(this->sym_hits.begin(),
+                                                    this->sym_hits.end());
+
+    std::sort(hits.begin(), hits.end(), [](auto& a, auto& b) {
+        return a.second > b.second;
+    });
+
+    if (hits.size() > max_entries)
+        hits.resize(max_entries);
+
+    hot_list.clear();
+
+    for (auto& hit : hits) {
+        const GuestSymbol* sym = this->find_symbol(hit.first);
+        if (sym && sym->start == hit.first) {
+            hot_list.push_back({sym->name, hit.second});
+        } else {
+            // symbol was removed after the samples were taken
+            char addr_str[16];
+            snprintf(addr_str, sizeof(addr_str), "0x%08X", hit.first);
+            hot_list.push_back({addr_str, hit.second});
+        }
+    }
+}
+
+void SymbolTable::reset_samples()
+{
+    this->sym_hits.clear();
+    this->num_samples  = 0;
+    this->unknown_hits = 0;
+}
+
+void GuestCodeProfile::populate_variables(std::vector<ProfileVar>& vars)
+{
+    SymbolTable* sym_table = SymbolTable::get_instance();
+
+    std::vector<std::pair<std::string, uint64_t>> hot_list;
+
+    sym_table->get_hot_symbols(hot_list, 20);
+
+    vars.clear();
+
+    vars.push_back({.name = "PC samples total",
+                    .format = ProfileVarFmt::DEC,
+                    .value = sym_table->get_num_samples()});
+
+    vars.push_back({.name = "PC samples without symbol",
+                    .format = ProfileVarFmt::DEC,
+                    .value = sym_table->get_unknown_hits()});
+
+    for (auto& entry : hot_list) {
+        vars.push_back({.name = entry.first,
+                        .format = ProfileVarFmt::DEC,
+                        .value = entry.second});
+    }
+}
+
+void GuestCodeProfile::reset()
+{
+    SymbolTable::get_instance()->reset_samples();
+}
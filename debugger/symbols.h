@@ -0,0 +1,137 @@
+/*
+DingusPPC - The Experimental PowerPC Macintosh emulator
+Copyright (C) 2018-23 divingkatae and maximum
+                      (theweirdo)     spatium
+
+(Contact divingkatae#1017 or powermax#2286 on Discord for more info)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file Guest symbol table for debugger, disassembler and profiling output.
+
+    Symbols are collected from several sources:
+    - user-supplied symbol maps, optionally selected by ROM checksum
+    - MacsBug procedure names embedded after 68k routines
+    - traceback tables emitted after PowerPC routines
+    - exports of PEF containers found in guest memory
+    - the OS and Toolbox trap dispatch tables
+
+    All symbols are kept in a single vector sorted by start address.
+    Overlapping entries are clipped when the table is finalized so that
+    an address can be resolved by a single binary search.
+ */
+
+#ifndef SYMBOLS_H
+#define SYMBOLS_H
+
+#include <utils/profiler.h>
+
+#include <cinttypes>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/** Symbol sources in order of increasing priority. */
+enum class SymSource : uint8_t {
+    TRAP_TABLE = 0,
+    MACSBUG,
+    TRACEBACK,
+    PEF,
+    USER_MAP,
+};
+
+typedef struct GuestSymbol {
+    uint32_t    start;
+    uint32_t    size;   /* 0 if unknown */
+    uint32_t    span;   /* lookup extent, computed when the table is finalized */
+    SymSource   source;
+    std::string name;
+} GuestSymbol;
+
+class SymbolTable {
+public:
+    static SymbolTable* get_instance() {
+        if (!symbol_table) {
+            symbol_table = new SymbolTable();
+        }
+        return symbol_table;
+    };
+
+    void   add_symbol(uint32_t start, uint32_t size, const std::string& name,
+                      SymSource source);
+    void   remove_symbols(SymSource source);
+    size_t num_symbols() { return this->symbols.size(); };
+
+    /** Return the symbol covering addr or nullptr if there is none. */
+    const GuestSymbol* find_symbol(uint32_t addr);
+
+    /** Return the bounds of the range around addr not covered by any symbol.
+        addr itself must not be covered by a symbol. */
+    void find_gap(uint32_t addr, uint32_t& gap_first, uint32_t& gap_last);
+
+    /** Look up the start address of a symbol by its name. */
+    bool find_by_name(const std::string& name, uint32_t& addr);
+
+    /** Format addr as "name" or "name+0xOFFSET", empty string if unknown. */
+    std::string symbolize(uint32_t addr);
+
+    // symbol sources
+    int load_map_file(const std::string& path);
+    int load_rom_map(const std::string& map_dir);
+    bool get_rom_checksum(uint32_t& checksum);
+    int scan_buffer(const uint8_t* buf, uint32_t base, uint32_t size);
+    int scan_guest_memory(uint32_t start, uint32_t size);
+    int load_trap_tables();
+
+    // guest code profiling
+    void record_sample(uint32_t pc);
+    void get_hot_symbols(std::vector<std::pair<std::string, uint64_t>>& hot_list,
+                         size_t max_entries);
+    void reset_samples();
+    uint64_t get_num_samples()  { return this->num_samples; };
+    uint64_t get_unknown_hits() { return this->unknown_hits; };
+
+private:
+    SymbolTable() {};  // private constructor to implement a singleton
+
+    void finalize();
+
+    int scan_macsbug_names(const uint8_t* buf, uint32_t base, uint32_t size);
+    int scan_traceback_tables(const uint8_t* buf, uint32_t base, uint32_t size);
+    int scan_pef_containers(const uint8_t* buf, uint32_t base, uint32_t size);
+
+    static SymbolTable* symbol_table;
+
+    std::vector<GuestSymbol>            symbols;
+    bool                                dirty = false;
+    std::map<uint16_t, std::string>     trap_names; // trap word -> name
+
+    std::unordered_map<uint32_t, uint64_t> sym_hits; // symbol start -> samples
+    uint64_t                            num_samples  = 0;
+    uint64_t                            unknown_hits = 0;
+};
+
+/** Profile listing the guest routines that received most PC samples. */
+class GuestCodeProfile : public BaseProfile {
+public:
+    GuestCodeProfile() : BaseProfile("GuestCode") {};
+
+    void populate_variables(std::vector<ProfileVar>& vars);
+
+    void reset(void);
+};
+
+#endif // SYMBOLS_H
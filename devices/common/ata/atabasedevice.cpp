@@ -26,6 +26,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <devices/common/ata/idechannel.h>
 #include <loguru.hpp>
 
+#include <algorithm>
 #include <cinttypes>
 
 using namespace ata_interface;
@@ -48,6 +49,21 @@ void AtaBaseDevice::device_reset(bool is_soft_reset) {
     this->r_error = 1; // device 0 passed, device 1 passed or not present
 }
 
+/* Power-on reset: drop any transfer in progress and present the signature. */
+void AtaBaseDevice::reset() {
+    this->data_ptr         = nullptr;
+    this->cur_data_ptr     = nullptr;
+    this->xfer_cnt         = 0;
+    this->chunk_cnt        = 0;
+    this->chunk_size       = 0;
+    this->post_xfer_action = nullptr;
+    this->intrq_state      = 0;
+    this->r_dev_ctrl       = 0x08;
+
+    device_reset(false);
+    device_set_signature();
+}
+
 void AtaBaseDevice::device_set_signature() {
     this->r_sect_count = 1;
     this->r_sect_num   = 1;
@@ -70,7 +86,10 @@ uint16_t AtaBaseDevice::read(const uint8_t reg_addr) {
                 if (this->xfer_cnt <= 0)
                     this->r_status &= ~DRQ;
                 else {
-                    this->chunk_cnt = this->chunk_size;
+                    // give the device a chance to fetch the next block
+                    if (this->post_xfer_action)
+                        this->post_xfer_action();
+                    this->chunk_cnt = std::min(this->xfer_cnt, this->chunk_size);
                     this->update_intrq(1);
                 }
             }
@@ -81,13 +100,13 @@ uint16_t AtaBaseDevice::read(const uint8_t reg_addr) {
     case ATA_Reg::ERROR:
         return this->r_error;
     case ATA_Reg::SEC_COUNT:
-        return this->r_sect_count;
+        return (this->r_dev_ctrl & HOB) ? this->r_hob_sect_count : this->r_sect_count;
     case ATA_Reg::SEC_NUM:
-        return this->r_sect_num;
+        return (this->r_dev_ctrl & HOB) ? this->r_hob_sect_num : this->r_sect_num;
     case ATA_Reg::CYL_LOW:
-        return this->r_cylinder_lo;
+        return (this->r_dev_ctrl & HOB) ? this->r_hob_cyl_lo : this->r_cylinder_lo;
     case ATA_Reg::CYL_HIGH:
-        return this->r_cylinder_hi;
+        return (this->r_dev_ctrl & HOB) ? this->r_hob_cyl_hi : this->r_cylinder_hi;
     case ATA_Reg::DEVICE_HEAD:
         return this->r_dev_head;
     case ATA_Reg::STATUS:
@@ -116,26 +135,38 @@ void AtaBaseDevice::write(const uint8_t reg_addr, const uint16_t value) {
                     this->update_intrq(1);
                 } else {
                     this->cur_data_ptr = this->data_ptr;
-                    this->chunk_cnt = this->chunk_size;
+                    this->chunk_cnt = std::min(this->xfer_cnt, this->chunk_size);
                     this->signal_data_ready();
                 }
             }
         }
         break;
+    // Command block registers are two-deep FIFOs for 48-bit commands,
+    // writing them clears the HOB bit.
     case ATA_Reg::FEATURES:
+        this->r_hob_features = this->r_features;
         this->r_features = value;
+        this->r_dev_ctrl &= ~HOB;
         break;
     case ATA_Reg::SEC_COUNT:
+        this->r_hob_sect_count = this->r_sect_count;
         this->r_sect_count = value;
+        this->r_dev_ctrl &= ~HOB;
         break;
     case ATA_Reg::SEC_NUM:
+        this->r_hob_sect_num = this->r_sect_num;
         this->r_sect_num = value;
+        this->r_dev_ctrl &= ~HOB;
         break;
     case ATA_Reg::CYL_LOW:
+        this->r_hob_cyl_lo = this->r_cylinder_lo;
         this->r_cylinder_lo = value;
+        this->r_dev_ctrl &= ~HOB;
         break;
     case ATA_Reg::CYL_HIGH:
+        this->r_hob_cyl_hi = this->r_cylinder_hi;
         this->r_cylinder_hi = value;
+        this->r_dev_ctrl &= ~HOB;
         break;
     case ATA_Reg::DEVICE_HEAD:
         this->r_dev_head = value;
@@ -186,6 +217,8 @@ void AtaBaseDevice::prepare_xfer(int xfer_size, int block_size) {
     this->chunk_cnt  = std::min(xfer_size, block_size);
     this->xfer_cnt   = xfer_size;
     this->chunk_size = block_size;
+
+    this->post_xfer_action = nullptr;
 }
 
 void AtaBaseDevice::signal_data_ready() {
@@ -42,6 +42,9 @@ public:
 
     void set_host(IdeChannel* host) { this->host_obj = host; };
 
+    // HWComponent methods
+    void reset() override;
+
     uint16_t read(const uint8_t reg_addr) override;
     void write(const uint8_t reg_addr, const uint16_t value) override;
 
@@ -60,7 +63,7 @@ public:
     void signal_data_ready();
 
     bool has_data() {
-        return data_ptr && xfer_cnt;
+        return data_ptr && xfer_cnt > 0;
     }
 
     uint16_t get_data() {
@@ -91,6 +94,13 @@ protected:
     uint8_t r_status_save;
     uint8_t r_dev_ctrl = 0x08;
 
+    // previous register contents for 48-bit commands
+    uint8_t r_hob_features   = 0;
+    uint8_t r_hob_sect_count = 0;
+    uint8_t r_hob_sect_num   = 0;
+    uint8_t r_hob_cyl_lo     = 0;
+    uint8_t r_hob_cyl_hi     = 0;
+
     uint16_t    *data_ptr       = nullptr;
     uint16_t    *cur_data_ptr   = nullptr;
     uint8_t     data_buf[512]   = {};
@@ -98,6 +108,7 @@ protected:
     int         chunk_cnt       = 0;
     int         chunk_size      = 0;
 
+    // called after each block of a multi-block transfer
     std::function<void()> post_xfer_action = nullptr;
 };
 
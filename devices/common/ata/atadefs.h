@@ -124,9 +124,12 @@ enum ATA_Cmd : uint8_t {
     READ_SECTOR_NR   = 0x21,
     READ_LONG        = 0x22,
     READ_SECTOR_EXT  = 0x24,
+    READ_MULTIPLE_EXT = 0x29,
     WRITE_SECTOR     = 0x30,
     WRITE_SECTOR_NR  = 0x31,
     WRITE_LONG       = 0x32,
+    WRITE_SECTOR_EXT = 0x34,
+    WRITE_MULTIPLE_EXT = 0x39,
     READ_VERIFY      = 0x40,
     FORMAT_TRACKS    = 0x50,
     IDE_SEEK         = 0x70,
@@ -137,9 +140,11 @@ enum ATA_Cmd : uint8_t {
     ATAPI_SERVICE    = 0xA2,
     READ_MULTIPLE    = 0xC4,
     WRITE_MULTIPLE   = 0xC5,
+    SET_MULTIPLE_MODE = 0xC6,
     READ_DMA         = 0xC8,
     WRITE_DMA        = 0xCA,
     FLUSH_CACHE      = 0xE7, // ATA-5
+    FLUSH_CACHE_EXT  = 0xEA, // ATA-6
     WRITE_BUFFER_DMA = 0xE9,
     READ_BUFFER_DMA  = 0xEB,
     IDENTIFY_DEVICE  = 0xEC,
@@ -28,6 +28,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <machines/machinebase.h>
 #include <memaccess.h>
 
+#include <algorithm>
 #include <cstring>
 #include <fstream>
 #include <string>
@@ -60,8 +61,17 @@ int AtaHardDisk::device_postinit() {
     return 0;
 }
 
+void AtaHardDisk::reset() {
+    AtaBaseDevice::reset();
+
+    this->sec_remain     = 0;
+    this->multiple_count = 0;
+}
+
 void AtaHardDisk::insert_image(std::string filename) {
-    if (!this->hdd_img.open(filename)) {
+    WriteSync sync = write_sync_from_str(GET_STR_PROP("hdd_sync"));
+
+    if (!this->hdd_img.open(filename, sync)) {
         ABORT_F("%s: could not open image file", this->name.c_str());
     }
 
@@ -71,6 +81,7 @@ void AtaHardDisk::insert_image(std::string filename) {
 
 int AtaHardDisk::perform_command() {
     this->r_status |= BSY;
+    this->r_status &= ~ERR;
     this->r_error = 0;
 
     switch (this->r_command) {
@@ -82,31 +93,57 @@ int AtaHardDisk::perform_command() {
         this->r_cylinder_hi = 0;
         break;
     case READ_SECTOR:
-    case READ_SECTOR_NR: {
-            uint16_t sec_count = this->r_sect_count ? this->r_sect_count : 256;
-            int      xfer_size = sec_count * ATA_HD_SEC_SIZE;
-            uint64_t offset    = this->get_lba() * ATA_HD_SEC_SIZE;
-            hdd_img.read(buffer, offset, xfer_size);
-            this->data_ptr = (uint16_t *)this->buffer;
-            // those commands should generate IRQ for each sector
-            this->prepare_xfer(xfer_size, ATA_HD_SEC_SIZE);
-            this->signal_data_ready();
+    case READ_SECTOR_NR:
+        // those commands should generate IRQ for each sector
+        this->start_read(this->get_lba(), this->get_sec_count(), 1);
+        break;
+    case READ_SECTOR_EXT:
+        this->start_read(this->get_lba48(), this->get_sec_count48(), 1);
+        break;
+    case READ_MULTIPLE:
+    case READ_MULTIPLE_EXT:
+        if (!this->multiple_count) {
+            this->abort_command();
+            break;
         }
+        // one IRQ per block of multiple_count sectors
+        if (this->r_command == READ_MULTIPLE_EXT)
+            this->start_read(this->get_lba48(), this->get_sec_count48(),
+                             this->multiple_count);
+        else
+            this->start_read(this->get_lba(), this->get_sec_count(),
+                             this->multiple_count);
         break;
     case WRITE_SECTOR:
-    case WRITE_SECTOR_NR: {
-            uint16_t sec_count = this->r_sect_count ? this->r_sect_count : 256;
-            this->cur_fpos = this->get_lba() * ATA_HD_SEC_SIZE;
-            this->data_ptr = (uint16_t *)this->buffer;
-            this->cur_data_ptr = this->data_ptr;
-            this->prepare_xfer(sec_count * ATA_HD_SEC_SIZE, ATA_HD_SEC_SIZE);
-            this->post_xfer_action = [this]() {
-                this->hdd_img.write(this->data_ptr, this->cur_fpos, this->chunk_size);
-                this->cur_fpos += this->chunk_size;
-            };
-            this->r_status |= DRQ;
-            this->r_status &= ~BSY;
+    case WRITE_SECTOR_NR:
+        this->start_write(this->get_lba(), this->get_sec_count(), 1);
+        break;
+    case WRITE_SECTOR_EXT:
+        this->start_write(this->get_lba48(), this->get_sec_count48(), 1);
+        break;
+    case WRITE_MULTIPLE:
+    case WRITE_MULTIPLE_EXT:
+        if (!this->multiple_count) {
+            this->abort_command();
+            break;
         }
+        if (this->r_command == WRITE_MULTIPLE_EXT)
+            this->start_write(this->get_lba48(), this->get_sec_count48(),
+                              this->multiple_count);
+        else
+            this->start_write(this->get_lba(), this->get_sec_count(),
+                              this->multiple_count);
+        break;
+    case SET_MULTIPLE_MODE:
+        // zero disables multiple mode, other values must be powers of two
+        if (this->r_sect_count > ATA_HD_MAX_MULTIPLE ||
+            (this->r_sect_count & (this->r_sect_count - 1))) {
+            this->abort_command();
+            break;
+        }
+        this->multiple_count = this->r_sect_count;
+        this->r_status &= ~BSY;
+        this->update_intrq(1);
         break;
     case INIT_DEV_PARAM:
         // update fictive disk geometry with parameters from host
@@ -120,6 +157,12 @@ int AtaHardDisk::perform_command() {
         this->device_set_signature();
         break;
     case FLUSH_CACHE: // used by the XNU kernel driver
+    case FLUSH_CACHE_EXT:
+        if (!this->hdd_img.flush()) {
+            LOG_F(ERROR, "%s: could not commit cached data", this->name.c_str());
+            this->abort_command();
+            break;
+        }
         this->r_status &= ~(BSY | DRQ | ERR);
         this->update_intrq(1);
         break;
@@ -165,6 +208,82 @@ int AtaHardDisk::perform_command() {
     return 0;
 }
 
+void AtaHardDisk::abort_command() {
+    this->r_error  |= ATA_Error::ABRT;
+    this->r_status |= ATA_Status::ERR;
+    this->r_status &= ~(BSY | DRQ);
+    this->update_intrq(1);
+}
+
+bool AtaHardDisk::check_range(uint64_t lba, uint32_t sec_count) {
+    if (lba >= this->total_sectors || sec_count > this->total_sectors - lba) {
+        LOG_F(ERROR, "%s: sectors %llu..%llu out of range", this->name.c_str(),
+              (unsigned long long)lba, (unsigned long long)(lba + sec_count - 1));
+        this->r_error  |= ATA_Error::IDNF;
+        this->r_status |= ATA_Status::ERR;
+        this->r_status &= ~(BSY | DRQ);
+        this->update_intrq(1);
+        return false;
+    }
+    return true;
+}
+
+void AtaHardDisk::start_read(uint64_t lba, uint32_t sec_count, int block_secs) {
+    if (!this->check_range(lba, sec_count))
+        return;
+
+    this->cur_fpos  = lba * ATA_HD_SEC_SIZE;
+    this->sec_remain = sec_count;
+    this->fill_read_buffer();
+
+    this->prepare_xfer(sec_count * ATA_HD_SEC_SIZE, block_secs * ATA_HD_SEC_SIZE);
+
+    // refill the buffer once the host has consumed it
+    this->post_xfer_action = [this]() {
+        if ((char *)this->data_ptr >= this->buffer + ATA_HD_BUF_SECS * ATA_HD_SEC_SIZE)
+            this->fill_read_buffer();
+    };
+
+    this->signal_data_ready();
+}
+
+void AtaHardDisk::fill_read_buffer() {
+    // The buffer size is a multiple of every allowed block size
+    // so that blocks never straddle two buffer fills.
+    uint32_t num_secs = std::min(this->sec_remain, (uint32_t)ATA_HD_BUF_SECS);
+
+    this->hdd_img.read(this->buffer, this->cur_fpos, num_secs * ATA_HD_SEC_SIZE);
+
+    this->cur_fpos   += num_secs * ATA_HD_SEC_SIZE;
+    this->sec_remain -= num_secs;
+    this->data_ptr    = (uint16_t *)this->buffer;
+}
+
+void AtaHardDisk::start_write(uint64_t lba, uint32_t sec_count, int block_secs) {
+    if (!this->check_range(lba, sec_count))
+        return;
+
+    this->cur_fpos = lba * ATA_HD_SEC_SIZE;
+    this->data_ptr = (uint16_t *)this->buffer;
+    this->cur_data_ptr = this->data_ptr;
+    this->prepare_xfer(sec_count * ATA_HD_SEC_SIZE, block_secs * ATA_HD_SEC_SIZE);
+
+    // write each block with a single call, the last one may be partial
+    this->post_xfer_action = [this]() {
+        size_t len = std::min(this->xfer_cnt, this->chunk_size);
+        if (this->hdd_img.write(this->data_ptr, this->cur_fpos, len) != len) {
+            LOG_F(ERROR, "%s: could not write to the image", this->name.c_str());
+            this->xfer_cnt = 0; // no more blocks will be requested
+            this->abort_command();
+            return;
+        }
+        this->cur_fpos += len;
+    };
+
+    this->r_status |= DRQ;
+    this->r_status &= ~BSY;
+}
+
 void AtaHardDisk::prepare_identify_info() {
     uint16_t    *buf_ptr = (uint16_t *)this->data_buf;
 
@@ -178,9 +297,41 @@ void AtaHardDisk::prepare_identify_info() {
     buf_ptr[ 3] = 5;
     buf_ptr[ 6] = 17;
 
+    // report maximum and current number of sectors per READ/WRITE MULTIPLE block
+    WRITE_WORD_LE_A(&buf_ptr[47], 0x8000U | ATA_HD_MAX_MULTIPLE);
+    if (this->multiple_count)
+        WRITE_WORD_LE_A(&buf_ptr[59], 0x100U | this->multiple_count);
+
     // report LBA capacity
-    WRITE_WORD_LE_A(&buf_ptr[60], (this->total_sectors & 0xFFFFU));
-    WRITE_WORD_LE_A(&buf_ptr[61], (this->total_sectors >> 16) & 0xFFFFU);
+    uint32_t lba28_sectors = std::min(this->total_sectors, (uint64_t)0x0FFFFFFFU);
+    WRITE_WORD_LE_A(&buf_ptr[60], (lba28_sectors & 0xFFFFU));
+    WRITE_WORD_LE_A(&buf_ptr[61], (lba28_sectors >> 16) & 0xFFFFU);
+
+    // supported ATA versions 1 to 6, 48-bit address feature set
+    WRITE_WORD_LE_A(&buf_ptr[80], 0x007EU);
+    WRITE_WORD_LE_A(&buf_ptr[83], 0x4400U);
+    WRITE_WORD_LE_A(&buf_ptr[84], 0x4000U);
+    WRITE_WORD_LE_A(&buf_ptr[86], 0x0400U);
+    WRITE_WORD_LE_A(&buf_ptr[87], 0x4000U);
+
+    // report 48-bit LBA capacity
+    for (int i = 0; i < 4; i++)
+        WRITE_WORD_LE_A(&buf_ptr[100 + i], (this->total_sectors >> (i * 16)) & 0xFFFFU);
+}
+
+uint32_t AtaHardDisk::get_sec_count() {
+    return this->r_sect_count ? this->r_sect_count : 256;
+}
+
+uint32_t AtaHardDisk::get_sec_count48() {
+    uint32_t sec_count = (this->r_hob_sect_count << 8) | this->r_sect_count;
+    return sec_count ? sec_count : 65536;
+}
+
+uint64_t AtaHardDisk::get_lba48() {
+    return ((uint64_t)this->r_hob_cyl_hi << 40) | ((uint64_t)this->r_hob_cyl_lo << 32) |
+           ((uint64_t)this->r_hob_sect_num << 24) | (this->r_cylinder_hi << 16) |
+           (this->r_cylinder_lo << 8) | this->r_sect_num;
 }
 
 uint64_t AtaHardDisk::get_lba() {
@@ -202,6 +353,7 @@ uint64_t AtaHardDisk::get_lba() {
 
 static const PropMap AtaHardDiskProperties = {
     {"hdd_img", new StrProperty("")},
+    {"hdd_sync", new StrProperty("writeback", {"unsafe", "writeback", "writethrough"})},
 };
 
 static const DeviceDescription AtaHardDiskDescriptor =
@@ -30,6 +30,8 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <string>
 
 #define ATA_HD_SEC_SIZE 512
+#define ATA_HD_BUF_SECS 256 // sectors buffered for reading and writing
+#define ATA_HD_MAX_MULTIPLE 128 // max sectors per READ/WRITE MULTIPLE block
 
 class AtaHardDisk : public AtaBaseDevice
 {
@@ -42,6 +44,7 @@ public:
     }
 
     int device_postinit() override;
+    void reset() override;
 
     void insert_image(std::string filename);
     int perform_command() override;
@@ -49,19 +52,29 @@ public:
 protected:
     void        prepare_identify_info();
     uint64_t    get_lba();
+    uint64_t    get_lba48();
+    uint32_t    get_sec_count();
+    uint32_t    get_sec_count48();
+    void        abort_command();
+    bool        check_range(uint64_t lba, uint32_t sec_count);
+    void        start_read(uint64_t lba, uint32_t sec_count, int block_secs);
+    void        fill_read_buffer();
+    void        start_write(uint64_t lba, uint32_t sec_count, int block_secs);
 
 private:
     ImgFile     hdd_img;
     uint64_t    img_size = 0;
-    uint32_t    total_sectors = 0;
+    uint64_t    total_sectors = 0;
     uint64_t    cur_fpos = 0;
+    uint32_t    sec_remain = 0;     // sectors not yet read into the buffer
+    uint8_t     multiple_count = 0; // sectors per block, 0 - multiple mode disabled
 
     // fictive disk geometry for CHS-to-LBA translation
     uint16_t    cylinders;
     uint8_t     heads;
     uint8_t     sectors;
 
-    char * buffer = new char[1 <<17];
+    char * buffer = new char[ATA_HD_BUF_SECS * ATA_HD_SEC_SIZE];
 
     uint8_t hd_id_data[ATA_HD_SEC_SIZE] = {};
 };
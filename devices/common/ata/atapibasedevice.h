@@ -37,6 +37,12 @@ public:
 
     void device_set_signature() override;
 
+    // HWComponent methods
+    void reset() override {
+        AtaBaseDevice::reset();
+        this->status_expected = false;
+    };
+
     uint16_t read(const uint8_t reg_addr) override;
     void write(const uint8_t reg_addr, const uint16_t value) override;
 
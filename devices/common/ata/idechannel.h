@@ -47,6 +47,9 @@ public:
     }
 
     int device_postinit() override;
+    void reset() override {
+        this->cur_dev = 0;
+    };
 
     void register_device(int id, AtaInterface* dev_obj);
 
@@ -25,6 +25,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <devices/common/dbdma.h>
 #include <devices/common/dmacore.h>
 #include <devices/common/hwinterrupt.h>
+#include <devices/common/iotrace.h>
 #include <devices/common/mmiodevice.h>
 #include <endianswap.h>
 #include <memaccess.h>
@@ -42,6 +43,10 @@ void DMAChannel::set_callbacks(DbdmaCallback start_cb, DbdmaCallback stop_cb) {
 void DMAChannel::fetch_cmd(uint32_t cmd_addr, DMACmd* p_cmd) {
     MapDmaResult res = mmu_map_dma_mem(cmd_addr, 16, false);
     memcpy((uint8_t*)p_cmd, res.host_va, 16);
+
+    if (io_trace_enabled)
+        IoTracer::get_instance()->trace_dma_mem(this->get_name(), cmd_addr,
+                                                res.host_va, 16);
 }
 
 uint8_t DMAChannel::interpret_cmd() {
@@ -75,6 +80,11 @@ uint8_t DMAChannel::interpret_cmd() {
         this->queue_data = res.host_va;
         this->queue_len  = cmd_struct.req_count;
         this->cmd_in_progress = true;
+
+        // the replay harness needs guest memory contents fed to devices
+        if (io_trace_enabled && this->cur_cmd <= DBDMA_Cmd::OUTPUT_LAST)
+            IoTracer::get_instance()->trace_dma_mem(this->get_name(),
+                cmd_struct.address, res.host_va, cmd_struct.req_count);
         break;
     case DBDMA_Cmd::STORE_QUAD:
         if ((cmd_struct.cmd_key & 7) != 6)
@@ -376,6 +386,9 @@ DmaPullResult DMAChannel::pull_data(uint32_t req_len, uint32_t *avail_len, uint8
             *avail_len      = this->queue_len;
             this->queue_len = 0;
         }
+        if (io_trace_enabled)
+            IoTracer::get_instance()->trace_dma_xfer(this->get_name(), *avail_len, false);
+
         return DmaPullResult::MoreData; // tell the caller there is more data
     }
 
@@ -399,6 +412,9 @@ int DMAChannel::push_data(const char* src_ptr, int len) {
         std::memcpy(this->queue_data, src_ptr, len);
         this->queue_data += len;
         this->queue_len  -= len;
+
+        if (io_trace_enabled)
+            IoTracer::get_instance()->trace_dma_xfer(this->get_name(), len, true);
     }
 
     // proceed with the DBDMA program if the buffer became exhausted
@@ -452,6 +468,22 @@ void DMAChannel::resume() {
     LOG_F(INFO, "%s: Resuming DMA channel", this->get_name().c_str());
 }
 
+/* Stop the channel and clear its registers, used during machine reset. */
+void DMAChannel::reset() {
+    if (this->ch_stat & CH_STAT_RUN)
+        this->abort();
+
+    this->ch_stat       = 0;
+    this->cmd_ptr       = 0;
+    this->queue_len     = 0;
+    this->queue_data    = 0;
+    this->int_select    = 0;
+    this->branch_select = 0;
+    this->wait_select   = 0;
+
+    this->cmd_in_progress = false;
+}
+
 void DMAChannel::abort() {
     LOG_F(9, "%s: Aborting DMA channel", this->get_name().c_str());
     if (this->stop_cb)
@@ -79,6 +79,11 @@ public:
         return 0;
     };
 
+    /** Return the component to its power-on state during a machine reset.
+        Host resources like memory, open images and windows are kept,
+        pending timers and asserted interrupts must be dropped. */
+    virtual void reset() {};
+
 protected:
     std::string name;
     uint64_t    supported_types = HWCompType::UNKNOWN;
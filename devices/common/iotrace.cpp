@@ -0,0 +1,201 @@
+/*
+DingusPPC - The Experimental PowerPC Macintosh emulator
+Copyright (C) 2018-23 divingkatae and maximum
+                      (theweirdo)     spatium
+
+(Contact divingkatae#1017 or powermax#2286 on Discord for more info)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file Device I/O trace capture. */
+
+#include <core/timermanager.h>
+#include <devices/common/iotrace.h>
+#include <devices/common/mmiodevice.h>
+#include <machines/machineproperties.h>
+#include <loguru.hpp>
+
+#include <cinttypes>
+#include <cstddef>
+#include <string>
+
+static_assert(sizeof(IoTraceRecord) == IO_TRACE_REC_SIZE,
+              "IoTraceRecord must not contain padding");
+
+IoTracer* IoTracer::io_tracer;
+
+bool io_trace_enabled = false;
+
+static void write_string(std::ofstream& f, const std::string& str) {
+    uint16_t len = (uint16_t)str.size();
+    f.write((const char*)&len, sizeof(len));
+    f.write(str.data(), len);
+}
+
+bool IoTracer::start(const std::string& path, const std::string& machine_id,
+                     const std::set<std::string>& sources)
+{
+    this->sources = sources;
+    this->src_ids.clear();
+    this->dev_ids.clear();
+    this->next_src_id = 0;
+
+    for (auto& cnt : this->counts)
+        cnt = 0;
+
+    // an empty path only counts events (used by the replay harness)
+    if (!path.empty()) {
+        this->trace_file.open(path, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (this->trace_file.fail()) {
+            LOG_F(ERROR, "IoTracer: could not create trace file %s", path.c_str());
+            return false;
+        }
+
+        uint32_t version = IO_TRACE_VERSION;
+        this->trace_file.write(IO_TRACE_MAGIC, 8);
+        this->trace_file.write((const char*)&version, sizeof(version));
+
+        write_string(this->trace_file, machine_id);
+
+        uint32_t num_settings = (uint32_t)gMachineSettings.size();
+        this->trace_file.write((const char*)&num_settings, sizeof(num_settings));
+
+        for (auto& s : gMachineSettings) {
+            write_string(this->trace_file, s.first);
+            write_string(this->trace_file, s.second->get_string());
+        }
+
+        LOG_F(INFO, "IoTracer: capturing device I/O to %s", path.c_str());
+    }
+
+    io_trace_enabled = true;
+
+    return true;
+}
+
+void IoTracer::stop() {
+    if (!io_trace_enabled)
+        return;
+
+    io_trace_enabled = false;
+
+    if (this->trace_file.is_open()) {
+        this->trace_file.close();
+        LOG_F(INFO, "IoTracer: %llu MMIO accesses, %llu DMA transfers, %llu interrupts captured",
+              (unsigned long long)(this->counts[IOT_MMIO_READ] + this->counts[IOT_MMIO_WRITE]),
+              (unsigned long long)(this->counts[IOT_DMA_PULL] + this->counts[IOT_DMA_PUSH]),
+              (unsigned long long)(this->counts[IOT_INT] + this->counts[IOT_DMA_INT]));
+    }
+}
+
+int IoTracer::get_src_id(const std::string& name, bool filtered) {
+    auto it = this->src_ids.find(name);
+    if (it != this->src_ids.end())
+        return it->second;
+
+    if (filtered && !this->sources.empty() && !this->sources.count(name))
+        return this->src_ids[name] = -1;
+
+    // source IDs are assigned in order of appearance
+    int src_id = this->next_src_id++;
+
+    this->src_ids[name] = src_id;
+
+    IoTraceRecord rec = {};
+    rec.time_ns = TimerManager::get_instance()->current_time_ns();
+    rec.kind    = IOT_SRC_DEF;
+    rec.src     = src_id;
+    rec.value   = (uint32_t)name.size();
+    write_record(rec, name.data());
+
+    return src_id;
+}
+
+void IoTracer::write_record(const IoTraceRecord& rec, const void* payload) {
+    this->counts[rec.kind]++;
+
+    if (!this->trace_file.is_open())
+        return;
+
+    this->trace_file.write((const char*)&rec, IO_TRACE_REC_SIZE);
+    if (payload)
+        this->trace_file.write((const char*)payload, rec.value);
+}
+
+void IoTracer::trace_mmio(MMIODevice* dev, uint32_t rgn_start, uint32_t offset,
+                          uint32_t value, int size, bool is_write)
+{
+    auto it = this->dev_ids.find(dev);
+    int src_id = (it != this->dev_ids.end()) ? it->second :
+                 (this->dev_ids[dev] = get_src_id(dev->get_name()));
+
+    if (src_id < 0)
+        return;
+
+    IoTraceRecord rec;
+    rec.time_ns = TimerManager::get_instance()->current_time_ns();
+    rec.addr    = rgn_start;
+    rec.value   = value;
+    rec.offset  = offset;
+    rec.src     = src_id;
+    rec.kind    = is_write ? IOT_MMIO_WRITE : IOT_MMIO_READ;
+    rec.size    = size;
+    write_record(rec);
+}
+
+void IoTracer::trace_dma_mem(const std::string& ch_name, uint32_t addr,
+                             const uint8_t* data, uint32_t len)
+{
+    int src_id = get_src_id(ch_name);
+    if (src_id < 0 || !data)
+        return;
+
+    IoTraceRecord rec = {};
+    rec.time_ns = TimerManager::get_instance()->current_time_ns();
+    rec.addr    = addr;
+    rec.value   = len;
+    rec.src     = src_id;
+    rec.kind    = IOT_DMA_MEM;
+    write_record(rec, data);
+}
+
+void IoTracer::trace_dma_xfer(const std::string& ch_name, uint32_t len, bool is_push) {
+    int src_id = get_src_id(ch_name);
+    if (src_id < 0)
+        return;
+
+    IoTraceRecord rec = {};
+    rec.time_ns = TimerManager::get_instance()->current_time_ns();
+    rec.value   = len;
+    rec.src     = src_id;
+    rec.kind    = is_push ? IOT_DMA_PUSH : IOT_DMA_PULL;
+    write_record(rec);
+}
+
+void IoTracer::trace_int(uint32_t irq_id, uint8_t irq_line_state, bool is_dma) {
+    // interrupt changes are the outcome of the traced activity
+    // so they are recorded regardless of the source selection
+    int src_id = get_src_id("int_ctrl", false);
+    if (src_id < 0)
+        return;
+
+    IoTraceRecord rec = {};
+    rec.time_ns = TimerManager::get_instance()->current_time_ns();
+    rec.addr    = irq_id;
+    rec.value   = irq_line_state;
+    rec.src     = src_id;
+    rec.kind    = is_dma ? IOT_DMA_INT : IOT_INT;
+    write_record(rec);
+}
@@ -0,0 +1,116 @@
+/*
+DingusPPC - The Experimental PowerPC Macintosh emulator
+Copyright (C) 2018-23 divingkatae and maximum
+                      (theweirdo)     spatium
+
+(Contact divingkatae#1017 or powermax#2286 on Discord for more info)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file Device I/O trace capture.
+
+    Records MMIO accesses, DBDMA transfers and interrupt line changes
+    together with their virtual timestamps into a compact binary file
+    that can be replayed against the device models without a CPU
+    (see benchmark/ioreplay.cpp).
+
+    Trace file layout:
+    - header: magic "DPPCIOTR", format version (uint32), machine ID and
+      machine settings as length-prefixed strings
+    - a stream of IoTraceRecord entries (IO_TRACE_REC_SIZE bytes each),
+      some of them followed by a payload of IoTraceRecord::value bytes.
+ */
+
+#ifndef IO_TRACE_H
+#define IO_TRACE_H
+
+#include <cinttypes>
+#include <fstream>
+#include <map>
+#include <set>
+#include <string>
+
+class MMIODevice;
+
+#define IO_TRACE_MAGIC      "DPPCIOTR"
+#define IO_TRACE_VERSION    1
+
+enum IoTraceKind : uint8_t {
+    IOT_SRC_DEF     = 0, // src -> name mapping, payload = name
+    IOT_MMIO_READ   = 1, // addr = region start, value = data
+    IOT_MMIO_WRITE  = 2, // addr = region start, value = data
+    IOT_DMA_MEM     = 3, // guest memory read by DMA, addr = phys, payload = data
+    IOT_DMA_PULL    = 4, // value = number of bytes delivered to the device
+    IOT_DMA_PUSH    = 5, // value = number of bytes received from the device
+    IOT_INT         = 6, // addr = irq_id, value = line state
+    IOT_DMA_INT     = 7, // addr = irq_id, value = line state
+    IOT_NUM_KINDS
+};
+
+/** Trace record as stored in the file (in host byte order). */
+typedef struct IoTraceRecord {
+    uint64_t    time_ns;    // virtual time of the event
+    uint32_t    addr;
+    uint32_t    value;
+    uint32_t    offset;     // register offset for MMIO accesses
+    uint16_t    src;        // source ID defined by an IOT_SRC_DEF record
+    uint8_t     kind;
+    uint8_t     size;       // access size for MMIO accesses
+} IoTraceRecord;
+
+#define IO_TRACE_REC_SIZE   24
+
+class IoTracer {
+public:
+    static IoTracer* get_instance() {
+        if (!io_tracer) {
+            io_tracer = new IoTracer();
+        }
+        return io_tracer;
+    };
+
+    // Start capturing into a file. An empty source list captures everything.
+    bool start(const std::string& path, const std::string& machine_id,
+               const std::set<std::string>& sources);
+    void stop();
+
+    void trace_mmio(MMIODevice* dev, uint32_t rgn_start, uint32_t offset,
+                    uint32_t value, int size, bool is_write);
+    void trace_dma_mem(const std::string& ch_name, uint32_t addr,
+                       const uint8_t* data, uint32_t len);
+    void trace_dma_xfer(const std::string& ch_name, uint32_t len, bool is_push);
+    void trace_int(uint32_t irq_id, uint8_t irq_line_state, bool is_dma);
+
+    uint64_t get_count(IoTraceKind kind) { return this->counts[kind]; };
+
+private:
+    static IoTracer* io_tracer;
+    IoTracer() {}; // private constructor to implement a singleton
+
+    int  get_src_id(const std::string& name, bool filtered = true);
+    void write_record(const IoTraceRecord& rec, const void* payload = nullptr);
+
+    std::ofstream                   trace_file;
+    std::set<std::string>           sources;
+    std::map<std::string, int>      src_ids; // -1 for filtered out sources
+    std::map<MMIODevice*, int>      dev_ids;
+    int                             next_src_id = 0;
+    uint64_t                        counts[IOT_NUM_KINDS] = {};
+};
+
+// checked at every hook so that disabled tracing costs only a branch
+extern bool io_trace_enabled;
+
+#endif // IO_TRACE_H
@@ -291,6 +291,10 @@ static const PropMap Bandit_Properties = {
         new StrProperty("")},
     {"pci_C1",
         new StrProperty("")},
+    {"pvblk_img", // disk image for a PvBlock device plugged in a slot
+        new StrProperty("")},
+    {"pvblk_sync", // when writes to the PvBlock image reach the host disk
+        new StrProperty("writeback", {"unsafe", "writeback", "writethrough"})},
 };
 
 static const DeviceDescription Bandit1_Descriptor = {
@@ -58,6 +58,7 @@ enum {
     PCI_VENDOR_MOTOROLA = 0x1057,
     PCI_VENDOR_APPLE    = 0x106B,
     PCI_VENDOR_NVIDIA   = 0x10DE,
+    PCI_VENDOR_DINGUS   = 0xD1B5, // emulator-private paravirtual devices
 };
 
 /** PCI BAR types */
@@ -84,6 +84,14 @@ bool PCIHost::pci_unregister_mmio_region(uint32_t start_addr, uint32_t size, PCI
     return mem_ctrl->remove_mmio_region(start_addr, size, obj);
 }
 
+bool PCIHost::pci_register_ram_region(uint32_t start_addr, uint32_t size,
+                                      uint8_t* mem_ptr, PCIDevice* obj)
+{
+    MemCtrlBase *mem_ctrl = dynamic_cast<MemCtrlBase *>
+                           (gMachineObj->get_comp_by_type(HWCompType::MEM_CTRL));
+    return mem_ctrl->add_dev_ram_region(start_addr, size, mem_ptr, obj);
+}
+
 void PCIHost::attach_pci_device(const std::string& dev_name, int slot_id)
 {
     this->attach_pci_device(dev_name, slot_id, "");
@@ -178,6 +186,26 @@ void PCIHost::pci_io_write_broadcast(uint32_t offset, int size, uint32_t value)
     );
 }
 
+IntSrc PCIHost::pci_get_slot_irq(PCIDevice* dev_instance)
+{
+    for (auto& dev : this->dev_map) {
+        if (dev.second != dev_instance)
+            continue;
+
+        // slots A1...C1 are at device numbers 0xD...0xF on all hosts
+        switch ((dev.first >> 3) & 0x1F) {
+        case 0xD:
+            return IntSrc::PCI_A;
+        case 0xE:
+            return IntSrc::PCI_B;
+        case 0xF:
+            return IntSrc::PCI_C;
+        }
+    }
+
+    return IntSrc::INT_UNKNOWN;
+}
+
 PCIDevice *PCIHost::pci_find_device(uint8_t bus_num, uint8_t dev_num, uint8_t fun_num)
 {
     for (auto& bridge : this->bridge_devs) {
@@ -23,6 +23,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #define PCI_HOST_H
 
 #include <core/bitops.h>
+#include <devices/common/hwinterrupt.h>
 #include <endianswap.h>
 
 #include <cinttypes>
@@ -64,6 +65,8 @@ public:
 
     virtual bool pci_register_mmio_region(uint32_t start_addr, uint32_t size, PCIDevice* obj);
     virtual bool pci_unregister_mmio_region(uint32_t start_addr, uint32_t size, PCIDevice* obj);
+    virtual bool pci_register_ram_region(uint32_t start_addr, uint32_t size,
+                                         uint8_t* mem_ptr, PCIDevice* obj);
 
     virtual void attach_pci_device(const std::string& dev_name, int slot_id);
     PCIDevice *attach_pci_device(const std::string& dev_name, int slot_id,
@@ -77,6 +80,9 @@ public:
 
     virtual PCIDevice *pci_find_device(uint8_t bus_num, uint8_t dev_num, uint8_t fun_num);
 
+    // interrupt source wired to the slot the device is plugged in
+    virtual IntSrc pci_get_slot_irq(PCIDevice* dev_instance);
+
     virtual uint32_t pci_t1_read(uint8_t dev, uint32_t fun, uint32_t reg, AccessDetails &details) {
         return 0;
     };
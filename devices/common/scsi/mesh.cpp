@@ -36,6 +36,7 @@ using namespace MeshScsi;
 int MeshController::device_postinit()
 {
     this->bus_obj = dynamic_cast<ScsiBus*>(gMachineObj->get_comp_by_name("Scsi0"));
+    this->bus_obj->register_device(7, static_cast<ScsiDevice*>(this));
 
     this->int_ctrl = dynamic_cast<InterruptCtrl*>(
         gMachineObj->get_comp_by_type(HWCompType::INT_CTRL));
@@ -58,6 +59,24 @@ void MeshController::reset(bool is_hard_reset)
     }
 }
 
+void MeshController::reset()
+{
+    if (this->seq_timer_id) {
+        TimerManager::get_instance()->cancel_timer(this->seq_timer_id);
+        this->seq_timer_id = 0;
+    }
+
+    ScsiDevice::reset();
+    this->reset(true);
+
+    this->cur_state     = SeqState::IDLE;
+    this->int_stat      = 0;
+    this->exception     = 0;
+    this->resel_enabled = false;
+    if (this->int_ctrl)
+        this->update_irq();
+}
+
 uint8_t MeshController::read(uint8_t reg_offset)
 {
     switch(reg_offset) {
@@ -71,10 +90,16 @@ uint8_t MeshController::read(uint8_t reg_offset)
         return this->bus_obj->test_ctrl_lines(0xFFU);
     case MeshReg::BusStatus1:
         return this->bus_obj->test_ctrl_lines(0xE000U) >> 8;
+    case MeshReg::FIFO:
+        if (this->fifo_cnt) {
+            this->fifo_cnt--;
+            return this->resel_id_bits;
+        }
+        break;
     case MeshReg::FIFOCount:
         return this->fifo_cnt;
     case MeshReg::Exception:
-        return 0;
+        return this->exception;
     case MeshReg::Error:
         return 0;
     case MeshReg::IntMask:
@@ -121,6 +146,8 @@ void MeshController::write(uint8_t reg_offset, uint8_t value)
         break;
     case MeshReg::Interrupt:
         this->int_stat &= ~(value & INT_MASK); // clear requested interrupt bits
+        if (value & INT_EXCEPTION)
+            this->exception = 0;
         update_irq();
         break;
     case MeshReg::SourceID:
@@ -162,11 +189,11 @@ void MeshController::perform_command(const uint8_t cmd)
         this->int_stat |= INT_CMD_DONE;
         break;
     case SeqCmd::EnaReselect:
-        LOG_F(INFO, "MESH: EnaReselect stub invoked");
+        this->resel_enabled = true;
         this->int_stat |= INT_CMD_DONE;
         break;
     case SeqCmd::DisReselect:
-        LOG_F(9, "MESH: DisReselect stub invoked");
+        this->resel_enabled = false;
         this->int_stat |= INT_CMD_DONE;
         break;
     case SeqCmd::ResetMesh:
@@ -187,6 +214,7 @@ void MeshController::seq_defer_state(uint64_t delay_ns)
     seq_timer_id = TimerManager::get_instance()->add_oneshot_timer(
         delay_ns,
         [this]() {
+            this->seq_timer_id = 0;
             // re-enter the sequencer with the state specified in next_state
             this->cur_state = this->next_state;
             this->sequencer();
@@ -254,6 +282,41 @@ void MeshController::sequencer()
     }
 }
 
+void MeshController::notify(ScsiMsg msg_type, int param)
+{
+    if (msg_type != ScsiMsg::BUS_PHASE_CHANGE || param != ScsiPhase::RESELECTION)
+        return;
+
+    if (!this->resel_enabled || !(this->bus_obj->get_data_lines() & (1 << this->src_id)))
+        return;
+
+    TimerManager::get_instance()->add_oneshot_timer(
+        BUS_SETTLE_DELAY,
+        [this]() {
+            this->reselected();
+    });
+}
+
+void MeshController::reselected()
+{
+    if (this->bus_obj->current_phase() != ScsiPhase::RESELECTION)
+        return;
+
+    this->resel_id_bits = this->bus_obj->get_data_lines();
+    this->fifo_cnt      = 1;
+
+    LOG_F(9, "MESH: reselected, bus IDs 0x%02X", this->resel_id_bits);
+
+    this->bus_obj->assert_ctrl_line(this->src_id, SCSI_CTRL_BSY);
+    this->bus_obj->confirm_reselection(this->src_id);
+    this->bus_obj->release_ctrl_line(this->src_id, SCSI_CTRL_BSY);
+
+    // the driver reads the bus IDs from the FIFO and takes the IDENTIFY message
+    this->exception |= EXC_RESEL;
+    this->int_stat  |= INT_EXCEPTION;
+    update_irq();
+}
+
 void MeshController::update_irq()
 {
     uint8_t new_irq = !!(this->int_stat & this->int_mask);
@@ -26,12 +26,12 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include <devices/common/dmacore.h>
 #include <devices/common/hwcomponent.h>
+#include <devices/common/scsi/scsi.h>
 
 #include <cinttypes>
 #include <memory>
 
 class InterruptCtrl;
-class ScsiBus;
 
 // Chip ID returned by the MESH ASIC on TNT machines (Apple part 343S1146-a)
 #define TntMeshID       0xE2
@@ -78,6 +78,7 @@ enum {
     EXC_SEL_TIMEOUT = 1 << 0,
     EXC_PHASE_MM    = 1 << 1,
     EXC_ARB_LOST    = 1 << 2,
+    EXC_RESEL       = 1 << 3,
 };
 
 // Interrupt register bits.
@@ -119,12 +120,11 @@ public:
     void   write(uint8_t reg_offset, uint8_t value) {};
 };
 
-class MeshController : public HWComponent {
+class MeshController : public ScsiDevice {
 public:
-    MeshController(uint8_t mesh_id) {
+    MeshController(uint8_t mesh_id) : ScsiDevice("MESH", 7) {
         supports_types(HWCompType::SCSI_HOST | HWCompType::SCSI_DEV);
         this->chip_id = mesh_id;
-        this->set_name("MESH");
         this->reset(true);
     };
     ~MeshController() = default;
@@ -143,6 +143,13 @@ public:
 
     // HWComponent methods
     int device_postinit();
+    void reset() override;
+
+    // ScsiDevice methods
+    void notify(ScsiMsg msg_type, int param) override;
+    bool prepare_data() override { return false; };
+    bool get_more_data() override { return false; };
+    void process_command() override {};
 
     void set_dma_channel(DmaBidirChannel *dma_ch) {
         this->dma_ch = dma_ch;
@@ -153,6 +160,7 @@ protected:
     void    perform_command(const uint8_t cmd);
     void    seq_defer_state(uint64_t delay_ns);
     void    sequencer();
+    void    reselected();
     void    update_irq();
 
 private:
@@ -165,14 +173,16 @@ private:
     uint8_t     cur_cmd;
     uint8_t     error;
     uint8_t     fifo_cnt;
-    uint8_t     exception;
+    uint8_t     exception = 0;
     uint32_t    xfer_count;
+    bool        resel_enabled = false;
+    uint8_t     resel_id_bits = 0;  // bus IDs latched in the FIFO on reselection
 
     ScsiBus*    bus_obj;
     uint16_t    bus_stat;
 
     // Sequencer state
-    uint32_t    seq_timer_id;
+    uint32_t    seq_timer_id = 0;
     uint32_t    cur_state;
     uint32_t    next_state;
 
@@ -58,9 +58,10 @@ void Sc53C94::reset_device()
     // part-unique ID to be read using a magic sequence
     this->set_xfer_count = this->chip_id << 16;
 
-    this->clk_factor   = 2;
-    this->sel_timeout  = 0;
-    this->is_initiator = true;
+    this->clk_factor    = 2;
+    this->sel_timeout   = 0;
+    this->is_initiator  = true;
+    this->resel_enabled = false;
 
     // clear command FIFO
     this->cmd_fifo_pos = 0;
@@ -74,6 +75,30 @@ void Sc53C94::reset_device()
     this->status = 0;
 }
 
+void Sc53C94::reset()
+{
+    TimerManager* timer_man = TimerManager::get_instance();
+
+    if (this->my_timer_id) {
+        timer_man->cancel_timer(this->my_timer_id);
+        this->my_timer_id = 0;
+    }
+    if (this->seq_timer_id) {
+        timer_man->cancel_timer(this->seq_timer_id);
+        this->seq_timer_id = 0;
+    }
+
+    ScsiDevice::reset();
+    reset_device();
+
+    this->on_reset   = false;
+    this->cmd_steps  = nullptr;
+    this->cur_state  = SeqState::IDLE;
+    this->int_status = 0;
+    if (this->int_ctrl)
+        this->update_irq();
+}
+
 uint8_t Sc53C94::read(uint8_t reg_offset)
 {
     uint8_t status, int_status;
@@ -276,6 +301,7 @@ void Sc53C94::exec_command()
         my_timer_id = TimerManager::get_instance()->add_oneshot_timer(
             USECS_TO_NSECS(25),
             [this]() {
+                this->my_timer_id = 0;
                 this->bus_obj->release_ctrl_line(this->my_bus_id, SCSI_CTRL_RST);
         });
         if (!(config1 & 0x40)) {
@@ -317,7 +343,9 @@ void Sc53C94::exec_command()
         }
         this->bus_obj->release_ctrl_line(this->my_bus_id, SCSI_CTRL_ACK);
         this->int_status  = INTSTAT_SR;
-        this->int_status |= INTSTAT_DIS; // TODO: handle target disconnection properly
+        // the target either releases the bus or requests the next phase
+        if (this->bus_obj->current_phase() == ScsiPhase::BUS_FREE)
+            this->int_status |= INTSTAT_DIS;
         this->update_irq();
         exec_next_command();
         break;
@@ -348,6 +376,7 @@ void Sc53C94::exec_command()
         LOG_F(9, "%s: SELECT WITH ATN command started", this->name.c_str());
         break;
     case CMD_ENA_SEL_RESEL:
+        this->resel_enabled = true;
         exec_next_command();
         break;
     default:
@@ -400,6 +429,7 @@ void Sc53C94::seq_defer_state(uint64_t delay_ns)
     seq_timer_id = TimerManager::get_instance()->add_oneshot_timer(
         delay_ns,
         [this]() {
+            this->seq_timer_id = 0;
             // re-enter the sequencer with the state specified in next_state
             this->cur_state = this->next_state;
             this->sequencer();
@@ -508,6 +538,17 @@ void Sc53C94::sequencer()
                 this->cur_state = SeqState::XFER_END;
                 this->sequencer();
             }
+            break;
+        case ScsiPhase::MESSAGE_IN:
+            // receive one message byte and hold ACK until it's accepted
+            this->bus_obj->negotiate_xfer(this->data_fifo_pos, this->bytes_out);
+            this->rcv_data();
+            this->bus_obj->assert_ctrl_line(this->my_bus_id, SCSI_CTRL_ACK);
+            this->cur_state  = SeqState::IDLE;
+            this->int_status = INTSTAT_SO;
+            this->update_irq();
+            exec_next_command();
+            break;
         }
         break;
     case SeqState::XFER_END:
@@ -567,6 +608,7 @@ void Sc53C94::notify(ScsiMsg msg_type, int param)
         if (this->target_id == param) {
             // cancel selection timeout timer
             TimerManager::get_instance()->cancel_timer(this->seq_timer_id);
+            this->seq_timer_id = 0;
             this->cur_state = SeqState::SEL_END;
             this->sequencer();
         } else {
@@ -576,7 +618,27 @@ void Sc53C94::notify(ScsiMsg msg_type, int param)
         break;
     case ScsiMsg::BUS_PHASE_CHANGE:
         this->cur_bus_phase = param;
-        if (param != ScsiPhase::BUS_FREE && this->cmd_steps != nullptr) {
+        if (param == ScsiPhase::RESELECTION) {
+            if (!this->resel_enabled ||
+                !(this->bus_obj->get_data_lines() & (1 << this->my_bus_id)))
+                break;
+            // reselection terminates a selection command waiting for the bus
+            if (this->seq_timer_id)
+                TimerManager::get_instance()->cancel_timer(this->seq_timer_id);
+            this->cmd_fifo_pos = 0;
+            this->cmd_steps    = nullptr;
+            this->cur_state    = SeqState::IDLE;
+            this->seq_timer_id = TimerManager::get_instance()->add_oneshot_timer(
+                BUS_SETTLE_DELAY,
+                [this]() {
+                    this->seq_timer_id = 0;
+                    this->reselected();
+            });
+            break;
+        }
+        // arbitration by a reselecting target doesn't advance our sequence
+        if (param != ScsiPhase::BUS_FREE && param != ScsiPhase::ARBITRATION &&
+            this->cmd_steps != nullptr) {
             this->cmd_steps++;
             this->cur_state = this->cmd_steps->next_step;
             this->sequencer();
@@ -612,6 +674,41 @@ int Sc53C94::send_data(uint8_t* dst_ptr, int count)
     return actual_count;
 }
 
+void Sc53C94::reselected()
+{
+    uint8_t id_bits = this->bus_obj->get_data_lines();
+
+    if (this->bus_obj->current_phase() != ScsiPhase::RESELECTION)
+        return;
+
+    this->resel_enabled = false;
+    this->is_initiator  = true;
+
+    for (int id = 0; id < SCSI_MAX_DEVS; id++) {
+        if (id != this->my_bus_id && (id_bits & (1 << id))) {
+            this->target_id = id;
+            break;
+        }
+    }
+
+    LOG_F(9, "%s: reselected by target %d", this->name.c_str(), this->target_id);
+
+    this->bus_obj->assert_ctrl_line(this->my_bus_id, SCSI_CTRL_BSY);
+    this->bus_obj->confirm_reselection(this->my_bus_id);
+    this->bus_obj->release_ctrl_line(this->my_bus_id, SCSI_CTRL_BSY);
+
+    // the bus ID bits and the IDENTIFY message go into the data FIFO
+    this->data_fifo[0]  = id_bits;
+    this->data_fifo_pos = 1;
+    this->bus_obj->negotiate_xfer(this->data_fifo_pos, this->bytes_out);
+    this->rcv_data();
+    this->bus_obj->assert_ctrl_line(this->my_bus_id, SCSI_CTRL_ACK);
+
+    this->seq_step   = 0;
+    this->int_status = INTSTAT_RESEL | INTSTAT_SO;
+    this->update_irq();
+}
+
 bool Sc53C94::rcv_data()
 {
     int req_count;
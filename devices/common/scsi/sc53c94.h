@@ -179,6 +179,7 @@ public:
 
     // ScsiDevice methods
     void notify(ScsiMsg msg_type, int param);
+    void reset() override;
     bool prepare_data() { return false; };
     bool get_more_data() { return false; };
     bool has_data() { return this->data_fifo_pos != 0; };
@@ -197,6 +198,7 @@ protected:
     void seq_defer_state(uint64_t delay_ns);
 
     bool rcv_data();
+    void reselected();
 
     void update_irq();
 
@@ -204,7 +206,7 @@ private:
     uint8_t     chip_id;
     uint8_t     my_bus_id;
     ScsiBus*    bus_obj;
-    uint32_t    my_timer_id;
+    uint32_t    my_timer_id = 0;
 
     uint8_t     cmd_fifo[2];
     uint8_t     data_fifo[16];
@@ -212,6 +214,7 @@ private:
     int         data_fifo_pos;
     int         bytes_out;
     bool        on_reset = false;
+    bool        resel_enabled = false;
     uint32_t    xfer_count;
     uint32_t    set_xfer_count;
     uint8_t     status;
@@ -226,7 +229,7 @@ private:
     uint8_t     config3;
 
     // sequencer state
-    uint32_t    seq_timer_id;
+    uint32_t    seq_timer_id = 0;
     uint32_t    cur_state;
     uint32_t    next_state;
     SeqDesc*    cmd_steps;
@@ -29,6 +29,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <array>
 #include <cinttypes>
 #include <functional>
+#include <future>
 #include <memory>
 #include <string>
 
@@ -73,6 +74,14 @@ namespace ScsiStatus {
 namespace ScsiMessage {
     enum : uint8_t {
         COMMAND_COMPLETE = 0,
+        DISCONNECT       = 4,
+        IDENTIFY         = 0x80,
+    };
+
+    // IDENTIFY message bits
+    enum : uint8_t {
+        IDENT_DISC_PRIV  = 0x40, // initiator allows the target to disconnect
+        IDENT_LUN_MASK   = 0x07,
     };
 };
 
@@ -83,6 +92,7 @@ enum ScsiMsg : int {
     SEND_CMD_END,
     MESSAGE_BEGIN,
     MESSAGE_END,
+    CONFIRM_RESEL,
 };
 
 enum ScsiCommand : uint8_t {
@@ -108,7 +118,8 @@ enum ScsiCommand : uint8_t {
     READ_10                      = 0x28,
     WRITE_10                     = 0x2A,
     VERIFY_10                    = 0x2F,
-    READ_LONG_10                 = 0x35,
+    SYNC_CACHE_10                = 0x35,
+    READ_LONG_10                 = 0x3E,
     WRITE_BUFFER                 = 0x3B,
     READ_BUFFER                  = 0x3C,
     MODE_SENSE_10                = 0x5A,
@@ -156,6 +167,9 @@ enum ScsiError : int {
 #define SEL_ABORT_TIME      200000
 #define SEL_TIME_OUT        250000000
 
+/** Interval for checking whether a disconnected target's I/O is done. */
+#define IO_POLL_DELAY       50000
+
 #define SCSI_MAX_DEVS   8
 
 class ScsiBus;
@@ -172,6 +186,9 @@ public:
     };
     ~ScsiDevice() = default;
 
+    // HWComponent methods
+    void reset() override;
+
     virtual void notify(ScsiMsg msg_type, int param);
     virtual void next_step();
     virtual void prepare_xfer(ScsiBus* bus_obj, int& bytes_in, int& bytes_out);
@@ -191,6 +208,17 @@ public:
     }
 
 protected:
+    /** Run a backend transfer and enter next_phase once it's done.
+        If the initiator granted the disconnect privilege, the target
+        releases the bus while the transfer is in progress on a host
+        thread and reselects the initiator afterwards.
+     */
+    void wait_for_io(std::function<void()> io_func, int next_phase);
+
+    void poll_io();
+    void try_reselection();
+    void cancel_io_timer();
+
     uint8_t     cmd_buf[16] = {};
     uint8_t     msg_buf[16] = {}; // TODO: clarify how big this one should be
     int         scsi_id;
@@ -206,6 +234,14 @@ protected:
 
     action_callback pre_xfer_action  = nullptr;
     action_callback post_xfer_action = nullptr;
+
+    // disconnect/reselection state
+    bool                disc_allowed   = false;
+    bool                io_pending     = false; // disconnected until I/O completes
+    int                 resume_phase   = ScsiPhase::BUS_FREE;
+    uint8_t*            saved_data_ptr = nullptr;
+    uint32_t            io_timer_id    = 0;
+    std::future<void>   io_job;
 };
 
 /** This class provides a higher level abstraction for the SCSI bus. */
@@ -214,6 +250,9 @@ public:
     ScsiBus(const std::string name);
     ~ScsiBus() = default;
 
+    // HWComponent methods
+    void reset() override;
+
     static std::unique_ptr<HWComponent> create_first() {
         return std::unique_ptr<ScsiBus>(new ScsiBus("SCSIO"));
     }
@@ -244,6 +283,8 @@ public:
     bool begin_selection(int initiator_id, int target_id, bool atn);
     void confirm_selection(int target_id);
     bool end_selection(int initiator_id, int target_id);
+    bool begin_reselection(int target_id, int initiator_id);
+    void confirm_reselection(int initiator_id);
     void disconnect(int dev_id);
     bool pull_data(const int id, uint8_t* dst_ptr, const int size);
     bool push_data(const int id, const uint8_t* src_ptr, const int size);
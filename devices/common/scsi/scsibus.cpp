@@ -45,6 +45,20 @@ ScsiBus::ScsiBus(const std::string name)
     this->target_id     = -1;
 }
 
+void ScsiBus::reset()
+{
+    for(int i = 0; i < SCSI_MAX_DEVS; i++) {
+        this->dev_ctrl_lines[i] = 0;
+    }
+
+    this->ctrl_lines    =  0;
+    this->data_lines    =  0;
+    this->cur_phase     = ScsiPhase::BUS_FREE;
+    this->arb_winner_id = -1;
+    this->initiator_id  = -1;
+    this->target_id     = -1;
+}
+
 void ScsiBus::register_device(int id, ScsiDevice* dev_obj)
 {
     if (this->devices[id] != nullptr) {
@@ -145,6 +159,9 @@ int ScsiBus::switch_phase(int id, int new_phase)
     case ScsiPhase::MESSAGE_OUT:
         this->release_ctrl_line(id, SCSI_CTRL_CD | SCSI_CTRL_MSG);
         break;
+    case ScsiPhase::MESSAGE_IN:
+        this->release_ctrl_line(id, SCSI_CTRL_CD | SCSI_CTRL_MSG | SCSI_CTRL_IO);
+        break;
     }
 
     // enter new phase (low-level)
@@ -161,6 +178,9 @@ int ScsiBus::switch_phase(int id, int new_phase)
     case ScsiPhase::MESSAGE_OUT:
         this->assert_ctrl_line(id, SCSI_CTRL_CD | SCSI_CTRL_MSG);
         break;
+    case ScsiPhase::MESSAGE_IN:
+        this->assert_ctrl_line(id, SCSI_CTRL_CD | SCSI_CTRL_MSG | SCSI_CTRL_IO);
+        break;
     }
 
     // switch the bus to the new phase (high-level)
@@ -173,7 +193,8 @@ int ScsiBus::switch_phase(int id, int new_phase)
 bool ScsiBus::begin_arbitration(int initiator_id)
 {
     if (this->cur_phase == ScsiPhase::BUS_FREE) {
-        this->data_lines |= 1 << initiator_id;
+        // nobody drives the data lines while the bus is free
+        this->data_lines = 1 << initiator_id;
         this->cur_phase = ScsiPhase::ARBITRATION;
         change_bus_phase(initiator_id);
         return true;
@@ -216,6 +237,7 @@ bool ScsiBus::begin_selection(int initiator_id, int target_id, bool atn)
     }
 
     this->initiator_id = initiator_id;
+    this->target_id    = -1;
     this->cur_phase = ScsiPhase::SELECTION;
     change_bus_phase(initiator_id);
     return true;
@@ -237,6 +259,34 @@ bool ScsiBus::end_selection(int initiator_id, int target_id)
     return this->target_id == target_id;
 }
 
+bool ScsiBus::begin_reselection(int target_id, int initiator_id)
+{
+    // perform bus integrity checks
+    if (this->cur_phase != ScsiPhase::ARBITRATION || this->arb_winner_id != target_id)
+        return false;
+
+    // I/O distinguishes reselection from selection
+    this->assert_ctrl_line(target_id, SCSI_CTRL_SEL | SCSI_CTRL_IO);
+
+    this->data_lines = (1 << initiator_id) | (1 << target_id);
+
+    this->initiator_id = -1;
+    this->target_id    = target_id;
+    this->cur_phase = ScsiPhase::RESELECTION;
+    change_bus_phase(target_id);
+    return true;
+}
+
+void ScsiBus::confirm_reselection(int initiator_id)
+{
+    this->initiator_id = initiator_id;
+
+    // notify target about reselection confirmation from initiator
+    if (this->target_id >= 0) {
+        this->devices[this->target_id]->notify(ScsiMsg::CONFIRM_RESEL, initiator_id);
+    }
+}
+
 bool ScsiBus::pull_data(const int id, uint8_t* dst_ptr, const int size)
 {
     if (dst_ptr == nullptr || !size) {
@@ -131,10 +131,11 @@ void ScsiCdrom::read(const uint32_t lba, uint16_t nblocks, const uint8_t cmd_len
 
     this->set_fpos(lba);
     this->data_ptr   = (uint8_t *)this->data_cache.get();
-    this->bytes_out  = this->read_begin(nblocks, UINT32_MAX);
 
     this->msg_buf[0] = ScsiMessage::COMMAND_COMPLETE;
-    this->switch_phase(ScsiPhase::DATA_IN);
+    this->wait_for_io([this, nblocks]() {
+        this->bytes_out = this->read_begin(nblocks, UINT32_MAX);
+    }, ScsiPhase::DATA_IN);
 }
 
 void ScsiCdrom::inquiry() {
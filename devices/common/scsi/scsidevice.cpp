@@ -23,11 +23,42 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <devices/common/scsi/scsi.h>
 #include <loguru.hpp>
 
+#include <chrono>
 #include <cinttypes>
 #include <cstring>
 
+void ScsiDevice::reset()
+{
+    this->cancel_io_timer();
+
+    // let an outstanding backend transfer finish before its buffer is reused
+    if (this->io_job.valid())
+        this->io_job.wait();
+
+    this->cur_phase = ScsiPhase::BUS_FREE;
+    this->data_ptr  = nullptr;
+    this->data_size = 0;
+    this->pre_xfer_action  = nullptr;
+    this->post_xfer_action = nullptr;
+    this->disc_allowed = false;
+    this->io_pending   = false;
+}
+
 void ScsiDevice::notify(ScsiMsg msg_type, int param)
 {
+    if (msg_type == ScsiMsg::CONFIRM_RESEL) {
+        this->cancel_io_timer();
+        this->initiator_id = param;
+        this->io_pending   = false;
+        this->bus_obj->assert_ctrl_line(this->scsi_id, SCSI_CTRL_BSY);
+        this->bus_obj->release_ctrl_line(this->scsi_id, SCSI_CTRL_SEL);
+        // identify ourselves before resuming the interrupted command
+        this->msg_buf[0] = ScsiMessage::IDENTIFY;
+        this->switch_phase(ScsiPhase::MESSAGE_IN);
+        this->bus_obj->assert_ctrl_line(this->scsi_id, SCSI_CTRL_REQ);
+        return;
+    }
+
     if (msg_type == ScsiMsg::BUS_PHASE_CHANGE) {
         switch (param) {
         case ScsiPhase::RESET:
@@ -35,7 +66,8 @@ void ScsiDevice::notify(ScsiMsg msg_type, int param)
             break;
         case ScsiPhase::SELECTION:
             // check if something tries to select us
-            if (this->bus_obj->get_data_lines() & (1 << scsi_id)) {
+            // a disconnected target can't accept another command
+            if ((this->bus_obj->get_data_lines() & (1 << scsi_id)) && !this->io_pending) {
                 LOG_F(9, "ScsiDevice %d selected", this->scsi_id);
                 TimerManager::get_instance()->add_oneshot_timer(
                     BUS_SETTLE_DELAY,
@@ -46,6 +78,7 @@ void ScsiDevice::notify(ScsiMsg msg_type, int param)
                         this->bus_obj->assert_ctrl_line(this->scsi_id, SCSI_CTRL_BSY);
                         this->bus_obj->confirm_selection(this->scsi_id);
                         this->initiator_id = this->bus_obj->get_initiator_id();
+                        this->disc_allowed = false;
                         if (this->bus_obj->test_ctrl_lines(SCSI_CTRL_ATN)) {
                             this->switch_phase(ScsiPhase::MESSAGE_OUT);
                         } else {
@@ -83,7 +116,8 @@ void ScsiDevice::next_step()
     case ScsiPhase::COMMAND:
         this->process_command();
         if (this->cur_phase != ScsiPhase::COMMAND) {
-            if (this->prepare_data()) {
+            // the data buffer belongs to the backend until its I/O is done
+            if (this->io_pending || this->prepare_data()) {
                 this->bus_obj->assert_ctrl_line(this->scsi_id, SCSI_CTRL_REQ);
             } else {
                 ABORT_F("ScsiDevice: prepare_data() failed");
@@ -97,9 +131,26 @@ void ScsiDevice::next_step()
         this->switch_phase(ScsiPhase::COMMAND);
         break;
     case ScsiPhase::MESSAGE_IN:
+        if (this->msg_buf[0] & ScsiMessage::IDENTIFY) {
+            // reselection done, continue where the command was interrupted
+            this->msg_buf[0] = ScsiMessage::COMMAND_COMPLETE;
+            this->data_ptr   = this->saved_data_ptr;
+            this->switch_phase(this->resume_phase);
+            if (this->prepare_data()) {
+                this->bus_obj->assert_ctrl_line(this->scsi_id, SCSI_CTRL_REQ);
+            } else {
+                ABORT_F("ScsiDevice: prepare_data() failed");
+            }
+            break;
+        }
+        // fall through
     case ScsiPhase::BUS_FREE:
         this->bus_obj->release_ctrl_lines(this->scsi_id);
         this->switch_phase(ScsiPhase::BUS_FREE);
+        if (this->io_pending) {
+            this->io_timer_id = TimerManager::get_instance()->add_oneshot_timer(
+                IO_POLL_DELAY, [this]() { this->poll_io(); });
+        }
         break;
     default:
         LOG_F(WARNING, "ScsiDevice: nothing to do for phase %d", this->cur_phase);
@@ -152,6 +203,7 @@ int ScsiDevice::xfer_data() {
             if (this->msg_buf[0] & 0x80) {
                 LOG_F(9, "%s: IDENTIFY MESSAGE received, code = 0x%X",
                       this->name.c_str(), this->msg_buf[0]);
+                this->disc_allowed = !!(this->msg_buf[0] & ScsiMessage::IDENT_DISC_PRIV);
                 this->next_step();
             } else {
                 ABORT_F("%s: unsupported message received, code = 0x%X",
@@ -216,3 +268,78 @@ int ScsiDevice::rcv_data(const uint8_t* src_ptr, const int count)
 
     return count;
 }
+
+void ScsiDevice::wait_for_io(std::function<void()> io_func, int next_phase)
+{
+    if (!this->disc_allowed) {
+        io_func();
+        this->switch_phase(next_phase);
+        return;
+    }
+
+    this->resume_phase   = next_phase;
+    this->saved_data_ptr = this->data_ptr;
+    this->io_pending     = true;
+    this->io_job = std::async(std::launch::async, std::move(io_func));
+
+    LOG_F(9, "%s: disconnecting until I/O is done", this->name.c_str());
+
+    this->msg_buf[0] = ScsiMessage::DISCONNECT;
+    this->switch_phase(ScsiPhase::MESSAGE_IN);
+}
+
+void ScsiDevice::poll_io()
+{
+    this->io_timer_id = 0;
+
+    if (this->io_job.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        this->io_timer_id = TimerManager::get_instance()->add_oneshot_timer(
+            IO_POLL_DELAY, [this]() { this->poll_io(); });
+        return;
+    }
+
+    this->io_job.get();
+    this->try_reselection();
+}
+
+void ScsiDevice::try_reselection()
+{
+    TimerManager* timer_man = TimerManager::get_instance();
+
+    this->io_timer_id = 0;
+
+    // wait until the bus becomes free
+    if (!this->bus_obj->begin_arbitration(this->scsi_id)) {
+        this->io_timer_id = timer_man->add_oneshot_timer(
+            BUS_FREE_DELAY, [this]() { this->try_reselection(); });
+        return;
+    }
+
+    this->io_timer_id = timer_man->add_oneshot_timer(ARB_DELAY, [this, timer_man]() {
+        this->io_timer_id = 0;
+
+        if (!this->bus_obj->end_arbitration(this->scsi_id) ||
+            !this->bus_obj->begin_reselection(this->scsi_id, this->initiator_id)) {
+            this->bus_obj->disconnect(this->scsi_id);
+            this->io_timer_id = timer_man->add_oneshot_timer(
+                BUS_CLEAR_DELAY, [this]() { this->try_reselection(); });
+            return;
+        }
+
+        // retry if the initiator doesn't respond
+        this->io_timer_id = timer_man->add_oneshot_timer(SEL_TIME_OUT, [this]() {
+            this->io_timer_id = 0;
+            LOG_F(WARNING, "%s: reselection timeout, retrying", this->name.c_str());
+            this->bus_obj->disconnect(this->scsi_id);
+            this->try_reselection();
+        });
+    });
+}
+
+void ScsiDevice::cancel_io_timer()
+{
+    if (this->io_timer_id) {
+        TimerManager::get_instance()->cancel_timer(this->io_timer_id);
+        this->io_timer_id = 0;
+    }
+}
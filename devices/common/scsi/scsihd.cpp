@@ -42,7 +42,9 @@ ScsiHardDisk::ScsiHardDisk(std::string name, int my_id) : ScsiDevice(name, my_id
 void ScsiHardDisk::insert_image(std::string filename) {
     //We don't want to store everything in memory, but
     //we want to keep the hard disk available.
-    if (!this->hdd_img.open(filename))
+    WriteSync sync = write_sync_from_str(GET_STR_PROP("hdd_sync"));
+
+    if (!this->hdd_img.open(filename, sync))
         ABORT_F("%s: could not open image file %s", this->name.c_str(), filename.c_str());
 
     this->img_size = this->hdd_img.size();
@@ -120,6 +122,9 @@ void ScsiHardDisk::process_command() {
     case ScsiCommand::READ_BUFFER:
         read_buffer();
         break;
+    case ScsiCommand::SYNC_CACHE_10:
+        this->sync_cache();
+        break;
     default:
         LOG_F(WARNING, "%s: unrecognized command: %x", this->name.c_str(), cmd[0]);
     }
@@ -318,8 +323,6 @@ void ScsiHardDisk::format() {
 void ScsiHardDisk::read(uint32_t lba, uint16_t transfer_len, uint8_t cmd_len) {
     uint32_t transfer_size = transfer_len;
 
-    std::memset(img_buffer, 0, sizeof(img_buffer));
-
     if (cmd_len == 6 && transfer_len == 0) {
         transfer_size = 256;
     }
@@ -327,11 +330,12 @@ void ScsiHardDisk::read(uint32_t lba, uint16_t transfer_len, uint8_t cmd_len) {
     transfer_size *= HDD_SECTOR_SIZE;
     uint64_t device_offset = lba * HDD_SECTOR_SIZE;
 
-    this->hdd_img.read(img_buffer, device_offset, transfer_size);
-
     this->bytes_out = transfer_size;
 
-    this->switch_phase(ScsiPhase::DATA_IN);
+    this->wait_for_io([this, device_offset, transfer_size]() {
+        std::memset(this->img_buffer, 0, sizeof(this->img_buffer));
+        this->hdd_img.read(this->img_buffer, device_offset, transfer_size);
+    }, ScsiPhase::DATA_IN);
 }
 
 void ScsiHardDisk::write(uint32_t lba, uint16_t transfer_len, uint8_t cmd_len) {
@@ -347,10 +351,26 @@ void ScsiHardDisk::write(uint32_t lba, uint16_t transfer_len, uint8_t cmd_len) {
     this->incoming_size = transfer_size;
 
     this->post_xfer_action = [this, device_offset]() {
-        this->hdd_img.write(this->img_buffer, device_offset, this->incoming_size);
+        size_t len = this->incoming_size;
+        if (this->hdd_img.write(this->img_buffer, device_offset, len) != len) {
+            LOG_F(ERROR, "%s: could not write to the image", this->name.c_str());
+            this->status = ScsiStatus::CHECK_CONDITION;
+            this->sense  = ScsiSense::MEDIUM_ERR;
+        }
     };
 }
 
+void ScsiHardDisk::sync_cache() {
+    // the range in the CDB is ignored, the whole image gets committed
+    if (!this->hdd_img.flush()) {
+        LOG_F(ERROR, "%s: could not commit cached data", this->name.c_str());
+        this->status = ScsiStatus::CHECK_CONDITION;
+        this->sense  = ScsiSense::MEDIUM_ERR;
+    }
+
+    this->switch_phase(ScsiPhase::STATUS);
+}
+
 void ScsiHardDisk::seek(uint32_t lba) {
     // No-op
 }
@@ -380,6 +400,7 @@ void ScsiHardDisk::read_buffer() {
 static const PropMap SCSI_HD_Properties = {
     {"hdd_img", new StrProperty("")},
     {"hdd_wr_prot", new BinProperty(0)},
+    {"hdd_sync", new StrProperty("writeback", {"unsafe", "writeback", "writethrough"})},
 };
 
 static const DeviceDescription SCSI_HD_Descriptor =
@@ -60,6 +60,7 @@ protected:
     void seek(uint32_t lba);
     void rewind();
     void read_buffer();
+    void sync_cache();
 
 private:
     ImgFile         hdd_img;
@@ -43,6 +43,46 @@ ViaCuda::ViaCuda() {
 
     supports_types(HWCompType::ADB_HOST | HWCompType::I2C_HOST);
 
+    this->int_ctrl = nullptr;
+
+    // calculate VIA clock duration in ns
+    this->via_clk_dur = 1.0f / VIA_CLOCK_HZ * NS_PER_SEC;
+
+    // PRAM is part of Cuda
+    this->pram_obj = std::unique_ptr<NVram> (new NVram("pram.bin", 256));
+
+    // establish ADB bus connection
+    this->adb_bus_obj = dynamic_cast<AdbBus*>(gMachineObj->get_comp_by_type(HWCompType::ADB_HOST));
+
+    // autopoll handler will be called during post-processing of the host events
+    EventManager::get_instance()->add_post_handler(this, &ViaCuda::autopoll_handler);
+
+    this->reset();
+}
+
+int ViaCuda::device_postinit()
+{
+    this->int_ctrl = dynamic_cast<InterruptCtrl*>(
+        gMachineObj->get_comp_by_type(HWCompType::INT_CTRL));
+    this->irq_id = this->int_ctrl->register_dev_int(IntSrc::VIA_CUDA);
+
+    return 0;
+}
+
+void ViaCuda::reset() {
+    TimerManager* timer_man = TimerManager::get_instance();
+
+    if (this->sr_timer_on) {
+        timer_man->cancel_timer(this->sr_timer_id);
+        this->sr_timer_on = false;
+    }
+    if (this->t1_active) {
+        timer_man->cancel_timer(this->t1_timer_id);
+    }
+    if (this->t2_active) {
+        timer_man->cancel_timer(this->t2_timer_id);
+    }
+
     // VIA reset clears all internal registers to logic 0
     // except timers/counters and the shift register
     // as stated in the 6522 datasheet
@@ -71,30 +111,16 @@ ViaCuda::ViaCuda() {
     this->t2_counter  = 0xFFFF;
     this->t2_active = false;
 
-    // calculate VIA clock duration in ns
-    this->via_clk_dur = 1.0f / VIA_CLOCK_HZ * NS_PER_SEC;
-
-    // PRAM is part of Cuda
-    this->pram_obj = std::unique_ptr<NVram> (new NVram("pram.bin", 256));
+    // release the interrupt line if it was asserted
+    if (this->old_ifr && this->int_ctrl != nullptr)
+        this->int_ctrl->ack_int(this->irq_id, 0);
+    this->old_ifr = 0;
 
-    // establish ADB bus connection
-    this->adb_bus_obj = dynamic_cast<AdbBus*>(gMachineObj->get_comp_by_type(HWCompType::ADB_HOST));
-
-    // autopoll handler will be called during post-processing of the host events
-    EventManager::get_instance()->add_post_handler(this, &ViaCuda::autopoll_handler);
+    this->autopoll_enabled = false;
+    this->out_handler      = &ViaCuda::null_out_handler;
+    this->next_out_handler = &ViaCuda::null_out_handler;
 
     this->cuda_init();
-
-    this->int_ctrl = nullptr;
-}
-
-int ViaCuda::device_postinit()
-{
-    this->int_ctrl = dynamic_cast<InterruptCtrl*>(
-        gMachineObj->get_comp_by_type(HWCompType::INT_CTRL));
-    this->irq_id = this->int_ctrl->register_dev_int(IntSrc::VIA_CUDA);
-
-    return 0;
 }
 
 void ViaCuda::cuda_init() {
@@ -634,12 +660,16 @@ void ViaCuda::pseudo_command(int cmd, int data_count) {
         response_header(CUDA_PKT_PSEUDO, 0);
         break;
     case CUDA_WARM_START:
-    case CUDA_POWER_DOWN:
     case CUDA_MONO_STABLE_RESET:
     case CUDA_RESTART_SYSTEM:
-        /* really kludge temp code */
-        LOG_F(INFO, "Cuda: Restart/Shutdown signal sent with command 0x%x!", cmd);
-        //exit(0);
+        LOG_F(INFO, "Cuda: Restart signal sent with command 0x%x!", cmd);
+        response_header(CUDA_PKT_PSEUDO, 0);
+        gMachineObj->request_reset();
+        break;
+    case CUDA_POWER_DOWN:
+        LOG_F(INFO, "Cuda: Shutdown signal sent with command 0x%x!", cmd);
+        response_header(CUDA_PKT_PSEUDO, 0);
+        gMachineObj->request_power_off();
         break;
     default:
         LOG_F(ERROR, "Cuda: unsupported pseudo command 0x%X", cmd);
@@ -163,6 +163,7 @@ public:
 
     // HWComponent methods
     int device_postinit();
+    void reset() override;
 
     uint8_t read(int reg);
     void write(int reg, uint8_t value);
@@ -184,13 +185,13 @@ private:
     bool     sr_timer_on = false;
 
     // timer 1 state
-    bool     t1_active;
+    bool     t1_active = false;
     uint16_t t1_counter;
     uint32_t t1_timer_id = 0;
     uint64_t t1_start_time = 0;
 
     // timer 2 state
-    bool     t2_active;
+    bool     t2_active = false;
     uint16_t t2_counter;
     uint32_t t2_timer_id = 0;
     uint64_t t2_start_time = 0;
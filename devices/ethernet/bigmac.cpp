@@ -24,6 +24,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <devices/deviceregistry.h>
 #include <devices/ethernet/bigmac.h>
 #include <loguru.hpp>
+#include <machines/machineproperties.h>
 
 BigMac::BigMac(uint8_t id) {
     set_name("BigMac");
@@ -33,6 +34,15 @@ BigMac::BigMac(uint8_t id) {
     this->chip_reset();
 }
 
+int BigMac::device_postinit() {
+    std::string sw_name = GET_STR_PROP("enet_switch");
+
+    if (!sw_name.empty() && !this->net_port.attach(sw_name))
+        LOG_F(WARNING, "%s: running without a network connection", this->name.c_str());
+
+    return 0;
+}
+
 void BigMac::chip_reset() {
     this->event_mask = 0xFFFFU; // disable HW events causing on-chip interrupts
     this->stat = 0;
@@ -443,12 +453,16 @@ void BigMac::srom_xmit_bit(const uint8_t bit_val) {
     }
 }
 
+static const PropMap BigMac_Properties = {
+    {"enet_switch", new StrProperty("")},
+};
+
 static const DeviceDescription BigMac_Heathrow_Descriptor = {
-    BigMac::create_for_heathrow, {}, {}
+    BigMac::create_for_heathrow, {}, BigMac_Properties
 };
 
 static const DeviceDescription BigMac_Paddington_Descriptor = {
-    BigMac::create_for_paddington, {}, {}
+    BigMac::create_for_paddington, {}, BigMac_Properties
 };
 
 REGISTER_DEVICE(BigMacHeathrow, BigMac_Heathrow_Descriptor);
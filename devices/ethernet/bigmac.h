@@ -25,6 +25,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #define BIG_MAC_H
 
 #include <devices/common/hwcomponent.h>
+#include <devices/ethernet/etherswitch.h>
 
 #include <cinttypes>
 #include <memory>
@@ -129,6 +130,8 @@ public:
         return std::unique_ptr<BigMac>(new BigMac(EthernetCellId::Paddington));
     }
 
+    int device_postinit() override;
+
     // BigMac register accessors
     uint16_t read(uint16_t reg_offset);
     void     write(uint16_t reg_offset, uint16_t value);
@@ -155,6 +158,8 @@ protected:
 private:
     uint8_t chip_id; // BigMac Chip ID
 
+    EtherSwitchPort net_port;
+
     // BigMac state
     uint16_t        tx_reset        = 0; // self-clearing one-bit register
     uint16_t        tx_if_ctrl      = 0;
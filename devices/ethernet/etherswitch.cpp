@@ -0,0 +1,471 @@
+/*
+DingusPPC - The Experimental PowerPC Macintosh emulator
+Copyright (C) 2018-23 divingkatae and maximum
+                      (theweirdo)     spatium
+
+(Contact divingkatae#1017 or powermax#2286 on Discord for more info)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file Virtual Ethernet switch shared between emulator instances. */
+
+#include <devices/ethernet/etherswitch.h>
+#include <loguru.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+#ifdef __linux__
+#include <cerrno>
+#include <climits>
+#include <ctime>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#define SWITCH_MAGIC        0x44455357  // 'DESW'
+#define SWITCH_VERSION      2
+#define SWITCH_READY        0xFFFFFFFFU // init_state of a usable segment
+#define SWITCH_MAX_PORTS    16
+#define SWITCH_RING_SLOTS   32          // must be a power of two
+#define SWITCH_MAC_ENTRIES  256         // must be a power of two
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free &&
+              std::atomic<uint64_t>::is_always_lock_free,
+              "the shared segment requires address-free atomics");
+
+/* The lower half of seq is the ring position. A slot is free for the
+   producer when it equals the producer position and holds a frame when it
+   equals the position plus one. A sender claims a free slot by putting its
+   PID into the upper half and clears it again when publishing the frame. */
+struct FrameSlot {
+    std::atomic<uint64_t>   seq;
+    uint16_t                len;
+    uint8_t                 data[ETH_MAX_FRAME];
+};
+
+struct PortState {
+    std::atomic<int32_t>    owner;      // PID of the attached process, 0 if free
+    std::atomic<uint32_t>   rx_head;    // next slot to be consumed
+    std::atomic<uint32_t>   rx_tail;    // next slot to be claimed by a sender
+    std::atomic<uint32_t>   rx_event;   // futex word bumped on every delivery
+    std::atomic<uint32_t>   rx_waiting;
+    std::atomic<uint64_t>   tx_frames;
+    std::atomic<uint64_t>   rx_frames;
+    std::atomic<uint64_t>   rx_drops;
+    FrameSlot               slots[SWITCH_RING_SLOTS];
+};
+
+struct EtherSwitchShm {
+    uint32_t                magic;
+    uint32_t                version;
+    std::atomic<uint32_t>   init_state; // 0 - blank, PID of the creator, SWITCH_READY
+    // learned addresses: MAC in the upper 48 bits, port number + 1 below
+    std::atomic<uint64_t>   mac_table[SWITCH_MAC_ENTRIES];
+    PortState               ports[SWITCH_MAX_PORTS];
+};
+
+static inline uint64_t mac_to_u64(const uint8_t* mac) {
+    uint64_t val = 0;
+    for (int i = 0; i < 6; i++)
+        val = (val << 8) | mac[i];
+    return val;
+}
+
+static inline int mac_hash(uint64_t mac) {
+    return (mac * 0x9E3779B97F4A7C15ULL) >> 56 & (SWITCH_MAC_ENTRIES - 1);
+}
+
+#ifdef __linux__
+static void futex_wait(std::atomic<uint32_t>* addr, uint32_t val, int timeout_ms) {
+    struct timespec ts = {timeout_ms / 1000, (timeout_ms % 1000) * 1000000L};
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(addr), FUTEX_WAIT, val, &ts,
+            nullptr, 0);
+}
+
+static void futex_wake(std::atomic<uint32_t>* addr) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(addr), FUTEX_WAKE, INT_MAX,
+            nullptr, nullptr, 0);
+}
+
+static bool pid_alive(int32_t pid) {
+    return kill(pid, 0) == 0 || errno != ESRCH;
+}
+
+static void init_switch(EtherSwitchShm* shm) {
+    shm->magic   = SWITCH_MAGIC;
+    shm->version = SWITCH_VERSION;
+
+    for (auto& entry : shm->mac_table)
+        entry.store(0, std::memory_order_relaxed);
+
+    for (auto& port : shm->ports) {
+        port.owner.store(0, std::memory_order_relaxed);
+        port.rx_head.store(0, std::memory_order_relaxed);
+        port.rx_tail.store(0, std::memory_order_relaxed);
+        port.rx_event.store(0, std::memory_order_relaxed);
+        port.rx_waiting.store(0, std::memory_order_relaxed);
+        for (int i = 0; i < SWITCH_RING_SLOTS; i++)
+            port.slots[i].seq.store(i, std::memory_order_relaxed);
+    }
+}
+
+static EtherSwitchShm* map_switch(const std::string& sw_name) {
+    std::string shm_name = "/dingusppc-enet-" + sw_name;
+
+    int fd = shm_open(shm_name.c_str(), O_RDWR | O_CREAT, 0600);
+    if (fd < 0) {
+        LOG_F(ERROR, "EtherSwitch: could not open %s", shm_name.c_str());
+        return nullptr;
+    }
+
+    // a new segment is zero-filled, which marks it as blank
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (st.st_size < (off_t)sizeof(EtherSwitchShm) &&
+        ftruncate(fd, sizeof(EtherSwitchShm)) < 0)) {
+        LOG_F(ERROR, "EtherSwitch: could not size %s", shm_name.c_str());
+        close(fd);
+        return nullptr;
+    }
+
+    void* ptr = mmap(nullptr, sizeof(EtherSwitchShm), PROT_READ | PROT_WRITE,
+                     MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (ptr == MAP_FAILED) {
+        LOG_F(ERROR, "EtherSwitch: could not map %s", shm_name.c_str());
+        return nullptr;
+    }
+
+    auto shm = static_cast<EtherSwitchShm*>(ptr);
+
+    uint32_t my_pid = getpid();
+
+    for (int i = 0; i < 1000; i++) {
+        uint32_t state = shm->init_state.load();
+
+        if (state == SWITCH_READY)
+            break;
+
+        // set up a blank segment or take over from a creator that died half way
+        if (!state || !pid_alive(state)) {
+            if (shm->init_state.compare_exchange_strong(state, my_pid)) {
+                init_switch(shm);
+                shm->init_state.store(SWITCH_READY);
+                break;
+            }
+            continue;
+        }
+
+        // another instance is setting the segment up
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    if (shm->init_state.load() != SWITCH_READY || shm->magic != SWITCH_MAGIC ||
+        shm->version != SWITCH_VERSION) {
+        LOG_F(ERROR, "EtherSwitch: %s has an incompatible layout", shm_name.c_str());
+        munmap(ptr, sizeof(EtherSwitchShm));
+        return nullptr;
+    }
+
+    return shm;
+}
+#endif
+
+EtherSwitchPort::~EtherSwitchPort() {
+    this->detach();
+}
+
+bool EtherSwitchPort::attach(const std::string& sw_name) {
+#ifdef __linux__
+    this->detach();
+
+    EtherSwitchShm* sw = map_switch(sw_name);
+    if (sw == nullptr)
+        return false;
+
+    this->my_pid = getpid();
+
+    for (int i = 0; i < SWITCH_MAX_PORTS; i++) {
+        PortState& port = sw->ports[i];
+        int32_t owner = port.owner.load();
+
+        // reclaim ports left behind by crashed instances
+        if (owner && (owner == (int32_t)this->my_pid || pid_alive(owner)))
+            continue;
+
+        if (!port.owner.compare_exchange_strong(owner, this->my_pid))
+            continue;
+
+        this->shm      = sw;
+        this->port_num = i;
+
+        // discard frames addressed to the previous owner, including slots
+        // claimed by senders that died since
+        while (this->recv_frame(nullptr, 0)) {}
+        port.tx_frames = 0;
+        port.rx_frames = 0;
+        port.rx_drops  = 0;
+
+        LOG_F(INFO, "EtherSwitch: attached to %s, port %d", sw_name.c_str(), i);
+        return true;
+    }
+
+    LOG_F(ERROR, "EtherSwitch: no free ports on %s", sw_name.c_str());
+    munmap(sw, sizeof(EtherSwitchShm));
+#else
+    LOG_F(ERROR, "EtherSwitch: not supported on this host");
+#endif
+    return false;
+}
+
+void EtherSwitchPort::detach() {
+    if (!this->shm)
+        return;
+
+#ifdef __linux__
+    this->forget_port();
+    this->shm->ports[this->port_num].owner.store(0);
+    munmap(this->shm, sizeof(EtherSwitchShm));
+#endif
+
+    this->shm      = nullptr;
+    this->port_num = -1;
+}
+
+void EtherSwitchPort::learn(const uint8_t* mac) {
+    uint64_t mac_val = mac_to_u64(mac);
+    uint64_t entry   = (mac_val << 16) | (this->port_num + 1);
+    int      idx     = mac_hash(mac_val);
+
+    for (int n = 0; n < SWITCH_MAC_ENTRIES; n++) {
+        auto& slot = this->shm->mac_table[(idx + n) & (SWITCH_MAC_ENTRIES - 1)];
+        uint64_t old_entry = slot.load(std::memory_order_relaxed);
+
+        if (!old_entry) {
+            if (slot.compare_exchange_strong(old_entry, entry))
+                return;
+        }
+        if ((old_entry >> 16) == mac_val) {
+            if (old_entry != entry)
+                slot.store(entry, std::memory_order_relaxed);
+            return;
+        }
+    }
+    // table full: frames to this address will be flooded
+}
+
+int EtherSwitchPort::lookup(const uint8_t* mac) const {
+    uint64_t mac_val = mac_to_u64(mac);
+    int      idx     = mac_hash(mac_val);
+
+    for (int n = 0; n < SWITCH_MAC_ENTRIES; n++) {
+        uint64_t entry = this->shm->mac_table[(idx + n) & (SWITCH_MAC_ENTRIES - 1)].load(
+            std::memory_order_relaxed);
+        if (!entry)
+            break;
+        if ((entry >> 16) == mac_val)
+            return (int)(entry & 0xFFFF) - 1;
+    }
+
+    return -1;
+}
+
+/* Keep the addresses learned on this port in the table so the probe
+   chains stay intact but mark them as unknown. */
+void EtherSwitchPort::forget_port() {
+    for (auto& slot : this->shm->mac_table) {
+        uint64_t entry = slot.load(std::memory_order_relaxed);
+        if (entry && (int)(entry & 0xFFFF) == this->port_num + 1)
+            slot.compare_exchange_strong(entry, entry & ~0xFFFFULL);
+    }
+}
+
+bool EtherSwitchPort::deliver(int dst_port, const uint8_t* frame, int len) {
+    PortState& port = this->shm->ports[dst_port];
+
+    uint32_t pos = port.rx_tail.load(std::memory_order_relaxed);
+    FrameSlot* slot;
+
+    // the slot is claimed first so a sender dying before it publishes
+    // the frame can be recognized, rx_tail is moved by any sender
+    for (;;) {
+        slot = &port.slots[pos & (SWITCH_RING_SLOTS - 1)];
+        uint64_t seq = slot->seq.load(std::memory_order_acquire);
+        int32_t  dif = (int32_t)((uint32_t)seq - pos);
+        if (!dif) {
+            uint32_t expected = pos;
+            if (!(seq >> 32) && slot->seq.compare_exchange_strong(seq,
+                (uint64_t(this->my_pid) << 32) | pos, std::memory_order_acquire)) {
+                port.rx_tail.compare_exchange_strong(expected, pos + 1);
+                break;
+            }
+            // claimed by another sender, make sure rx_tail moves past it
+            port.rx_tail.compare_exchange_strong(expected, pos + 1);
+            pos = port.rx_tail.load(std::memory_order_relaxed);
+        } else if (dif < 0) { // ring full
+            port.rx_drops++;
+            return false;
+        } else {
+            // the slot has been claimed already, rx_tail lags behind
+            uint32_t expected = pos;
+            port.rx_tail.compare_exchange_strong(expected, pos + 1);
+            pos = port.rx_tail.load(std::memory_order_relaxed);
+        }
+    }
+
+    slot->len = len;
+    std::memcpy(slot->data, frame, len);
+    slot->seq.store(uint32_t(pos + 1), std::memory_order_release);
+
+#ifdef __linux__
+    port.rx_event.fetch_add(1);
+    if (port.rx_waiting.load())
+        futex_wake(&port.rx_event);
+#endif
+
+    return true;
+}
+
+bool EtherSwitchPort::send_frame(const uint8_t* frame, int len) {
+    if (!this->shm || len < ETH_MIN_FRAME || len > ETH_MAX_FRAME)
+        return false;
+
+    this->shm->ports[this->port_num].tx_frames++;
+
+    const uint8_t* src_mac = &frame[6];
+    if (!(src_mac[0] & 1))
+        this->learn(src_mac);
+
+    // unicast to a known port
+    if (!(frame[0] & 1)) {
+        int dst_port = this->lookup(frame);
+        if (dst_port == this->port_num)
+            return false; // stays on the local segment
+        if (dst_port >= 0 && this->shm->ports[dst_port].owner.load())
+            return this->deliver(dst_port, frame, len);
+    }
+
+    bool delivered = false;
+
+    for (int i = 0; i < SWITCH_MAX_PORTS; i++) {
+        if (i != this->port_num && this->shm->ports[i].owner.load())
+            delivered |= this->deliver(i, frame, len);
+    }
+
+    return delivered;
+}
+
+/* A sender that died between claiming a slot and publishing its frame
+   would block the ring forever. Its slot is dropped once the process
+   is gone. */
+bool EtherSwitchPort::skip_dead_claim() {
+#ifdef __linux__
+    PortState& port = this->shm->ports[this->port_num];
+    uint32_t   pos  = port.rx_head.load(std::memory_order_relaxed);
+    FrameSlot& slot = port.slots[pos & (SWITCH_RING_SLOTS - 1)];
+    uint64_t   seq  = slot.seq.load(std::memory_order_acquire);
+
+    if (!(seq >> 32) || (uint32_t)seq != pos || pid_alive(seq >> 32))
+        return false;
+
+    if (!slot.seq.compare_exchange_strong(seq, uint32_t(pos + SWITCH_RING_SLOTS)))
+        return false;
+
+    port.rx_head.store(pos + 1, std::memory_order_relaxed);
+    port.rx_drops++;
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool EtherSwitchPort::has_frame() {
+    if (!this->shm)
+        return false;
+
+    PortState& port = this->shm->ports[this->port_num];
+
+    do {
+        uint32_t pos = port.rx_head.load(std::memory_order_relaxed);
+
+        if (port.slots[pos & (SWITCH_RING_SLOTS - 1)].seq.load(
+            std::memory_order_acquire) == uint32_t(pos + 1))
+            return true;
+    } while (this->skip_dead_claim());
+
+    return false;
+}
+
+int EtherSwitchPort::recv_frame(uint8_t* buf, int buf_size) {
+    if (!this->has_frame())
+        return 0;
+
+    PortState& port = this->shm->ports[this->port_num];
+    uint32_t   pos  = port.rx_head.load(std::memory_order_relaxed);
+    FrameSlot& slot = port.slots[pos & (SWITCH_RING_SLOTS - 1)];
+
+    int len = slot.len;
+    if (buf)
+        std::memcpy(buf, slot.data, std::min(len, buf_size));
+
+    slot.seq.store(uint32_t(pos + SWITCH_RING_SLOTS), std::memory_order_release);
+    port.rx_head.store(pos + 1, std::memory_order_relaxed);
+    port.rx_frames++;
+
+    return len;
+}
+
+bool EtherSwitchPort::wait_frame(int timeout_ms) {
+    if (!this->shm)
+        return false;
+
+#ifdef __linux__
+    PortState& port = this->shm->ports[this->port_num];
+
+    uint32_t event = port.rx_event.load();
+    if (this->has_frame())
+        return true;
+
+    // senders check rx_waiting after bumping rx_event so either they see
+    // the flag or the futex sees the new event value
+    port.rx_waiting.store(1);
+    if (!this->has_frame())
+        futex_wait(&port.rx_event, event, timeout_ms);
+    port.rx_waiting.store(0);
+#endif
+
+    return this->has_frame();
+}
+
+uint64_t EtherSwitchPort::get_tx_frames() const {
+    return this->shm ? this->shm->ports[this->port_num].tx_frames.load() : 0;
+}
+
+uint64_t EtherSwitchPort::get_rx_frames() const {
+    return this->shm ? this->shm->ports[this->port_num].rx_frames.load() : 0;
+}
+
+uint64_t EtherSwitchPort::get_rx_drops() const {
+    return this->shm ? this->shm->ports[this->port_num].rx_drops.load() : 0;
+}
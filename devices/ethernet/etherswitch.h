@@ -0,0 +1,99 @@
+/*
+DingusPPC - The Experimental PowerPC Macintosh emulator
+Copyright (C) 2018-23 divingkatae and maximum
+                      (theweirdo)     spatium
+
+(Contact divingkatae#1017 or powermax#2286 on Discord for more info)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file Virtual Ethernet switch shared between emulator instances.
+
+    Every switch lives in a named POSIX shared memory segment so Ethernet
+    controllers in the same or in different emulator processes can exchange
+    frames without going through the host network stack.
+
+    Each port owns a lock-free receive ring that any port may append to.
+    The switch learns source MAC addresses, delivers unicast frames to the
+    port their destination was last seen on and floods broadcast, multicast
+    and unknown unicast frames to all other attached ports. A receiver
+    blocked in wait_frame() sleeps on a futex in the shared segment and is
+    woken up by the sender.
+
+    Instances may die at any point. A ring slot claimed by a sender that
+    died before publishing its frame is skipped by the receiver, ports of
+    dead instances are reclaimed on attach and a segment left half set up
+    by its creator is initialized again.
+
+    Only Linux hosts are supported for now.
+ */
+
+#ifndef ETHER_SWITCH_H
+#define ETHER_SWITCH_H
+
+#include <cinttypes>
+#include <string>
+
+#define ETH_MIN_FRAME   14      // destination, source and EtherType
+#define ETH_MAX_FRAME   1522    // including a VLAN tag, excluding FCS
+
+struct EtherSwitchShm;
+
+class EtherSwitchPort {
+public:
+    EtherSwitchPort() = default;
+    ~EtherSwitchPort();
+
+    EtherSwitchPort(const EtherSwitchPort&) = delete;
+    EtherSwitchPort& operator=(const EtherSwitchPort&) = delete;
+
+    /** Connects to the switch called sw_name creating it if necessary. */
+    bool attach(const std::string& sw_name);
+    void detach();
+
+    bool is_attached() const { return this->shm != nullptr; };
+    int  get_port_num() const { return this->port_num; };
+
+    /** Forwards a frame to other ports. Returns false if it was dropped
+        by all destinations. */
+    bool send_frame(const uint8_t* frame, int len);
+
+    /** Copies the next received frame into buf.
+        Returns its length or 0 if nothing has been received. */
+    int recv_frame(uint8_t* buf, int buf_size);
+
+    bool has_frame();
+
+    /** Waits up to timeout_ms for a frame to arrive. */
+    bool wait_frame(int timeout_ms);
+
+    // statistics
+    uint64_t get_tx_frames() const;
+    uint64_t get_rx_frames() const;
+    uint64_t get_rx_drops() const;
+
+private:
+    void learn(const uint8_t* mac);
+    int  lookup(const uint8_t* mac) const;
+    bool deliver(int dst_port, const uint8_t* frame, int len);
+    bool skip_dead_claim();
+    void forget_port();
+
+    EtherSwitchShm* shm      = nullptr;
+    int             port_num = -1;
+    uint32_t        my_pid   = 0;
+};
+
+#endif // ETHER_SWITCH_H
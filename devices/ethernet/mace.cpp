@@ -24,11 +24,23 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <devices/deviceregistry.h>
 #include <devices/ethernet/mace.h>
 #include <loguru.hpp>
+#include <machines/machineproperties.h>
 
 #include <cinttypes>
+#include <string>
 
 using namespace MaceEnet;
 
+int MaceController::device_postinit()
+{
+    std::string sw_name = GET_STR_PROP("enet_switch");
+
+    if (!sw_name.empty() && !this->net_port.attach(sw_name))
+        LOG_F(WARNING, "MACE: running without a network connection");
+
+    return 0;
+}
+
 uint8_t MaceController::read(uint8_t reg_offset)
 {
     switch(reg_offset) {
@@ -57,8 +69,12 @@ void MaceController::write(uint8_t reg_offset, uint8_t value)
     }
 }
 
+static const PropMap Mace_Properties = {
+    {"enet_switch", new StrProperty("")},
+};
+
 static const DeviceDescription Mace_Descriptor = {
-    MaceController::create, {}, {}
+    MaceController::create, {}, Mace_Properties
 };
 
 REGISTER_DEVICE(Mace, Mace_Descriptor);
@@ -25,6 +25,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #define MACE_H
 
 #include <devices/common/hwcomponent.h>
+#include <devices/ethernet/etherswitch.h>
 
 #include <cinttypes>
 #include <memory>
@@ -78,12 +79,16 @@ public:
         return std::unique_ptr<MaceController>(new MaceController(MACE_ID));
     }
 
+    int device_postinit() override;
+
     // MACE registers access
     uint8_t read(uint8_t reg_offset);
     void    write(uint8_t reg_offset, uint8_t value);
 
 private:
     uint16_t    chip_id; // per-instance MACE Chip ID
+
+    EtherSwitchPort net_port;
 };
 
 #endif // MACE_H
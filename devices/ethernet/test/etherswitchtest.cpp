@@ -0,0 +1,301 @@
+/*
+DingusPPC - The Experimental PowerPC Macintosh emulator
+Copyright (C) 2018-23 divingkatae and maximum
+                      (theweirdo)     spatium
+
+(Contact divingkatae#1017 or powermax#2286 on Discord for more info)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file Tests of the shared-memory virtual Ethernet switch. */
+
+#include <devices/ethernet/etherswitch.h>
+#include <loguru.hpp>
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+int ntested; // number of checks
+int nfailed; // number of failed checks
+
+static void check(bool cond, const string& what) {
+    ntested++;
+    if (!cond) {
+        cout << "FAILED: " << what << endl;
+        nfailed++;
+    }
+}
+
+#ifdef __linux__
+
+static const uint8_t MAC_A[6]     = {0x02, 0, 0, 0, 0, 0x0A};
+static const uint8_t MAC_B[6]     = {0x02, 0, 0, 0, 0, 0x0B};
+static const uint8_t MAC_C[6]     = {0x02, 0, 0, 0, 0, 0x0C};
+static const uint8_t MAC_OTHER[6] = {0x02, 0, 0, 0, 0, 0x0F};
+static const uint8_t MAC_BCAST[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+
+static int make_frame(uint8_t* buf, const uint8_t* dst, const uint8_t* src,
+                      uint8_t tag, int len = 64) {
+    memset(buf, 0, len);
+    memcpy(buf, dst, 6);
+    memcpy(buf + 6, src, 6);
+    buf[12] = 0x08; // IPv4
+    buf[14] = tag;
+    return len;
+}
+
+/** Receive the next frame and return its tag, -1 if none is pending. */
+static int recv_tag(EtherSwitchPort& port) {
+    uint8_t buf[ETH_MAX_FRAME];
+    return port.recv_frame(buf, sizeof(buf)) ? buf[14] : -1;
+}
+
+static void drain(EtherSwitchPort& port) {
+    while (port.recv_frame(nullptr, 0)) {}
+}
+
+static void test_forwarding(const string& sw_name) {
+    EtherSwitchPort a, b, c;
+    uint8_t frame[ETH_MAX_FRAME];
+
+    check(a.attach(sw_name) && b.attach(sw_name) && c.attach(sw_name), "attach three ports");
+
+    // broadcast reaches everyone else, not the sender
+    a.send_frame(frame, make_frame(frame, MAC_BCAST, MAC_A, 1));
+    check(recv_tag(b) == 1 && recv_tag(c) == 1, "broadcast flooded");
+    check(recv_tag(a) == -1, "broadcast not reflected");
+
+    // unknown unicast is flooded too
+    b.send_frame(frame, make_frame(frame, MAC_OTHER, MAC_B, 2));
+    check(recv_tag(a) == 2 && recv_tag(c) == 2, "unknown unicast flooded");
+
+    // A and B have been learned, unicast only reaches its destination
+    c.send_frame(frame, make_frame(frame, MAC_A, MAC_C, 3));
+    check(recv_tag(a) == 3, "unicast to learned port");
+    check(recv_tag(b) == -1, "unicast not flooded");
+
+    b.send_frame(frame, make_frame(frame, MAC_C, MAC_B, 4));
+    check(recv_tag(c) == 4 && recv_tag(a) == -1, "unicast to port learned from a reply");
+
+    // a detached port is forgotten, frames for it get flooded again
+    c.detach();
+    a.send_frame(frame, make_frame(frame, MAC_C, MAC_A, 5));
+    check(recv_tag(b) == 5, "unicast to detached port flooded");
+}
+
+static void test_full_ring(const string& sw_name) {
+    EtherSwitchPort a, b;
+    uint8_t frame[ETH_MAX_FRAME];
+
+    check(a.attach(sw_name) && b.attach(sw_name), "attach two ports");
+
+    b.send_frame(frame, make_frame(frame, MAC_BCAST, MAC_B, 0));
+    drain(a);
+
+    int num_sent = 0;
+    for (int i = 0; i < 100; i++)
+        num_sent += a.send_frame(frame, make_frame(frame, MAC_B, MAC_A, i));
+
+    check(num_sent > 0 && num_sent < 100, "frames dropped once the ring is full");
+    check(b.get_rx_drops() == uint64_t(100 - num_sent), "drops counted");
+
+    int num_recv = 0;
+    for (int tag; (tag = recv_tag(b)) >= 0; num_recv++)
+        check(tag == num_recv, "frames received in order");
+    check(num_recv == num_sent, "all accepted frames received");
+
+    // space becomes available again after draining
+    check(a.send_frame(frame, make_frame(frame, MAC_B, MAC_A, 7)) && recv_tag(b) == 7,
+          "ring usable after draining");
+}
+
+static void test_wakeup(const string& sw_name) {
+    EtherSwitchPort a, b;
+    uint8_t frame[ETH_MAX_FRAME];
+
+    check(a.attach(sw_name) && b.attach(sw_name), "attach two ports");
+
+    bool got_frame = false;
+    auto start     = chrono::steady_clock::now();
+
+    thread waiter([&]() { got_frame = b.wait_frame(5000); });
+
+    this_thread::sleep_for(chrono::milliseconds(100));
+    a.send_frame(frame, make_frame(frame, MAC_BCAST, MAC_A, 8));
+    waiter.join();
+
+    auto waited = chrono::steady_clock::now() - start;
+
+    check(got_frame && recv_tag(b) == 8, "sleeping wait_frame gets the frame");
+    check(waited < chrono::milliseconds(2000), "sleeping wait_frame woken up by the sender");
+    check(!b.wait_frame(10), "wait_frame times out without frames");
+}
+
+static void test_fork(const string& sw_name) {
+    EtherSwitchPort a;
+    uint8_t frame[ETH_MAX_FRAME];
+
+    check(a.attach(sw_name), "attach parent port");
+
+    pid_t child = fork();
+    if (!child) {
+        // echo one frame back to its sender
+        EtherSwitchPort b;
+        uint8_t buf[ETH_MAX_FRAME];
+
+        if (!b.attach(sw_name))
+            _exit(1);
+        b.send_frame(buf, make_frame(buf, MAC_BCAST, MAC_B, 0)); // announce B
+        if (!b.wait_frame(5000) || b.recv_frame(buf, sizeof(buf)) <= 0)
+            _exit(2);
+        b.send_frame(buf, make_frame(buf, MAC_A, MAC_B, buf[14] + 1));
+        _exit(0);
+    }
+
+    check(a.wait_frame(5000) && recv_tag(a) == 0, "frame from another process");
+
+    a.send_frame(frame, make_frame(frame, MAC_B, MAC_A, 9));
+    check(a.wait_frame(5000) && recv_tag(a) == 10, "reply from another process");
+
+    int status = -1;
+    waitpid(child, &status, 0);
+    check(WIFEXITED(status) && !WEXITSTATUS(status), "child process succeeded");
+}
+
+static void test_dead_senders(const string& sw_name) {
+    EtherSwitchPort a, b;
+    uint8_t frame[ETH_MAX_FRAME];
+
+    check(a.attach(sw_name) && b.attach(sw_name), "attach two ports");
+
+    b.send_frame(frame, make_frame(frame, MAC_BCAST, MAC_B, 0));
+    drain(a);
+
+    // senders die at random points of their own execution, some of them
+    // between claiming a ring slot and publishing the frame
+    for (int i = 0; i < 40; i++) {
+        pid_t child = fork();
+        if (!child) {
+            EtherSwitchPort c;
+            uint8_t buf[ETH_MAX_FRAME];
+
+            if (!c.attach(sw_name))
+                _exit(1);
+
+            signal(SIGVTALRM, [](int) { _exit(0); });
+            itimerval timer = {{0, 0}, {0, 1000 + (i * 397) % 4000}};
+            setitimer(ITIMER_VIRTUAL, &timer, nullptr);
+
+            for (;;) {
+                if (!c.send_frame(buf, make_frame(buf, MAC_B, MAC_C, 0, ETH_MAX_FRAME)))
+                    sched_yield();
+            }
+        }
+
+        // keep the ring draining so the sender isn't just dropping frames
+        auto until = chrono::steady_clock::now() + chrono::seconds(5);
+        while (!waitpid(child, nullptr, WNOHANG) && chrono::steady_clock::now() < until) {
+            if (!b.recv_frame(nullptr, 0))
+                sched_yield();
+        }
+
+        kill(child, SIGKILL);
+        waitpid(child, nullptr, 0);
+
+        drain(b);
+        a.send_frame(frame, make_frame(frame, MAC_B, MAC_A, 11));
+        if (recv_tag(b) != 11) {
+            check(false, "ring usable after killing a sender");
+            return;
+        }
+    }
+
+    check(true, "ring usable after killing senders");
+}
+
+static void test_dead_creator(const string& sw_name) {
+    string shm_name = "/dingusppc-enet-" + sw_name;
+
+    pid_t child = fork();
+    if (!child)
+        _exit(0);
+    waitpid(child, nullptr, 0);
+
+    // a segment whose creator died while setting it up,
+    // init_state follows the magic and version words
+    int fd = shm_open(shm_name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+    check(fd >= 0 && !ftruncate(fd, 4096), "create abandoned segment");
+    uint32_t* hdr = (uint32_t*)mmap(nullptr, 4096, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    hdr[2] = child;
+    munmap(hdr, 4096);
+    close(fd);
+
+    EtherSwitchPort a, b;
+    uint8_t frame[ETH_MAX_FRAME];
+
+    check(a.attach(sw_name) && b.attach(sw_name), "attach to abandoned segment");
+    a.send_frame(frame, make_frame(frame, MAC_BCAST, MAC_A, 12));
+    check(recv_tag(b) == 12, "abandoned segment usable");
+}
+
+#endif
+
+int main() {
+    loguru::g_stderr_verbosity = loguru::Verbosity_WARNING;
+
+    cout << "Running virtual Ethernet switch tests..." << endl << endl;
+
+    ntested = 0;
+    nfailed = 0;
+
+#ifdef __linux__
+    string sw_name = "test-" + to_string(getpid());
+
+    test_forwarding(sw_name);
+    test_full_ring(sw_name);
+    test_wakeup(sw_name);
+    test_fork(sw_name);
+    test_dead_senders(sw_name);
+
+    shm_unlink(("/dingusppc-enet-" + sw_name).c_str());
+
+    test_dead_creator(sw_name);
+
+    shm_unlink(("/dingusppc-enet-" + sw_name).c_str());
+#else
+    cout << "Not supported on this host, skipping." << endl;
+#endif
+
+    cout << "... completed." << endl;
+    cout << "--> Tested: " << dec << ntested << endl;
+    cout << "--> Failed: " << dec << nfailed << endl << endl;
+
+    return nfailed ? 1 : 0;
+}
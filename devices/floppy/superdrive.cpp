@@ -53,6 +53,14 @@ void MacSuperDrive::reset_params()
     this->switch_drive_mode(RecMethod::MFM);
 }
 
+/* The inserted disk stays in place, only the mechanics are stopped. */
+void MacSuperDrive::reset()
+{
+    this->motor_stat    = 0;
+    this->motor_on_time = 0;
+    this->is_ready      = 0;
+}
+
 void MacSuperDrive::command(uint8_t addr, uint8_t value)
 {
     uint8_t new_motor_stat;
@@ -162,11 +170,9 @@ int MacSuperDrive::insert_disk(std::string& img_path, int write_flag = 0)
         this->img_conv = std::unique_ptr<FloppyImgConverter>(img_conv);
         set_disk_phys_params();
 
-        // allocate memory for raw disk data
-        this->disk_data = std::unique_ptr<char[]>(new char[this->img_conv->get_data_size()]);
-
-        // swallow all raw disk data at once!
-        this->img_conv->get_raw_disk_data(this->disk_data.get());
+        // raw disk data will be read on first sector access because
+        // most sessions never touch the floppy drive at all
+        this->disk_data.reset();
 
         // disk is write-enabled by default
         this->wr_protect = write_flag;
@@ -364,8 +370,20 @@ SectorHdr MacSuperDrive::current_sector_header()
     };
 }
 
+void MacSuperDrive::load_disk_data()
+{
+    // allocate memory for raw disk data
+    this->disk_data = std::unique_ptr<char[]>(new char[this->img_conv->get_data_size()]);
+
+    // swallow all raw disk data at once!
+    this->img_conv->get_raw_disk_data(this->disk_data.get());
+}
+
 char* MacSuperDrive::get_sector_data_ptr(int sector_num)
 {
+    if (!this->disk_data)
+        load_disk_data();
+
     return this->disk_data.get() +
         ((this->track2lblk[this->cur_track] +
          (this->cur_head * this->sectors_per_track[this->cur_track]) +
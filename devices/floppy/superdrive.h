@@ -99,6 +99,9 @@ public:
     MacSuperDrive();
     ~MacSuperDrive() = default;
 
+    // HWComponent methods
+    void reset() override;
+
     void command(uint8_t addr, uint8_t value);
     uint8_t status(uint8_t addr);
     int insert_disk(std::string& img_path, int write_flag);
@@ -117,6 +120,7 @@ protected:
     void reset_params();
     void set_disk_phys_params();
     void switch_drive_mode(int mode);
+    void load_disk_data();
 
 private:
     uint8_t     has_disk;
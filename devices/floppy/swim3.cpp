@@ -76,6 +76,44 @@ int Swim3Ctrl::device_postinit()
     return 0;
 };
 
+void Swim3Ctrl::reset()
+{
+    TimerManager* timer_man = TimerManager::get_instance();
+
+    if (this->one_us_timer_id) {
+        timer_man->cancel_timer(this->one_us_timer_id);
+        this->one_us_timer_id = 0;
+    }
+    if (this->step_timer_id) {
+        timer_man->cancel_timer(this->step_timer_id);
+        this->step_timer_id = 0;
+    }
+    if (this->access_timer_id) {
+        timer_man->cancel_timer(this->access_timer_id);
+        this->access_timer_id = 0;
+    }
+
+    this->setup_reg  = 0;
+    this->mode_reg   = 0;
+    this->int_reg    = 0;
+    this->int_flags  = 0;
+    this->int_mask   = 0;
+    this->error      = 0;
+    this->step_count = 0;
+    this->xfer_cnt   = 0;
+    this->first_sec  = 0xFF;
+    this->timer_val  = 0;
+
+    this->cur_state = SWIM3_IDLE;
+
+    if (this->irq) {
+        this->irq = 0;
+        this->int_ctrl->ack_int(this->irq_id, 0);
+    }
+
+    this->int_drive->reset();
+}
+
 uint8_t Swim3Ctrl::read(uint8_t reg_offset)
 {
     uint8_t status_addr, rddata_val, old_int_flags, old_error;
@@ -378,6 +416,7 @@ void Swim3Ctrl::init_timer(const uint8_t start_val)
     this->one_us_timer_id = TimerManager::get_instance()->add_oneshot_timer(
         this->timer_val * NS_PER_USEC,
         [this]() {
+            this->one_us_timer_id = 0;
             this->timer_val = 0;
             this->int_flags |= INT_TIMER_DONE;
             update_irq();
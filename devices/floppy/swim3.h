@@ -87,7 +87,9 @@ public:
         return std::unique_ptr<Swim3Ctrl>(new Swim3Ctrl());
     }
 
+    // HWComponent methods
     int device_postinit();
+    void reset() override;
 
     // SWIM3 registers access
     uint8_t read(uint8_t reg_offset);
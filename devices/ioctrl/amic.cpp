@@ -29,6 +29,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <cpu/ppc/ppcmmu.h>
 #include <devices/deviceregistry.h>
 #include <devices/common/hwcomponent.h>
+#include <devices/common/iotrace.h>
 #include <devices/common/scsi/sc53c94.h>
 #include <devices/common/viacuda.h>
 #include <devices/ethernet/mace.h>
@@ -113,6 +114,31 @@ int AMIC::device_postinit()
     return 0;
 }
 
+/* The pseudo-VBL timer keeps running, it's driven by the board clock. */
+void AMIC::reset()
+{
+    this->snd_out_dma->disable();
+    this->awacs->reset();
+
+    this->dma_base      = 0;
+    this->scsi_dma_base = 0;
+    this->snd_buf_size  = 0;
+    this->snd_out_ctrl  = 0;
+
+    this->int_ctrl      = 0;
+    this->dev_irq_lines = 0;
+    this->dma_ifr0      = 0;
+    this->dma_ifr1      = 0;
+    this->dma_irq       = 0;
+
+    this->via2_ier      = 0;
+    this->via2_ifr      = 0;
+    this->via2_irq      = 0;
+    this->via2_slot_ier = 0;
+    this->via2_slot_ifr = 0x7F;
+    this->via2_slot_irq = 0;
+}
+
 uint32_t AMIC::read(uint32_t rgn_start, uint32_t offset, int size)
 {
     uint32_t  phase_val;
@@ -443,6 +469,9 @@ uint32_t AMIC::register_dma_int(IntSrc src_id) {
 }
 
 void AMIC::ack_int(uint32_t irq_id, uint8_t irq_line_state) {
+    if (io_trace_enabled)
+        IoTracer::get_instance()->trace_int(irq_id, irq_line_state, false);
+
     // dispatch cascaded AMIC interrupts from various sources
     // irq_id format: 00DDCCBBAA where
     // - AA -> CPU interrupts
@@ -512,6 +541,9 @@ void AMIC::ack_cpu_int(uint32_t irq_id, uint8_t irq_line_state) {
 }
 
 void AMIC::ack_dma_int(uint32_t irq_id, uint8_t irq_line_state) {
+    if (io_trace_enabled)
+        IoTracer::get_instance()->trace_int(irq_id, irq_line_state, true);
+
     if (irq_id >= 0x100) { // DMA Interrupt Flags 1
         irq_id = (irq_id >> 8) & 0xFFU;
         if (irq_line_state)
@@ -283,6 +283,7 @@ public:
 
     // HWComponent methods
     int device_postinit();
+    void reset() override;
 
     /* MMIODevice methods */
     uint32_t read(uint32_t rgn_start, uint32_t offset, int size);
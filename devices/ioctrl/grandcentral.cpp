@@ -21,6 +21,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include <cpu/ppc/ppcemu.h>
 #include <devices/deviceregistry.h>
+#include <devices/common/iotrace.h>
 #include <devices/common/scsi/sc53c94.h>
 #include <devices/ethernet/mace.h>
 #include <devices/floppy/swim3.h>
@@ -95,6 +96,22 @@ GrandCentral::GrandCentral() : PCIDevice("mac-io/grandcentral"), InterruptCtrl()
     this->floppy_dma->register_dma_int(this, this->register_dma_int(IntSrc::DMA_SWIM3));
 }
 
+void GrandCentral::reset()
+{
+    this->int_mask      = 0;
+    this->int_levels    = 0;
+    this->int_events    = 0;
+    this->cpu_int_latch = false;
+
+    this->awacs->reset();
+
+    this->snd_out_dma->reset();
+    this->ext_scsi_dma->reset();
+    this->floppy_dma->reset();
+    if (this->mesh_dma)
+        this->mesh_dma->reset();
+}
+
 void GrandCentral::notify_bar_change(int bar_num)
 {
     if (bar_num) // only BAR0 is supported
@@ -311,6 +328,9 @@ uint32_t GrandCentral::register_dev_int(IntSrc src_id) {
     case IntSrc::SCSI_MESH:     return 1 << 13;
     case IntSrc::VIA_CUDA:      return 1 << 18;
     case IntSrc::SWIM3:         return 1 << 19;
+    case IntSrc::PCI_A:         return 1 << 22;
+    case IntSrc::PCI_B:         return 1 << 23;
+    case IntSrc::PCI_C:         return 1 << 24;
     case IntSrc::CONTROL:       return 1 << 26;
     case IntSrc::PLATINUM:      return 1 << 30;
     default:
@@ -353,10 +373,16 @@ void GrandCentral::ack_int_common(uint32_t irq_id, uint8_t irq_line_state) {
 }
 
 void GrandCentral::ack_int(uint32_t irq_id, uint8_t irq_line_state) {
+    if (io_trace_enabled)
+        IoTracer::get_instance()->trace_int(irq_id, irq_line_state, false);
+
     this->ack_int_common(irq_id, irq_line_state);
 }
 
 void GrandCentral::ack_dma_int(uint32_t irq_id, uint8_t irq_line_state) {
+    if (io_trace_enabled)
+        IoTracer::get_instance()->trace_int(irq_id, irq_line_state, true);
+
     this->ack_int_common(irq_id, irq_line_state);
 }
 
@@ -24,6 +24,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <devices/common/ata/idechannel.h>
 #include <devices/common/dbdma.h>
 #include <devices/common/hwcomponent.h>
+#include <devices/common/iotrace.h>
 #include <devices/common/viacuda.h>
 #include <devices/floppy/swim3.h>
 #include <devices/ioctrl/macio.h>
@@ -103,6 +104,25 @@ HeathrowIC::HeathrowIC() : PCIDevice("mac-io/heathrow"), InterruptCtrl()
     this->emmo_pin = GET_BIN_PROP("emmo") ^ 1;
 }
 
+void HeathrowIC::reset()
+{
+    this->int_events1   = 0;
+    this->int_mask1     = 0;
+    this->int_levels1   = 0;
+    this->int_events2   = 0;
+    this->int_mask2     = 0;
+    this->int_levels2   = 0;
+    this->feat_ctrl     = 0;
+    this->aux_ctrl      = 0;
+    this->cpu_int_latch = false;
+
+    this->scsi_dma->reset();
+    this->floppy_dma->reset();
+    this->enet_xmit_dma->reset();
+    this->enet_rcv_dma->reset();
+    this->snd_out_dma->reset();
+}
+
 void HeathrowIC::notify_bar_change(int bar_num)
 {
     if (bar_num) // only BAR0 is supported
@@ -374,6 +394,12 @@ uint32_t HeathrowIC::register_dev_int(IntSrc src_id)
         return 1 << 7;
     case IntSrc::SWIM3:
         return 1 << 8;
+    case IntSrc::PCI_A: // IRQs 0x17...0x19
+        return 1 << 12;
+    case IntSrc::PCI_B:
+        return 1 << 13;
+    case IntSrc::PCI_C:
+        return 1 << 14;
     default:
         ABORT_F("Heathrow: unknown interrupt source %d", src_id);
     }
@@ -387,6 +413,9 @@ uint32_t HeathrowIC::register_dma_int(IntSrc src_id)
 
 void HeathrowIC::ack_int(uint32_t irq_id, uint8_t irq_line_state)
 {
+    if (io_trace_enabled)
+        IoTracer::get_instance()->trace_int(irq_id, irq_line_state, false);
+
 #if 1
     if (irq_id >= (1 << 20)) { // does this irq_id belong to the second set?
         irq_id >>= (20 - 10); // adjust for non-DMA interrupt bits of the 2nd set
@@ -459,6 +488,9 @@ void HeathrowIC::ack_int(uint32_t irq_id, uint8_t irq_line_state)
 
 void HeathrowIC::ack_dma_int(uint32_t irq_id, uint8_t irq_line_state)
 {
+    if (io_trace_enabled)
+        IoTracer::get_instance()->trace_int(irq_id, irq_line_state, true);
+
 #if 1
     if (irq_id >= (1 << 10)) { // does this irq_id belong to the second set?
         irq_id >>= 10; // adjust for DMA interrupt bits of the 2nd set
@@ -116,6 +116,9 @@ public:
         return std::unique_ptr<GrandCentral>(new GrandCentral());
     }
 
+    // HWComponent methods
+    void reset() override;
+
     // MMIO device methods
     uint32_t read(uint32_t rgn_start, uint32_t offset, int size);
     void write(uint32_t rgn_start, uint32_t offset, uint32_t value, int size);
@@ -175,6 +178,9 @@ public:
         return std::unique_ptr<OHare>(new OHare());
     }
 
+    // HWComponent methods
+    void reset() override;
+
     // MMIO device methods
     uint32_t read(uint32_t rgn_start, uint32_t offset, int size);
     void write(uint32_t rgn_start, uint32_t offset, uint32_t value, int size);
@@ -264,6 +270,9 @@ public:
         return std::unique_ptr<HeathrowIC>(new HeathrowIC());
     }
 
+    // HWComponent methods
+    void reset() override;
+
     // MMIO device methods
     uint32_t read(uint32_t rgn_start, uint32_t offset, int size);
     void write(uint32_t rgn_start, uint32_t offset, uint32_t value, int size);
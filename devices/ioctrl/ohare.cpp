@@ -63,6 +63,17 @@ OHare::OHare() : PCIDevice("mac-io/ohare"), InterruptCtrl()
     this->escc = dynamic_cast<EsccController*>(gMachineObj->get_comp_by_name("Escc"));
 }
 
+void OHare::reset()
+{
+    this->int_mask      = 0;
+    this->int_levels    = 0;
+    this->int_events    = 0;
+    this->cpu_int_latch = false;
+
+    this->awacs->reset();
+    this->snd_out_dma->reset();
+}
+
 void OHare::notify_bar_change(int bar_num)
 {
     if (bar_num) // only BAR0 is supported
@@ -21,13 +21,34 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include <devices/memctrl/memctrlbase.h>
 #include <devices/common/mmiodevice.h>
+#include <utils/coldpages.h>
+#include <utils/hostmem.h>
 
 #include <algorithm>    // to shut up MSVC errors (:
+#include <cstdio>
 #include <cstring>
+#include <fstream>
 #include <string>
 #include <vector>
 #include <loguru.hpp>
 
+#if defined(__linux__) && !defined(__EMSCRIPTEN__)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+static inline bool is_zero_page(const uint8_t* page, size_t page_size) {
+    const uint64_t* p   = reinterpret_cast<const uint64_t*>(page);
+    const uint64_t* end = p + page_size / sizeof(uint64_t);
+
+    for (; p < end; p += 4) {
+        if (p[0] | p[1] | p[2] | p[3])
+            return false;
+    }
+
+    return true;
+}
+
 static inline bool match_mem_entry(const AddressMapEntry* entry,
                                    const uint32_t start, const uint32_t end,
                                    MMIODevice* dev_instance)
@@ -43,8 +64,10 @@ MemCtrlBase::~MemCtrlBase() {
     }
 
     for (auto& reg : mem_regions) {
-        if (reg)
-            delete (reg);
+        if (this->cold_pages && (reg.type & RT_RAM))
+            ColdPageCompactor::get_instance()->remove_region(reg.mem_ptr);
+        if (reg.mem_ptr)
+            host_mem_free(reg.mem_ptr);
     }
     this->mem_regions.clear();
     this->address_map.clear();
@@ -153,9 +176,17 @@ bool MemCtrlBase::add_mem_region(uint32_t start_addr, uint32_t size,
     if (!is_range_free(start_addr, size))
         return false;
 
-    uint8_t* reg_content = new uint8_t[size];
+    char reg_name[32];
+    snprintf(reg_name, sizeof(reg_name), "%s@0x%08X",
+             type & RT_ROM ? "ROM" : "RAM", start_addr);
 
-    this->mem_regions.push_back(reg_content);
+    uint8_t* reg_content = host_mem_alloc(size, reg_name);
+
+    // fresh host memory is zero-filled
+    if (init_val)
+        std::memset(reg_content, init_val, size);
+
+    this->mem_regions.push_back({reg_content, size, type});
 
     entry = new AddressMapEntry;
 
@@ -276,6 +307,34 @@ bool MemCtrlBase::add_mmio_region(uint32_t start_addr, uint32_t size, MMIODevice
     return true;
 }
 
+bool MemCtrlBase::add_dev_ram_region(uint32_t start_addr, uint32_t size,
+                                     uint8_t* mem_ptr, MMIODevice* dev_instance)
+{
+    AddressMapEntry *entry;
+
+    /* error if a memory region for the given range already exists */
+    if (!is_range_free(start_addr, size))
+        return false;
+
+    entry = new AddressMapEntry;
+
+    // the memory stays owned by the device so it isn't added to mem_regions
+    uint32_t end   = start_addr + size - 1;
+    entry->start   = start_addr;
+    entry->end     = end;
+    entry->mirror  = 0;
+    entry->type    = RT_RAM;
+    entry->devobj  = dev_instance;
+    entry->mem_ptr = mem_ptr;
+
+    this->address_map.push_back(entry);
+
+    LOG_F(INFO, "Added device RAM region 0x%X..0x%X (%s)", start_addr, end,
+          dev_instance->get_name().c_str());
+
+    return true;
+}
+
 bool MemCtrlBase::remove_mmio_region(uint32_t start_addr, uint32_t size, MMIODevice* dev_instance)
 {
     int found = 0;
@@ -327,3 +386,203 @@ AddressMapEntry* MemCtrlBase::find_rom_region()
 
     return nullptr;
 }
+
+uint64_t MemCtrlBase::release_zero_pages()
+{
+    uint64_t released = 0;
+
+#if defined(__linux__) && !defined(__EMSCRIPTEN__)
+    const size_t page_size = sysconf(_SC_PAGESIZE);
+
+    std::vector<unsigned char> residency;
+
+    for (auto& reg : mem_regions) {
+        // the cold page compactor takes care of zero pages in its regions
+        if (!(reg.type & RT_RAM) || this->cold_pages)
+            continue;
+
+        // MADV_DONTNEED only releases memory of private anonymous mappings
+        const HostMemBlock* block = host_mem_find(reg.mem_ptr);
+        if (!block || !block->mapped || block->fd >= 0)
+            continue;
+
+        size_t num_pages = reg.size / page_size;
+
+        // only look at resident pages, reading the others would fault them in
+        residency.resize(num_pages);
+        if (mincore(reg.mem_ptr, num_pages * page_size, residency.data()))
+            continue;
+
+        size_t run_start = 0, run_len = 0;
+
+        for (size_t pg = 0; pg <= num_pages; pg++) {
+            if (pg < num_pages && (residency[pg] & 1) &&
+                is_zero_page(reg.mem_ptr + pg * page_size, page_size)) {
+                if (!run_len)
+                    run_start = pg;
+                run_len++;
+                continue;
+            }
+
+            // drop each run of zero pages with a single call, the host will
+            // supply fresh zero-filled pages when the guest touches them again
+            if (run_len) {
+                if (!madvise(reg.mem_ptr + run_start * page_size,
+                             run_len * page_size, MADV_DONTNEED))
+                    released += run_len * page_size;
+                run_len = 0;
+            }
+        }
+    }
+#endif
+
+    this->zero_released += released;
+    this->zero_scans++;
+
+    LOG_F(9, "Zero page scan released %llu KB of guest RAM",
+          (unsigned long long)(released >> 10));
+
+    return released;
+}
+
+void MemCtrlBase::get_host_mem_stats(HostMemStats& stats)
+{
+    stats = {};
+
+    for (auto& reg : mem_regions)
+        stats.total += reg.size;
+
+    stats.resident      = stats.total;
+    stats.zero_released = this->zero_released;
+    stats.zero_scans    = this->zero_scans;
+
+#if defined(__linux__) && !defined(__EMSCRIPTEN__)
+    const size_t page_size = sysconf(_SC_PAGESIZE);
+
+    std::vector<unsigned char> residency;
+
+    stats.resident = 0;
+
+    for (auto& reg : mem_regions) {
+        const HostMemBlock* block = host_mem_find(reg.mem_ptr);
+        if (!block || !block->mapped) {
+            stats.resident += reg.size;
+            continue;
+        }
+
+        size_t num_pages = (reg.size + page_size - 1) / page_size;
+        residency.resize(num_pages);
+        if (mincore(reg.mem_ptr, reg.size, residency.data()))
+            continue;
+
+        stats.resident += std::count_if(residency.begin(), residency.end(),
+            [](unsigned char r) { return r & 1; }) * page_size;
+    }
+
+    // guest memory is the only mergeable memory in this process so the
+    // per-process KSM counter (Linux 6.1+) describes exactly our regions
+    std::ifstream ksm_file("/proc/self/ksm_merging_pages");
+    uint64_t merged_pages;
+    if (ksm_file >> merged_pages)
+        stats.shared = merged_pages * page_size;
+#endif
+}
+
+bool MemCtrlBase::enable_cold_pages()
+{
+    for (auto& reg : mem_regions) {
+        if (!(reg.type & RT_RAM))
+            continue;
+
+        // releasing compressed pages only works for private anonymous mappings
+        const HostMemBlock* block = host_mem_find(reg.mem_ptr);
+        if (!block || !block->mapped || block->fd >= 0) {
+            LOG_F(WARNING, "Cold page compaction needs private mappings, RAM isn't tracked");
+            continue;
+        }
+
+        if (ColdPageCompactor::get_instance()->add_region(reg.mem_ptr, reg.size))
+            this->cold_pages = true;
+    }
+
+    return this->cold_pages;
+}
+
+bool MemCtrlBase::write_mem_layout(const std::string& path)
+{
+    FILE* layout_file = fopen(path.c_str(), "w");
+    if (!layout_file) {
+        LOG_F(ERROR, "Could not create memory layout file %s", path.c_str());
+        return false;
+    }
+
+#if defined(__linux__) && !defined(__EMSCRIPTEN__)
+    int pid = getpid();
+#else
+    int pid = 0;
+#endif
+
+    fprintf(layout_file, "# DingusPPC guest memory layout, pid %d\n", pid);
+    fprintf(layout_file, "# block <name> <size> <memfd path>\n");
+
+    for (auto& block : host_mem_blocks()) {
+        if (block.fd < 0)
+            continue;
+        fprintf(layout_file, "block %s 0x%zX /proc/%d/fd/%d\n",
+                block.name.c_str(), block.size, pid, block.fd);
+    }
+
+    fprintf(layout_file, "# range <phys start> <phys end> <type> <block> <block offset>\n");
+
+    for (auto& entry : address_map) {
+        if (!entry->mem_ptr)
+            continue;
+
+        const HostMemBlock* block = host_mem_find(entry->mem_ptr);
+        if (!block || block->fd < 0)
+            continue;
+
+        fprintf(layout_file, "range 0x%08X 0x%08X %s %s 0x%zX\n",
+                entry->start, entry->end,
+                entry->type & RT_ROM ? "ROM" : "RAM",
+                block->name.c_str(), size_t(entry->mem_ptr - block->mem_ptr));
+    }
+
+    fclose(layout_file);
+
+    LOG_F(INFO, "Guest memory layout written to %s", path.c_str());
+
+    return true;
+}
+
+void HostMemProfile::populate_variables(std::vector<ProfileVar>& vars) {
+    HostMemStats stats;
+
+    this->mem_ctrl->get_host_mem_stats(stats);
+
+    vars.clear();
+
+    vars.push_back({.name = "Guest memory (KB)",
+                    .format = ProfileVarFmt::DEC,
+                    .value = stats.total >> 10});
+
+    vars.push_back({.name = "Resident (KB)",
+                    .format = ProfileVarFmt::DEC,
+                    .value = stats.resident >> 10});
+
+    vars.push_back({.name = "Shared via KSM (KB)",
+                    .format = ProfileVarFmt::DEC,
+                    .value = stats.shared >> 10});
+
+    vars.push_back({.name = "Private resident (KB)",
+                    .format = ProfileVarFmt::DEC,
+                    .value = (stats.resident - std::min(stats.resident, stats.shared)) >> 10});
+
+    vars.push_back({.name = "Zero pages released (KB)",
+                    .format = ProfileVarFmt::DEC,
+                    .value = stats.zero_released >> 10});
+
+    vars.push_back({.name = "Zero page scans",
+                    .format = ProfileVarFmt::DEC,
+                    .value = stats.zero_scans});
+}
@@ -22,6 +22,8 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #ifndef MEMORY_CONTROLLER_BASE_H
 #define MEMORY_CONTROLLER_BASE_H
 
+#include <utils/profiler.h>
+
 #include <cinttypes>
 #include <string>
 #include <vector>
@@ -57,6 +59,15 @@ typedef struct AddressMapEntry {
     unsigned char* mem_ptr; /* direct pointer to data for memory objects */
 } AddressMapEntry;
 
+/** Host memory usage of the guest memory allocated by a memory controller. */
+typedef struct HostMemStats {
+    uint64_t total;         /* bytes of host address space reserved for guest memory */
+    uint64_t resident;      /* bytes currently backed by host pages */
+    uint64_t shared;        /* resident bytes merged with identical pages (KSM) */
+    uint64_t zero_released; /* bytes handed back to the host by zero page scans */
+    uint64_t zero_scans;    /* number of zero page scans performed so far */
+} HostMemStats;
+
 
 /** Base class for memory controllers. */
 class MemCtrlBase {
@@ -70,6 +81,11 @@ public:
     virtual bool add_mmio_region(uint32_t start_addr, uint32_t size, MMIODevice* dev_instance);
     virtual bool remove_mmio_region(uint32_t start_addr, uint32_t size, MMIODevice* dev_instance);
 
+    // Map host memory owned by a device (e.g. a linear framebuffer) so that
+    // the CPU accesses it like RAM. Use remove_mmio_region() to unmap it.
+    virtual bool add_dev_ram_region(uint32_t start_addr, uint32_t size,
+                                    uint8_t* mem_ptr, MMIODevice* dev_instance);
+
     virtual bool set_data(uint32_t reg_addr, const uint8_t* data, uint32_t size);
 
     AddressMapEntry* find_range(uint32_t addr);
@@ -80,13 +96,53 @@ public:
 
     AddressMapEntry* find_rom_region();
 
+    const std::vector<AddressMapEntry*>& get_address_map() const {
+        return this->address_map;
+    };
+
+    // Return all-zero resident RAM pages to the host, returns bytes released
+    uint64_t release_zero_pages();
+    void get_host_mem_stats(HostMemStats& stats);
+
+    // Compress RAM pages that stay unused (see utils/coldpages.h)
+    bool enable_cold_pages();
+
+    // Publish physical layout of the exported (memfd backed) guest memory
+    bool write_mem_layout(const std::string& path);
+
 protected:
     bool add_mem_region(
         uint32_t start_addr, uint32_t size, uint32_t dest_addr, uint32_t type, uint8_t init_val);
 
 private:
-    std::vector<uint8_t*> mem_regions;
+    /* Guest memory blocks allocated from the host (see utils/hostmem.h). */
+    typedef struct HostMemRegion {
+        uint8_t*    mem_ptr;
+        size_t      size;
+        uint32_t    type;
+    } HostMemRegion;
+
+    std::vector<HostMemRegion> mem_regions;
     std::vector<AddressMapEntry*> address_map;
+
+    uint64_t zero_released = 0;
+    uint64_t zero_scans    = 0;
+    bool     cold_pages    = false;
+};
+
+/** Profile reporting host memory consumption of the emulated machine. */
+class HostMemProfile : public BaseProfile {
+public:
+    HostMemProfile(MemCtrlBase* mem_ctrl) : BaseProfile("HostMem") {
+        this->mem_ctrl = mem_ctrl;
+    };
+
+    void populate_variables(std::vector<ProfileVar>& vars);
+
+    void reset(void) {}; // all values are either live or cumulative
+
+private:
+    MemCtrlBase* mem_ctrl;
 };
 
 #endif /* MEMORY_CONTROLLER_BASE_H */
@@ -54,7 +54,7 @@ PlatinumCtrl::PlatinumCtrl() : MemCtrlBase(), VideoCtrlBase(640, 480) {
     this->half_access = 0;
 
     // allocate VRAM
-    this->vram_ptr = std::unique_ptr<uint8_t[]> (new uint8_t[this->vram_size]);
+    this->vram_ptr = HostMemPtr(host_mem_alloc(this->vram_size, "VRAM:" + this->name));
 
     // initialize the CPUID register with the following CPU:
     // PowerPC 601 @ 90 MHz, bus frequency: 45 MHz
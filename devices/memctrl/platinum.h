@@ -36,6 +36,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <devices/video/appleramdac.h>
 #include <devices/video/displayid.h>
 #include <devices/video/videoctrl.h>
+#include <utils/hostmem.h>
 
 #include <cinttypes>
 #include <memory>
@@ -261,7 +262,7 @@ private:
     uint32_t    cursor_line         = 0;
     uint32_t    cursor_task_id      = 0;
 
-    std::unique_ptr<uint8_t[]>      vram_ptr = nullptr;
+    HostMemPtr                      vram_ptr = nullptr;
     std::unique_ptr<DisplayID>      display_id = nullptr;
     std::unique_ptr<AppleRamdac>    dacula = nullptr;
 };
@@ -68,6 +68,8 @@ void EsccController::reset()
 
     this->ch_a->reset(true);
     this->ch_b->reset(true);
+
+    this->reg_ptr = 0;
 }
 
 uint8_t EsccController::read(uint8_t reg_offset)
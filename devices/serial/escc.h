@@ -126,12 +126,14 @@ public:
         return std::unique_ptr<EsccController>(new EsccController());
     }
 
+    // HWComponent methods
+    void reset() override;
+
     // ESCC registers access
     uint8_t read(uint8_t reg_offset);
     void    write(uint8_t reg_offset, uint8_t value);
 
 private:
-    void reset();
     void write_internal(EsccChannel* ch, uint8_t value);
 
     std::unique_ptr<EsccChannel>    ch_a;
@@ -32,6 +32,8 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <endianswap.h>
 #include <machines/machinebase.h>
 
+#include <algorithm>
+#include <iterator>
 #include <loguru.hpp>
 
 AwacsBase::AwacsBase(std::string name) {
@@ -140,6 +142,14 @@ int AwacsScreamer::device_postinit() {
     return 0;
 }
 
+void AwacsScreamer::reset() {
+    AwacsBase::reset();
+
+    this->snd_ctrl_reg = 0;
+    this->is_busy      = 0;
+    std::fill(std::begin(this->control_regs), std::end(this->control_regs), 0);
+}
+
 uint32_t AwacsScreamer::snd_ctrl_read(uint32_t offset, int size) {
     switch (offset) {
     case AWAC_SOUND_CTRL_REG:
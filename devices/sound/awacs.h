@@ -48,6 +48,11 @@ public:
         this->dma_out_ch = dma_out_ch;
     };
 
+    // HWComponent methods
+    void reset() override {
+        this->dma_out_stop();
+    };
+
     void set_sample_rate(int sr_id);
     void dma_out_start();
     void dma_out_stop();
@@ -166,6 +171,7 @@ public:
     void        snd_ctrl_write(uint32_t offset, uint32_t value, int size);
 
     int device_postinit();
+    void reset() override;
 
     static std::unique_ptr<HWComponent> create() {
         return std::unique_ptr<AwacsScreamer>(new AwacsScreamer("Screamer"));
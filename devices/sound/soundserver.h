@@ -36,6 +36,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include <devices/common/hwcomponent.h>
 
+#include <cinttypes>
 #include <memory>
 
 class SoundServer : public HWComponent {
@@ -49,6 +50,16 @@ public:
     int start_out_stream();
     void close_out_stream();
 
+    // The null sink doesn't open any host audio device. Output streams
+    // are only drained when pull_out_frames() is called.
+    // Must be selected before the sound server is created.
+    static void set_null_sink(bool null_sink);
+    static bool is_null_sink();
+
+    // Fill out_buf with stereo 16-bit frames from the open output stream
+    // like the host audio callback does (null sink only)
+    long pull_out_frames(int16_t* out_buf, long req_frames);
+
 private:
     class Impl; // Holds private fields
     std::unique_ptr<Impl> impl;
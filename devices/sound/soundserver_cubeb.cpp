@@ -19,10 +19,12 @@ You should have received a copy of the GNU General Public License
 along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 
+#include <cpu/ppc/ppcemu.h>
 #include <devices/common/dmacore.h>
 #include <devices/sound/soundserver.h>
 #include <endianswap.h>
 
+#include <cstring>
 #include <loguru.hpp>
 #include <cubeb/cubeb.h>
 #ifdef _WIN32
@@ -43,8 +45,19 @@ public:
     cubeb *cubeb_ctx;
 
     cubeb_stream *out_stream;
+    void *out_user_data = nullptr; /* output stream source for the null sink */
 };
 
+static bool null_sink_mode = false;
+
+void SoundServer::set_null_sink(bool null_sink) {
+    null_sink_mode = null_sink;
+}
+
+bool SoundServer::is_null_sink() {
+    return null_sink_mode;
+}
+
 SoundServer::SoundServer(): impl(std::make_unique<Impl>())
 {
     supports_types(HWCompType::SND_SERVER);
@@ -66,6 +79,12 @@ int SoundServer::start()
 
     impl->status = SND_SERVER_DOWN;
 
+    if (null_sink_mode) {
+        LOG_F(INFO, "Sound output goes to the null sink");
+        impl->status = SND_API_READY;
+        return 0;
+    }
+
     res = cubeb_init(&impl->cubeb_ctx, "Dingus sound server", NULL);
     if (res != CUBEB_OK) {
         LOG_F(ERROR, "Could not initialize Cubeb library");
@@ -90,7 +109,8 @@ void SoundServer::shutdown()
     case SND_SERVER_UP:
         /* fall through */
     case SND_API_READY:
-        cubeb_destroy(impl->cubeb_ctx);
+        if (!null_sink_mode)
+            cubeb_destroy(impl->cubeb_ctx);
     }
 
     impl->status = SND_SERVER_DOWN;
@@ -98,22 +118,19 @@ void SoundServer::shutdown()
     LOG_F(INFO, "Sound Server shut down.");
 }
 
-long sound_out_callback(cubeb_stream *stream, void *user_data,
-                        void const *input_buffer, void *output_buffer,
-                        long req_frames)
+/* Pull up to req_frames frames from the DMA channel and convert them
+   to native endianness. Returns the number of frames delivered. */
+static long fill_out_buffer(DmaOutChannel *dma_ch, int16_t *out_buf, long req_frames)
 {
     uint8_t *p_in;
-    int16_t* in_buf, * out_buf;
+    int16_t* in_buf;
     uint32_t got_len;
     long frames, out_frames;
-    DmaOutChannel *dma_ch = static_cast<DmaOutChannel*>(user_data); /* C API baby! */
 
     if (!dma_ch->is_active()) {
         return 0;
     }
 
-    out_buf = (int16_t*)output_buffer;
-
     out_frames = 0;
 
     while (req_frames > 0) {
@@ -140,6 +157,30 @@ long sound_out_callback(cubeb_stream *stream, void *user_data,
     return out_frames;
 }
 
+long sound_out_callback(cubeb_stream *stream, void *user_data,
+                        void const *input_buffer, void *output_buffer,
+                        long req_frames)
+{
+    DmaOutChannel *dma_ch = static_cast<DmaOutChannel*>(user_data); /* C API baby! */
+
+    // sound hardware is powered down while the CPU sleeps
+    if (ppc_power_mode == PowerMode::SLEEP) {
+        std::memset(output_buffer, 0, req_frames * 2 * sizeof(int16_t));
+        return req_frames;
+    }
+
+    return fill_out_buffer(dma_ch, (int16_t*)output_buffer, req_frames);
+}
+
+long SoundServer::pull_out_frames(int16_t* out_buf, long req_frames)
+{
+    if (!null_sink_mode || impl->status != SND_STREAM_OPENED)
+        return 0;
+
+    return fill_out_buffer(static_cast<DmaOutChannel*>(impl->out_user_data), out_buf,
+                           req_frames);
+}
+
 static void status_callback(cubeb_stream *stream, void *user_data, cubeb_state state)
 {
     LOG_F(9, "Cubeb status callback fired, status = %d", state);
@@ -151,6 +192,12 @@ int SoundServer::open_out_stream(uint32_t sample_rate, void *user_data)
     uint32_t latency_frames;
     cubeb_stream_params params;
 
+    if (null_sink_mode) {
+        impl->out_user_data = user_data;
+        impl->status = SND_STREAM_OPENED;
+        return 0;
+    }
+
     params.format = CUBEB_SAMPLE_S16NE;
     params.rate = sample_rate;
     params.channels = 2;
@@ -182,13 +229,20 @@ int SoundServer::open_out_stream(uint32_t sample_rate, void *user_data)
 
 int SoundServer::start_out_stream()
 {
+    if (null_sink_mode)
+        return 0;
+
     return cubeb_stream_start(impl->out_stream);
 }
 
 void SoundServer::close_out_stream()
 {
-    cubeb_stream_stop(impl->out_stream);
-    cubeb_stream_destroy(impl->out_stream);
+    if (null_sink_mode) {
+        impl->out_user_data = nullptr;
+    } else {
+        cubeb_stream_stop(impl->out_stream);
+        cubeb_stream_destroy(impl->out_stream);
+    }
     impl->status = SND_STREAM_CLOSED;
     LOG_F(9, "Sound output stream closed.");
 }
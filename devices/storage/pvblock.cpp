@@ -0,0 +1,399 @@
+/*
+DingusPPC - The Experimental PowerPC Macintosh emulator
+Copyright (C) 2018-23 divingkatae and maximum
+                      (theweirdo)     spatium
+
+(Contact divingkatae#1017 or powermax#2286 on Discord for more info)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file Paravirtual PCI block device emulation. */
+
+#include <core/timermanager.h>
+#include <cpu/ppc/ppcmmu.h>
+#include <devices/common/hwinterrupt.h>
+#include <devices/deviceregistry.h>
+#include <devices/storage/pvblock.h>
+#include <loguru.hpp>
+#include <machines/machinebase.h>
+#include <machines/machineproperties.h>
+#include <memaccess.h>
+
+#include <fstream>
+#include <string>
+
+using namespace PvBlock;
+
+PvBlockDevice::PvBlockDevice() : PCIDevice("PvBlock")
+{
+    supports_types(HWCompType::MMIO_DEV | HWCompType::PCI_DEV);
+
+    // set up PCI configuration space header
+    this->vendor_id = PCI_VENDOR_DINGUS;
+    this->device_id = PV_BLOCK_DEV_ID;
+    this->class_rev = (0x018000 << 8) | 1; // other mass storage controller
+    this->irq_pin   = 1;
+
+    this->setup_bars({{0, ~(PV_BLOCK_REGS_SIZE - 1)}}); // registers
+
+    this->pci_notify_bar_change = [this](int bar_num) {
+        this->notify_bar_change(bar_num);
+    };
+
+    // the expansion ROM holding the FCode and Mac OS drivers is optional
+    if (std::ifstream("pvblock.rom").good()) {
+        this->attach_exp_rom_image(std::string("pvblock.rom"));
+    }
+}
+
+int PvBlockDevice::device_postinit()
+{
+    std::string img_path = GET_STR_PROP("pvblk_img");
+
+    if (!img_path.empty()) {
+        WriteSync sync = write_sync_from_str(GET_STR_PROP("pvblk_sync"));
+        if (!this->disk_img.open(img_path, sync)) {
+            LOG_F(ERROR, "%s: could not open image file %s", this->name.c_str(),
+                  img_path.c_str());
+            return -1;
+        }
+        this->num_blocks = this->disk_img.size() / PV_BLOCK_SEC_SIZE;
+        this->is_ready   = true;
+    }
+
+    this->int_ctrl = dynamic_cast<InterruptCtrl*>(
+        gMachineObj->get_comp_by_type(HWCompType::INT_CTRL));
+
+    IntSrc int_src = this->host_instance->pci_get_slot_irq(this);
+    if (this->int_ctrl && int_src != IntSrc::INT_UNKNOWN) {
+        this->irq_id = this->int_ctrl->register_dev_int(int_src);
+    } else {
+        LOG_F(WARNING, "%s: no interrupt line, completions must be polled",
+              this->name.c_str());
+    }
+
+    gProfilerObj->register_profile("PvBlock",
+        std::unique_ptr<BaseProfile>(new PvBlockProfile(this)));
+
+    return 0;
+}
+
+/* Forget the guest's ring setup, the disk image stays open. */
+void PvBlockDevice::reset()
+{
+    if (this->coal_timer_id) {
+        TimerManager::get_instance()->cancel_timer(this->coal_timer_id);
+        this->coal_timer_id = 0;
+    }
+
+    this->ring_base    = 0;
+    this->ring_size    = 0;
+    this->control      = 0;
+    this->cons_idx     = 0;
+    this->coal_count   = 1;
+    this->coal_usecs   = 0;
+    this->coal_pending = 0;
+
+    if (this->int_status) {
+        this->int_status = 0;
+        this->update_irq(false);
+    }
+}
+
+void PvBlockDevice::notify_bar_change(int bar_num)
+{
+    if (bar_num) // only BAR0 is supported
+        return;
+
+    uint32_t new_base = this->bars[bar_num] & ~(PV_BLOCK_REGS_SIZE - 1);
+
+    if (this->regs_base != new_base) {
+        if (this->regs_base) {
+            this->host_instance->pci_unregister_mmio_region(this->regs_base,
+                                                            PV_BLOCK_REGS_SIZE, this);
+        }
+
+        this->regs_base = new_base;
+
+        if (this->regs_base) {
+            this->host_instance->pci_register_mmio_region(this->regs_base,
+                                                          PV_BLOCK_REGS_SIZE, this);
+            LOG_F(INFO, "%s: registers mapped at 0x%08X", this->name.c_str(),
+                  this->regs_base);
+        }
+    }
+}
+
+uint32_t PvBlockDevice::read(uint32_t rgn_start, uint32_t offset, int size)
+{
+    uint32_t value;
+
+    switch (offset & ~3) {
+    case PvBlockReg::MAGIC:
+        value = PV_BLOCK_MAGIC;
+        break;
+    case PvBlockReg::VERSION:
+        value = PV_BLOCK_VERSION;
+        break;
+    case PvBlockReg::CAPACITY_HI:
+        value = (uint32_t)(this->num_blocks >> 32);
+        break;
+    case PvBlockReg::CAPACITY_LO:
+        value = (uint32_t)this->num_blocks;
+        break;
+    case PvBlockReg::BLOCK_SIZE:
+        value = PV_BLOCK_SEC_SIZE;
+        break;
+    case PvBlockReg::RING_BASE:
+        value = this->ring_base;
+        break;
+    case PvBlockReg::RING_SIZE:
+        value = this->ring_size;
+        break;
+    case PvBlockReg::CONTROL:
+        value = this->control;
+        break;
+    case PvBlockReg::INT_STATUS:
+        value = this->int_status;
+        break;
+    case PvBlockReg::COALESCE_COUNT:
+        value = this->coal_count;
+        break;
+    case PvBlockReg::COALESCE_USECS:
+        value = this->coal_usecs;
+        break;
+    case PvBlockReg::USED_IDX:
+        value = this->cons_idx;
+        break;
+    default:
+        LOG_F(WARNING, "%s: read from unknown register 0x%X", this->name.c_str(),
+              offset);
+        return 0;
+    }
+
+    if (size == 4)
+        return value;
+
+    // narrow accesses return the addressed bytes of a big-endian register
+    return (value >> ((4 - size - (offset & 3)) * 8)) & ((1ULL << (size * 8)) - 1);
+}
+
+void PvBlockDevice::write(uint32_t rgn_start, uint32_t offset, uint32_t value, int size)
+{
+    if (size != 4 || (offset & 3)) {
+        LOG_F(WARNING, "%s: unsupported register write, offset=0x%X, size=%d",
+              this->name.c_str(), offset, size);
+        return;
+    }
+
+    switch (offset) {
+    case PvBlockReg::RING_BASE:
+        this->ring_base = value;
+        this->cons_idx  = 0;
+        break;
+    case PvBlockReg::RING_SIZE:
+        if (!value || value > PV_BLOCK_MAX_RING || (value & (value - 1))) {
+            LOG_F(ERROR, "%s: invalid ring size %d", this->name.c_str(), value);
+            break;
+        }
+        this->ring_size = value;
+        this->cons_idx  = 0;
+        break;
+    case PvBlockReg::CONTROL:
+        this->control = value;
+        break;
+    case PvBlockReg::DOORBELL:
+        this->num_doorbells++;
+        this->process_ring(value);
+        break;
+    case PvBlockReg::INT_STATUS:
+        this->int_status &= ~value;
+        if (!this->int_status)
+            this->update_irq(false);
+        break;
+    case PvBlockReg::COALESCE_COUNT:
+        this->coal_count = value;
+        break;
+    case PvBlockReg::COALESCE_USECS:
+        this->coal_usecs = value;
+        break;
+    default:
+        LOG_F(WARNING, "%s: write to unknown register 0x%X", this->name.c_str(),
+              offset);
+    }
+}
+
+/* Execute all requests between the last consumed descriptor and prod_idx. */
+void PvBlockDevice::process_ring(uint32_t prod_idx)
+{
+    if (!(this->control & CTRL_ENABLE) || !this->ring_size) {
+        LOG_F(WARNING, "%s: doorbell rung while the ring is disabled",
+              this->name.c_str());
+        return;
+    }
+
+    uint32_t num_pending = prod_idx - this->cons_idx;
+
+    if (num_pending > this->ring_size) {
+        LOG_F(ERROR, "%s: producer index %d is out of range", this->name.c_str(),
+              prod_idx);
+        return;
+    }
+
+    if (!num_pending)
+        return;
+
+    // the ring is followed by the completion index
+    MapDmaResult res = mmu_map_dma_mem(this->ring_base,
+        this->ring_size * PV_BLOCK_DESC_SIZE + 4, false);
+
+    for (; this->cons_idx != prod_idx; this->cons_idx++) {
+        uint8_t* desc = res.host_va +
+            (this->cons_idx & (this->ring_size - 1)) * PV_BLOCK_DESC_SIZE;
+
+        desc[1] = this->exec_request(desc);
+    }
+
+    WRITE_DWORD_BE_A(res.host_va + this->ring_size * PV_BLOCK_DESC_SIZE,
+                     this->cons_idx);
+
+    this->num_requests += num_pending;
+
+    this->complete_requests(num_pending);
+}
+
+uint8_t PvBlockDevice::exec_request(uint8_t* desc)
+{
+    uint32_t num_blks = READ_DWORD_BE_A(&desc[4]);
+    uint64_t lba      = READ_QWORD_BE_A(&desc[8]);
+    uint32_t buf_addr = READ_DWORD_BE_A(&desc[16]);
+
+    if (!this->is_ready)
+        return ST_IO_ERROR;
+
+    switch (desc[0]) {
+    case OP_READ:
+    case OP_WRITE:
+        break;
+    case OP_FLUSH:
+        return this->disk_img.flush() ? ST_OK : ST_IO_ERROR;
+    default:
+        return ST_UNSUPPORTED;
+    }
+
+    if (!num_blks || lba >= this->num_blocks || num_blks > this->num_blocks - lba ||
+        num_blks > (0xFFFFFFFFUL / PV_BLOCK_SEC_SIZE))
+        return ST_IO_ERROR;
+
+    uint32_t xfer_len = num_blks * PV_BLOCK_SEC_SIZE;
+
+    MapDmaResult res = mmu_map_dma_mem(buf_addr, xfer_len, false);
+
+    if (desc[0] == OP_READ) {
+        if (!res.is_writable)
+            return ST_IO_ERROR;
+        if (this->disk_img.read(res.host_va, lba * PV_BLOCK_SEC_SIZE, xfer_len) != xfer_len)
+            return ST_IO_ERROR;
+        this->num_blocks_rd += num_blks;
+    } else {
+        if (this->disk_img.write(res.host_va, lba * PV_BLOCK_SEC_SIZE, xfer_len) != xfer_len)
+            return ST_IO_ERROR;
+        this->num_blocks_wr += num_blks;
+    }
+
+    return ST_OK;
+}
+
+/* Signal completions immediately once enough of them have accumulated,
+   otherwise defer the interrupt by the coalescing period. */
+void PvBlockDevice::complete_requests(uint32_t count)
+{
+    this->coal_pending += count;
+
+    if (!(this->control & CTRL_INT_ENABLE))
+        return;
+
+    auto raise_int = [this]() {
+        this->coal_pending = 0;
+        this->int_status |= INT_COMPLETION;
+        this->num_interrupts++;
+        this->update_irq(true);
+    };
+
+    if (this->coal_pending >= this->coal_count || !this->coal_usecs) {
+        if (this->coal_timer_id) {
+            TimerManager::get_instance()->cancel_timer(this->coal_timer_id);
+            this->coal_timer_id = 0;
+        }
+        raise_int();
+    } else if (!this->coal_timer_id) {
+        this->coal_timer_id = TimerManager::get_instance()->add_oneshot_timer(
+            USECS_TO_NSECS(uint64_t(this->coal_usecs)), [this, raise_int]() {
+                this->coal_timer_id = 0;
+                raise_int();
+        });
+    }
+}
+
+void PvBlockDevice::update_irq(bool assert)
+{
+    if (this->int_ctrl && this->irq_id)
+        this->int_ctrl->ack_int(this->irq_id, assert);
+}
+
+void PvBlockProfile::populate_variables(std::vector<ProfileVar>& vars)
+{
+    vars.clear();
+
+    vars.push_back({.name = "Requests",
+                    .format = ProfileVarFmt::DEC,
+                    .value = this->dev_obj->num_requests});
+
+    vars.push_back({.name = "Doorbell writes",
+                    .format = ProfileVarFmt::DEC,
+                    .value = this->dev_obj->num_doorbells});
+
+    vars.push_back({.name = "Interrupts",
+                    .format = ProfileVarFmt::DEC,
+                    .value = this->dev_obj->num_interrupts});
+
+    vars.push_back({.name = "Blocks read",
+                    .format = ProfileVarFmt::DEC,
+                    .value = this->dev_obj->num_blocks_rd});
+
+    vars.push_back({.name = "Blocks written",
+                    .format = ProfileVarFmt::DEC,
+                    .value = this->dev_obj->num_blocks_wr});
+}
+
+void PvBlockProfile::reset()
+{
+    this->dev_obj->num_requests   = 0;
+    this->dev_obj->num_doorbells  = 0;
+    this->dev_obj->num_interrupts = 0;
+    this->dev_obj->num_blocks_rd  = 0;
+    this->dev_obj->num_blocks_wr  = 0;
+}
+
+static const PropMap PvBlock_Properties = {
+    {"pvblk_img", new StrProperty("")},
+    {"pvblk_sync", new StrProperty("writeback", {"unsafe", "writeback", "writethrough"})},
+};
+
+static const DeviceDescription PvBlock_Descriptor = {
+    PvBlockDevice::create, {}, PvBlock_Properties
+};
+
+REGISTER_DEVICE(PvBlock, PvBlock_Descriptor);
@@ -0,0 +1,179 @@
+/*
+DingusPPC - The Experimental PowerPC Macintosh emulator
+Copyright (C) 2018-23 divingkatae and maximum
+                      (theweirdo)     spatium
+
+(Contact divingkatae#1017 or powermax#2286 on Discord for more info)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file Paravirtual PCI block device definitions.
+
+    This device gives guests with a matching driver direct access to a disk
+    image without going through an emulated SCSI or ATA controller.
+
+    The driver places a ring of request descriptors in guest memory, fills in
+    a batch of them and announces the whole batch with a single write to the
+    doorbell register. The device executes all pending requests at once,
+    stores the result into each descriptor's status field and publishes the
+    new completion index right after the descriptor ring. Completion interrupts
+    can be coalesced over a number of requests or a period of time.
+
+    All registers and descriptor fields are big-endian.
+ */
+
+#ifndef PV_BLOCK_H
+#define PV_BLOCK_H
+
+#include <devices/common/hwcomponent.h>
+#include <devices/common/pci/pcidevice.h>
+#include <utils/imgfile.h>
+#include <utils/profiler.h>
+
+#include <cinttypes>
+#include <memory>
+#include <string>
+
+class InterruptCtrl;
+
+#define PV_BLOCK_DEV_ID     0x0001  // device ID under PCI_VENDOR_DINGUS
+
+#define PV_BLOCK_MAGIC      0x50564253  // 'PVBS'
+#define PV_BLOCK_VERSION    1
+#define PV_BLOCK_REGS_SIZE  0x1000U
+#define PV_BLOCK_SEC_SIZE   512
+#define PV_BLOCK_MAX_RING   1024
+#define PV_BLOCK_DESC_SIZE  32
+
+namespace PvBlock {
+
+// Register offsets.
+enum PvBlockReg : uint32_t {
+    MAGIC           = 0x00, // RO: PV_BLOCK_MAGIC
+    VERSION         = 0x04, // RO: interface version
+    CAPACITY_HI     = 0x08, // RO: disk size in blocks, upper 32 bits
+    CAPACITY_LO     = 0x0C, // RO: disk size in blocks, lower 32 bits
+    BLOCK_SIZE      = 0x10, // RO: block size in bytes
+    RING_BASE       = 0x14, // RW: physical address of the descriptor ring
+    RING_SIZE       = 0x18, // RW: number of descriptors, power of two
+    CONTROL         = 0x1C, // RW: see control bits below
+    DOORBELL        = 0x20, // WO: producer index of the last submitted request + 1
+    INT_STATUS      = 0x24, // RW: pending interrupts, write 1 to clear
+    COALESCE_COUNT  = 0x28, // RW: interrupt after this many completions
+    COALESCE_USECS  = 0x2C, // RW: or after this many microseconds
+    USED_IDX        = 0x30, // RO: number of completed requests
+};
+
+// CONTROL register bits.
+enum {
+    CTRL_ENABLE     = 1 << 0, // process requests
+    CTRL_INT_ENABLE = 1 << 1, // signal completions by interrupt
+};
+
+// INT_STATUS register bits.
+enum {
+    INT_COMPLETION  = 1 << 0,
+};
+
+// Request descriptor layout:
+//  0: uint8_t  opcode
+//  1: uint8_t  status (written by the device)
+//  2: uint16_t reserved
+//  4: uint32_t number of blocks
+//  8: uint64_t starting block
+// 16: uint32_t physical buffer address
+// 20: uint32_t reserved
+// 24: uint64_t cookie (ignored by the device)
+enum RequestOp : uint8_t {
+    OP_READ         = 0,
+    OP_WRITE        = 1,
+    OP_FLUSH        = 2,
+};
+
+enum RequestStatus : uint8_t {
+    ST_PENDING      = 0,
+    ST_OK           = 1,
+    ST_IO_ERROR     = 2,
+    ST_UNSUPPORTED  = 3,
+};
+
+}; // namespace PvBlock
+
+class PvBlockDevice : public PCIDevice {
+public:
+    PvBlockDevice();
+    ~PvBlockDevice() = default;
+
+    static std::unique_ptr<HWComponent> create() {
+        return std::unique_ptr<PvBlockDevice>(new PvBlockDevice());
+    }
+
+    int device_postinit() override;
+    void reset() override;
+
+    // MMIODevice methods
+    uint32_t read(uint32_t rgn_start, uint32_t offset, int size) override;
+    void write(uint32_t rgn_start, uint32_t offset, uint32_t value, int size) override;
+
+    // statistics
+    uint64_t num_requests   = 0;
+    uint64_t num_doorbells  = 0;
+    uint64_t num_interrupts = 0;
+    uint64_t num_blocks_rd  = 0;
+    uint64_t num_blocks_wr  = 0;
+
+protected:
+    void notify_bar_change(int bar_num);
+    void process_ring(uint32_t prod_idx);
+    uint8_t exec_request(uint8_t* desc);
+    void complete_requests(uint32_t count);
+    void update_irq(bool assert);
+
+private:
+    ImgFile         disk_img;
+    uint64_t        num_blocks = 0;
+    bool            is_ready   = false;
+
+    uint32_t        regs_base  = 0;
+    uint32_t        ring_base  = 0;
+    uint32_t        ring_size  = 0;
+    uint32_t        control    = 0;
+    uint32_t        int_status = 0;
+    uint32_t        cons_idx   = 0;
+    uint32_t        coal_count = 1;
+    uint32_t        coal_usecs = 0;
+    uint32_t        coal_pending = 0;
+    uint32_t        coal_timer_id = 0;
+
+    InterruptCtrl*  int_ctrl = nullptr;
+    uint32_t        irq_id   = 0;
+};
+
+/** Profile showing how efficiently guests batch requests. */
+class PvBlockProfile : public BaseProfile {
+public:
+    PvBlockProfile(PvBlockDevice* dev_obj) : BaseProfile("PvBlock") {
+        this->dev_obj = dev_obj;
+    };
+
+    void populate_variables(std::vector<ProfileVar>& vars);
+
+    void reset(void);
+
+private:
+    PvBlockDevice* dev_obj;
+};
+
+#endif // PV_BLOCK_H
@@ -62,7 +62,7 @@ AtiMach64Gx::AtiMach64Gx()
 
     // allocate video RAM
     this->vram_size = 2 << 20;
-    this->vram_ptr = std::unique_ptr<uint8_t[]> (new uint8_t[this->vram_size]);
+    this->vram_ptr = HostMemPtr(host_mem_alloc(this->vram_size, "VRAM:" + this->name));
 
     // set up RAMDAC identification
     this->regs[ATI_CONFIG_STAT0] = 1 << 9;
@@ -27,6 +27,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <devices/common/pci/pcidevice.h>
 #include <devices/video/displayid.h>
 #include <devices/video/videoctrl.h>
+#include <utils/hostmem.h>
 
 #include <cinttypes>
 #include <memory>
@@ -81,7 +82,7 @@ private:
     uint8_t     dac_regs[256];
 
     std::unique_ptr<DisplayID>  disp_id;
-    std::unique_ptr<uint8_t[]>  vram_ptr;
+    HostMemPtr                  vram_ptr;
 };
 
 #endif // ATI_MACH64_GX_H
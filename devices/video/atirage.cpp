@@ -96,7 +96,7 @@ ATIRage::ATIRage(uint16_t dev_id)
     this->vram_size = GET_INT_PROP("gfxmem_size") << 20; // convert MBs to bytes
 
     // allocate video RAM
-    this->vram_ptr = std::unique_ptr<uint8_t[]> (new uint8_t[this->vram_size]);
+    this->vram_ptr = HostMemPtr(host_mem_alloc(this->vram_size, "VRAM:" + this->name));
 
     // ATI Rage driver needs to know ASIC ID (manufacturer's internal chip code)
     // to operate properly
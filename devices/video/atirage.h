@@ -26,6 +26,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <devices/video/atimach64defs.h>
 #include <devices/video/displayid.h>
 #include <devices/video/videoctrl.h>
+#include <utils/hostmem.h>
 
 #include <cinttypes>
 #include <memory>
@@ -87,7 +88,7 @@ private:
     uint8_t     cmd_fifo_size = 0;
 
     // Video RAM variables
-    std::unique_ptr<uint8_t[]>  vram_ptr;
+    HostMemPtr  vram_ptr;
     uint32_t    vram_size;
 
     uint32_t    aperture_base = 0;
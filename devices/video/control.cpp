@@ -68,7 +68,7 @@ ControlVideo::ControlVideo()
     this->num_banks = this->vram_size >> 21; // 2 MB => 1 bank, 4 MB >> 2 banks
 
     // allocate VRAM
-    this->vram_ptr = std::unique_ptr<uint8_t[]> (new uint8_t[this->vram_size]);
+    this->vram_ptr = HostMemPtr(host_mem_alloc(this->vram_size, "VRAM:" + this->name));
 
     // set up PCI configuration space header
     this->vendor_id   = PCI_VENDOR_APPLE;
@@ -29,6 +29,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <devices/video/appleramdac.h>
 #include <devices/video/displayid.h>
 #include <devices/video/videoctrl.h>
+#include <utils/hostmem.h>
 
 #include <cinttypes>
 #include <memory>
@@ -136,7 +137,7 @@ private:
     std::unique_ptr<AthensClocks>   clk_gen;
     std::unique_ptr<AppleRamdac>    radacal = nullptr;
 
-    std::unique_ptr<uint8_t[]>  vram_ptr;
+    HostMemPtr                      vram_ptr;
 
     uint32_t    vram_size;
     uint32_t    io_base = 0;
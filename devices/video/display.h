@@ -28,6 +28,15 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include <functional>
 #include <memory>
+#include <vector>
+
+/** Rectangular area of the screen in pixels. */
+struct DisplayRect {
+    int x;
+    int y;
+    int w;
+    int h;
+};
 
 class Display {
 public:
@@ -45,9 +54,22 @@ public:
                 std::function<void(uint8_t *dst_buf, int dst_pitch)> cursor_ovl_cb,
                 bool draw_hw_cursor, int cursor_x, int cursor_y);
 
+    // Updates the given screen areas only, everything else keeps its content.
+    // convert_rect_cb receives the destination address of the top-left pixel.
+    void update_rects(std::function<void(uint8_t *dst_buf, int dst_pitch,
+                                         const DisplayRect& rect)> convert_rect_cb,
+                      const std::vector<DisplayRect>& rects);
+
     void handle_events(const WindowEvent& wnd_event);
     void setup_hw_cursor(std::function<void(uint8_t *dst_buf, int dst_pitch)> draw_hw_cursor,
                          int cursor_width, int cursor_height);
+
+    // Headless displays don't create any host windows. Frames are still
+    // converted, but into an off-screen ARGB8888 buffer instead.
+    // Must be selected before the first display is configured.
+    static void set_headless(bool headless);
+    static bool is_headless();
+
 private:
     class Impl; // Holds private fields
     std::unique_ptr<Impl> impl;
@@ -23,8 +23,14 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <SDL.h>
 #include <loguru.hpp>
 
+#include <algorithm>
+#include <vector>
+
+static bool headless_mode = false;
+
 class Display::Impl {
 public:
+    bool            configured = false;
     bool            resizing = false;
     uint32_t        disp_wnd_id = 0;
     SDL_Window*     display_wnd = 0;
@@ -32,8 +38,24 @@ public:
     SDL_Texture*    disp_texture = 0;
     SDL_Texture*    cursor_texture = 0;
     SDL_Rect        cursor_rect; // destination rectangle for cursor drawing
+
+    // off-screen buffers for headless operation
+    std::vector<uint8_t>    host_fb;
+    int                     host_pitch = 0;
+    std::vector<uint8_t>    cursor_buf;
+
+    // staging buffer for partial texture updates
+    std::vector<uint8_t>    rect_buf;
 };
 
+void Display::set_headless(bool headless) {
+    headless_mode = headless;
+}
+
+bool Display::is_headless() {
+    return headless_mode;
+}
+
 Display::Display(): impl(std::make_unique<Impl>()) {
 }
 
@@ -54,6 +76,14 @@ Display::~Display() {
 bool Display::configure(int width, int height) {
     bool is_initialization = false;
 
+    if (headless_mode) {
+        is_initialization = !impl->configured;
+        impl->configured  = true;
+        impl->host_pitch  = width * 4;
+        impl->host_fb.assign((size_t)impl->host_pitch * height, 0);
+        return is_initialization;
+    }
+
     if (!impl->display_wnd) { // create display window
         impl->display_wnd = SDL_CreateWindow(
             "DingusPPC Display",
@@ -100,6 +130,11 @@ void Display::handle_events(const WindowEvent& wnd_event) {
 }
 
 void Display::blank() {
+    if (headless_mode) {
+        std::fill(impl->host_fb.begin(), impl->host_fb.end(), 0);
+        return;
+    }
+
     SDL_SetRenderDrawColor(impl->renderer, 0, 0, 0, 255);
     SDL_RenderClear(impl->renderer);
     SDL_RenderPresent(impl->renderer);
@@ -114,6 +149,13 @@ void Display::update(std::function<void(uint8_t *dst_buf, int dst_pitch)> conver
     uint8_t*    dst_buf;
     int         dst_pitch;
 
+    if (headless_mode) {
+        convert_fb_cb(impl->host_fb.data(), impl->host_pitch);
+        if (cursor_ovl_cb != nullptr)
+            cursor_ovl_cb(impl->host_fb.data(), impl->host_pitch);
+        return;
+    }
+
     SDL_LockTexture(impl->disp_texture, NULL, (void **)&dst_buf, &dst_pitch);
 
     // texture update callback to get ARGB data from guest framebuffer
@@ -137,11 +179,49 @@ void Display::update(std::function<void(uint8_t *dst_buf, int dst_pitch)> conver
     SDL_RenderPresent(impl->renderer);
 }
 
+void Display::update_rects(std::function<void(uint8_t *dst_buf, int dst_pitch,
+                                             const DisplayRect& rect)> convert_rect_cb,
+                           const std::vector<DisplayRect>& rects) {
+    if (impl->resizing || rects.empty())
+        return;
+
+    if (headless_mode) {
+        for (auto& rect : rects) {
+            convert_rect_cb(&impl->host_fb[rect.y * impl->host_pitch + rect.x * 4],
+                            impl->host_pitch, rect);
+        }
+        return;
+    }
+
+    // SDL_LockTexture() doesn't preserve the pixels of the locked area
+    // so every rectangle is converted separately and uploaded as is
+    for (auto& rect : rects) {
+        size_t rect_size = (size_t)rect.w * rect.h * 4;
+        if (impl->rect_buf.size() < rect_size)
+            impl->rect_buf.resize(rect_size);
+
+        convert_rect_cb(impl->rect_buf.data(), rect.w * 4, rect);
+
+        SDL_Rect dst_rect = {rect.x, rect.y, rect.w, rect.h};
+        SDL_UpdateTexture(impl->disp_texture, &dst_rect, impl->rect_buf.data(), rect.w * 4);
+    }
+
+    SDL_RenderClear(impl->renderer);
+    SDL_RenderCopy(impl->renderer, impl->disp_texture, NULL, NULL);
+    SDL_RenderPresent(impl->renderer);
+}
+
 void Display::setup_hw_cursor(std::function<void(uint8_t *dst_buf, int dst_pitch)> draw_hw_cursor,
                               int cursor_width, int cursor_height) {
     uint8_t*    dst_buf;
     int         dst_pitch;
 
+    if (headless_mode) {
+        impl->cursor_buf.assign(cursor_width * cursor_height * 4, 0);
+        draw_hw_cursor(impl->cursor_buf.data(), cursor_width * 4);
+        return;
+    }
+
     if (impl->cursor_texture)
         SDL_DestroyTexture(impl->cursor_texture);
 
@@ -0,0 +1,467 @@
+/*
+DingusPPC - The Experimental PowerPC Macintosh emulator
+Copyright (C) 2018-23 divingkatae and maximum
+                      (theweirdo)     spatium
+
+(Contact divingkatae#1017 or powermax#2286 on Discord for more info)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file Paravirtual PCI display emulation. */
+
+#include <core/timermanager.h>
+#include <cpu/ppc/ppcmmu.h>
+#include <devices/common/hwinterrupt.h>
+#include <devices/deviceregistry.h>
+#include <devices/video/pvdisplay.h>
+#include <loguru.hpp>
+#include <machines/machinebase.h>
+#include <memaccess.h>
+
+#include <fstream>
+#include <string>
+
+using namespace PvDisplay;
+
+typedef struct {
+    uint16_t    width;
+    uint16_t    height;
+} PvDisplayMode;
+
+static const PvDisplayMode pv_modes[] = {
+    { 640,  480}, { 800,  600}, { 832,  624}, {1024,  768},
+    {1152,  870}, {1280,  960}, {1280, 1024}, {1600, 1200},
+};
+
+#define PV_NUM_MODES (sizeof(pv_modes) / sizeof(pv_modes[0]))
+
+PvDisplayDevice::PvDisplayDevice() : PCIDevice("PvDisplay"), VideoCtrlBase(640, 480)
+{
+    supports_types(HWCompType::MMIO_DEV | HWCompType::PCI_DEV);
+
+    this->vram_ptr = HostMemPtr(host_mem_alloc(PV_DISPLAY_VRAM_SIZE, "VRAM:" + this->name));
+
+    // set up PCI configuration space header
+    this->vendor_id = PCI_VENDOR_DINGUS;
+    this->device_id = PV_DISPLAY_DEV_ID;
+    this->class_rev = (0x030000 << 8) | 1; // VGA compatible controller
+    this->irq_pin   = 1;
+
+    this->setup_bars({
+        {0, ~(PV_DISPLAY_REGS_SIZE - 1)}, // registers
+        {1, ~(PV_DISPLAY_VRAM_SIZE - 1)}  // linear framebuffer
+    });
+
+    this->pci_notify_bar_change = [this](int bar_num) {
+        this->notify_bar_change(bar_num);
+    };
+
+    // VBL is reported through INT_STATUS, the interrupt line stays
+    // asserted until the driver acknowledges it
+    this->vbl_cb = [this](uint8_t irq_line_state) {
+        if (!irq_line_state)
+            return;
+        this->int_status |= INT_VBL;
+        if ((this->control & CTRL_VBL_INT) && this->int_ctrl)
+            this->int_ctrl->ack_int(this->irq_id, 1);
+    };
+
+    // the expansion ROM holding the FCode and Mac OS drivers is optional
+    if (std::ifstream("pvdisplay.rom").good()) {
+        this->attach_exp_rom_image(std::string("pvdisplay.rom"));
+    }
+}
+
+/* Blank the screen until the driver sets up a mode again. The host window
+   and the VRAM allocation are kept. */
+void PvDisplayDevice::reset()
+{
+    if (this->int_status && this->int_ctrl)
+        this->int_ctrl->ack_int(this->irq_id, 0);
+
+    this->mode_select = 0;
+    this->req_width   = 640;
+    this->req_height  = 480;
+    this->req_depth   = 8;
+    this->fb_offset   = 0;
+    this->control     = 0;
+    this->mode_error  = 0;
+    this->int_status  = 0;
+    this->clut_index  = 0;
+    this->damage_pos  = 0;
+    this->damage_list = 0;
+
+    this->blank_on        = true;
+    this->crtc_on         = false;
+    this->damage_tracking = false;
+    this->set_full_damage();
+    this->blank_display();
+}
+
+int PvDisplayDevice::device_postinit()
+{
+    this->int_ctrl = dynamic_cast<InterruptCtrl*>(
+        gMachineObj->get_comp_by_type(HWCompType::INT_CTRL));
+
+    IntSrc int_src = this->host_instance->pci_get_slot_irq(this);
+    if (this->int_ctrl && int_src != IntSrc::INT_UNKNOWN) {
+        this->irq_id = this->int_ctrl->register_dev_int(int_src);
+    } else {
+        LOG_F(WARNING, "%s: no interrupt line, VBL must be polled",
+              this->name.c_str());
+    }
+
+    this->set_mode();
+
+    gProfilerObj->register_profile("PvDisplay",
+        std::unique_ptr<BaseProfile>(new PvDisplayProfile(this)));
+
+    return 0;
+}
+
+void PvDisplayDevice::notify_bar_change(int bar_num)
+{
+    switch (bar_num) {
+    case 0: {
+        uint32_t new_base = this->bars[bar_num] & ~(PV_DISPLAY_REGS_SIZE - 1);
+        if (this->regs_base != new_base) {
+            if (this->regs_base)
+                this->host_instance->pci_unregister_mmio_region(this->regs_base,
+                    PV_DISPLAY_REGS_SIZE, this);
+            this->regs_base = new_base;
+            if (this->regs_base) {
+                this->host_instance->pci_register_mmio_region(this->regs_base,
+                    PV_DISPLAY_REGS_SIZE, this);
+                LOG_F(INFO, "%s: registers mapped at 0x%08X", this->name.c_str(),
+                      this->regs_base);
+            }
+        }
+        break;
+    }
+    case 1: {
+        uint32_t new_base = this->bars[bar_num] & ~(PV_DISPLAY_VRAM_SIZE - 1);
+        if (this->vram_base != new_base) {
+            if (this->vram_base)
+                this->host_instance->pci_unregister_mmio_region(this->vram_base,
+                    PV_DISPLAY_VRAM_SIZE, this);
+            this->vram_base = new_base;
+            if (this->vram_base) {
+                this->host_instance->pci_register_ram_region(this->vram_base,
+                    PV_DISPLAY_VRAM_SIZE, this->vram_ptr.get(), this);
+                LOG_F(INFO, "%s: framebuffer mapped at 0x%08X", this->name.c_str(),
+                      this->vram_base);
+            }
+        }
+        break;
+    }
+    }
+}
+
+uint32_t PvDisplayDevice::get_mode_depths(int width, int height)
+{
+    uint32_t depths = 0;
+
+    for (int bpp = 8, bit = DEPTH_8; bpp <= 32; bpp <<= 1, bit <<= 1) {
+        if ((uint64_t)width * height * (bpp >> 3) <= PV_DISPLAY_VRAM_SIZE)
+            depths |= bit;
+    }
+
+    return depths;
+}
+
+bool PvDisplayDevice::set_mode()
+{
+    const PvDisplayMode* mode = nullptr;
+
+    for (auto& m : pv_modes) {
+        if (m.width == this->req_width && m.height == this->req_height) {
+            mode = &m;
+            break;
+        }
+    }
+
+    uint32_t depth_bit = this->req_depth == 8 ? DEPTH_8 :
+                         this->req_depth == 16 ? DEPTH_16 :
+                         this->req_depth == 32 ? DEPTH_32 : 0;
+
+    uint32_t pitch = this->req_width * (this->req_depth >> 3);
+
+    if (!mode || !(this->get_mode_depths(mode->width, mode->height) & depth_bit) ||
+        this->fb_offset + (uint64_t)pitch * this->req_height > PV_DISPLAY_VRAM_SIZE) {
+        LOG_F(ERROR, "%s: unsupported mode %dx%d@%d, offset 0x%X", this->name.c_str(),
+              this->req_width, this->req_height, this->req_depth, this->fb_offset);
+        return false;
+    }
+
+    this->stop_refresh_task();
+
+    // the requested mode is one of pv_modes here, so it fits the signed fields
+    if (this->req_width != (uint32_t)this->active_width ||
+        this->req_height != (uint32_t)this->active_height)
+        this->create_display_window(this->req_width, this->req_height);
+
+    this->pixel_depth = this->req_depth;
+    this->fb_pitch    = pitch;
+    this->fb_ptr      = this->vram_ptr.get() + this->fb_offset;
+
+    switch (this->pixel_depth) {
+    case 8:
+        this->convert_fb_cb = [this](uint8_t *dst_buf, int dst_pitch) {
+            this->convert_frame_8bpp_indexed(dst_buf, dst_pitch);
+        };
+        this->convert_rect_cb = [this](uint8_t *dst_buf, int dst_pitch,
+                                       const DisplayRect& rect) {
+            this->convert_rect_8bpp_indexed(dst_buf, dst_pitch, rect);
+        };
+        break;
+    case 16:
+        this->convert_fb_cb = [this](uint8_t *dst_buf, int dst_pitch) {
+            this->convert_frame_15bpp_BE(dst_buf, dst_pitch);
+        };
+        this->convert_rect_cb = [this](uint8_t *dst_buf, int dst_pitch,
+                                       const DisplayRect& rect) {
+            this->convert_rect_15bpp_BE(dst_buf, dst_pitch, rect);
+        };
+        break;
+    case 32:
+        this->convert_fb_cb = [this](uint8_t *dst_buf, int dst_pitch) {
+            this->convert_frame_32bpp_BE(dst_buf, dst_pitch);
+        };
+        this->convert_rect_cb = [this](uint8_t *dst_buf, int dst_pitch,
+                                       const DisplayRect& rect) {
+            this->convert_rect_32bpp_BE(dst_buf, dst_pitch, rect);
+        };
+        break;
+    }
+
+    // made-up timing for a 60 Hz display with typical blanking intervals
+    this->hori_total   = this->active_width  + 160;
+    this->vert_total   = this->active_height + 45;
+    this->hori_blank   = 160;
+    this->vert_blank   = 45;
+    this->refresh_rate = 60.0f;
+    this->pixel_clock  = (float)this->hori_total * this->vert_total * this->refresh_rate;
+
+    this->set_full_damage();
+    this->start_refresh_task();
+
+    LOG_F(INFO, "%s: display mode set to %dx%d@%d", this->name.c_str(),
+          this->active_width, this->active_height, this->pixel_depth);
+
+    return true;
+}
+
+void PvDisplayDevice::read_damage_list(uint32_t count)
+{
+    if (!count)
+        return;
+
+    if (count > PV_DISPLAY_MAX_DAMAGE) {
+        this->set_full_damage();
+        return;
+    }
+
+    MapDmaResult res = mmu_map_dma_mem(this->damage_list, count * 8, false);
+    uint8_t* entry = res.host_va;
+
+    for (; count > 0; count--, entry += 8) {
+        this->add_damage_rect(READ_WORD_BE_A(entry), READ_WORD_BE_A(entry + 2),
+                              READ_WORD_BE_A(entry + 4), READ_WORD_BE_A(entry + 6));
+    }
+}
+
+uint32_t PvDisplayDevice::read(uint32_t rgn_start, uint32_t offset, int size)
+{
+    uint32_t value;
+
+    switch (offset & ~3) {
+    case PvDisplayReg::MAGIC:
+        value = PV_DISPLAY_MAGIC;
+        break;
+    case PvDisplayReg::VERSION:
+        value = PV_DISPLAY_VERSION;
+        break;
+    case PvDisplayReg::VRAM_SIZE:
+        value = PV_DISPLAY_VRAM_SIZE;
+        break;
+    case PvDisplayReg::NUM_MODES:
+        value = PV_NUM_MODES;
+        break;
+    case PvDisplayReg::MODE_SELECT:
+        value = this->mode_select;
+        break;
+    case PvDisplayReg::MODE_WIDTH:
+        value = this->mode_select < PV_NUM_MODES ? pv_modes[this->mode_select].width : 0;
+        break;
+    case PvDisplayReg::MODE_HEIGHT:
+        value = this->mode_select < PV_NUM_MODES ? pv_modes[this->mode_select].height : 0;
+        break;
+    case PvDisplayReg::MODE_DEPTHS:
+        value = this->mode_select < PV_NUM_MODES ? this->get_mode_depths(
+            pv_modes[this->mode_select].width, pv_modes[this->mode_select].height) : 0;
+        break;
+    case PvDisplayReg::WIDTH:
+        value = this->req_width;
+        break;
+    case PvDisplayReg::HEIGHT:
+        value = this->req_height;
+        break;
+    case PvDisplayReg::DEPTH:
+        value = this->req_depth;
+        break;
+    case PvDisplayReg::PITCH:
+        value = this->fb_pitch;
+        break;
+    case PvDisplayReg::FB_OFFSET:
+        value = this->fb_offset;
+        break;
+    case PvDisplayReg::CONTROL:
+        value = this->control;
+        break;
+    case PvDisplayReg::SET_MODE:
+        value = this->mode_error;
+        break;
+    case PvDisplayReg::INT_STATUS:
+        value = this->int_status;
+        break;
+    case PvDisplayReg::CLUT_INDEX:
+        value = this->clut_index;
+        break;
+    case PvDisplayReg::DAMAGE_POS:
+        value = this->damage_pos;
+        break;
+    case PvDisplayReg::DAMAGE_LIST:
+        value = this->damage_list;
+        break;
+    default:
+        LOG_F(WARNING, "%s: read from unknown register 0x%X", this->name.c_str(),
+              offset);
+        return 0;
+    }
+
+    if (size == 4)
+        return value;
+
+    // narrow accesses return the addressed bytes of a big-endian register
+    return (value >> ((4 - size - (offset & 3)) * 8)) & ((1ULL << (size * 8)) - 1);
+}
+
+void PvDisplayDevice::write(uint32_t rgn_start, uint32_t offset, uint32_t value, int size)
+{
+    if (size != 4 || (offset & 3)) {
+        LOG_F(WARNING, "%s: unsupported register write, offset=0x%X, size=%d",
+              this->name.c_str(), offset, size);
+        return;
+    }
+
+    switch (offset) {
+    case PvDisplayReg::MODE_SELECT:
+        this->mode_select = value;
+        break;
+    case PvDisplayReg::WIDTH:
+        this->req_width = value;
+        break;
+    case PvDisplayReg::HEIGHT:
+        this->req_height = value;
+        break;
+    case PvDisplayReg::DEPTH:
+        this->req_depth = value;
+        break;
+    case PvDisplayReg::FB_OFFSET:
+        this->fb_offset = value;
+        break;
+    case PvDisplayReg::CONTROL:
+        if ((value ^ this->control) & CTRL_DAMAGE)
+            this->set_full_damage();
+        this->control  = value;
+        this->blank_on = !(value & CTRL_DISPLAY_ON);
+        this->crtc_on  = !!(value & CTRL_DISPLAY_ON);
+        this->damage_tracking = !!(value & CTRL_DAMAGE);
+        if (!(value & CTRL_VBL_INT) && this->int_ctrl)
+            this->int_ctrl->ack_int(this->irq_id, 0);
+        break;
+    case PvDisplayReg::SET_MODE:
+        this->mode_error = !this->set_mode();
+        break;
+    case PvDisplayReg::INT_STATUS:
+        this->int_status &= ~value;
+        if (!(this->int_status & INT_VBL) && this->int_ctrl)
+            this->int_ctrl->ack_int(this->irq_id, 0);
+        break;
+    case PvDisplayReg::CLUT_INDEX:
+        this->clut_index = value & 0xFF;
+        break;
+    case PvDisplayReg::CLUT_DATA:
+        this->set_palette_color(this->clut_index, (value >> 16) & 0xFF,
+                                (value >> 8) & 0xFF, value & 0xFF, 0xFF);
+        this->clut_index = (this->clut_index + 1) & 0xFF;
+        if (this->pixel_depth == 8)
+            this->set_full_damage();
+        break;
+    case PvDisplayReg::DAMAGE_POS:
+        this->damage_pos = value;
+        break;
+    case PvDisplayReg::DAMAGE_SIZE:
+        this->num_damage_reports++;
+        this->add_damage_rect(this->damage_pos >> 16, this->damage_pos & 0xFFFF,
+                              value >> 16, value & 0xFFFF);
+        break;
+    case PvDisplayReg::DAMAGE_LIST:
+        this->damage_list = value;
+        break;
+    case PvDisplayReg::DAMAGE_COUNT:
+        this->num_damage_reports++;
+        this->read_damage_list(value);
+        break;
+    default:
+        LOG_F(WARNING, "%s: write to unknown register 0x%X", this->name.c_str(),
+              offset);
+    }
+}
+
+void PvDisplayProfile::populate_variables(std::vector<ProfileVar>& vars)
+{
+    vars.clear();
+
+    vars.push_back({.name = "Damage reports",
+                    .format = ProfileVarFmt::DEC,
+                    .value = this->dev_obj->num_damage_reports});
+
+    vars.push_back({.name = "Full screen updates",
+                    .format = ProfileVarFmt::DEC,
+                    .value = this->dev_obj->num_full_updates});
+
+    vars.push_back({.name = "Rectangle updates",
+                    .format = ProfileVarFmt::DEC,
+                    .value = this->dev_obj->num_rect_updates});
+
+    vars.push_back({.name = "Pixels converted",
+                    .format = ProfileVarFmt::DEC,
+                    .value = this->dev_obj->num_pixels_converted});
+}
+
+void PvDisplayProfile::reset()
+{
+    this->dev_obj->num_damage_reports   = 0;
+    this->dev_obj->num_full_updates     = 0;
+    this->dev_obj->num_rect_updates     = 0;
+    this->dev_obj->num_pixels_converted = 0;
+}
+
+static const DeviceDescription PvDisplay_Descriptor = {
+    PvDisplayDevice::create, {}, {}
+};
+
+REGISTER_DEVICE(PvDisplay, PvDisplay_Descriptor);
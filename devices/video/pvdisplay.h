@@ -0,0 +1,170 @@
+/*
+DingusPPC - The Experimental PowerPC Macintosh emulator
+Copyright (C) 2018-23 divingkatae and maximum
+                      (theweirdo)     spatium
+
+(Contact divingkatae#1017 or powermax#2286 on Discord for more info)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file Paravirtual PCI display definitions.
+
+    This display adapter is meant for guests with a matching driver.
+    Its linear framebuffer lives in host memory mapped directly into the
+    guest physical address space so drawing costs no emulated I/O at all.
+
+    Display modes are negotiated through registers: the driver enumerates
+    the supported resolutions, programs width, height and depth and applies
+    them with a single write. In damage mode the host refreshes only the
+    screen areas the guest reports through the damage doorbells, so the
+    display cost is proportional to what the guest actually draws.
+
+    All registers and damage list entries are big-endian.
+ */
+
+#ifndef PV_DISPLAY_H
+#define PV_DISPLAY_H
+
+#include <devices/common/hwcomponent.h>
+#include <devices/common/pci/pcidevice.h>
+#include <devices/video/videoctrl.h>
+#include <utils/hostmem.h>
+#include <utils/profiler.h>
+
+#include <cinttypes>
+#include <memory>
+
+#define PV_DISPLAY_DEV_ID       0x0002  // device ID under PCI_VENDOR_DINGUS
+
+#define PV_DISPLAY_MAGIC        0x50564642  // 'PVFB'
+#define PV_DISPLAY_VERSION      1
+#define PV_DISPLAY_REGS_SIZE    0x1000U
+#define PV_DISPLAY_VRAM_SIZE    0x800000U   // 8 MB
+#define PV_DISPLAY_MAX_DAMAGE   256         // max entries per damage list
+
+namespace PvDisplay {
+
+// Register offsets.
+enum PvDisplayReg : uint32_t {
+    MAGIC           = 0x00, // RO: PV_DISPLAY_MAGIC
+    VERSION         = 0x04, // RO: interface version
+    VRAM_SIZE       = 0x08, // RO: framebuffer size in bytes
+    NUM_MODES       = 0x0C, // RO: number of entries in the mode list
+    MODE_SELECT     = 0x10, // RW: mode list entry shown in MODE_WIDTH...MODE_DEPTHS
+    MODE_WIDTH      = 0x14, // RO: width of the selected mode list entry
+    MODE_HEIGHT     = 0x18, // RO: height of the selected mode list entry
+    MODE_DEPTHS     = 0x1C, // RO: depths supported by the selected entry
+    WIDTH           = 0x20, // RW: requested width in pixels
+    HEIGHT          = 0x24, // RW: requested height in pixels
+    DEPTH           = 0x28, // RW: requested depth in bits per pixel (8, 16, 32)
+    PITCH           = 0x2C, // RO: bytes per row of the current mode
+    FB_OFFSET       = 0x30, // RW: offset of the visible area within VRAM
+    CONTROL         = 0x34, // RW: see control bits below
+    SET_MODE        = 0x38, // WO: apply requested mode, RO: 1 if it was rejected
+    INT_STATUS      = 0x3C, // RW: pending interrupts, write 1 to clear
+    CLUT_INDEX      = 0x40, // RW: next palette entry to write
+    CLUT_DATA       = 0x44, // WO: 0x00RRGGBB, auto-increments CLUT_INDEX
+    DAMAGE_POS      = 0x48, // RW: (x << 16) | y of the next damaged area
+    DAMAGE_SIZE     = 0x4C, // WO: (width << 16) | height, reports the area
+    DAMAGE_LIST     = 0x50, // RW: physical address of a damage list
+    DAMAGE_COUNT    = 0x54, // WO: reports that many damage list entries
+};
+
+// CONTROL register bits.
+enum {
+    CTRL_DISPLAY_ON = 1 << 0, // scan out the framebuffer
+    CTRL_DAMAGE     = 1 << 1, // refresh reported areas only
+    CTRL_VBL_INT    = 1 << 2, // signal vertical blanking by interrupt
+};
+
+// MODE_DEPTHS bits.
+enum {
+    DEPTH_8         = 1 << 0,
+    DEPTH_16        = 1 << 1,
+    DEPTH_32        = 1 << 2,
+};
+
+// INT_STATUS register bits.
+enum {
+    INT_VBL         = 1 << 0,
+};
+
+// Damage list entry layout:
+//  0: uint16_t x
+//  2: uint16_t y
+//  4: uint16_t width
+//  6: uint16_t height
+
+}; // namespace PvDisplay
+
+class PvDisplayDevice : public PCIDevice, public VideoCtrlBase {
+public:
+    PvDisplayDevice();
+    ~PvDisplayDevice() = default;
+
+    static std::unique_ptr<HWComponent> create() {
+        return std::unique_ptr<PvDisplayDevice>(new PvDisplayDevice());
+    }
+
+    int device_postinit() override;
+    void reset() override;
+
+    // MMIODevice methods
+    uint32_t read(uint32_t rgn_start, uint32_t offset, int size) override;
+    void write(uint32_t rgn_start, uint32_t offset, uint32_t value, int size) override;
+
+    // statistics
+    uint64_t num_damage_reports = 0;
+
+protected:
+    void notify_bar_change(int bar_num);
+    uint32_t get_mode_depths(int width, int height);
+    bool set_mode();
+    void read_damage_list(uint32_t count);
+
+private:
+    HostMemPtr  vram_ptr;
+
+    uint32_t    regs_base   = 0;
+    uint32_t    vram_base   = 0;
+    uint32_t    mode_select = 0;
+    uint32_t    req_width   = 640;
+    uint32_t    req_height  = 480;
+    uint32_t    req_depth   = 8;
+    uint32_t    fb_offset   = 0;
+    uint32_t    control     = 0;
+    uint32_t    mode_error  = 0;
+    uint32_t    int_status  = 0;
+    uint32_t    clut_index  = 0;
+    uint32_t    damage_pos  = 0;
+    uint32_t    damage_list = 0;
+};
+
+/** Profile showing how much of the screen gets converted. */
+class PvDisplayProfile : public BaseProfile {
+public:
+    PvDisplayProfile(PvDisplayDevice* dev_obj) : BaseProfile("PvDisplay") {
+        this->dev_obj = dev_obj;
+    };
+
+    void populate_variables(std::vector<ProfileVar>& vars);
+
+    void reset(void);
+
+private:
+    PvDisplayDevice* dev_obj;
+};
+
+#endif // PV_DISPLAY_H
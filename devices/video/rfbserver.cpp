@@ -0,0 +1,1003 @@
+/*
+DingusPPC - The Experimental PowerPC Macintosh emulator
+Copyright (C) 2018-23 divingkatae and maximum
+                      (theweirdo)     spatium
+
+(Contact divingkatae#1017 or powermax#2286 on Discord for more info)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file Built-in RFB (VNC) server. */
+
+#include <core/hostevents.h>
+#include <core/timermanager.h>
+#include <devices/common/adb/adbkeyboard.h>
+#include <devices/video/rfbserver.h>
+#include <loguru.hpp>
+#include <memaccess.h>
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+
+#if !defined(_WIN32) && !defined(__EMSCRIPTEN__)
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#define RFB_SUPPORTED
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+using namespace Rfb;
+
+RfbServer* RfbServer::rfb_server_obj = nullptr;
+
+namespace {
+
+const int TILE_SIZE = 16;
+
+const int HANDSHAKE_TIMEOUT_MS = 5000;
+
+const uint32_t MAX_CUT_TEXT = 1 << 20;
+
+// Hextile subencoding flags.
+enum : uint8_t {
+    HT_RAW              = 1,
+    HT_BG_SPECIFIED     = 2,
+    HT_FG_SPECIFIED     = 4,
+    HT_ANY_SUBRECTS     = 8,
+    HT_SUBRECTS_COLORED = 16,
+};
+
+// Our native pixel format, matches the ARGB8888 output of the frame converters.
+const PixelFormat native_fmt = {32, 24, false, true, 255, 255, 255, 16, 8, 0};
+
+/** Translate an X11 keysym sent by the client into an ADB key code. */
+int keysym_to_adb(uint32_t keysym)
+{
+    if (keysym >= 'a' && keysym <= 'z')
+        keysym -= 'a' - 'A';
+
+    switch (keysym) {
+    case 'A': return AdbKey_A;
+    case 'B': return AdbKey_B;
+    case 'C': return AdbKey_C;
+    case 'D': return AdbKey_D;
+    case 'E': return AdbKey_E;
+    case 'F': return AdbKey_F;
+    case 'G': return AdbKey_G;
+    case 'H': return AdbKey_H;
+    case 'I': return AdbKey_I;
+    case 'J': return AdbKey_J;
+    case 'K': return AdbKey_K;
+    case 'L': return AdbKey_L;
+    case 'M': return AdbKey_M;
+    case 'N': return AdbKey_N;
+    case 'O': return AdbKey_O;
+    case 'P': return AdbKey_P;
+    case 'Q': return AdbKey_Q;
+    case 'R': return AdbKey_R;
+    case 'S': return AdbKey_S;
+    case 'T': return AdbKey_T;
+    case 'U': return AdbKey_U;
+    case 'V': return AdbKey_V;
+    case 'W': return AdbKey_W;
+    case 'X': return AdbKey_X;
+    case 'Y': return AdbKey_Y;
+    case 'Z': return AdbKey_Z;
+
+    // shifted variants map to the unshifted key
+    case '1': case '!':     return AdbKey_1;
+    case '2': case '@':     return AdbKey_2;
+    case '3': case '#':     return AdbKey_3;
+    case '4': case '$':     return AdbKey_4;
+    case '5': case '%':     return AdbKey_5;
+    case '6': case '^':     return AdbKey_6;
+    case '7': case '&':     return AdbKey_7;
+    case '8': case '*':     return AdbKey_8;
+    case '9': case '(':     return AdbKey_9;
+    case '0': case ')':     return AdbKey_0;
+    case '-': case '_':     return AdbKey_Minus;
+    case '=': case '+':     return AdbKey_Equal;
+    case '[': case '{':     return AdbKey_LeftBracket;
+    case ']': case '}':     return AdbKey_RightBracket;
+    case '\\': case '|':    return AdbKey_Backslash;
+    case ';': case ':':     return AdbKey_Semicolon;
+    case '\'': case '"':    return AdbKey_Quote;
+    case ',': case '<':     return AdbKey_Comma;
+    case '.': case '>':     return AdbKey_Period;
+    case '/': case '?':     return AdbKey_Slash;
+    case '`': case '~':     return AdbKey_Grave;
+    case ' ':               return AdbKey_Space;
+
+    case 0xFF08:            return AdbKey_Delete;       // BackSpace
+    case 0xFF09:            return AdbKey_Tab;
+    case 0xFF0D:            return AdbKey_Return;
+    case 0xFF1B:            return AdbKey_Escape;
+    case 0xFFFF:            return AdbKey_ForwardDelete;
+    case 0xFF63:            return AdbKey_Help;         // Insert
+    case 0xFF6A:            return AdbKey_Help;
+    case 0xFF50:            return AdbKey_Home;
+    case 0xFF57:            return AdbKey_End;
+    case 0xFF55:            return AdbKey_PageUp;
+    case 0xFF56:            return AdbKey_PageDown;
+    case 0xFF51:            return AdbKey_ArrowLeft;
+    case 0xFF52:            return AdbKey_ArrowUp;
+    case 0xFF53:            return AdbKey_ArrowRight;
+    case 0xFF54:            return AdbKey_ArrowDown;
+
+    case 0xFFE1: case 0xFFE2: return AdbKey_Shift;
+    case 0xFFE3: case 0xFFE4: return AdbKey_Control;
+    case 0xFFE5:            return AdbKey_CapsLock;
+    case 0xFFE9: case 0xFFEA: return AdbKey_Option;     // Alt
+    case 0xFFE7: case 0xFFE8: return AdbKey_Command;    // Meta
+    case 0xFFEB: case 0xFFEC: return AdbKey_Command;    // Super
+
+    case 0xFFBE:            return AdbKey_F1;
+    case 0xFFBF:            return AdbKey_F2;
+    case 0xFFC0:            return AdbKey_F3;
+    case 0xFFC1:            return AdbKey_F4;
+    case 0xFFC2:            return AdbKey_F5;
+    case 0xFFC3:            return AdbKey_F6;
+    case 0xFFC4:            return AdbKey_F7;
+    case 0xFFC5:            return AdbKey_F8;
+    case 0xFFC6:            return AdbKey_F9;
+    case 0xFFC7:            return AdbKey_F10;
+    case 0xFFC8:            return AdbKey_F11;
+    case 0xFFC9:            return AdbKey_F12;
+    case 0xFFCA:            return AdbKey_F13;
+    case 0xFFCB:            return AdbKey_F14;
+    case 0xFFCC:            return AdbKey_F15;
+
+    case 0xFFB0:            return AdbKey_Keypad0;
+    case 0xFFB1:            return AdbKey_Keypad1;
+    case 0xFFB2:            return AdbKey_Keypad2;
+    case 0xFFB3:            return AdbKey_Keypad3;
+    case 0xFFB4:            return AdbKey_Keypad4;
+    case 0xFFB5:            return AdbKey_Keypad5;
+    case 0xFFB6:            return AdbKey_Keypad6;
+    case 0xFFB7:            return AdbKey_Keypad7;
+    case 0xFFB8:            return AdbKey_Keypad8;
+    case 0xFFB9:            return AdbKey_Keypad9;
+    case 0xFFAE:            return AdbKey_KeypadDecimal;
+    case 0xFFAB:            return AdbKey_KeypadPlus;
+    case 0xFFAD:            return AdbKey_KeypadMinus;
+    case 0xFFAA:            return AdbKey_KeypadMultiply;
+    case 0xFFAF:            return AdbKey_KeypadDivide;
+    case 0xFF8D:            return AdbKey_KeypadEnter;
+    case 0xFFBD:            return AdbKey_KeypadEquals;
+    case 0xFF0B:            return AdbKey_KeypadClear;  // Clear
+
+    default:
+        return -1;
+    }
+}
+
+#ifdef RFB_SUPPORTED
+
+bool send_all(int fd, const uint8_t* buf, size_t len)
+{
+    while (len) {
+        ssize_t sent = send(fd, buf, len, MSG_NOSIGNAL);
+        if (sent <= 0) {
+            if (sent < 0 && errno == EINTR)
+                continue;
+            return false;
+        }
+        buf += sent;
+        len -= sent;
+    }
+    return true;
+}
+
+bool recv_exact(int fd, uint8_t* buf, size_t len)
+{
+    while (len) {
+        pollfd pfd = {fd, POLLIN, 0};
+        if (poll(&pfd, 1, HANDSHAKE_TIMEOUT_MS) <= 0)
+            return false;
+
+        ssize_t got = recv(fd, buf, len, 0);
+        if (got <= 0) {
+            if (got < 0 && errno == EINTR)
+                continue;
+            return false;
+        }
+        buf += got;
+        len -= got;
+    }
+    return true;
+}
+
+#endif // RFB_SUPPORTED
+
+inline void put16(std::vector<uint8_t>& buf, uint16_t val) {
+    buf.push_back(val >> 8);
+    buf.push_back(val & 0xFF);
+}
+
+inline void put32(std::vector<uint8_t>& buf, uint32_t val) {
+    put16(buf, val >> 16);
+    put16(buf, val & 0xFFFF);
+}
+
+} // anonymous namespace
+
+#ifdef RFB_SUPPORTED
+
+bool RfbServer::start(const std::string& addr, int port)
+{
+    if (this->running)
+        return true;
+
+    sockaddr_in sa = {};
+    sa.sin_family = AF_INET;
+    sa.sin_port   = htons(port);
+
+    if (inet_pton(AF_INET, addr.c_str(), &sa.sin_addr) != 1) {
+        LOG_F(ERROR, "RFB: invalid address %s", addr.c_str());
+        return false;
+    }
+
+    this->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (this->listen_fd < 0) {
+        LOG_F(ERROR, "RFB: socket create error: %s", strerror(errno));
+        return false;
+    }
+
+    int one = 1;
+    setsockopt(this->listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    if (bind(this->listen_fd, (sockaddr*)&sa, sizeof(sa)) < 0 ||
+        listen(this->listen_fd, 1) < 0 || pipe(this->wake_fds) < 0) {
+        LOG_F(ERROR, "RFB: can't listen on %s:%d: %s", addr.c_str(), port, strerror(errno));
+        close(this->listen_fd);
+        this->listen_fd = -1;
+        return false;
+    }
+
+    fcntl(this->wake_fds[0], F_SETFL, O_NONBLOCK);
+
+    this->running = true;
+    this->thread  = std::thread(&RfbServer::server_thread, this);
+
+    // input events are delivered at the Macintosh polling rate
+    this->input_timer = TimerManager::get_instance()->add_cyclic_timer(
+        MSECS_TO_NSECS(11), [this]() {
+            this->poll_input();
+    });
+
+    gProfilerObj->register_profile("RFB",
+        std::unique_ptr<BaseProfile>(new RfbProfile()));
+
+    LOG_F(INFO, "RFB: listening on %s:%d", addr.c_str(), port);
+
+    return true;
+}
+
+void RfbServer::stop()
+{
+    if (!this->running)
+        return;
+
+    this->running = false;
+
+    if (write(this->wake_fds[1], "q", 1) < 0)
+        LOG_F(WARNING, "RFB: can't wake up the server thread");
+
+    this->thread.join();
+
+    TimerManager::get_instance()->cancel_timer(this->input_timer);
+
+    close(this->listen_fd);
+    close(this->wake_fds[0]);
+    close(this->wake_fds[1]);
+
+    this->listen_fd = -1;
+}
+
+void RfbServer::end_frame()
+{
+    this->frame_ready = true;
+    this->want_frame  = false;
+    this->frame_mutex.unlock();
+
+    if (write(this->wake_fds[1], "f", 1) < 0)
+        LOG_F(WARNING, "RFB: can't wake up the server thread");
+}
+
+void RfbServer::server_thread()
+{
+    while (this->running) {
+        pollfd fds[2] = {{this->listen_fd, POLLIN, 0}, {this->wake_fds[0], POLLIN, 0}};
+
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            LOG_F(ERROR, "RFB: poll error: %s", strerror(errno));
+            break;
+        }
+
+        if (fds[1].revents & POLLIN) {
+            char dummy[64];
+            while (read(this->wake_fds[0], dummy, sizeof(dummy)) > 0) {}
+        }
+
+        if (fds[0].revents & POLLIN) {
+            int fd = accept(this->listen_fd, nullptr, nullptr);
+            if (fd >= 0) {
+                this->serve_client(fd);
+                close(fd);
+            }
+        }
+    }
+}
+
+void RfbServer::serve_client(int fd)
+{
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+#ifdef SO_NOSIGPIPE
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+
+    this->num_clients++;
+
+    LOG_F(INFO, "RFB: client connected");
+
+    if (!this->handshake(fd)) {
+        LOG_F(WARNING, "RFB: handshake failed");
+        this->want_frame = false;
+        return;
+    }
+
+    while (this->running) {
+        pollfd fds[2] = {{fd, POLLIN, 0}, {this->wake_fds[0], POLLIN, 0}};
+
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+
+        if (fds[1].revents & POLLIN) {
+            char dummy[64];
+            while (read(this->wake_fds[0], dummy, sizeof(dummy)) > 0) {}
+        }
+
+        if (fds[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+            if (!this->handle_messages(fd))
+                break;
+        }
+
+        bool have_frame = false;
+
+        {
+            std::lock_guard<std::mutex> lock(this->frame_mutex);
+            if (this->frame_ready) {
+                std::swap(this->cur_fb, this->shared_fb);
+                this->fb_width    = this->shared_width;
+                this->fb_height   = this->shared_height;
+                this->frame_ready = false;
+                have_frame        = true;
+            }
+        }
+
+        if (have_frame && this->update_requested && !this->send_update(fd))
+            break;
+
+        // incremental requests stay pending until something changes
+        if (this->update_requested)
+            this->want_frame = true;
+    }
+
+    this->want_frame = false;
+
+    LOG_F(INFO, "RFB: client disconnected");
+}
+
+bool RfbServer::handshake(int fd)
+{
+    uint8_t buf[24];
+
+    if (!send_all(fd, (const uint8_t*)"RFB 003.008\n", 12) || !recv_exact(fd, buf, 12) ||
+        memcmp(buf, "RFB 003.", 8))
+        return false;
+
+    int minor = (buf[8] - '0') * 100 + (buf[9] - '0') * 10 + (buf[10] - '0');
+
+    if (minor >= 7) {
+        // one security type: None
+        const uint8_t sec_types[2] = {1, 1};
+        if (!send_all(fd, sec_types, 2) || !recv_exact(fd, buf, 1) || buf[0] != 1)
+            return false;
+        if (minor >= 8) {
+            const uint8_t sec_result[4] = {0, 0, 0, 0};
+            if (!send_all(fd, sec_result, 4))
+                return false;
+        }
+    } else {
+        const uint8_t sec_type[4] = {0, 0, 0, 1};
+        if (!send_all(fd, sec_type, 4))
+            return false;
+    }
+
+    // ClientInit, the shared flag doesn't matter with a single client
+    if (!recv_exact(fd, buf, 1))
+        return false;
+
+    // ask for a frame to learn the current screen size
+    this->want_frame = true;
+
+    pollfd pfd = {this->wake_fds[0], POLLIN, 0};
+    poll(&pfd, 1, 1000);
+
+    {
+        std::lock_guard<std::mutex> lock(this->frame_mutex);
+        if (this->frame_ready) {
+            std::swap(this->cur_fb, this->shared_fb);
+            this->fb_width    = this->shared_width;
+            this->fb_height   = this->shared_height;
+            this->frame_ready = false;
+        } else if (!this->fb_width) {
+            this->fb_width  = 640;
+            this->fb_height = 480;
+        }
+        this->cur_fb.resize((size_t)this->fb_width * this->fb_height * 4);
+    }
+
+    this->want_frame       = false;
+    this->client_width     = this->fb_width;
+    this->client_height    = this->fb_height;
+    this->update_requested = false;
+    this->full_update      = true;
+    this->use_hextile      = false;
+    this->desktop_size     = false;
+    this->sent_fb.clear();
+    this->in_buf.clear();
+    this->set_pixel_format(native_fmt);
+
+    const char* name = "DingusPPC";
+
+    this->out_buf.clear();
+    put16(this->out_buf, this->fb_width);
+    put16(this->out_buf, this->fb_height);
+    this->out_buf.push_back(native_fmt.bpp);
+    this->out_buf.push_back(native_fmt.depth);
+    this->out_buf.push_back(native_fmt.big_endian);
+    this->out_buf.push_back(native_fmt.true_color);
+    put16(this->out_buf, native_fmt.red_max);
+    put16(this->out_buf, native_fmt.green_max);
+    put16(this->out_buf, native_fmt.blue_max);
+    this->out_buf.push_back(native_fmt.red_shift);
+    this->out_buf.push_back(native_fmt.green_shift);
+    this->out_buf.push_back(native_fmt.blue_shift);
+    this->out_buf.insert(this->out_buf.end(), 3, 0);
+    put32(this->out_buf, (uint32_t)strlen(name));
+    this->out_buf.insert(this->out_buf.end(), name, name + strlen(name));
+
+    return send_all(fd, this->out_buf.data(), this->out_buf.size());
+}
+
+bool RfbServer::handle_messages(int fd)
+{
+    uint8_t buf[4096];
+
+    ssize_t got = recv(fd, buf, sizeof(buf), MSG_DONTWAIT);
+    if (got == 0 || (got < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+        return false;
+
+    if (got > 0)
+        this->in_buf.insert(this->in_buf.end(), buf, buf + got);
+
+    size_t pos = 0;
+
+    while (pos < this->in_buf.size()) {
+        const uint8_t* msg = &this->in_buf[pos];
+        size_t avail = this->in_buf.size() - pos;
+        size_t need;
+
+        switch (msg[0]) {
+        case 0: { // SetPixelFormat
+            need = 20;
+            if (avail < need)
+                goto done;
+
+            PixelFormat fmt;
+            fmt.bpp         = msg[4];
+            fmt.depth       = msg[5];
+            fmt.big_endian  = !!msg[6];
+            fmt.true_color  = !!msg[7];
+            fmt.red_max     = READ_WORD_BE_U(&msg[8]);
+            fmt.green_max   = READ_WORD_BE_U(&msg[10]);
+            fmt.blue_max    = READ_WORD_BE_U(&msg[12]);
+            fmt.red_shift   = msg[14];
+            fmt.green_shift = msg[15];
+            fmt.blue_shift  = msg[16];
+
+            if (!fmt.true_color || (fmt.bpp != 8 && fmt.bpp != 16 && fmt.bpp != 32)) {
+                LOG_F(WARNING, "RFB: unsupported pixel format (%d bpp, true color %d)",
+                      fmt.bpp, fmt.true_color);
+                return false;
+            }
+            this->set_pixel_format(fmt);
+            this->full_update = true;
+            break;
+        }
+        case 2: { // SetEncodings
+            if (avail < 4)
+                goto done;
+            int num_encs = READ_WORD_BE_U(&msg[2]);
+            need = 4 + num_encs * 4;
+            if (avail < need)
+                goto done;
+
+            this->use_hextile  = false;
+            this->desktop_size = false;
+
+            for (int i = 0; i < num_encs; i++) {
+                int32_t enc = READ_DWORD_BE_U(&msg[4 + i * 4]);
+                if (enc == ENC_HEXTILE)
+                    this->use_hextile = true;
+                else if (enc == ENC_DESKTOP_SIZE)
+                    this->desktop_size = true;
+            }
+            break;
+        }
+        case 3: // FramebufferUpdateRequest
+            need = 10;
+            if (avail < need)
+                goto done;
+            this->update_requested = true;
+            if (!msg[1])
+                this->full_update = true;
+            break;
+        case 4: { // KeyEvent
+            need = 8;
+            if (avail < need)
+                goto done;
+            std::lock_guard<std::mutex> lock(this->input_mutex);
+            this->input_queue.push_back(
+                {true, !!msg[1], uint32_t(READ_DWORD_BE_U(&msg[4])), 0, 0, 0});
+            break;
+        }
+        case 5: { // PointerEvent
+            need = 6;
+            if (avail < need)
+                goto done;
+            std::lock_guard<std::mutex> lock(this->input_mutex);
+            this->input_queue.push_back({false, false, 0, msg[1],
+                                         READ_WORD_BE_U(&msg[2]), READ_WORD_BE_U(&msg[4])});
+            break;
+        }
+        case 6: { // ClientCutText, ignored
+            if (avail < 8)
+                goto done;
+            uint32_t len = READ_DWORD_BE_U(&msg[4]);
+            if (len > MAX_CUT_TEXT)
+                return false;
+            need = 8 + len;
+            if (avail < need)
+                goto done;
+            break;
+        }
+        default:
+            LOG_F(WARNING, "RFB: unknown client message type %d", msg[0]);
+            return false;
+        }
+
+        pos += need;
+    }
+
+done:
+    this->in_buf.erase(this->in_buf.begin(), this->in_buf.begin() + pos);
+
+    return true;
+}
+
+#else // RFB_SUPPORTED
+
+bool RfbServer::start(const std::string& addr, int port)
+{
+    LOG_F(ERROR, "RFB: not supported on this platform");
+    return false;
+}
+
+void RfbServer::stop()
+{
+}
+
+void RfbServer::end_frame()
+{
+    this->want_frame = false;
+    this->frame_mutex.unlock();
+}
+
+#endif // RFB_SUPPORTED
+
+uint8_t* RfbServer::begin_frame(int width, int height, int& pitch)
+{
+    this->frame_mutex.lock();
+
+    this->shared_width  = width;
+    this->shared_height = height;
+    this->shared_fb.resize((size_t)width * height * 4);
+
+    pitch = width * 4;
+
+    return this->shared_fb.data();
+}
+
+void RfbServer::set_pixel_format(const PixelFormat& fmt)
+{
+    this->pix_fmt = fmt;
+
+    this->native = fmt.bpp == 32 && !fmt.big_endian && fmt.red_max == 255 &&
+                   fmt.green_max == 255 && fmt.blue_max == 255 && fmt.red_shift == 16 &&
+                   fmt.green_shift == 8 && fmt.blue_shift == 0;
+
+    for (int i = 0; i < 256; i++) {
+        this->red_lut[i]   = ((i * fmt.red_max   + 127) / 255) << fmt.red_shift;
+        this->green_lut[i] = ((i * fmt.green_max + 127) / 255) << fmt.green_shift;
+        this->blue_lut[i]  = ((i * fmt.blue_max  + 127) / 255) << fmt.blue_shift;
+    }
+}
+
+void RfbServer::put_pixel(uint32_t argb)
+{
+    if (this->native) {
+        this->out_buf.push_back(argb & 0xFF);
+        this->out_buf.push_back((argb >> 8) & 0xFF);
+        this->out_buf.push_back((argb >> 16) & 0xFF);
+        this->out_buf.push_back(0);
+        return;
+    }
+
+    uint32_t val = this->red_lut[(argb >> 16) & 0xFF] | this->green_lut[(argb >> 8) & 0xFF] |
+                   this->blue_lut[argb & 0xFF];
+
+    int num_bytes = this->pix_fmt.bpp >> 3;
+
+    for (int i = 0; i < num_bytes; i++) {
+        int shift = this->pix_fmt.big_endian ? (num_bytes - 1 - i) * 8 : i * 8;
+        this->out_buf.push_back((val >> shift) & 0xFF);
+    }
+}
+
+bool RfbServer::tile_dirty(int tx, int ty)
+{
+    if (this->full_update || this->sent_fb.size() != this->cur_fb.size())
+        return true;
+
+    int x = tx * TILE_SIZE;
+    int w = std::min(TILE_SIZE, this->fb_width - x) * 4;
+    int y_end = std::min((ty + 1) * TILE_SIZE, this->fb_height);
+
+    for (int y = ty * TILE_SIZE; y < y_end; y++) {
+        size_t offset = ((size_t)y * this->fb_width + x) * 4;
+        if (memcmp(&this->cur_fb[offset], &this->sent_fb[offset], w))
+            return true;
+    }
+
+    return false;
+}
+
+void RfbServer::encode_raw(int x, int y, int w, int h)
+{
+    for (int row = y; row < y + h; row++) {
+        const uint8_t* src = &this->cur_fb[((size_t)row * this->fb_width + x) * 4];
+        for (int col = 0; col < w; col++, src += 4)
+            this->put_pixel(READ_DWORD_LE_A(src));
+    }
+}
+
+void RfbServer::encode_hextile(int x, int y, int w, int h)
+{
+    uint32_t px[TILE_SIZE * TILE_SIZE];
+    bool     covered[TILE_SIZE * TILE_SIZE];
+    uint32_t last_bg  = 0;
+    bool     bg_valid = false;
+
+    int pix_bytes = this->pix_fmt.bpp >> 3;
+
+    struct Subrect { uint32_t color; uint8_t xy, wh; };
+    std::vector<Subrect> subrects;
+
+    for (int ty = y; ty < y + h; ty += TILE_SIZE) {
+        int th = std::min(TILE_SIZE, y + h - ty);
+
+        for (int tx = x; tx < x + w; tx += TILE_SIZE) {
+            int tw = std::min(TILE_SIZE, x + w - tx);
+
+            for (int row = 0; row < th; row++) {
+                const uint8_t* src = &this->cur_fb[((size_t)(ty + row) * this->fb_width + tx) * 4];
+                for (int col = 0; col < tw; col++, src += 4)
+                    px[row * tw + col] = READ_DWORD_LE_A(src) & 0xFFFFFFU;
+            }
+
+            int      num_px = tw * th;
+            uint32_t bg     = px[0];
+            uint32_t fg     = bg;
+            bool     mono   = true;
+
+            for (int i = 1; i < num_px; i++) {
+                if (px[i] == bg || px[i] == fg)
+                    continue;
+                if (fg == bg)
+                    fg = px[i];
+                else
+                    mono = false;
+            }
+
+            if (fg == bg) { // solid tile
+                if (bg_valid && bg == last_bg) {
+                    this->out_buf.push_back(0);
+                } else {
+                    this->out_buf.push_back(HT_BG_SPECIFIED);
+                    this->put_pixel(bg);
+                    last_bg  = bg;
+                    bg_valid = true;
+                }
+                continue;
+            }
+
+            // cover everything but the background with single color rectangles
+            subrects.clear();
+            std::fill(covered, covered + num_px, false);
+
+            for (int row = 0; row < th; row++) {
+                for (int col = 0; col < tw; col++) {
+                    int i = row * tw + col;
+                    if (covered[i] || px[i] == bg)
+                        continue;
+
+                    uint32_t c = px[i];
+                    int col_end = col + 1;
+                    while (col_end < tw && px[row * tw + col_end] == c &&
+                           !covered[row * tw + col_end])
+                        col_end++;
+
+                    int row_end = row + 1;
+                    for (; row_end < th; row_end++) {
+                        bool same = true;
+                        for (int k = col; k < col_end && same; k++)
+                            same = px[row_end * tw + k] == c && !covered[row_end * tw + k];
+                        if (!same)
+                            break;
+                    }
+
+                    for (int r = row; r < row_end; r++)
+                        std::fill(&covered[r * tw + col], &covered[r * tw + col_end], true);
+
+                    subrects.push_back({c, uint8_t((col << 4) | row),
+                        uint8_t(((col_end - col - 1) << 4) | (row_end - row - 1))});
+                }
+            }
+
+            bool   new_bg   = !bg_valid || bg != last_bg;
+            size_t enc_size = 2 + (new_bg ? pix_bytes : 0) + (mono ? pix_bytes : 0) +
+                              subrects.size() * (mono ? 2 : pix_bytes + 2);
+
+            if (subrects.size() > 255 || enc_size >= 1 + (size_t)num_px * pix_bytes) {
+                this->out_buf.push_back(HT_RAW);
+                for (int i = 0; i < num_px; i++)
+                    this->put_pixel(px[i]);
+                bg_valid = false; // undefined after a raw tile
+                continue;
+            }
+
+            this->out_buf.push_back((new_bg ? HT_BG_SPECIFIED : 0) |
+                                    (mono ? HT_FG_SPECIFIED : HT_SUBRECTS_COLORED) |
+                                    HT_ANY_SUBRECTS);
+            if (new_bg)
+                this->put_pixel(bg);
+            if (mono)
+                this->put_pixel(fg);
+            this->out_buf.push_back((uint8_t)subrects.size());
+
+            for (auto& sr : subrects) {
+                if (!mono)
+                    this->put_pixel(sr.color);
+                this->out_buf.push_back(sr.xy);
+                this->out_buf.push_back(sr.wh);
+            }
+
+            last_bg  = bg;
+            bg_valid = true;
+        }
+    }
+}
+
+#ifdef RFB_SUPPORTED
+
+bool RfbServer::send_update(int fd)
+{
+    this->out_buf.clear();
+
+    if (this->fb_width != this->client_width || this->fb_height != this->client_height) {
+        if (!this->desktop_size) {
+            LOG_F(WARNING, "RFB: client can't follow the screen size change to %dx%d",
+                  this->fb_width, this->fb_height);
+            return false;
+        }
+
+        this->out_buf = {0, 0, 0, 1, 0, 0, 0, 0};
+        put16(this->out_buf, this->fb_width);
+        put16(this->out_buf, this->fb_height);
+        put32(this->out_buf, (uint32_t)ENC_DESKTOP_SIZE);
+
+        this->client_width     = this->fb_width;
+        this->client_height    = this->fb_height;
+        this->full_update      = true;
+        this->update_requested = false;
+
+        return send_all(fd, this->out_buf.data(), this->out_buf.size());
+    }
+
+    // coalesce horizontal runs of changed tiles into rectangles
+    struct Run { int x, y, w, h; };
+    std::vector<Run> runs;
+
+    int tiles_x = (this->fb_width  + TILE_SIZE - 1) / TILE_SIZE;
+    int tiles_y = (this->fb_height + TILE_SIZE - 1) / TILE_SIZE;
+
+    for (int ty = 0; ty < tiles_y; ty++) {
+        for (int tx = 0; tx < tiles_x; tx++) {
+            if (!this->tile_dirty(tx, ty))
+                continue;
+
+            int x = tx * TILE_SIZE;
+            int y = ty * TILE_SIZE;
+            int h = std::min(TILE_SIZE, this->fb_height - y);
+
+            if (!runs.empty() && runs.back().y == y && runs.back().x + runs.back().w == x)
+                runs.back().w += std::min(TILE_SIZE, this->fb_width - x);
+            else
+                runs.push_back({x, y, std::min(TILE_SIZE, this->fb_width - x), h});
+
+            this->num_tiles++;
+        }
+    }
+
+    if (runs.empty())
+        return true;
+
+    this->out_buf = {0, 0};
+    put16(this->out_buf, (uint16_t)runs.size());
+
+    for (auto& run : runs) {
+        put16(this->out_buf, run.x);
+        put16(this->out_buf, run.y);
+        put16(this->out_buf, run.w);
+        put16(this->out_buf, run.h);
+        put32(this->out_buf, this->use_hextile ? ENC_HEXTILE : ENC_RAW);
+
+        if (this->use_hextile)
+            this->encode_hextile(run.x, run.y, run.w, run.h);
+        else
+            this->encode_raw(run.x, run.y, run.w, run.h);
+    }
+
+    if (!send_all(fd, this->out_buf.data(), this->out_buf.size()))
+        return false;
+
+    this->sent_fb          = this->cur_fb;
+    this->full_update      = false;
+    this->update_requested = false;
+
+    this->num_updates++;
+    this->num_bytes += this->out_buf.size();
+
+    return true;
+}
+
+#endif // RFB_SUPPORTED
+
+void RfbServer::poll_input()
+{
+    std::deque<InputEvent> events;
+
+    {
+        std::lock_guard<std::mutex> lock(this->input_mutex);
+        events.swap(this->input_queue);
+    }
+
+    EventManager* event_mgr = EventManager::get_instance();
+
+    for (auto& event : events) {
+        if (event.is_key) {
+            int key_code = keysym_to_adb(event.keysym);
+            if (key_code < 0) {
+                LOG_F(WARNING, "RFB: unknown keysym 0x%X", event.keysym);
+                continue;
+            }
+
+            KeyboardEvent ke;
+            ke.key   = key_code;
+            ke.flags = event.down ? KEYBOARD_EVENT_DOWN : KEYBOARD_EVENT_UP;
+
+            // Caps Lock is a toggle key for the guest but not for RFB clients
+            if (key_code == AdbKey_CapsLock) {
+                if (!event.down)
+                    continue;
+                this->caps_lock = !this->caps_lock;
+                ke.flags = this->caps_lock ? KEYBOARD_EVENT_DOWN : KEYBOARD_EVENT_UP;
+            }
+
+            event_mgr->post_keyboard_event(ke);
+            continue;
+        }
+
+        // the guest only knows relative mouse motion
+        if (event.x != this->ptr_x || event.y != this->ptr_y) {
+            MouseEvent me;
+            me.flags = MOUSE_EVENT_MOTION;
+            me.xrel  = event.x - this->ptr_x;
+            me.yrel  = event.y - this->ptr_y;
+            event_mgr->post_mouse_event(me);
+
+            this->ptr_x = event.x;
+            this->ptr_y = event.y;
+        }
+
+        if ((event.buttons ^ this->ptr_buttons) & 1) {
+            MouseEvent me;
+            me.flags         = MOUSE_EVENT_BUTTON;
+            me.buttons_state = event.buttons & 1;
+            event_mgr->post_mouse_event(me);
+        }
+
+        this->ptr_buttons = event.buttons;
+    }
+}
+
+void RfbProfile::populate_variables(std::vector<ProfileVar>& vars)
+{
+    RfbServer* rfb = RfbServer::get_instance();
+
+    vars.clear();
+
+    vars.push_back({.name = "Clients served",
+                    .format = ProfileVarFmt::DEC,
+                    .value = rfb->num_clients});
+
+    vars.push_back({.name = "Updates sent",
+                    .format = ProfileVarFmt::DEC,
+                    .value = rfb->num_updates});
+
+    vars.push_back({.name = "Tiles sent",
+                    .format = ProfileVarFmt::DEC,
+                    .value = rfb->num_tiles});
+
+    vars.push_back({.name = "Bytes sent",
+                    .format = ProfileVarFmt::DEC,
+                    .value = rfb->num_bytes});
+}
+
+void RfbProfile::reset()
+{
+    RfbServer* rfb = RfbServer::get_instance();
+
+    rfb->num_updates = 0;
+    rfb->num_tiles   = 0;
+    rfb->num_bytes   = 0;
+}
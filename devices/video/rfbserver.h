@@ -0,0 +1,169 @@
+/*
+DingusPPC - The Experimental PowerPC Macintosh emulator
+Copyright (C) 2018-23 divingkatae and maximum
+                      (theweirdo)     spatium
+
+(Contact divingkatae#1017 or powermax#2286 on Discord for more info)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file Built-in RFB (VNC) server.
+
+    The server runs in its own thread and serves one client at a time.
+    When the client asks for an update, the video controller converts its
+    next frame into a shared ARGB8888 buffer (see VideoCtrlBase::update_screen).
+    The server thread compares it to the last frame sent in 16x16 tiles
+    and sends the changed tiles only, using the Hextile or Raw encoding
+    in the pixel format requested by the client.
+
+    Keyboard and pointer events are queued by the server thread and
+    delivered to the ADB devices through the EventManager on the emulator
+    thread. Without a client, nothing is converted or copied.
+ */
+
+#ifndef RFB_SERVER_H
+#define RFB_SERVER_H
+
+#include <utils/profiler.h>
+
+#include <atomic>
+#include <cinttypes>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Rfb {
+
+typedef struct PixelFormat {
+    uint8_t     bpp;
+    uint8_t     depth;
+    bool        big_endian;
+    bool        true_color;
+    uint16_t    red_max, green_max, blue_max;
+    uint8_t     red_shift, green_shift, blue_shift;
+} PixelFormat;
+
+typedef struct InputEvent {
+    bool        is_key;
+    bool        down;       // key events only
+    uint32_t    keysym;     // key events only
+    uint8_t     buttons;    // pointer events only
+    int         x, y;       // pointer events only
+} InputEvent;
+
+enum Encoding : int32_t {
+    ENC_RAW         = 0,
+    ENC_HEXTILE     = 5,
+    ENC_DESKTOP_SIZE = -223,
+};
+
+}; // namespace Rfb
+
+class RfbServer {
+public:
+    static RfbServer* get_instance() {
+        if (!rfb_server_obj) {
+            rfb_server_obj = new RfbServer();
+        }
+        return rfb_server_obj;
+    };
+
+    bool start(const std::string& addr, int port);
+    void stop();
+
+    // called by the video controller on the emulator thread
+    bool frame_wanted() const {
+        return this->want_frame.load(std::memory_order_relaxed);
+    };
+    uint8_t* begin_frame(int width, int height, int& pitch);
+    void     end_frame();
+
+    // statistics
+    uint64_t num_clients = 0;
+    uint64_t num_updates = 0;
+    uint64_t num_tiles   = 0;
+    uint64_t num_bytes   = 0;
+
+private:
+    RfbServer() {};  // private constructor to implement a singleton
+
+    void server_thread();
+    void serve_client(int fd);
+    bool handshake(int fd);
+    bool handle_messages(int fd);
+    bool send_update(int fd);
+    void poll_input();
+
+    // pixel encoding
+    void set_pixel_format(const Rfb::PixelFormat& fmt);
+    void put_pixel(uint32_t argb);
+    void encode_raw(int x, int y, int w, int h);
+    void encode_hextile(int x, int y, int w, int h);
+    bool tile_dirty(int tx, int ty);
+
+    static RfbServer* rfb_server_obj;
+
+    int             listen_fd   = -1;
+    int             wake_fds[2] = {-1, -1};
+    std::thread     thread;
+    std::atomic<bool> running{false};
+    std::atomic<bool> want_frame{false};
+
+    // frame handed over by the emulator thread
+    std::mutex              frame_mutex;
+    std::vector<uint8_t>    shared_fb;
+    int                     shared_width  = 0;
+    int                     shared_height = 0;
+    bool                    frame_ready   = false;
+
+    // server thread state
+    std::vector<uint8_t>    cur_fb;     // frame being sent
+    std::vector<uint8_t>    sent_fb;    // what the client displays
+    int                     fb_width  = 0;
+    int                     fb_height = 0;
+    int                     client_width  = 0;  // size known to the client
+    int                     client_height = 0;
+    Rfb::PixelFormat        pix_fmt;
+    bool                    native = true;      // pix_fmt matches our frames
+    uint32_t                red_lut[256], green_lut[256], blue_lut[256];
+    bool                    use_hextile  = false;
+    bool                    desktop_size = false;
+    bool                    update_requested = false;
+    bool                    full_update  = false;
+    std::vector<uint8_t>    in_buf;
+    std::vector<uint8_t>    out_buf;
+
+    // input events, drained on the emulator thread
+    std::mutex              input_mutex;
+    std::deque<Rfb::InputEvent> input_queue;
+    uint32_t                input_timer = 0;
+    int                     ptr_x = 0, ptr_y = 0;
+    uint8_t                 ptr_buttons = 0;
+    bool                    caps_lock = false;
+};
+
+/** Profile showing the RFB server traffic. */
+class RfbProfile : public BaseProfile {
+public:
+    RfbProfile() : BaseProfile("RFB") {};
+
+    void populate_variables(std::vector<ProfileVar>& vars);
+
+    void reset(void);
+};
+
+#endif // RFB_SERVER_H
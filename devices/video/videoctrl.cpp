@@ -22,11 +22,15 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 /** @file Video Conroller base class implementation. */
 
 #include <core/timermanager.h>
+#include <cpu/ppc/ppcemu.h>
 #include <devices/common/hwinterrupt.h>
+#include <devices/video/rfbserver.h>
 #include <devices/video/videoctrl.h>
 #include <memaccess.h>
 
+#include <algorithm>
 #include <cinttypes>
+#include <cstring>
 
 VideoCtrlBase::VideoCtrlBase(int width, int height)
 {
@@ -62,11 +66,45 @@ void VideoCtrlBase::blank_display() {
 
 void VideoCtrlBase::update_screen()
 {
+    RfbServer* rfb = RfbServer::get_instance();
+
+    // hand a full frame to the RFB server when its client asks for one
+    if (rfb->frame_wanted() && this->active_width > 0 && this->active_height > 0) {
+        int      pitch;
+        uint8_t* buf = rfb->begin_frame(this->active_width, this->active_height, pitch);
+
+        if (this->blank_on || this->convert_fb_cb == nullptr) {
+            std::memset(buf, 0, pitch * this->active_height);
+        } else {
+            this->convert_fb_cb(buf, pitch);
+            if (this->cursor_ovl_cb != nullptr)
+                this->cursor_ovl_cb(buf, pitch);
+        }
+
+        rfb->end_frame();
+    }
+
     if (this->blank_on) {
         this->display.blank();
         return;
     }
 
+    if (this->damage_tracking && this->convert_rect_cb != nullptr) {
+        if (!this->full_damage) {
+            for (auto& rect : this->damage_rects)
+                this->num_pixels_converted += rect.w * rect.h;
+            this->num_rect_updates += this->damage_rects.size();
+            this->display.update_rects(this->convert_rect_cb, this->damage_rects);
+            this->damage_rects.clear();
+            return;
+        }
+        this->full_damage = false;
+        this->damage_rects.clear();
+    }
+
+    this->num_full_updates++;
+    this->num_pixels_converted += this->active_width * this->active_height;
+
     int cursor_x = 0;
     int cursor_y = 0;
     if (this->cursor_on) {
@@ -83,6 +121,10 @@ void VideoCtrlBase::start_refresh_task() {
     this->refresh_task_id = TimerManager::get_instance()->add_cyclic_timer(
         refresh_interval,
         [this]() {
+            // the display is powered down while the CPU sleeps
+            if (ppc_power_mode == PowerMode::SLEEP)
+                return;
+
             // assert VBL interrupt
             this->vbl_cb(1);
             this->update_screen();
@@ -110,6 +152,48 @@ void VideoCtrlBase::stop_refresh_task() {
     }
 }
 
+#define MAX_DAMAGE_RECTS 32
+
+void VideoCtrlBase::add_damage_rect(int x, int y, int width, int height)
+{
+    if (this->full_damage)
+        return;
+
+    // clip to the visible area
+    int right  = std::min(x + width,  this->active_width);
+    int bottom = std::min(y + height, this->active_height);
+    x = std::max(x, 0);
+    y = std::max(y, 0);
+    if (right <= x || bottom <= y)
+        return;
+
+    DisplayRect new_rect = {x, y, right - x, bottom - y};
+
+    // merge with an overlapping or adjacent rectangle when the union
+    // doesn't add much area that would be converted needlessly
+    for (auto& rect : this->damage_rects) {
+        int ux1 = std::min(rect.x, new_rect.x);
+        int uy1 = std::min(rect.y, new_rect.y);
+        int ux2 = std::max(rect.x + rect.w, new_rect.x + new_rect.w);
+        int uy2 = std::max(rect.y + rect.h, new_rect.y + new_rect.h);
+
+        int union_area = (ux2 - ux1) * (uy2 - uy1);
+        int sum_area   = rect.w * rect.h + new_rect.w * new_rect.h;
+
+        if (union_area <= sum_area + sum_area / 4) {
+            rect = {ux1, uy1, ux2 - ux1, uy2 - uy1};
+            return;
+        }
+    }
+
+    if (this->damage_rects.size() >= MAX_DAMAGE_RECTS) {
+        this->full_damage = true;
+        return;
+    }
+
+    this->damage_rects.push_back(new_rect);
+}
+
 void VideoCtrlBase::get_palette_colors(uint8_t index, uint8_t& r, uint8_t& g,
                                        uint8_t& b, uint8_t& a)
 {
@@ -435,3 +519,60 @@ void VideoCtrlBase::convert_frame_32bpp_BE(uint8_t *dst_buf, int dst_pitch)
         dst_row = (uint32_t*)((uint8_t*)dst_row + dst_pitch);
     }
 }
+
+void VideoCtrlBase::convert_rect_8bpp_indexed(uint8_t *dst_buf, int dst_pitch,
+                                              const DisplayRect& rect)
+{
+    uint8_t *src_row = this->fb_ptr + rect.y * this->fb_pitch + rect.x;
+
+    for (int h = 0; h < rect.h; h++) {
+        uint8_t *src = src_row;
+        uint8_t *dst = dst_buf;
+        for (int x = rect.w; x > 0; x--) {
+            WRITE_DWORD_LE_A(dst, this->palette[*src++]);
+            dst += 4;
+        }
+        src_row += this->fb_pitch;
+        dst_buf += dst_pitch;
+    }
+}
+
+void VideoCtrlBase::convert_rect_15bpp_BE(uint8_t *dst_buf, int dst_pitch,
+                                          const DisplayRect& rect)
+{
+    uint8_t *src_row = this->fb_ptr + rect.y * this->fb_pitch + rect.x * 2;
+
+    for (int h = 0; h < rect.h; h++) {
+        uint8_t *src = src_row;
+        uint8_t *dst = dst_buf;
+        for (int x = rect.w; x > 0; x--) {
+            uint32_t c = READ_WORD_BE_A(src);
+            uint32_t r = ((c << 9) & 0x00F80000) | ((c << 4) & 0x00070000);
+            uint32_t g = ((c << 6) & 0x0000F800) | ((c << 1) & 0x00000700);
+            uint32_t b = ((c << 3) & 0x000000F8) | ((c >> 2) & 0x00000007);
+            WRITE_DWORD_LE_A(dst, r | g | b);
+            src += 2;
+            dst += 4;
+        }
+        src_row += this->fb_pitch;
+        dst_buf += dst_pitch;
+    }
+}
+
+void VideoCtrlBase::convert_rect_32bpp_BE(uint8_t *dst_buf, int dst_pitch,
+                                          const DisplayRect& rect)
+{
+    uint8_t *src_row = this->fb_ptr + rect.y * this->fb_pitch + rect.x * 4;
+
+    for (int h = 0; h < rect.h; h++) {
+        uint8_t *src = src_row;
+        uint8_t *dst = dst_buf;
+        for (int x = rect.w; x > 0; x--) {
+            WRITE_DWORD_LE_A(dst, READ_DWORD_BE_A(src));
+            src += 4;
+            dst += 4;
+        }
+        src_row += this->fb_pitch;
+        dst_buf += dst_pitch;
+    }
+}
@@ -29,6 +29,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include <cinttypes>
 #include <functional>
+#include <vector>
 
 class WindowEvent;
 
@@ -45,6 +46,11 @@ public:
     void start_refresh_task();
     void stop_refresh_task();
 
+    // damage tracking: with damage_tracking on, refreshes convert
+    // only the screen areas reported since the last refresh
+    void add_damage_rect(int x, int y, int width, int height);
+    void set_full_damage() { this->full_damage = true; };
+
     void get_palette_colors(uint8_t index, uint8_t& r, uint8_t& g, uint8_t& b,
                             uint8_t& a);
     void set_palette_color(uint8_t index, uint8_t r, uint8_t g, uint8_t b, uint8_t a);
@@ -70,6 +76,19 @@ public:
     virtual void convert_frame_32bpp(uint8_t *dst_buf, int dst_pitch);
     virtual void convert_frame_32bpp_BE(uint8_t *dst_buf, int dst_pitch);
 
+    // converters for partial updates
+    virtual void convert_rect_8bpp_indexed(uint8_t *dst_buf, int dst_pitch,
+                                           const DisplayRect& rect);
+    virtual void convert_rect_15bpp_BE(uint8_t *dst_buf, int dst_pitch,
+                                       const DisplayRect& rect);
+    virtual void convert_rect_32bpp_BE(uint8_t *dst_buf, int dst_pitch,
+                                       const DisplayRect& rect);
+
+    // refresh statistics
+    uint64_t    num_full_updates = 0;
+    uint64_t    num_rect_updates = 0;
+    uint64_t    num_pixels_converted = 0;
+
 protected:
     // CRT controller parameters
     bool        crtc_on = false;
@@ -103,6 +122,13 @@ protected:
 
     std::function<void(uint8_t *dst_buf, int dst_pitch)> convert_fb_cb = nullptr;
     std::function<void(uint8_t *dst_buf, int dst_pitch)> cursor_ovl_cb = nullptr;
+    std::function<void(uint8_t *dst_buf, int dst_pitch,
+                       const DisplayRect& rect)> convert_rect_cb = nullptr;
+
+    // damage tracking
+    bool        damage_tracking = false;
+    bool        full_damage     = true;
+    std::vector<DisplayRect> damage_rects;
 
 private:
     Display display;
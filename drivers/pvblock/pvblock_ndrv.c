@@ -0,0 +1,393 @@
+/*
+DingusPPC - The Experimental PowerPC Macintosh emulator
+Copyright (C) 2018-23 divingkatae and maximum
+                      (theweirdo)     spatium
+
+(Contact divingkatae#1017 or powermax#2286 on Discord for more info)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file Mac OS native (NDRV) driver for the paravirtual block device.
+
+    Build as a PEF shared library exporting TheDriverDescription and
+    DoDriverIO against DriverServicesLib, NameRegistryLib and InterfaceLib
+    (Universal Interfaces 3.x), name the result pvblock_ndrv.pef and
+    tokenize pvblock.fth to get an expansion ROM carrying this driver.
+
+    Every Device Manager request is split into physically contiguous
+    extents that are submitted as one batch with a single doorbell write.
+    The device completes the batch before the doorbell write returns,
+    so the driver runs fully synchronously and keeps interrupts disabled.
+ */
+
+#include <Devices.h>
+#include <Disks.h>
+#include <DriverGestalt.h>
+#include <DriverServices.h>
+#include <Events.h>
+#include <Files.h>
+#include <NameRegistry.h>
+
+/* Must match devices/storage/pvblock.h */
+enum {
+    kRegMagic       = 0x00,
+    kRegCapacityHi  = 0x08,
+    kRegCapacityLo  = 0x0C,
+    kRegRingBase    = 0x14,
+    kRegRingSize    = 0x18,
+    kRegControl     = 0x1C,
+    kRegDoorbell    = 0x20,
+
+    kPvBlockMagic   = 0x50564253,
+    kCtrlEnable     = 1,
+
+    kOpRead         = 0,
+    kOpWrite        = 1,
+    kStatusOK       = 1,
+
+    kBlockSize      = 512,
+    kNumDescs       = 64,
+    kMaxPages       = kNumDescs - 1
+};
+
+typedef struct PvDesc {
+    UInt8   opcode;
+    UInt8   status;
+    UInt16  reserved1;
+    UInt32  numBlocks;
+    UInt32  lbaHi;
+    UInt32  lbaLo;
+    UInt32  bufAddr;
+    UInt32  reserved2;
+    UInt32  cookieHi;
+    UInt32  cookieLo;
+} PvDesc;
+
+typedef struct PvRing {
+    PvDesc  desc[kNumDescs];
+    UInt32  usedIdx;
+} PvRing;
+
+typedef struct DriverGlobals {
+    volatile UInt32*    regs;
+    PvRing*             ring;
+    IOPreparationTable  ringPrep;
+    PhysicalAddress     ringPhys;
+    UInt32              prodIdx;
+    UInt32              numBlocks;
+    DriverRefNum        refNum;
+    DrvSts2*            drvSts;
+} DriverGlobals;
+
+static DriverGlobals gPv;
+
+DriverDescription TheDriverDescription = {
+    kTheDescriptionSignature,
+    kInitialDriverDescriptor,
+    { "\ppvblock", { 0x01, 0x00, 0x80, 0x00 } },
+    { kDriverIsLoadedUponDiscovery | kDriverIsOpenedUponLoad, "\p.pvblock" },
+    { 1, { { kServiceCategoryNdrvDriver, kNdrvTypeIsBlockStorage,
+             { 0x01, 0x00, 0x80, 0x00 } } } }
+};
+
+static UInt32 RegRead(UInt32 offset)
+{
+    return gPv.regs[offset >> 2];
+}
+
+static void RegWrite(UInt32 offset, UInt32 value)
+{
+    gPv.regs[offset >> 2] = value;
+    SynchronizeIO();
+}
+
+static OSStatus MapRegisters(RegEntryIDPtr entry)
+{
+    LogicalAddress  addrs[6];
+    RegPropertyValueSize size = sizeof(addrs);
+    OSStatus        err;
+
+    /* Open Firmware publishes logical addresses of the assigned BARs */
+    err = RegistryPropertyGet(entry, "AAPL,address", addrs, &size);
+    if (err != noErr || size < sizeof(LogicalAddress))
+        return paramErr;
+
+    gPv.regs = (volatile UInt32*)addrs[0];
+
+    return (RegRead(kRegMagic) == kPvBlockMagic) ? noErr : nsDrvErr;
+}
+
+static OSStatus SetupRing(void)
+{
+    OSStatus err;
+
+    gPv.ring = (PvRing*)MemAllocatePhysicallyContiguous(sizeof(PvRing), true);
+    if (gPv.ring == NULL)
+        return memFullErr;
+
+    gPv.ringPrep.options           = kIOIsInput | kIOIsOutput | kIOLogicalRanges;
+    gPv.ringPrep.addressSpace      = kCurrentAddressSpaceID;
+    gPv.ringPrep.granularity       = 0;
+    gPv.ringPrep.firstPrepared     = 0;
+    gPv.ringPrep.mappingEntryCount = 1;
+    gPv.ringPrep.logicalMapping    = NULL;
+    gPv.ringPrep.physicalMapping   = &gPv.ringPhys;
+    gPv.ringPrep.rangeInfo.range.base   = gPv.ring;
+    gPv.ringPrep.rangeInfo.range.length = sizeof(PvRing);
+
+    err = PrepareMemoryForIO(&gPv.ringPrep);
+    if (err != noErr)
+        return err;
+
+    gPv.prodIdx = 0;
+
+    RegWrite(kRegRingBase, (UInt32)gPv.ringPhys);
+    RegWrite(kRegRingSize, kNumDescs);
+    RegWrite(kRegControl,  kCtrlEnable);
+
+    return noErr;
+}
+
+/* Transfer a block-aligned buffer by submitting one descriptor
+   per physically contiguous extent in a single batch. */
+static OSStatus TransferBlocks(UInt8 opcode, void* buffer, UInt32 startBlock,
+                               UInt32 numBytes)
+{
+    IOPreparationTable  prep;
+    PhysicalAddress     physMap[kMaxPages];
+    UInt32              pageSize = GetLogicalPageSize();
+    UInt32              firstIdx, idx, lba, done, extent, physStart, i;
+    OSStatus            err;
+
+    while (numBytes) {
+        UInt32 chunk = numBytes;
+        if (chunk > (kMaxPages - 1) * pageSize)
+            chunk = (kMaxPages - 1) * pageSize;
+
+        prep.options           = kIOLogicalRanges |
+                                 ((opcode == kOpRead) ? kIOIsInput : kIOIsOutput);
+        prep.addressSpace      = kCurrentAddressSpaceID;
+        prep.granularity       = 0;
+        prep.firstPrepared     = 0;
+        prep.mappingEntryCount = kMaxPages;
+        prep.logicalMapping    = NULL;
+        prep.physicalMapping   = physMap;
+        prep.rangeInfo.range.base   = buffer;
+        prep.rangeInfo.range.length = chunk;
+
+        err = PrepareMemoryForIO(&prep);
+        if (err != noErr)
+            return err;
+
+        chunk    = prep.lengthPrepared;
+        firstIdx = gPv.prodIdx;
+        lba      = startBlock;
+        done     = 0;
+        i        = 0;
+
+        /* merge physically adjacent pages into extents; the first mapping
+           entry points to the first byte, the following ones to page starts */
+        while (done < chunk) {
+            physStart = (UInt32)physMap[i];
+            extent    = pageSize - (physStart & (pageSize - 1));
+
+            while (done + extent < chunk && i + 1 < prep.mappingEntryCount &&
+                   (UInt32)physMap[i + 1] == physStart + extent) {
+                i++;
+                extent += pageSize;
+            }
+
+            if (done + extent > chunk)
+                extent = chunk - done;
+
+            /* extents must cover whole blocks */
+            if (extent % kBlockSize) {
+                CheckpointIO(prep.preparationID, kNilOptions);
+                return paramErr;
+            }
+
+            idx = gPv.prodIdx++ & (kNumDescs - 1);
+            gPv.ring->desc[idx].opcode    = opcode;
+            gPv.ring->desc[idx].status    = 0;
+            gPv.ring->desc[idx].numBlocks = extent / kBlockSize;
+            gPv.ring->desc[idx].lbaHi     = 0;
+            gPv.ring->desc[idx].lbaLo     = lba;
+            gPv.ring->desc[idx].bufAddr   = physStart;
+
+            lba  += extent / kBlockSize;
+            done += extent;
+            i++;
+        }
+
+        /* one doorbell for the whole batch */
+        RegWrite(kRegDoorbell, gPv.prodIdx);
+
+        CheckpointIO(prep.preparationID, kNilOptions);
+
+        for (idx = firstIdx; idx != gPv.prodIdx; idx++) {
+            if (gPv.ring->desc[idx & (kNumDescs - 1)].status != kStatusOK)
+                return ioErr;
+        }
+
+        buffer      = (UInt8*)buffer + chunk;
+        startBlock += chunk / kBlockSize;
+        numBytes   -= chunk;
+    }
+
+    return noErr;
+}
+
+static OSStatus DoReadWrite(ParmBlkPtr pb, UInt8 opcode)
+{
+    UInt64  pos;
+    UInt32  count = pb->ioParam.ioReqCount;
+    OSStatus err;
+
+    if (pb->ioParam.ioPosMode & kWidePosOffsetBit)
+        pos = ((XIOParamPtr)pb)->ioWPosOffset;
+    else
+        pos = (UInt32)pb->ioParam.ioPosOffset;
+
+    pb->ioParam.ioActCount = 0;
+
+    if ((pos % kBlockSize) || (count % kBlockSize))
+        return paramErr;
+    if (pos / kBlockSize + count / kBlockSize > gPv.numBlocks)
+        return (opcode == kOpRead) ? eofErr : dskFulErr;
+
+    err = TransferBlocks(opcode, pb->ioParam.ioBuffer, (UInt32)(pos / kBlockSize), count);
+    if (err == noErr)
+        pb->ioParam.ioActCount = count;
+
+    return err;
+}
+
+static OSStatus DoControl(CntrlParam* pb)
+{
+    switch (pb->csCode) {
+    case kVerify:
+    case kEject:
+        return noErr;
+    default:
+        return controlErr;
+    }
+}
+
+static OSStatus DoStatus(CntrlParam* pb)
+{
+    DriverGestaltParam* gp = (DriverGestaltParam*)pb;
+
+    switch (pb->csCode) {
+    case kDriveStatus:
+        BlockMoveData(gPv.drvSts, &pb->csParam, sizeof(DrvSts));
+        return noErr;
+    case kDriverGestaltCode:
+        switch (gp->driverGestaltSelector) {
+        case kdgSync:
+            GetDriverGestaltBooleanResponse(gp)->value = true;
+            return noErr;
+        case kdgDeviceType:
+            GetDriverGestaltDevTResponse(gp)->deviceType = kdgDiskType;
+            return noErr;
+        case kdgInterface:
+            GetDriverGestaltIntfResponse(gp)->interfaceType = kdgPCIIntf;
+            return noErr;
+        }
+        return statusErr;
+    default:
+        return statusErr;
+    }
+}
+
+static OSStatus DoInitialize(DriverInitInfoPtr info)
+{
+    OSStatus err;
+
+    gPv.refNum = info->refNum;
+
+    err = MapRegisters(&info->deviceEntry);
+    if (err != noErr)
+        return err;
+
+    gPv.numBlocks = RegRead(kRegCapacityLo);
+    if (RegRead(kRegCapacityHi))
+        gPv.numBlocks = 0xFFFFFFFFUL;
+
+    err = SetupRing();
+    if (err != noErr)
+        return err;
+
+    /* publish the disk to the File Manager */
+    gPv.drvSts = (DrvSts2*)PoolAllocateResident(sizeof(DrvSts2), true);
+    if (gPv.drvSts == NULL)
+        return memFullErr;
+
+    gPv.drvSts->driveSize   = gPv.numBlocks & 0xFFFF;
+    gPv.drvSts->driveS1     = gPv.numBlocks >> 16;
+    gPv.drvSts->qType       = 1; /* driveSize fields are valid */
+    gPv.drvSts->installed   = 1;
+    gPv.drvSts->diskInPlace = 8; /* non-ejectable */
+
+    AddDrive(gPv.refNum, 8, (DrvQEl*)&gPv.drvSts->qLink);
+    PostEvent(diskEvt, 8);
+
+    return noErr;
+}
+
+OSStatus DoDriverIO(AddressSpaceID spaceID, IOCommandID ioCommandID,
+                    IOCommandContents contents, IOCommandCode code,
+                    IOCommandKind kind)
+{
+    OSStatus err;
+
+    switch (code) {
+    case kInitializeCommand:
+    case kReplaceCommand:
+        err = DoInitialize(contents.initialInfo);
+        break;
+    case kFinalizeCommand:
+    case kSupersededCommand:
+        RegWrite(kRegControl, 0);
+        CheckpointIO(gPv.ringPrep.preparationID, kNilOptions);
+        err = noErr;
+        break;
+    case kOpenCommand:
+    case kCloseCommand:
+        err = noErr;
+        break;
+    case kReadCommand:
+        err = DoReadWrite(contents.pb, kOpRead);
+        break;
+    case kWriteCommand:
+        err = DoReadWrite(contents.pb, kOpWrite);
+        break;
+    case kControlCommand:
+        err = DoControl((CntrlParam*)contents.pb);
+        break;
+    case kStatusCommand:
+        err = DoStatus((CntrlParam*)contents.pb);
+        break;
+    case kKillIOCommand:
+        err = noErr; /* requests never stay queued */
+        break;
+    default:
+        err = paramErr;
+    }
+
+    if (kind & kImmediateIOCommandKind)
+        return err;
+
+    return IOCommandIsComplete(ioCommandID, err);
+}
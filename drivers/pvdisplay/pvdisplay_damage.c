@@ -0,0 +1,295 @@
+/*
+DingusPPC - The Experimental PowerPC Macintosh emulator
+Copyright (C) 2018-23 divingkatae and maximum
+                      (theweirdo)     spatium
+
+(Contact divingkatae#1017 or powermax#2286 on Discord for more info)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file Mac OS extension reporting QuickDraw damage to the paravirtual display.
+
+    Build as an accelerated INIT resource (PowerPC code fragment behind a
+    routine descriptor, loaded into the system heap) and put it into the
+    Extensions folder together with the pvdisplay NDRV.
+
+    The extension patches the QuickDraw bottleneck traps. After every drawing
+    call that targets the PvDisplay framebuffer it clips the affected area
+    against the port's visible and clip regions and reports the result in
+    screen coordinates straight to the device registers. Once the patches
+    are in place it asks the driver to switch the device into damage mode.
+    Applications writing into the framebuffer directly bypass QuickDraw and
+    must be run with the extension disabled.
+ */
+
+#include <Devices.h>
+#include <Fonts.h>
+#include <MixedMode.h>
+#include <Patches.h>
+#include <QuickDraw.h>
+#include <Traps.h>
+#include <Video.h>
+
+/* Must match pvdisplay_ndrv.c */
+enum {
+    kRegDamagePos       = 0x48,
+    kRegDamageSize      = 0x4C,
+
+    cscPvSetDamageMode  = 0x5000,
+    cscPvGetRegisters   = 0x5000
+};
+
+enum {
+    uppScrollRectProcInfo = kPascalStackBased
+        | STACK_ROUTINE_PARAMETER(1, SIZE_CODE(sizeof(const Rect*)))
+        | STACK_ROUTINE_PARAMETER(2, SIZE_CODE(sizeof(short)))
+        | STACK_ROUTINE_PARAMETER(3, SIZE_CODE(sizeof(short)))
+        | STACK_ROUTINE_PARAMETER(4, SIZE_CODE(sizeof(RgnHandle)))
+};
+
+static volatile UInt32* gRegs;
+static Ptr              gFbBase;
+static Rect             gScreenRect;
+
+static QDTextUPP    gOldStdText;
+static QDLineUPP    gOldStdLine;
+static QDRectUPP    gOldStdRect;
+static QDRRectUPP   gOldStdRRect;
+static QDOvalUPP    gOldStdOval;
+static QDArcUPP     gOldStdArc;
+static QDPolyUPP    gOldStdPoly;
+static QDRgnUPP     gOldStdRgn;
+static QDBitsUPP    gOldStdBits;
+static UniversalProcPtr gOldScrollRect;
+
+/* Reports a rectangle given in local coordinates of the current port. */
+static void ReportLocalRect(const Rect* localRect)
+{
+    GrafPtr port;
+    Ptr     baseAddr;
+    Rect    bounds, r;
+
+    GetPort(&port);
+
+    if ((port->portBits.rowBytes & 0xC000) == 0xC000) {
+        PixMapHandle pm = ((CGrafPtr)port)->portPixMap;
+        baseAddr = (**pm).baseAddr;
+        bounds   = (**pm).bounds;
+    } else {
+        baseAddr = port->portBits.baseAddr;
+        bounds   = port->portBits.bounds;
+    }
+
+    /* off-screen drawing doesn't concern the display */
+    if (baseAddr != gFbBase)
+        return;
+
+    if (!SectRect(localRect, &(**port->visRgn).rgnBBox, &r))
+        return;
+    if (!SectRect(&r, &(**port->clipRgn).rgnBBox, &r))
+        return;
+
+    /* local -> global -> framebuffer coordinates */
+    OffsetRect(&r, -bounds.left - gScreenRect.left, -bounds.top - gScreenRect.top);
+    if (r.left < 0)
+        r.left = 0;
+    if (r.top < 0)
+        r.top = 0;
+    if (r.right <= r.left || r.bottom <= r.top)
+        return;
+
+    gRegs[kRegDamagePos >> 2]  = ((UInt32)r.left << 16) | (UInt16)r.top;
+    gRegs[kRegDamageSize >> 2] = ((UInt32)(r.right - r.left) << 16) |
+                                 (UInt16)(r.bottom - r.top);
+}
+
+/* Frames extend past the rectangle by the pen size. */
+static void ReportShape(GrafVerb verb, const Rect* r)
+{
+    GrafPtr port;
+    Rect    area = *r;
+
+    if (verb == kQDGrafVerbFrame) {
+        GetPort(&port);
+        area.right  += port->pnSize.h;
+        area.bottom += port->pnSize.v;
+    }
+
+    ReportLocalRect(&area);
+}
+
+static pascal void MyStdText(short count, const void* textAddr, Point numer, Point denom)
+{
+    GrafPtr  port;
+    FontInfo info;
+    Rect     r;
+    short    width;
+
+    GetPort(&port);
+    GetFontInfo(&info);
+    width = TextWidth(textAddr, 0, count);
+    if (denom.h)
+        width = (short)((long)width * numer.h / denom.h);
+
+    /* leave room for italic overhang and outline styles */
+    r.left   = port->pnLoc.h - info.widMax / 2;
+    r.right  = port->pnLoc.h + width + info.widMax / 2;
+    r.top    = port->pnLoc.v - info.ascent;
+    r.bottom = port->pnLoc.v + info.descent + 1;
+
+    CallQDTextProc(gOldStdText, count, textAddr, numer, denom);
+
+    ReportLocalRect(&r);
+}
+
+static pascal void MyStdLine(Point newPt)
+{
+    GrafPtr port;
+    Rect    r;
+
+    GetPort(&port);
+    Pt2Rect(port->pnLoc, newPt, &r);
+    r.right  += port->pnSize.h;
+    r.bottom += port->pnSize.v;
+
+    CallQDLineProc(gOldStdLine, newPt);
+
+    ReportLocalRect(&r);
+}
+
+static pascal void MyStdRect(GrafVerb verb, const Rect* r)
+{
+    CallQDRectProc(gOldStdRect, verb, r);
+    ReportShape(verb, r);
+}
+
+static pascal void MyStdRRect(GrafVerb verb, const Rect* r, short ovalWidth,
+                              short ovalHeight)
+{
+    CallQDRRectProc(gOldStdRRect, verb, r, ovalWidth, ovalHeight);
+    ReportShape(verb, r);
+}
+
+static pascal void MyStdOval(GrafVerb verb, const Rect* r)
+{
+    CallQDOvalProc(gOldStdOval, verb, r);
+    ReportShape(verb, r);
+}
+
+static pascal void MyStdArc(GrafVerb verb, const Rect* r, short startAngle,
+                            short arcAngle)
+{
+    CallQDArcProc(gOldStdArc, verb, r, startAngle, arcAngle);
+    ReportShape(verb, r);
+}
+
+static pascal void MyStdPoly(GrafVerb verb, PolyHandle poly)
+{
+    Rect r = (**poly).polyBBox;
+
+    CallQDPolyProc(gOldStdPoly, verb, poly);
+    ReportShape(verb, &r);
+}
+
+static pascal void MyStdRgn(GrafVerb verb, RgnHandle rgn)
+{
+    Rect r = (**rgn).rgnBBox;
+
+    CallQDRgnProc(gOldStdRgn, verb, rgn);
+    ReportShape(verb, &r);
+}
+
+static pascal void MyStdBits(const BitMap* srcBits, const Rect* srcRect,
+                             const Rect* dstRect, short mode, RgnHandle maskRgn)
+{
+    Rect r = *dstRect;
+
+    CallQDBitsProc(gOldStdBits, srcBits, srcRect, dstRect, mode, maskRgn);
+    ReportLocalRect(&r);
+}
+
+static pascal void MyScrollRect(const Rect* r, short dh, short dv, RgnHandle updateRgn)
+{
+    Rect area = *r;
+
+    CallUniversalProc(gOldScrollRect, uppScrollRectProcInfo, r, dh, dv, updateRgn);
+    ReportLocalRect(&area);
+}
+
+static RoutineDescriptor gStdTextRD   = BUILD_ROUTINE_DESCRIPTOR(uppQDTextProcInfo, MyStdText);
+static RoutineDescriptor gStdLineRD   = BUILD_ROUTINE_DESCRIPTOR(uppQDLineProcInfo, MyStdLine);
+static RoutineDescriptor gStdRectRD   = BUILD_ROUTINE_DESCRIPTOR(uppQDRectProcInfo, MyStdRect);
+static RoutineDescriptor gStdRRectRD  = BUILD_ROUTINE_DESCRIPTOR(uppQDRRectProcInfo, MyStdRRect);
+static RoutineDescriptor gStdOvalRD   = BUILD_ROUTINE_DESCRIPTOR(uppQDOvalProcInfo, MyStdOval);
+static RoutineDescriptor gStdArcRD    = BUILD_ROUTINE_DESCRIPTOR(uppQDArcProcInfo, MyStdArc);
+static RoutineDescriptor gStdPolyRD   = BUILD_ROUTINE_DESCRIPTOR(uppQDPolyProcInfo, MyStdPoly);
+static RoutineDescriptor gStdRgnRD    = BUILD_ROUTINE_DESCRIPTOR(uppQDRgnProcInfo, MyStdRgn);
+static RoutineDescriptor gStdBitsRD   = BUILD_ROUTINE_DESCRIPTOR(uppQDBitsProcInfo, MyStdBits);
+static RoutineDescriptor gScrollRectRD = BUILD_ROUTINE_DESCRIPTOR(uppScrollRectProcInfo, MyScrollRect);
+
+static UniversalProcPtr Patch(short trap, RoutineDescriptor* rd)
+{
+    UniversalProcPtr old = NGetTrapAddress(trap, ToolTrap);
+
+    NSetTrapAddress((UniversalProcPtr)rd, trap, ToolTrap);
+
+    return old;
+}
+
+/* Looks for the screen driven by the pvdisplay driver. */
+static GDHandle FindPvDisplay(short* refNum)
+{
+    GDHandle    gd;
+    CntrlParam  pb;
+
+    for (gd = GetDeviceList(); gd != NULL; gd = GetNextDevice(gd)) {
+        pb.ioCRefNum = (**gd).gdRefNum;
+        pb.csCode    = cscPvGetRegisters;
+        if (PBStatusSync((ParmBlkPtr)&pb) == noErr) {
+            gRegs   = *(volatile UInt32**)&pb.csParam;
+            *refNum = (**gd).gdRefNum;
+            return gd;
+        }
+    }
+
+    return NULL;
+}
+
+void main(void)
+{
+    GDHandle    gd;
+    short       refNum;
+    Boolean     enable = true;
+
+    gd = FindPvDisplay(&refNum);
+    if (gd == NULL)
+        return;
+
+    gFbBase     = (**(**gd).gdPMap).baseAddr;
+    gScreenRect = (**gd).gdRect;
+
+    gOldStdText    = (QDTextUPP)Patch(_StdText, &gStdTextRD);
+    gOldStdLine    = (QDLineUPP)Patch(_StdLine, &gStdLineRD);
+    gOldStdRect    = (QDRectUPP)Patch(_StdRect, &gStdRectRD);
+    gOldStdRRect   = (QDRRectUPP)Patch(_StdRRect, &gStdRRectRD);
+    gOldStdOval    = (QDOvalUPP)Patch(_StdOval, &gStdOvalRD);
+    gOldStdArc     = (QDArcUPP)Patch(_StdArc, &gStdArcRD);
+    gOldStdPoly    = (QDPolyUPP)Patch(_StdPoly, &gStdPolyRD);
+    gOldStdRgn     = (QDRgnUPP)Patch(_StdRgn, &gStdRgnRD);
+    gOldStdBits    = (QDBitsUPP)Patch(_StdBits, &gStdBitsRD);
+    gOldScrollRect = Patch(_ScrollRect, &gScrollRectRD);
+
+    Control(refNum, cscPvSetDamageMode, &enable);
+}
@@ -0,0 +1,584 @@
+/*
+DingusPPC - The Experimental PowerPC Macintosh emulator
+Copyright (C) 2018-23 divingkatae and maximum
+                      (theweirdo)     spatium
+
+(Contact divingkatae#1017 or powermax#2286 on Discord for more info)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file Mac OS native (NDRV) display driver for the paravirtual display.
+
+    Build as a PEF shared library exporting TheDriverDescription and
+    DoDriverIO against DriverServicesLib, NameRegistryLib, VideoServicesLib
+    and InterfaceLib (Universal Interfaces 3.x), name the result
+    pvdisplay_ndrv.pef and tokenize pvdisplay.fth to get an expansion ROM
+    carrying this driver.
+
+    Besides the standard video driver calls the driver implements private
+    calls used by the damage reporting extension (pvdisplay_damage.c).
+    Until that extension enables damage mode the host refreshes the whole
+    screen on every frame. In damage mode the VBL interrupt handler also
+    reports the area of the cursor, which the Cursor Manager draws straight
+    into the framebuffer.
+ */
+
+#include <Devices.h>
+#include <DriverGestalt.h>
+#include <DriverServices.h>
+#include <Interrupts.h>
+#include <NameRegistry.h>
+#include <Video.h>
+#include <VideoServices.h>
+
+/* Must match devices/video/pvdisplay.h */
+enum {
+    kRegMagic       = 0x00,
+    kRegVramSize    = 0x08,
+    kRegNumModes    = 0x0C,
+    kRegModeSelect  = 0x10,
+    kRegModeWidth   = 0x14,
+    kRegModeHeight  = 0x18,
+    kRegModeDepths  = 0x1C,
+    kRegWidth       = 0x20,
+    kRegHeight      = 0x24,
+    kRegDepth       = 0x28,
+    kRegPitch       = 0x2C,
+    kRegFbOffset    = 0x30,
+    kRegControl     = 0x34,
+    kRegSetMode     = 0x38,
+    kRegIntStatus   = 0x3C,
+    kRegClutIndex   = 0x40,
+    kRegClutData    = 0x44,
+    kRegDamagePos   = 0x48,
+    kRegDamageSize  = 0x4C,
+
+    kPvDisplayMagic = 0x50564642,
+
+    kCtrlDisplayOn  = 1,
+    kCtrlDamage     = 2,
+    kCtrlVblInt     = 4,
+
+    kIntVbl         = 1
+};
+
+/* Private control and status codes shared with pvdisplay_damage.c */
+enum {
+    cscPvSetDamageMode  = 0x5000,   /* csParam: Boolean enable */
+    cscPvGetRegisters   = 0x5000    /* csParam: volatile UInt32* */
+};
+
+/* Low memory globals of the Cursor Manager */
+#define LMCrsrRect  ((volatile Rect*)0x083C)
+
+typedef struct DriverGlobals {
+    volatile UInt32*    regs;
+    UInt8*              fbBase;
+    RegEntryID          regEntry;
+    InterruptSetMember  istMember;
+    void*               istRefCon;
+    InterruptHandler    oldHandler;
+    InterruptEnabler    oldEnabler;
+    InterruptDisabler   oldDisabler;
+    InterruptServiceIDType vblService;
+    DisplayModeID       curMode;
+    DepthMode           curDepth;
+    UInt16              curPage;
+    Boolean             vblEnabled;
+    Boolean             damageMode;
+    Boolean             grayMode;
+    Rect                lastCursor;
+    UInt32              numModes;
+} DriverGlobals;
+
+static DriverGlobals gPv;
+
+DriverDescription TheDriverDescription = {
+    kTheDescriptionSignature,
+    kInitialDriverDescriptor,
+    { "\ppvdisplay", { 0x01, 0x00, 0x80, 0x00 } },
+    { kDriverIsLoadedUponDiscovery | kDriverIsOpenedUponLoad, "\p.Display_Video_PvDisplay" },
+    { 1, { { kServiceCategoryNdrvDriver, kNdrvTypeIsVideo,
+             { 0x01, 0x00, 0x80, 0x00 } } } }
+};
+
+static UInt32 RegRead(UInt32 offset)
+{
+    return gPv.regs[offset >> 2];
+}
+
+static void RegWrite(UInt32 offset, UInt32 value)
+{
+    gPv.regs[offset >> 2] = value;
+    SynchronizeIO();
+}
+
+/* Display mode IDs are mode list indices plus one. */
+static Boolean GetModeSize(DisplayModeID mode, UInt32* width, UInt32* height,
+                           UInt32* depths)
+{
+    if (mode < 1 || mode > gPv.numModes)
+        return false;
+
+    RegWrite(kRegModeSelect, mode - 1);
+    *width  = RegRead(kRegModeWidth);
+    *height = RegRead(kRegModeHeight);
+    *depths = RegRead(kRegModeDepths);
+
+    return true;
+}
+
+static UInt32 DepthToBits(DepthMode depth)
+{
+    switch (depth) {
+    case kDepthMode1: return 8;
+    case kDepthMode2: return 16;
+    default:          return 32;
+    }
+}
+
+static OSStatus SetMode(DisplayModeID mode, DepthMode depth, UInt16 page)
+{
+    UInt32 width, height, depths;
+
+    if (page != 0 || depth < kDepthMode1 || depth > kDepthMode3)
+        return paramErr;
+    if (!GetModeSize(mode, &width, &height, &depths))
+        return paramErr;
+    if (!(depths & (1 << (depth - kDepthMode1))))
+        return paramErr;
+
+    RegWrite(kRegWidth, width);
+    RegWrite(kRegHeight, height);
+    RegWrite(kRegDepth, DepthToBits(depth));
+    RegWrite(kRegFbOffset, 0);
+    RegWrite(kRegSetMode, 1);
+    if (RegRead(kRegSetMode))
+        return paramErr;
+
+    gPv.curMode  = mode;
+    gPv.curDepth = depth;
+    gPv.curPage  = page;
+
+    return noErr;
+}
+
+static void UpdateControl(void)
+{
+    UInt32 ctrl = kCtrlDisplayOn;
+
+    if (gPv.damageMode)
+        ctrl |= kCtrlDamage;
+    if (gPv.vblEnabled)
+        ctrl |= kCtrlVblInt;
+
+    RegWrite(kRegControl, ctrl);
+}
+
+static void ReportDamage(const Rect* r)
+{
+    if (r->right <= r->left || r->bottom <= r->top)
+        return;
+
+    RegWrite(kRegDamagePos, ((UInt32)(UInt16)r->left << 16) | (UInt16)r->top);
+    RegWrite(kRegDamageSize, ((UInt32)(r->right - r->left) << 16) |
+                             (UInt16)(r->bottom - r->top));
+}
+
+static InterruptMemberNumber VblInterruptHandler(InterruptSetMember member,
+                                                 void* refCon, UInt32 count)
+{
+    Rect cursor;
+
+    if (!(RegRead(kRegIntStatus) & kIntVbl))
+        return kIsrIsNotComplete;
+
+    RegWrite(kRegIntStatus, kIntVbl);
+
+    /* the cursor moved since the last VBL: both areas need refreshing */
+    if (gPv.damageMode) {
+        cursor = *LMCrsrRect;
+        if (*(UInt32*)&cursor != *(UInt32*)&gPv.lastCursor ||
+            *((UInt32*)&cursor + 1) != *((UInt32*)&gPv.lastCursor + 1)) {
+            /* the interrupted code may be halfway through its own report */
+            UInt32 savedPos = RegRead(kRegDamagePos);
+            ReportDamage(&gPv.lastCursor);
+            ReportDamage(&cursor);
+            RegWrite(kRegDamagePos, savedPos);
+            gPv.lastCursor = cursor;
+        }
+    }
+
+    if (gPv.vblService)
+        VSLDoInterruptService(gPv.vblService);
+
+    return kIsrIsComplete;
+}
+
+static void VblInterruptEnabler(InterruptSetMember member, void* refCon)
+{
+}
+
+static Boolean VblInterruptDisabler(InterruptSetMember member, void* refCon)
+{
+    return true;
+}
+
+static OSStatus InstallVblInterrupt(void)
+{
+    RegPropertyValueSize size = sizeof(gPv.istMember);
+    OSStatus err;
+
+    err = RegistryPropertyGet(&gPv.regEntry, "driver-ist", &gPv.istMember, &size);
+    if (err != noErr)
+        return err;
+
+    err = GetInterruptFunctions(gPv.istMember.setID, gPv.istMember.member,
+                                &gPv.istRefCon, &gPv.oldHandler,
+                                &gPv.oldEnabler, &gPv.oldDisabler);
+    if (err != noErr)
+        return err;
+
+    err = InstallInterruptFunctions(gPv.istMember.setID, gPv.istMember.member,
+                                    NULL, VblInterruptHandler,
+                                    VblInterruptEnabler, VblInterruptDisabler);
+    if (err != noErr)
+        return err;
+
+    return VSLNewInterruptService(&gPv.regEntry, kVBLInterruptServiceType,
+                                  &gPv.vblService);
+}
+
+static OSStatus MapRegisters(RegEntryIDPtr entry)
+{
+    LogicalAddress  addrs[6];
+    RegPropertyValueSize size = sizeof(addrs);
+    OSStatus        err;
+
+    /* Open Firmware publishes logical addresses of the assigned BARs */
+    err = RegistryPropertyGet(entry, "AAPL,address", addrs, &size);
+    if (err != noErr || size < 2 * sizeof(LogicalAddress))
+        return paramErr;
+
+    gPv.regs   = (volatile UInt32*)addrs[0];
+    gPv.fbBase = (UInt8*)addrs[1];
+
+    return (RegRead(kRegMagic) == kPvDisplayMagic) ? noErr : nsDrvErr;
+}
+
+static OSStatus SetEntries(VDSetEntryRecord* rec, Boolean direct)
+{
+    ColorSpec*  table = rec->csTable;
+    SInt16      i, index;
+
+    if (table == NULL)
+        return paramErr;
+    if (direct != (gPv.curDepth != kDepthMode1))
+        return controlErr;
+
+    for (i = 0; i <= rec->csCount; i++) {
+        index = (rec->csStart == -1) ? table[i].value : rec->csStart + i;
+        RegWrite(kRegClutIndex, index & 0xFF);
+
+        if (gPv.grayMode) {
+            /* NTSC luminance weights */
+            UInt32 y = ((UInt32)table[i].rgb.red * 30 +
+                        (UInt32)table[i].rgb.green * 59 +
+                        (UInt32)table[i].rgb.blue * 11) / 100;
+            RegWrite(kRegClutData, ((y >> 8) << 16) | ((y >> 8) << 8) | (y >> 8));
+        } else {
+            RegWrite(kRegClutData, ((UInt32)(table[i].rgb.red   >> 8) << 16) |
+                                   ((UInt32)(table[i].rgb.green >> 8) << 8)  |
+                                    (UInt32)(table[i].rgb.blue  >> 8));
+        }
+    }
+
+    return noErr;
+}
+
+static OSStatus GrayPage(void)
+{
+    UInt32  rowBytes = RegRead(kRegPitch);
+    UInt32  height   = RegRead(kRegHeight);
+    UInt32  bits     = DepthToBits(gPv.curDepth);
+    UInt32  white    = (bits == 8) ? 0 : (bits == 16) ? 0x7FFF : 0x00FFFFFF;
+    UInt32  black    = (bits == 8) ? 0xFF : 0;
+    UInt32  pattern, x, y;
+    Rect    screen;
+
+    /* 50% dither of alternating black and white pixels */
+    pattern = (bits == 32) ? white : (bits == 16) ? (white << 16) | black :
+              (white << 24) | (black << 16) | (white << 8) | black;
+
+    for (y = 0; y < height; y++) {
+        UInt32* row = (UInt32*)(gPv.fbBase + y * rowBytes);
+        UInt32  rowPat = pattern;
+        if ((y & 1) != (bits == 32))
+            rowPat = (bits == 32) ? black : (pattern << bits) | (pattern >> (32 - bits));
+        for (x = 0; x < rowBytes / 4; x++) {
+            row[x] = rowPat;
+            if (bits == 32)
+                rowPat ^= white;
+        }
+    }
+
+    screen.top    = 0;
+    screen.left   = 0;
+    screen.bottom = height;
+    screen.right  = RegRead(kRegWidth);
+    if (gPv.damageMode)
+        ReportDamage(&screen);
+
+    return noErr;
+}
+
+static OSStatus DoControl(CntrlParam* pb)
+{
+    void* param = *(void**)&pb->csParam;
+
+    switch (pb->csCode) {
+    case cscReset:
+    case cscKillIO:
+        return noErr;
+    case cscSetMode: {
+        VDPageInfo* info = (VDPageInfo*)param;
+        OSStatus err = SetMode(gPv.curMode, (DepthMode)info->csMode, info->csPage);
+        info->csBaseAddr = gPv.fbBase;
+        return err;
+    }
+    case cscSwitchMode: {
+        VDSwitchInfoRec* info = (VDSwitchInfoRec*)param;
+        OSStatus err = SetMode(info->csData, (DepthMode)info->csMode, info->csPage);
+        info->csBaseAddr = gPv.fbBase;
+        return err;
+    }
+    case cscSetEntries:
+        return SetEntries((VDSetEntryRecord*)param, false);
+    case cscDirectSetEntries:
+        return SetEntries((VDSetEntryRecord*)param, true);
+    case cscSetGamma:
+        return noErr; /* the host applies its own gamma */
+    case cscGrayPage:
+        return GrayPage();
+    case cscSetGray:
+        gPv.grayMode = ((VDGrayRecord*)param)->csMode != 0;
+        return noErr;
+    case cscSetInterrupt:
+        gPv.vblEnabled = ((VDFlagRecord*)param)->csMode == 0;
+        UpdateControl();
+        return noErr;
+    case cscPvSetDamageMode:
+        gPv.damageMode = *(Boolean*)&pb->csParam != 0;
+        gPv.lastCursor = *LMCrsrRect;
+        UpdateControl();
+        return noErr;
+    default:
+        return controlErr;
+    }
+}
+
+static OSStatus DoStatus(CntrlParam* pb)
+{
+    void*   param = *(void**)&pb->csParam;
+    UInt32  width, height, depths;
+
+    switch (pb->csCode) {
+    case cscGetMode:
+    case cscGetPageCnt:
+    case cscGetPageBase: {
+        VDPageInfo* info = (VDPageInfo*)param;
+        info->csMode     = gPv.curDepth;
+        info->csData     = 0;
+        info->csPage     = (pb->csCode == cscGetPageCnt) ? 1 : gPv.curPage;
+        info->csBaseAddr = gPv.fbBase;
+        return noErr;
+    }
+    case cscGetCurMode: {
+        VDSwitchInfoRec* info = (VDSwitchInfoRec*)param;
+        info->csMode     = gPv.curDepth;
+        info->csData     = gPv.curMode;
+        info->csPage     = gPv.curPage;
+        info->csBaseAddr = gPv.fbBase;
+        return noErr;
+    }
+    case cscGetGray:
+        ((VDGrayRecord*)param)->csMode = gPv.grayMode;
+        return noErr;
+    case cscGetInterrupt:
+        ((VDFlagRecord*)param)->csMode = !gPv.vblEnabled;
+        return noErr;
+    case cscGetConnection: {
+        VDDisplayConnectInfoRec* info = (VDDisplayConnectInfoRec*)param;
+        info->csDisplayType          = kGenericLCD;
+        info->csConnectTaggedType    = 0;
+        info->csConnectTaggedData    = 0;
+        info->csConnectFlags         = (1 << kAllModesValid) | (1 << kAllModesSafe);
+        info->csDisplayComponent     = 0;
+        return noErr;
+    }
+    case cscGetModeTiming: {
+        VDTimingInfoRec* info = (VDTimingInfoRec*)param;
+        if (!GetModeSize(info->csTimingMode, &width, &height, &depths))
+            return paramErr;
+        info->csTimingFormat = kDeclROMtables;
+        info->csTimingData   = timingApple_FixedRateLCD;
+        info->csTimingFlags  = (1 << kModeValid) | (1 << kModeSafe) |
+            ((info->csTimingMode == 1) ? (1 << kModeDefault) : 0);
+        return noErr;
+    }
+    case cscGetNextResolution: {
+        VDResolutionInfoRec* info = (VDResolutionInfoRec*)param;
+        DisplayModeID next = (info->csPreviousDisplayModeID == kDisplayModeIDFindFirstResolution)
+                           ? 1 : info->csPreviousDisplayModeID + 1;
+        if (info->csPreviousDisplayModeID == kDisplayModeIDCurrent)
+            next = gPv.curMode;
+        if (!GetModeSize(next, &width, &height, &depths)) {
+            info->csDisplayModeID = kDisplayModeIDNoMoreResolutions;
+            return noErr;
+        }
+        info->csDisplayModeID    = next;
+        info->csHorizontalPixels = width;
+        info->csVerticalLines    = height;
+        info->csRefreshRate      = 60 << 16;
+        info->csMaxDepthMode     = (depths & 4) ? kDepthMode3 :
+                                   (depths & 2) ? kDepthMode2 : kDepthMode1;
+        return noErr;
+    }
+    case cscGetVideoParameters: {
+        VDVideoParametersInfoRec* info = (VDVideoParametersInfoRec*)param;
+        VPBlockPtr vp = info->csVPBlockPtr;
+        UInt32 bits;
+        if (!GetModeSize(info->csDisplayModeID, &width, &height, &depths))
+            return paramErr;
+        if (info->csDepthMode < kDepthMode1 || info->csDepthMode > kDepthMode3 ||
+            !(depths & (1 << (info->csDepthMode - kDepthMode1))))
+            return paramErr;
+        bits = DepthToBits(info->csDepthMode);
+        vp->vpBaseOffset   = 0;
+        vp->vpRowBytes     = width * bits / 8;
+        vp->vpBounds.top   = 0;
+        vp->vpBounds.left  = 0;
+        vp->vpBounds.bottom = height;
+        vp->vpBounds.right = width;
+        vp->vpVersion      = 0;
+        vp->vpPackType     = 0;
+        vp->vpPackSize     = 0;
+        vp->vpHRes         = 0x00480000;
+        vp->vpVRes         = 0x00480000;
+        vp->vpPixelType    = (bits == 8) ? 0 : 16; /* chunky or RGBDirect */
+        vp->vpPixelSize    = (bits == 16) ? 16 : bits;
+        vp->vpCmpCount     = (bits == 8) ? 1 : 3;
+        vp->vpCmpSize      = (bits == 8) ? 8 : (bits == 16) ? 5 : 8;
+        vp->vpPlaneBytes   = 0;
+        info->csPageCount  = 1;
+        info->csDeviceType = (bits == 8) ? clutType : directType;
+        return noErr;
+    }
+    case cscPvGetRegisters:
+        *(volatile UInt32**)&pb->csParam = gPv.regs;
+        return noErr;
+    default:
+        return statusErr;
+    }
+}
+
+static OSStatus DoInitialize(DriverInitInfoPtr info)
+{
+    OSStatus err;
+
+    RegistryEntryIDCopy(&info->deviceEntry, &gPv.regEntry);
+
+    err = MapRegisters(&info->deviceEntry);
+    if (err != noErr)
+        return err;
+
+    gPv.numModes = RegRead(kRegNumModes);
+
+    /* keep the mode Open Firmware has set up */
+    gPv.curMode    = 1;
+    gPv.curDepth   = kDepthMode1;
+    gPv.curPage    = 0;
+    gPv.damageMode = false;
+    gPv.vblEnabled = InstallVblInterrupt() == noErr;
+
+    err = SetMode(gPv.curMode, gPv.curDepth, gPv.curPage);
+    if (err != noErr)
+        return err;
+
+    UpdateControl();
+
+    return noErr;
+}
+
+static OSStatus DoFinalize(void)
+{
+    gPv.damageMode = false;
+    gPv.vblEnabled = false;
+    RegWrite(kRegControl, 0);
+
+    if (gPv.vblService)
+        VSLDisposeInterruptService(gPv.vblService);
+
+    if (gPv.oldHandler)
+        InstallInterruptFunctions(gPv.istMember.setID, gPv.istMember.member,
+                                  gPv.istRefCon, gPv.oldHandler,
+                                  gPv.oldEnabler, gPv.oldDisabler);
+
+    RegistryEntryIDDispose(&gPv.regEntry);
+
+    return noErr;
+}
+
+OSStatus DoDriverIO(AddressSpaceID spaceID, IOCommandID cmdID,
+                    IOCommandContents contents, IOCommandCode cmdCode,
+                    IOCommandKind cmdKind)
+{
+    OSStatus err;
+
+    switch (cmdCode) {
+    case kInitializeCommand:
+    case kReplaceCommand:
+        err = DoInitialize(contents.initialInfo);
+        break;
+    case kFinalizeCommand:
+    case kSupersededCommand:
+        err = DoFinalize();
+        break;
+    case kOpenCommand:
+    case kCloseCommand:
+        err = noErr;
+        break;
+    case kControlCommand:
+        err = DoControl((CntrlParam*)contents.pb);
+        break;
+    case kStatusCommand:
+        err = DoStatus((CntrlParam*)contents.pb);
+        break;
+    case kReadCommand:
+    case kWriteCommand:
+        err = paramErr;
+        break;
+    case kKillIOCommand:
+        err = noErr;
+        break;
+    default:
+        err = paramErr;
+    }
+
+    if (cmdKind & kImmediateIOCommandKind)
+        return err;
+
+    return IOCommandIsComplete(cmdID, err);
+}
@@ -0,0 +1,289 @@
+/*
+DingusPPC - The Experimental PowerPC Macintosh emulator
+Copyright (C) 2018-23 divingkatae and maximum
+                      (theweirdo)     spatium
+
+(Contact divingkatae#1017 or powermax#2286 on Discord for more info)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file Native CallUniversalProc shortcut. */
+
+#include <cpu/ppc/ppcemu.h>
+#include <cpu/ppc/ppchle.h>
+#include <cpu/ppc/ppcmmu.h>
+#include <debugger/symbols.h>
+#include <devices/memctrl/memctrlbase.h>
+#include <hle/mixedmode.h>
+#include <loguru.hpp>
+#include <memaccess.h>
+
+#include <memory>
+#include <string>
+
+using namespace MixedMode;
+
+MixedModeAccel* MixedModeAccel::mm_accel_obj = nullptr;
+
+namespace {
+
+/** Thrown when a call has to be executed by the ROM glue. */
+struct Fallback {};
+
+const uint16_t MIXED_MODE_MAGIC = 0xAAFE;   // _MixedModeMagic A-trap
+const uint8_t  RD_VERSION       = 7;
+const uint8_t  RD_SELECTORS_ARE_INDEXABLE = 0x01;
+
+const uint32_t RD_HEADER_SIZE   = 12;
+const uint32_t RR_SIZE          = 20;
+
+// Fat descriptors rarely hold more than a handful of routines.
+const int MAX_ROUTINES = 16;
+
+// CallUniversalProc(theProcPtr, procInfo, ...)
+const int CUP_FIRST_PARAM = 2;
+
+// Parameter area of the PowerPC calling convention.
+const uint32_t LINKAGE_SIZE = 24;
+const int      NUM_ARG_GPRS = 8;
+
+/** Return host pointer to guest data, throws Fallback if it's not in memory.
+    Don't pass the call to the byte-wise memaccess macros, they would
+    translate the address once per byte. */
+uint8_t* guest_ptr(uint32_t va, uint32_t size, bool is_write = false)
+{
+    uint32_t pa;
+
+    if ((va & 0xFFFU) + size > 0x1000U || !mmu_translate_data(va, is_write, pa))
+        throw Fallback();
+
+    AddressMapEntry* rgn = mem_ctrl_instance->find_range(pa);
+
+    if (!rgn || !rgn->mem_ptr || !(rgn->type & (RT_ROM | RT_RAM)) ||
+        pa + size - 1 > rgn->end || (is_write && !(rgn->type & RT_RAM)))
+        throw Fallback();
+
+    return rgn->mem_ptr + (pa - rgn->start);
+}
+
+/** Return the number of parameters described by a procInfo word. */
+int param_count(uint32_t proc_info)
+{
+    int num_params = 0;
+
+    while (num_params < PI_MAX_PARAMS &&
+           ((proc_info >> (PI_PARAM_SHIFT + num_params * 2)) & 3))
+        num_params++;
+
+    return num_params;
+}
+
+bool is_stack_based(uint32_t proc_info)
+{
+    uint32_t conv = proc_info & PI_CONV_MASK;
+
+    return conv == CONV_PASCAL_STACK || conv == CONV_C_STACK;
+}
+
+} // anonymous namespace
+
+void MixedModeAccel::enable()
+{
+    if (this->enabled)
+        return;
+
+    SymbolTable* sym_table = SymbolTable::get_instance();
+    uint32_t     addr;
+
+    // prefer the user's symbol map over the export of the ROM fragments
+    if (!sym_table->find_by_name("mm/CallUniversalProc", addr) &&
+        !sym_table->find_by_name("CallUniversalProc", addr)) {
+        LOG_F(WARNING, "Mixed Mode accelerator: CallUniversalProc not found in ROM");
+        return;
+    }
+
+    this->hook_id = hle_install_hook(addr, "mm/CallUniversalProc", [this]() {
+        return this->handle_call();
+    });
+
+    if (this->hook_id < 0)
+        return;
+
+    this->enabled = true;
+
+    gProfilerObj->register_profile("MixedModeAccel",
+        std::unique_ptr<BaseProfile>(new MixedModeProfile()));
+
+    LOG_F(INFO, "Mixed Mode accelerator: CallUniversalProc hooked at 0x%08X", addr);
+}
+
+bool MixedModeAccel::select_routine(uint32_t upp, Routine& routine)
+{
+    if (upp & 1)
+        throw Fallback();
+
+    uint8_t* hdr = guest_ptr(upp, RD_HEADER_SIZE);
+
+    // anything else is a plain 68k procedure pointer
+    if (READ_WORD_BE_U(hdr) != MIXED_MODE_MAGIC)
+        return false;
+
+    if (hdr[2] != RD_VERSION || (hdr[3] & RD_SELECTORS_ARE_INDEXABLE))
+        throw Fallback();
+
+    int num_routines = READ_WORD_BE_U(&hdr[10]) + 1;
+
+    if (num_routines > MAX_ROUTINES)
+        throw Fallback();
+
+    bool found = false;
+
+    for (int i = 0; i < num_routines; i++) {
+        uint8_t* rr = guest_ptr(upp + RD_HEADER_SIZE + i * RR_SIZE, RR_SIZE);
+
+        uint16_t flags = READ_WORD_BE_U(&rr[6]);
+
+        // leave selector dispatch to the ROM
+        if (flags & (RF_IS_DISPATCHED | RF_IS_INDEX))
+            throw Fallback();
+
+        if (found || (rr[5] & ISA_MASK) != ISA_POWERPC)
+            continue;
+
+        routine.proc_info = READ_DWORD_BE_U(rr);
+        routine.isa       = rr[5];
+        routine.flags     = flags;
+        routine.proc_desc = READ_DWORD_BE_U(&rr[8]);
+
+        if (flags & RF_IS_RELATIVE)
+            routine.proc_desc += upp;
+
+        found = true;
+    }
+
+    return found;
+}
+
+bool MixedModeAccel::handle_call()
+{
+    Routine  routine;
+    uint32_t params[PI_MAX_PARAMS];
+    uint8_t* stack_ptrs[PI_MAX_PARAMS] = {};
+
+    uint32_t sp        = ppc_state.gpr[1];
+    uint32_t proc_info = ppc_state.gpr[4];
+    uint32_t code, toc, tvec;
+    int      num_params;
+
+    // nothing may be changed in the guest state before the last Fallback
+    try {
+        if (ppc_state.msr & MSR::LE)
+            throw Fallback();
+
+        if (!this->select_routine(ppc_state.gpr[3], routine)) {
+            this->num_68k_calls++;
+            return false;
+        }
+
+        // the parameters passed by the caller must be those the routine expects
+        if (routine.flags & RF_NEEDS_PREPARING || !is_stack_based(proc_info) ||
+            !is_stack_based(routine.proc_info) ||
+            (proc_info >> PI_RESULT_SHIFT) != (routine.proc_info >> PI_RESULT_SHIFT))
+            throw Fallback();
+
+        tvec = routine.proc_desc;
+        if (tvec & 3)
+            throw Fallback();
+
+        uint8_t* tv_ptr = guest_ptr(tvec, 8);
+        code = READ_DWORD_BE_A(tv_ptr);
+        toc  = READ_DWORD_BE_A(tv_ptr + 4);
+        if (!code || (code & 3))
+            throw Fallback();
+
+        num_params = param_count(proc_info);
+
+        // parameter i moves from argument word i + 2 to argument word i
+        for (int i = 0; i < num_params; i++) {
+            int src = i + CUP_FIRST_PARAM;
+
+            if (src < NUM_ARG_GPRS) {
+                params[i] = ppc_state.gpr[3 + src];
+            } else {
+                uint8_t* param = guest_ptr(sp + LINKAGE_SIZE + src * 4, 4);
+                params[i] = READ_DWORD_BE_U(param);
+            }
+
+            if (i >= NUM_ARG_GPRS)
+                stack_ptrs[i] = guest_ptr(sp + LINKAGE_SIZE + i * 4, 4, true);
+        }
+    } catch (Fallback&) {
+        this->num_fallbacks++;
+        return false;
+    }
+
+    for (int i = 0; i < num_params; i++) {
+        if (i < NUM_ARG_GPRS)
+            ppc_state.gpr[3 + i] = params[i];
+        else
+            WRITE_DWORD_BE_U(stack_ptrs[i], params[i]);
+    }
+
+    // enter the routine the way the cross-TOC glue does, LR still points
+    // back to the caller of CallUniversalProc which restores its own TOC
+    ppc_state.gpr[2]  = toc;
+    ppc_state.gpr[12] = tvec;
+    ppc_state.spr[SPR::CTR] = code;
+
+    hle_resume_at(code);
+
+    this->num_handled++;
+    this->num_params += num_params;
+
+    return true;
+}
+
+void MixedModeProfile::populate_variables(std::vector<ProfileVar>& vars)
+{
+    MixedModeAccel* mm_accel = MixedModeAccel::get_instance();
+
+    vars.clear();
+
+    vars.push_back({.name = "Native calls handled",
+                    .format = ProfileVarFmt::DEC,
+                    .value = mm_accel->num_handled});
+
+    vars.push_back({.name = "Native calls left to ROM",
+                    .format = ProfileVarFmt::DEC,
+                    .value = mm_accel->num_fallbacks});
+
+    vars.push_back({.name = "Calls into 68k code",
+                    .format = ProfileVarFmt::DEC,
+                    .value = mm_accel->num_68k_calls});
+
+    vars.push_back({.name = "Parameters passed",
+                    .format = ProfileVarFmt::DEC,
+                    .value = mm_accel->num_params});
+}
+
+void MixedModeProfile::reset()
+{
+    MixedModeAccel* mm_accel = MixedModeAccel::get_instance();
+
+    mm_accel->num_handled   = 0;
+    mm_accel->num_fallbacks = 0;
+    mm_accel->num_68k_calls = 0;
+    mm_accel->num_params    = 0;
+}
@@ -0,0 +1,137 @@
+/*
+DingusPPC - The Experimental PowerPC Macintosh emulator
+Copyright (C) 2018-23 divingkatae and maximum
+                      (theweirdo)     spatium
+
+(Contact divingkatae#1017 or powermax#2286 on Discord for more info)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file Native CallUniversalProc shortcut.
+
+    Native code calls universal procedure pointers (UPPs) through
+    CallUniversalProc. The Mixed Mode Manager then looks up the routine
+    descriptor, saves its context, marshals the parameters described by
+    the procInfo word and either switches into the 68k emulator or calls
+    the PowerPC routine. Callbacks registered through CFM and patched traps
+    reached from native code make this one of the most frequent paths
+    through the ROM.
+
+    Only the native to native case is shortcut. A hooked call selecting a
+    PowerPC routine with a stack based calling convention is turned into
+    a direct call of the routine's transition vector: the parameters are
+    shifted into place and the routine returns straight to the caller of
+    CallUniversalProc.
+
+    Mode switches are always left to the ROM: 68k code entering a routine
+    descriptor through _MixedModeMagic and native code calling 68k
+    routines. So are register based and dispatched conventions, selector
+    dispatch and fragments not yet prepared.
+
+    CallUniversalProc is located through the export of the same name of
+    the CFM fragments in ROM, which the symbol table collects when it scans
+    the ROM. An entry named "mm/CallUniversalProc" in the symbol map of the
+    ROM (see SymbolTable::load_rom_map) takes precedence over it.
+ */
+
+#ifndef MIXED_MODE_ACCEL_H
+#define MIXED_MODE_ACCEL_H
+
+#include <utils/profiler.h>
+
+#include <cinttypes>
+#include <vector>
+
+namespace MixedMode {
+
+/** Fields of a procInfo word. */
+enum : uint32_t {
+    PI_CONV_MASK    = 0x0F,
+    PI_RESULT_SHIFT = 4,
+    PI_PARAM_SHIFT  = 6,    // 2 bits per parameter, starting with the first
+};
+
+const int PI_MAX_PARAMS = 13;
+
+/** Calling conventions encoded in procInfo. */
+enum : uint32_t {
+    CONV_PASCAL_STACK   = 0,
+    CONV_C_STACK        = 1,
+};
+
+/** Instruction set architectures of a routine record. */
+enum : uint8_t {
+    ISA_M68K    = 0,
+    ISA_POWERPC = 1,
+    ISA_MASK    = 0x0F,
+};
+
+/** Routine record flags. */
+enum : uint16_t {
+    RF_IS_RELATIVE      = 0x01,
+    RF_NEEDS_PREPARING  = 0x02,
+    RF_IS_DISPATCHED    = 0x10,
+    RF_IS_INDEX         = 0x20,
+};
+
+typedef struct Routine {
+    uint32_t    proc_info;
+    uint8_t     isa;
+    uint16_t    flags;
+    uint32_t    proc_desc;
+} Routine;
+
+}; // namespace MixedMode
+
+class MixedModeAccel {
+public:
+    static MixedModeAccel* get_instance() {
+        if (!mm_accel_obj) {
+            mm_accel_obj = new MixedModeAccel();
+        }
+        return mm_accel_obj;
+    };
+
+    void enable();
+
+    // statistics
+    uint64_t num_handled    = 0;
+    uint64_t num_fallbacks  = 0;
+    uint64_t num_68k_calls  = 0;    // calls needing a switch into the emulator
+    uint64_t num_params     = 0;    // parameters passed by handled calls
+
+private:
+    MixedModeAccel() {};  // private constructor to implement a singleton
+
+    bool handle_call();
+    bool select_routine(uint32_t upp, MixedMode::Routine& routine);
+
+    static MixedModeAccel* mm_accel_obj;
+
+    bool    enabled = false;
+    int     hook_id = -1;
+};
+
+/** Profile showing how many Mixed Mode calls were dispatched on the host. */
+class MixedModeProfile : public BaseProfile {
+public:
+    MixedModeProfile() : BaseProfile("MixedModeAccel") {};
+
+    void populate_variables(std::vector<ProfileVar>& vars);
+
+    void reset(void);
+};
+
+#endif // MIXED_MODE_ACCEL_H
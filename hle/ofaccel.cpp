@@ -0,0 +1,1010 @@
+/*
+DingusPPC - The Experimental PowerPC Macintosh emulator
+Copyright (C) 2018-23 divingkatae and maximum
+                      (theweirdo)     spatium
+
+(Contact divingkatae#1017 or powermax#2286 on Discord for more info)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file Native execution of Open Firmware Forth primitives. */
+
+#include <cpu/ppc/ppcemu.h>
+#include <cpu/ppc/ppchle.h>
+#include <cpu/ppc/ppcmmu.h>
+#include <debugger/symbols.h>
+#include <devices/memctrl/memctrlbase.h>
+#include <hle/ofaccel.h>
+#include <loguru.hpp>
+#include <memaccess.h>
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <set>
+
+using namespace OfForth;
+
+OfForthAccel* OfForthAccel::of_accel_obj = nullptr;
+
+namespace {
+
+/** Thrown when a call has to be executed by the guest code. */
+struct Fallback {};
+
+enum : int {
+    DUP = 0, DROP, SWAP, OVER, ROT, MINUS_ROT, NIP, TUCK,
+    TWO_DUP, TWO_DROP, TWO_SWAP, TWO_OVER,
+    UM_STAR, UM_SLASH_MOD, U_SLASH_MOD,
+    FETCH, STORE, C_FETCH, C_STORE, W_FETCH, W_STORE, L_FETCH, L_STORE,
+    PLUS_STORE,
+    MOVE, FILL, ERASE, COMP,
+    NUM_PRIMITIVES
+};
+
+const Primitive primitives[NUM_PRIMITIVES] = {
+    {"dup",     1, 2}, {"drop",   1, 0}, {"swap",  2, 2}, {"over",  2, 3},
+    {"rot",     3, 3}, {"-rot",   3, 3}, {"nip",   2, 1}, {"tuck",  2, 3},
+    {"2dup",    2, 4}, {"2drop",  2, 0}, {"2swap", 4, 4}, {"2over", 4, 6},
+    {"um*",     2, 2}, {"um/mod", 3, 2}, {"u/mod", 2, 2},
+    {"@",       1, 1}, {"!",      2, 0}, {"c@",    1, 1}, {"c!",    2, 0},
+    {"w@",      1, 1}, {"w!",     2, 0}, {"l@",    1, 1}, {"l!",    2, 0},
+    {"+!",      2, 0},
+    {"move",    3, 0}, {"fill",   3, 0}, {"erase", 2, 0}, {"comp",  3, 1},
+};
+
+const int MAX_OUT = 6;
+
+// Primitives with fewer guest instructions are cheaper to interpret than to hook.
+// A hooked call costs 25-50 ns on the host (swap to rot with the stack page
+// in the SoftTLB) while the interpreter needs 6-10 ns per instruction.
+// Hooking dup, drop and swap in a loop calling them was no faster than
+// interpreting them, rot came out even.
+const int MIN_GUEST_INSNS = 4;
+const int MAX_GUEST_INSNS = 256;
+
+// Longest routine evaluated when looking for primitives.
+const int MAX_EVAL_INSNS = 32;
+
+// Larger blocks are left to the guest to keep the pre-mapping bounded.
+const uint32_t MAX_BLOCK_LEN = 0x100000;
+
+const uint32_t OF_IMAGE_OFFSETS[] = {0x320000, 0x330000};
+
+const uint32_t PPC_BLR = 0x4E800020UL;
+
+inline int insn_op(uint32_t insn)  { return insn >> 26; }
+inline int insn_rd(uint32_t insn)  { return (insn >> 21) & 0x1F; }
+inline int insn_ra(uint32_t insn)  { return (insn >> 16) & 0x1F; }
+inline int insn_rb(uint32_t insn)  { return (insn >> 11) & 0x1F; }
+inline int insn_d(uint32_t insn)   { return int16_t(insn & 0xFFFF); }
+
+/** Return host pointer to guest data, throws Fallback if it's not in memory.
+    Don't pass the call to the byte-wise memaccess macros, they would
+    translate the address once per byte. */
+uint8_t* guest_ptr(uint32_t va, uint32_t size, bool is_write = false)
+{
+    uint32_t pa;
+
+    if ((va & 0xFFFU) + size > 0x1000U)
+        throw Fallback();
+
+    // pages the guest has touched recently are mapped by the SoftTLB
+    if (uint8_t* host_va = mmu_probe_dtlb(va, is_write))
+        return host_va;
+
+    if (!mmu_translate_data(va, is_write, pa))
+        throw Fallback();
+
+    AddressMapEntry* rgn = mem_ctrl_instance->find_range(pa);
+
+    if (!rgn || !rgn->mem_ptr || !(rgn->type & (RT_ROM | RT_RAM)) ||
+        pa + size - 1 > rgn->end || (is_write && !(rgn->type & RT_RAM)))
+        throw Fallback();
+
+    return rgn->mem_ptr + (pa - rgn->start);
+}
+
+/** Read an instruction from ROM by its physical address, 0 if not in ROM. */
+uint32_t rom_insn(uint32_t pa)
+{
+    AddressMapEntry* rgn = mem_ctrl_instance->find_range(pa);
+
+    if (!rgn || !rgn->mem_ptr || !(rgn->type & RT_ROM) || pa + 3 > rgn->end)
+        return 0;
+
+    return READ_DWORD_BE_A(rgn->mem_ptr + (pa - rgn->start));
+}
+
+/** Return the address of the given primitive from the symbol map, 0 if unknown. */
+uint32_t prim_addr(const char* name)
+{
+    uint32_t addr;
+
+    if (!SymbolTable::get_instance()->find_by_name(std::string("of/") + name, addr))
+        return 0;
+
+    return addr;
+}
+
+/** Symbolic value: an expression plus a constant. Expression 0 is zero. */
+struct SymVal {
+    int      expr;
+    uint32_t offs;
+
+    bool operator==(const SymVal& other) const {
+        return this->expr == other.expr && this->offs == other.offs;
+    }
+    bool operator!=(const SymVal& other) const {
+        return !(*this == other);
+    }
+    bool operator<(const SymVal& other) const {
+        return this->expr != other.expr ? this->expr < other.expr : this->offs < other.offs;
+    }
+};
+
+enum class SymOp : uint8_t {
+    ZERO, SP, CELL, REG, LOAD, ADD, SUB, MUL_LO, MUL_HIU, DIVU,
+};
+
+struct SymExpr {
+    SymOp   op;
+    int     arg;    // cell or register number, access size of a load
+    SymVal  x;
+    SymVal  y;
+};
+
+/** Memory write of a routine other than to the data stack. */
+struct SymStore {
+    SymVal  addr;
+    SymVal  val;
+    int     size;
+
+    bool operator==(const SymStore& other) const {
+        return this->addr == other.addr && this->val == other.val && this->size == other.size;
+    }
+};
+
+/** Expressions of a single routine. Equal expressions get the same number
+    so comparing two values doesn't need to walk the expression trees. */
+class SymTable {
+public:
+    SymTable() { this->exprs.push_back({SymOp::ZERO}); };
+
+    SymVal konst(uint32_t val)  { return {0, val}; };
+    SymVal sp()                 { return this->make(SymOp::SP); };
+    SymVal cell(int item)       { return this->make(SymOp::CELL, item); };
+    SymVal reg(int num)         { return this->make(SymOp::REG, num); };
+    SymVal load(SymVal addr, int size) { return this->make(SymOp::LOAD, size, addr); };
+
+    SymVal add(SymVal x, SymVal y) {
+        if (!x.expr || !y.expr)
+            return {x.expr | y.expr, x.offs + y.offs};
+        SymVal res = this->make(SymOp::ADD, 0, std::min(SymVal{x.expr, 0}, SymVal{y.expr, 0}),
+                                std::max(SymVal{x.expr, 0}, SymVal{y.expr, 0}));
+        res.offs = x.offs + y.offs;
+        return res;
+    };
+
+    SymVal sub(SymVal x, SymVal y) {
+        if (x.expr == y.expr || !y.expr)
+            return {x.expr == y.expr ? 0 : x.expr, x.offs - y.offs};
+        SymVal res = this->make(SymOp::SUB, 0, {x.expr, 0}, {y.expr, 0});
+        res.offs = x.offs - y.offs;
+        return res;
+    };
+
+    SymVal mul_lo(SymVal x, SymVal y) {
+        if (!x.expr && !y.expr)
+            return this->konst(x.offs * y.offs);
+        return this->make(SymOp::MUL_LO, 0, std::min(x, y), std::max(x, y));
+    };
+
+    SymVal mul_hiu(SymVal x, SymVal y) {
+        if (!x.expr && !y.expr)
+            return this->konst(uint32_t((uint64_t(x.offs) * y.offs) >> 32));
+        return this->make(SymOp::MUL_HIU, 0, std::min(x, y), std::max(x, y));
+    };
+
+    SymVal divu(SymVal x, SymVal y) {
+        if (!x.expr && !y.expr && y.offs)
+            return this->konst(x.offs / y.offs);
+        return this->make(SymOp::DIVU, 0, x, y);
+    };
+
+private:
+    SymVal make(SymOp op, int arg = 0, SymVal x = {}, SymVal y = {}) {
+        for (int i = 1; i < (int)this->exprs.size(); i++) {
+            const SymExpr& e = this->exprs[i];
+            if (e.op == op && e.arg == arg && e.x == x && e.y == y)
+                return {i, 0};
+        }
+        this->exprs.push_back({op, arg, x, y});
+        return {(int)this->exprs.size() - 1, 0};
+    };
+
+    std::vector<SymExpr> exprs;
+};
+
+/** Effect of a straight-line routine on the registers and memory. */
+struct RoutineEffect {
+    SymVal                      regs[32];
+    std::map<int32_t, SymVal>   stack;      // data stack writes relative to the entry SP
+    std::vector<SymStore>       stores;     // all other memory writes
+    std::set<int>               late_cells; // stack cells read after a memory write
+};
+
+/** Evaluate the routine at addr symbolically. Returns false for routines
+    containing branches, loops or instructions the accelerator can't
+    reproduce, like those changing CR or XER. */
+bool eval_routine(uint32_t addr, const StackAbi& abi, SymTable& tab, RoutineEffect& eff)
+{
+    int     cached = abi.tos_reg >= 0;
+    int32_t stride = -abi.push_disp;    // address distance to the next deeper cell
+    SymVal  sp     = tab.sp();
+
+    for (int r = 0; r < 32; r++)
+        eff.regs[r] = tab.reg(r);
+
+    eff.regs[abi.sp_reg] = sp;
+
+    if (cached)
+        eff.regs[abi.tos_reg] = tab.cell(0);
+
+    // loads following a store could alias it, only data stack cells are tracked
+    // so far. Cells read after memory writes are checked against the primitive.
+    auto load = [&](SymVal ea, int size, SymVal& val) {
+        if (ea.expr != sp.expr) {
+            if (!eff.stores.empty() || !eff.stack.empty())
+                return false;
+            val = tab.load(ea, size);
+            return true;
+        }
+        int32_t off = ea.offs;
+        if (size != 4 || (off % stride))
+            return false;
+        auto it = eff.stack.find(off);
+        if (it != eff.stack.end()) {
+            val = it->second;
+            return true;
+        }
+        if (off / stride + cached < cached)
+            return false;   // above the top of stack
+        val = tab.cell(off / stride + cached);
+        if (!eff.stores.empty())
+            eff.late_cells.insert(off / stride + cached);
+        return true;
+    };
+
+    auto store = [&](SymVal ea, int size, SymVal val) {
+        if (ea.expr != sp.expr) {
+            eff.stores.push_back({ea, val, size});
+            return true;
+        }
+        if (size != 4 || (int32_t(ea.offs) % stride))
+            return false;
+        eff.stack[int32_t(ea.offs)] = val;
+        return true;
+    };
+
+    for (int i = 0; i < MAX_EVAL_INSNS; i++) {
+        uint32_t insn = rom_insn(addr + i * 4);
+
+        if (insn == PPC_BLR)
+            return true;
+
+        int    op   = insn_op(insn), rd = insn_rd(insn), ra = insn_ra(insn);
+        SymVal base = ra ? eff.regs[ra] : tab.konst(0);
+        SymVal ea   = tab.add(base, tab.konst(insn_d(insn)));
+
+        switch (op) {
+        case 14: // addi
+            eff.regs[rd] = ea;
+            break;
+        case 15: // addis
+            eff.regs[rd] = tab.add(base, tab.konst(insn << 16));
+            break;
+        case 32: // lwz
+        case 33: // lwzu
+        case 34: // lbz
+        case 35: // lbzu
+        case 40: // lhz
+        case 41: { // lhzu
+            int    size = op < 34 ? 4 : (op < 40 ? 1 : 2);
+            SymVal val;
+            if (((op & 1) && (!ra || ra == rd)) || !load(ea, size, val))
+                return false;
+            eff.regs[rd] = val;
+            if (op & 1)
+                eff.regs[ra] = ea;
+            break;
+        }
+        case 36: // stw
+        case 37: // stwu
+        case 38: // stb
+        case 39: // stbu
+        case 44: // sth
+        case 45: { // sthu
+            int size = op < 38 ? 4 : (op < 40 ? 1 : 2);
+            if (((op & 1) && !ra) || !store(ea, size, eff.regs[rd]))
+                return false;
+            if (op & 1)
+                eff.regs[ra] = ea;
+            break;
+        }
+        case 31: {
+            // record and overflow forms change CR and XER
+            if (insn & 0x401)
+                return false;
+            SymVal a = eff.regs[ra], b = eff.regs[insn_rb(insn)];
+            switch ((insn >> 1) & 0x3FF) {
+            case 444: // or, only as mr
+                if (insn_rb(insn) != rd)
+                    return false;
+                eff.regs[ra] = eff.regs[rd];
+                break;
+            case 266: // add
+                eff.regs[rd] = tab.add(a, b);
+                break;
+            case 40: // subf
+                eff.regs[rd] = tab.sub(b, a);
+                break;
+            case 235: // mullw
+                eff.regs[rd] = tab.mul_lo(a, b);
+                break;
+            case 11: // mulhwu
+                eff.regs[rd] = tab.mul_hiu(a, b);
+                break;
+            case 459: // divwu
+                eff.regs[rd] = tab.divu(a, b);
+                break;
+            default:
+                return false;
+            }
+            break;
+        }
+        default:
+            return false;
+        }
+    }
+
+    return false;
+}
+
+/** Describe the outputs and memory writes of a primitive in terms of its
+    input cells. Returns false for primitives containing loops. */
+bool prim_spec(int prim, SymTable& tab, std::vector<SymVal>& out,
+               std::vector<SymStore>& stores)
+{
+    // output cells of the stack words as input cell numbers
+    static const std::vector<int> shuffles[TWO_OVER + 1] = {
+        {0, 0}, {}, {1, 0}, {1, 0, 1}, {2, 0, 1}, {1, 2, 0}, {0}, {0, 1, 0},
+        {0, 1, 0, 1}, {}, {2, 3, 0, 1}, {2, 3, 0, 1, 2, 3},
+    };
+
+    if (prim <= TWO_OVER) {
+        for (int item : shuffles[prim])
+            out.push_back(tab.cell(item));
+        return true;
+    }
+
+    SymVal in0 = tab.cell(0), in1 = tab.cell(1);
+
+    switch (prim) {
+    case UM_STAR:
+        out = {tab.mul_hiu(in1, in0), tab.mul_lo(in1, in0)};
+        break;
+    case U_SLASH_MOD: {
+        SymVal quot = tab.divu(in1, in0);
+        out = {quot, tab.sub(in1, tab.mul_lo(quot, in0))};
+        break;
+    }
+    case FETCH:
+    case L_FETCH:
+        out = {tab.load(in0, 4)};
+        break;
+    case C_FETCH:
+        out = {tab.load(in0, 1)};
+        break;
+    case W_FETCH:
+        out = {tab.load(in0, 2)};
+        break;
+    case STORE:
+    case L_STORE:
+        stores = {{in0, in1, 4}};
+        break;
+    case C_STORE:
+        stores = {{in0, in1, 1}};
+        break;
+    case W_STORE:
+        stores = {{in0, in1, 2}};
+        break;
+    case PLUS_STORE:
+        stores = {{in0, tab.add(tab.load(in0, 4), in1), 4}};
+        break;
+    default:
+        return false;
+    }
+
+    return true;
+}
+
+/** Check if the effect of a routine is exactly that of the given primitive. */
+bool is_primitive(int prim, const StackAbi& abi, SymTable& tab, const RoutineEffect& eff)
+{
+    const Primitive& p = primitives[prim];
+
+    std::vector<SymVal>   out;
+    std::vector<SymStore> stores;
+
+    if (!prim_spec(prim, tab, out, stores) || eff.stores != stores)
+        return false;
+
+    int     cached  = abi.tos_reg >= 0;
+
+    // handle_call reads only the uncovered TOS after the memory operation
+    for (int item : eff.late_cells)
+        if (!cached || p.num_out || item != p.num_in)
+            return false;
+    int32_t stride  = -abi.push_disp;
+    int32_t new_off = stride * (p.num_in - p.num_out);
+
+    if (eff.regs[abi.sp_reg] != SymVal{tab.sp().expr, uint32_t(new_off)})
+        return false;
+
+    if (cached && eff.regs[abi.tos_reg] != (p.num_out ? out[0] : tab.cell(p.num_in)))
+        return false;
+
+    // content of the stack cell at the given offset from the entry SP before the call
+    auto orig_cell = [&](int32_t off) {
+        return (off / stride < 0) ? SymVal{-1, 0} : tab.cell(off / stride + cached);
+    };
+
+    for (int i = cached; i < p.num_out; i++) {
+        int32_t off = new_off + stride * (i - cached);
+        auto    it  = eff.stack.find(off);
+        if (((it != eff.stack.end()) ? it->second : orig_cell(off)) != out[i])
+            return false;
+    }
+
+    // writes above the new top of stack are dead, cells below the outputs must keep their values
+    for (auto& [off, val] : eff.stack) {
+        int item = (off - new_off) / stride + cached;
+        if (item >= p.num_out && val != orig_cell(off))
+            return false;
+    }
+
+    return true;
+}
+
+} // anonymous namespace
+
+void OfForthAccel::enable()
+{
+    if (this->enabled)
+        return;
+
+    if (!this->find_of_image()) {
+        LOG_F(WARNING, "OF accelerator: no Open Firmware image found in ROM");
+        return;
+    }
+
+    this->collect_call_targets();
+
+    if (!this->learn_stack_abi()) {
+        LOG_F(WARNING, "OF accelerator: can't determine the data stack layout");
+        return;
+    }
+
+    this->enabled = true;
+
+    this->num_handled.assign(NUM_PRIMITIVES, 0);
+    this->num_fallbacks.assign(NUM_PRIMITIVES, 0);
+
+    gProfilerObj->register_profile("OfForthAccel",
+        std::unique_ptr<BaseProfile>(new OfForthProfile()));
+
+    this->find_primitives();
+    this->install_hooks();
+}
+
+bool OfForthAccel::find_of_image()
+{
+    AddressMapEntry* rom_entry = mem_ctrl_instance->find_rom_region();
+    if (!rom_entry || !rom_entry->mem_ptr)
+        return false;
+
+    for (uint32_t offset : OF_IMAGE_OFFSETS) {
+        uint32_t pa = rom_entry->start + offset;
+
+        // COFF header with Gary Davidian's signature in place of the date
+        if (pa + 0x3C > rom_entry->end || (rom_insn(pa) >> 16) != 0x1DF ||
+            rom_insn(pa + 4) != 0x47617279UL)
+            continue;
+
+        this->of_start = pa;
+        this->of_end   = std::min(pa + 0x3C + rom_insn(pa + 0x24), rom_entry->end);
+
+        LOG_F(INFO, "OF accelerator: Open Firmware image at 0x%08X", pa);
+        return true;
+    }
+
+    return false;
+}
+
+void OfForthAccel::collect_call_targets()
+{
+    for (uint32_t pa = this->of_start; pa < this->of_end; pa += 4) {
+        uint32_t insn = rom_insn(pa);
+
+        // bl with a relative target, the code runs from a RAM copy of the image
+        if (insn_op(insn) != 18 || (insn & 3) != 1)
+            continue;
+
+        uint32_t target = pa + ((int32_t(insn << 6) >> 6) & ~3);
+
+        if (target >= this->of_start && target < this->of_end)
+            this->call_targets[target]++;
+    }
+}
+
+bool OfForthAccel::learn_stack_abi()
+{
+    uint32_t dup_addr  = prim_addr("dup");
+    uint32_t drop_addr = prim_addr("drop");
+
+    if (dup_addr && drop_addr) {
+        if (!this->abi_from_dup_drop(dup_addr, drop_addr))
+            return false;
+    } else {
+        // other stacks may use the same code, dup and drop are the most called
+        std::vector<uint32_t> dups, drops;
+
+        for (auto& [addr, num_calls] : this->call_targets) {
+            uint32_t insn0 = rom_insn(addr), insn1 = rom_insn(addr + 4);
+
+            if (insn_op(insn0) == 37 || (insn_op(insn0) == 32 && insn_op(insn1) == 37))
+                dups.push_back(addr);
+            if ((insn_op(insn0) == 32 && insn_op(insn1) == 14) ||
+                (insn_op(insn0) == 14 && insn1 == PPC_BLR))
+                drops.push_back(addr);
+        }
+
+        StackAbi best_abi   = {};
+        int      best_calls = 0;
+
+        for (uint32_t dup : dups) {
+            for (uint32_t drop : drops) {
+                int num_calls = this->call_targets[dup] + this->call_targets[drop];
+
+                this->abi = {};
+
+                if (num_calls > best_calls && this->abi_from_dup_drop(dup, drop)) {
+                    best_abi   = this->abi;
+                    best_calls = num_calls;
+                }
+            }
+        }
+
+        this->abi = best_abi;
+
+        if (!best_calls)
+            return false;
+    }
+
+    LOG_F(INFO, "OF accelerator: data stack pointer in r%d, %s",
+          this->abi.sp_reg, this->abi.tos_reg < 0 ? "TOS in memory" :
+          ("TOS in r" + std::to_string(this->abi.tos_reg)).c_str());
+
+    return true;
+}
+
+bool OfForthAccel::abi_from_dup_drop(uint32_t dup_addr, uint32_t drop_addr)
+{
+    uint32_t dup[3], drop[3];
+
+    for (int i = 0; i < 3; i++) {
+        dup[i]  = rom_insn(dup_addr  + i * 4);
+        drop[i] = rom_insn(drop_addr + i * 4);
+    }
+
+    // TOS cached in a register:
+    //   dup:  stwu  T,-4(S); blr
+    //   drop: lwz   T,0(S); addi S,S,4; blr
+    if (insn_op(dup[0]) == 37 && dup[1] == PPC_BLR && insn_op(drop[0]) == 32 &&
+        insn_op(drop[1]) == 14 && drop[2] == PPC_BLR) {
+        int t = insn_rd(dup[0]), s = insn_ra(dup[0]), disp = insn_d(dup[0]);
+
+        if ((disp == -4 || disp == 4) && s != t && insn_rd(drop[0]) == t &&
+            insn_ra(drop[0]) == s && !insn_d(drop[0]) && insn_rd(drop[1]) == s &&
+            insn_ra(drop[1]) == s && insn_d(drop[1]) == -disp) {
+            this->abi = {s, t, disp};
+        }
+    }
+
+    // all cells in memory:
+    //   dup:  lwz   X,0(S); stwu X,-4(S); blr
+    //   drop: addi  S,S,4; blr
+    if (insn_op(dup[0]) == 32 && insn_op(dup[1]) == 37 && dup[2] == PPC_BLR &&
+        insn_op(drop[0]) == 14 && drop[1] == PPC_BLR) {
+        int s = insn_ra(dup[0]), disp = insn_d(dup[1]);
+
+        if ((disp == -4 || disp == 4) && !insn_d(dup[0]) &&
+            insn_rd(dup[1]) == insn_rd(dup[0]) && insn_ra(dup[1]) == s &&
+            insn_rd(drop[0]) == s && insn_ra(drop[0]) == s &&
+            insn_d(drop[0]) == -disp) {
+            this->abi = {s, -1, disp};
+        }
+    }
+
+    return this->abi.push_disp != 0;
+}
+
+void OfForthAccel::find_primitives()
+{
+    std::set<uint32_t> known;
+
+    this->prim_entries.assign(NUM_PRIMITIVES, {});
+
+    for (int i = 0; i < NUM_PRIMITIVES; i++) {
+        uint32_t addr = prim_addr(primitives[i].name);
+
+        if (!addr)
+            continue;
+
+        if (addr < this->of_start || addr >= this->of_end) {
+            LOG_F(WARNING, "OF accelerator: %s at 0x%08X is outside of the OF image",
+                  primitives[i].name, addr);
+            continue;
+        }
+
+        this->prim_entries[i].push_back(addr);
+        known.insert(addr);
+    }
+
+    int num_found = 0;
+
+    for (auto& [addr, num_calls] : this->call_targets) {
+        SymTable      tab;
+        RoutineEffect eff;
+
+        if (known.count(addr) || !eval_routine(addr, this->abi, tab, eff))
+            continue;
+
+        for (int i = 0; i < NUM_PRIMITIVES; i++) {
+            if (is_primitive(i, this->abi, tab, eff)) {
+                VLOG_F(5, "OF accelerator: %s recognized at 0x%08X", primitives[i].name, addr);
+                this->prim_entries[i].push_back(addr);
+                num_found++;
+                break;
+            }
+        }
+    }
+
+    LOG_F(INFO, "OF accelerator: %d primitives recognized in the OF image", num_found);
+}
+
+void OfForthAccel::install_hooks()
+{
+    for (int i = 0; i < NUM_PRIMITIVES; i++) {
+        for (uint32_t addr : this->prim_entries[i]) {
+            int num_insns = 0;
+
+            while (num_insns < MAX_GUEST_INSNS && rom_insn(addr + num_insns * 4) != PPC_BLR)
+                num_insns++;
+
+            if (num_insns < MIN_GUEST_INSNS) {
+                VLOG_F(5, "OF accelerator: %s is too short to hook", primitives[i].name);
+                continue;
+            }
+
+            int hook_id = hle_install_hook(addr, std::string("of/") + primitives[i].name,
+                [this, i]() {
+                    return this->handle_call(i);
+            });
+
+            if (hook_id >= 0)
+                this->num_hooks++;
+        }
+    }
+
+    LOG_F(INFO, "OF accelerator: %d primitives hooked", this->num_hooks);
+}
+
+uint8_t* OfForthAccel::cell_ptr(uint32_t sp, int item, bool is_write)
+{
+    if (this->abi.tos_reg >= 0)
+        item--;
+
+    return guest_ptr(sp - this->abi.push_disp * item, 4, is_write);
+}
+
+bool OfForthAccel::handle_call(int prim)
+{
+    const Primitive& p = primitives[prim];
+
+    uint32_t in[4], out[MAX_OUT];
+    uint8_t* out_ptrs[MAX_OUT] = {};
+    uint8_t* new_tos_ptr = nullptr;
+
+    uint32_t sp     = ppc_state.gpr[this->abi.sp_reg];
+    uint32_t new_sp = sp - this->abi.push_disp * (p.num_in - p.num_out);
+    bool     cached = this->abi.tos_reg >= 0;
+
+    // nothing may be written to the guest memory before the last Fallback
+    try {
+        if (ppc_state.msr & MSR::LE)
+            throw Fallback();
+
+        for (int i = 0; i < p.num_in; i++) {
+            if (!i && cached) {
+                in[i] = ppc_state.gpr[this->abi.tos_reg];
+            } else {
+                uint8_t* cell = this->cell_ptr(sp, i, false);
+                in[i] = READ_DWORD_BE_U(cell);
+            }
+        }
+
+        // a word leaving nothing on the stack uncovers a new cached TOS,
+        // the guest code reads it after the memory operation of the word
+        if (cached && !p.num_out)
+            new_tos_ptr = this->cell_ptr(sp, p.num_in, false);
+
+        for (int i = (cached ? 1 : 0); i < p.num_out; i++)
+            out_ptrs[i] = this->cell_ptr(new_sp, i, true);
+
+        switch (prim) {
+        case DUP:
+            out[0] = in[0]; out[1] = in[0];
+            break;
+        case DROP:
+        case TWO_DROP:
+            break;
+        case SWAP:
+            out[0] = in[1]; out[1] = in[0];
+            break;
+        case OVER:
+            out[0] = in[1]; out[1] = in[0]; out[2] = in[1];
+            break;
+        case ROT:
+            out[0] = in[2]; out[1] = in[0]; out[2] = in[1];
+            break;
+        case MINUS_ROT:
+            out[0] = in[1]; out[1] = in[2]; out[2] = in[0];
+            break;
+        case NIP:
+            out[0] = in[0];
+            break;
+        case TUCK:
+            out[0] = in[0]; out[1] = in[1]; out[2] = in[0];
+            break;
+        case TWO_DUP:
+            out[0] = in[0]; out[1] = in[1]; out[2] = in[0]; out[3] = in[1];
+            break;
+        case TWO_SWAP:
+            out[0] = in[2]; out[1] = in[3]; out[2] = in[0]; out[3] = in[1];
+            break;
+        case TWO_OVER:
+            out[0] = in[2]; out[1] = in[3]; out[2] = in[0]; out[3] = in[1];
+            out[4] = in[2]; out[5] = in[3];
+            break;
+        case UM_STAR: {
+            uint64_t prod = uint64_t(in[1]) * in[0];
+            out[0] = uint32_t(prod >> 32); out[1] = uint32_t(prod);
+            break;
+        }
+        case UM_SLASH_MOD: {
+            // leave division by zero and quotient overflow to the guest
+            if (!in[0] || in[1] >= in[0])
+                throw Fallback();
+            uint64_t ud = (uint64_t(in[1]) << 32) | in[2];
+            out[0] = uint32_t(ud / in[0]); out[1] = uint32_t(ud % in[0]);
+            break;
+        }
+        case U_SLASH_MOD:
+            if (!in[0])
+                throw Fallback();
+            out[0] = in[1] / in[0]; out[1] = in[1] % in[0];
+            break;
+        case FETCH:
+        case L_FETCH: {
+            uint8_t* ptr = guest_ptr(in[0], 4);
+            out[0] = READ_DWORD_BE_U(ptr);
+            break;
+        }
+        case C_FETCH:
+            out[0] = *guest_ptr(in[0], 1);
+            break;
+        case W_FETCH: {
+            uint8_t* ptr = guest_ptr(in[0], 2);
+            out[0] = READ_WORD_BE_U(ptr);
+            break;
+        }
+        case STORE:
+        case L_STORE: {
+            uint8_t* ptr = guest_ptr(in[0], 4, true);
+            WRITE_DWORD_BE_U(ptr, in[1]);
+            break;
+        }
+        case C_STORE:
+            *guest_ptr(in[0], 1, true) = in[1];
+            break;
+        case W_STORE: {
+            uint8_t* ptr = guest_ptr(in[0], 2, true);
+            WRITE_WORD_BE_U(ptr, in[1]);
+            break;
+        }
+        case PLUS_STORE: {
+            uint8_t* p = guest_ptr(in[0], 4, true);
+            WRITE_DWORD_BE_U(p, READ_DWORD_BE_U(p) + in[1]);
+            break;
+        }
+        case MOVE:
+            this->block_move(in[2], in[1], in[0]);
+            break;
+        case FILL:
+            this->block_fill(in[2], in[1], in[0]);
+            break;
+        case ERASE:
+            this->block_fill(in[1], in[0], 0);
+            break;
+        case COMP:
+            out[0] = this->block_comp(in[2], in[1], in[0]);
+            break;
+        }
+    } catch (Fallback&) {
+        this->num_fallbacks[prim]++;
+        return false;
+    }
+
+    // commit the new stack state
+    for (int i = 0; i < p.num_out; i++) {
+        if (!i && cached)
+            ppc_state.gpr[this->abi.tos_reg] = out[i];
+        else
+            WRITE_DWORD_BE_U(out_ptrs[i], out[i]);
+    }
+
+    if (new_tos_ptr)
+        ppc_state.gpr[this->abi.tos_reg] = READ_DWORD_BE_U(new_tos_ptr);
+
+    ppc_state.gpr[this->abi.sp_reg] = new_sp;
+
+    this->num_handled[prim]++;
+
+    return true;
+}
+
+void OfForthAccel::map_block(uint32_t va, uint32_t len, bool is_write,
+                             std::vector<uint8_t*>& pages)
+{
+    if (len > MAX_BLOCK_LEN)
+        throw Fallback();
+
+    pages.clear();
+
+    while (len) {
+        uint32_t chunk = std::min(len, 0x1000U - (va & 0xFFFU));
+        pages.push_back(guest_ptr(va, chunk, is_write));
+        va  += chunk;
+        len -= chunk;
+    }
+}
+
+void OfForthAccel::block_move(uint32_t src, uint32_t dst, uint32_t len)
+{
+    this->map_block(src, len, false, this->src_pages);
+    this->map_block(dst, len, true, this->dst_pages);
+
+    // going through a buffer gives memmove semantics for overlapping blocks
+    this->block_buf.resize(len);
+
+    uint32_t pos = 0;
+
+    for (uint8_t* page : this->src_pages) {
+        uint32_t chunk = std::min(len - pos, 0x1000U - ((src + pos) & 0xFFFU));
+        std::memcpy(&this->block_buf[pos], page, chunk);
+        pos += chunk;
+    }
+
+    pos = 0;
+
+    for (uint8_t* page : this->dst_pages) {
+        uint32_t chunk = std::min(len - pos, 0x1000U - ((dst + pos) & 0xFFFU));
+        std::memcpy(page, &this->block_buf[pos], chunk);
+        pos += chunk;
+    }
+
+    this->num_bytes += len;
+}
+
+void OfForthAccel::block_fill(uint32_t addr, uint32_t len, uint8_t val)
+{
+    this->map_block(addr, len, true, this->dst_pages);
+
+    uint32_t pos = 0;
+
+    for (uint8_t* page : this->dst_pages) {
+        uint32_t chunk = std::min(len - pos, 0x1000U - ((addr + pos) & 0xFFFU));
+        std::memset(page, val, chunk);
+        pos += chunk;
+    }
+
+    this->num_bytes += len;
+}
+
+int OfForthAccel::block_comp(uint32_t addr1, uint32_t addr2, uint32_t len)
+{
+    this->map_block(addr1, len, false, this->src_pages);
+    this->map_block(addr2, len, false, this->dst_pages);
+
+    this->num_bytes += len;
+
+    // only the first chunk of a block may start in the middle of a page
+    auto byte_at = [](const std::vector<uint8_t*>& pages, uint32_t va, uint32_t pos) {
+        uint32_t off = (va & 0xFFFU) + pos;
+        return (off >> 12) ? pages[off >> 12][off & 0xFFFU] : pages[0][pos];
+    };
+
+    // compare byte by byte as the chunks of both blocks don't line up
+    for (uint32_t pos = 0; pos < len; pos++) {
+        uint8_t b1 = byte_at(this->src_pages, addr1, pos);
+        uint8_t b2 = byte_at(this->dst_pages, addr2, pos);
+
+        if (b1 != b2)
+            return b1 < b2 ? -1 : 1;
+    }
+
+    return 0;
+}
+
+void OfForthProfile::populate_variables(std::vector<ProfileVar>& vars)
+{
+    OfForthAccel* of_accel = OfForthAccel::get_instance();
+
+    vars.clear();
+
+    vars.push_back({.name = "Hooked primitives",
+                    .format = ProfileVarFmt::DEC,
+                    .value = uint64_t(of_accel->num_hooks)});
+
+    for (int i = 0; i < NUM_PRIMITIVES; i++) {
+        if (!of_accel->num_handled[i] && !of_accel->num_fallbacks[i])
+            continue;
+
+        vars.push_back({.name = std::string(primitives[i].name) + " handled",
+                        .format = ProfileVarFmt::DEC,
+                        .value = of_accel->num_handled[i]});
+
+        vars.push_back({.name = std::string(primitives[i].name) + " fallbacks",
+                        .format = ProfileVarFmt::DEC,
+                        .value = of_accel->num_fallbacks[i]});
+    }
+
+    vars.push_back({.name = "Bytes processed",
+                    .format = ProfileVarFmt::DEC,
+                    .value = of_accel->num_bytes});
+}
+
+void OfForthProfile::reset()
+{
+    OfForthAccel* of_accel = OfForthAccel::get_instance();
+
+    std::fill(of_accel->num_handled.begin(), of_accel->num_handled.end(), 0);
+    std::fill(of_accel->num_fallbacks.begin(), of_accel->num_fallbacks.end(), 0);
+
+    of_accel->num_bytes = 0;
+}
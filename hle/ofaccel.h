@@ -0,0 +1,142 @@
+/*
+DingusPPC - The Experimental PowerPC Macintosh emulator
+Copyright (C) 2018-23 divingkatae and maximum
+                      (theweirdo)     spatium
+
+(Contact divingkatae#1017 or powermax#2286 on Discord for more info)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file Native execution of Open Firmware Forth primitives.
+
+    Old World Open Firmware doesn't interpret threaded code. Its kernel
+    and all FCode are compiled to subroutine-threaded PowerPC code, so
+    there is no NEXT or docolon to replace. What remains expensive are
+    the kernel primitives called from that code: stack shuffling, double
+    precision arithmetic and memory block operations.
+
+    Primitives with straight-line code (stack words, fetch and store,
+    um* and u/mod) are recognized in the OF image itself, so no ROM
+    specific data is needed. Every routine called from the image is
+    evaluated symbolically and its effect on the data stack and memory
+    is compared with the definition of each primitive. The register
+    holding the data stack pointer and whether the top of stack is cached
+    in a register are learned from routines shaped like dup and drop.
+
+    Primitives containing loops (move, fill, erase, comp and um/mod) can't
+    be recognized that way. Their entry points are taken from the symbol
+    map of the ROM (see SymbolTable::load_rom_map) under names like
+    "of/move". Names from the map take precedence over recognized code.
+    The primitives are hooked in ROM before the OF kernel copies itself
+    into RAM.
+
+    A hooked primitive is executed on the host when all of its stack cells
+    and memory operands are in RAM or ROM. Anything else, including MMIO
+    accesses, is left to the guest code.
+ */
+
+#ifndef OF_ACCEL_H
+#define OF_ACCEL_H
+
+#include <utils/profiler.h>
+
+#include <cinttypes>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace OfForth {
+
+/** Data stack layout used by the OF kernel. */
+typedef struct StackAbi {
+    int     sp_reg;     // GPR holding the data stack pointer
+    int     tos_reg;    // GPR caching the top of stack, -1 if not cached
+    int     push_disp;  // displacement used by stwu to push a cell
+} StackAbi;
+
+typedef struct Primitive {
+    const char* name;       // Forth name of the word
+    int         num_in;     // cells consumed from the data stack
+    int         num_out;    // cells left on the data stack
+} Primitive;
+
+}; // namespace OfForth
+
+class OfForthAccel {
+public:
+    static OfForthAccel* get_instance() {
+        if (!of_accel_obj) {
+            of_accel_obj = new OfForthAccel();
+        }
+        return of_accel_obj;
+    };
+
+    void enable();
+
+    // statistics
+    std::vector<uint64_t> num_handled;
+    std::vector<uint64_t> num_fallbacks;
+    uint64_t num_bytes = 0;     // bytes moved, filled or compared
+
+    int      num_hooks = 0;
+
+private:
+    OfForthAccel() {};  // private constructor to implement a singleton
+
+    bool find_of_image();
+    void collect_call_targets();
+    bool learn_stack_abi();
+    bool abi_from_dup_drop(uint32_t dup_addr, uint32_t drop_addr);
+    void find_primitives();
+    void install_hooks();
+    bool handle_call(int prim);
+
+    // data stack access, item 0 is the top of stack
+    uint8_t* cell_ptr(uint32_t sp, int item, bool is_write);
+
+    // memory block operations, all pages are mapped before anything is written
+    void map_block(uint32_t va, uint32_t len, bool is_write,
+                   std::vector<uint8_t*>& pages);
+    void block_move(uint32_t src, uint32_t dst, uint32_t len);
+    void block_fill(uint32_t addr, uint32_t len, uint8_t val);
+    int  block_comp(uint32_t addr1, uint32_t addr2, uint32_t len);
+
+    static OfForthAccel* of_accel_obj;
+
+    bool                enabled = false;
+    uint32_t            of_start = 0;   // physical address of the OF image
+    uint32_t            of_end   = 0;
+    OfForth::StackAbi   abi = {};
+
+    std::map<uint32_t, int>             call_targets;   // bl targets within the image
+    std::vector<std::vector<uint32_t>>  prim_entries;   // entry points per primitive
+
+    // per-call state, kept here to reuse allocations
+    std::vector<uint8_t*>   src_pages;
+    std::vector<uint8_t*>   dst_pages;
+    std::vector<uint8_t>    block_buf;
+};
+
+/** Profile showing how many OF primitives were executed on the host. */
+class OfForthProfile : public BaseProfile {
+public:
+    OfForthProfile() : BaseProfile("OfForthAccel") {};
+
+    void populate_variables(std::vector<ProfileVar>& vars);
+
+    void reset(void);
+};
+
+#endif // OF_ACCEL_H
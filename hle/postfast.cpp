@@ -0,0 +1,389 @@
+/*
+DingusPPC - The Experimental PowerPC Macintosh emulator
+Copyright (C) 2018-23 divingkatae and maximum
+                      (theweirdo)     spatium
+
+(Contact divingkatae#1017 or powermax#2286 on Discord for more info)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file Fast path for the memory loops of the ROM power-on self-test. */
+
+#include <cpu/ppc/ppcemu.h>
+#include <cpu/ppc/ppchle.h>
+#include <cpu/ppc/ppcmmu.h>
+#include <devices/memctrl/memctrlbase.h>
+#include <hle/postfast.h>
+#include <loguru.hpp>
+#include <memaccess.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+
+using namespace PostLoops;
+
+PostFastPath* PostFastPath::post_fp_obj = nullptr;
+
+namespace {
+
+const char* kind_names[NUM_KINDS] = {"Fill", "Indexed fill", "Verify", "Sum"};
+
+inline int insn_op(uint32_t insn)  { return insn >> 26; }
+inline int insn_rd(uint32_t insn)  { return (insn >> 21) & 0x1F; }
+inline int insn_ra(uint32_t insn)  { return (insn >> 16) & 0x1F; }
+inline int insn_rb(uint32_t insn)  { return (insn >> 11) & 0x1F; }
+inline int insn_d(uint32_t insn)   { return int16_t(insn & 0xFFFF); }
+
+/** bdnz to the given displacement, with or without the prediction hint. */
+inline bool is_bdnz(uint32_t insn, int disp) {
+    return (insn & ~0x00200000UL) == (0x42000000UL | (disp & 0xFFFC));
+}
+
+/** bne crN,target with or without the prediction hint. */
+inline bool is_bne(uint32_t insn) {
+    return insn_op(insn) == 16 && ((insn >> 21) & 0x1E) == 4 && !(insn & 3);
+}
+
+inline bool is_add(uint32_t insn) {
+    return (insn & 0xFC0007FFUL) == 0x7C000214UL;
+}
+
+/** cmpw or cmplw, returns 1 for signed, 0 for unsigned and -1 otherwise. */
+inline int cmp_type(uint32_t insn) {
+    switch (insn & 0xFC6007FFUL) {
+    case 0x7C000000UL:
+        return 1;
+    case 0x7C000040UL:
+        return 0;
+    default:
+        return -1;
+    }
+}
+
+} // anonymous namespace
+
+void PostFastPath::enable()
+{
+    if (this->enabled)
+        return;
+
+    AddressMapEntry* rom_entry = mem_ctrl_instance->find_rom_region();
+    if (!rom_entry || !rom_entry->mem_ptr)
+        return;
+
+    this->enabled = true;
+
+    gProfilerObj->register_profile("PostFastPath",
+        std::unique_ptr<BaseProfile>(new PostFastPathProfile()));
+
+    uint32_t rom_size = rom_entry->end - rom_entry->start + 1;
+    PostLoop lp;
+
+    for (uint32_t offset = 0; offset + 16 <= rom_size; offset += 4) {
+        if (!this->match_loop(rom_entry->mem_ptr + offset, rom_entry->start + offset, lp))
+            continue;
+
+        int loop_idx = (int)this->loops.size();
+
+        this->loops.push_back(lp);
+
+        int hook_id = hle_install_hook(lp.addr, std::string("POST ") + kind_names[lp.kind],
+            [this, loop_idx]() {
+                return this->handle_call(loop_idx);
+        });
+
+        if (hook_id < 0) {
+            this->loops.pop_back();
+            continue;
+        }
+
+        this->num_hooks++;
+    }
+
+    LOG_F(INFO, "POST fast path: %d memory loops found in ROM", this->num_hooks);
+}
+
+bool PostFastPath::match_loop(const uint8_t* code, uint32_t addr, PostLoop& lp)
+{
+    uint32_t i0 = READ_DWORD_BE_A(code);
+    uint32_t i1 = READ_DWORD_BE_A(code + 4);
+    uint32_t i2 = READ_DWORD_BE_A(code + 8);
+    uint32_t i3 = READ_DWORD_BE_A(code + 12);
+
+    lp = {};
+    lp.addr = addr;
+    lp.ra   = insn_ra(i0);
+    lp.rs   = insn_rd(i0);
+    lp.size = 4;
+
+    if (!lp.ra)
+        return false;
+
+    // stwu rS,4(rA); bdnz .-4
+    if (insn_op(i0) == 37 && insn_d(i0) == 4 && is_bdnz(i1, -4)) {
+        lp.kind      = FILL_UPDATE;
+        lp.num_insns = 2;
+        return true;
+    }
+
+    // stw rS,0(rA); addi rA,rA,4; bdnz .-8
+    if (insn_op(i0) == 36 && !insn_d(i0) && insn_op(i1) == 14 &&
+        insn_rd(i1) == lp.ra && insn_ra(i1) == lp.ra && insn_d(i1) == 4 &&
+        is_bdnz(i2, -8)) {
+        lp.kind      = FILL_INDEX;
+        lp.num_insns = 3;
+        return true;
+    }
+
+    lp.rx = insn_rd(i0);
+
+    // lwzu rX,4(rA); cmp[l]w crN,rX,rS; bne crN,fail; bdnz .-12
+    if (insn_op(i0) == 33 && insn_d(i0) == 4 && lp.rx != lp.ra &&
+        cmp_type(i1) >= 0 && is_bne(i2) && is_bdnz(i3, -12)) {
+        lp.crf        = (i1 >> 23) & 7;
+        lp.cmp_signed = cmp_type(i1) == 1;
+
+        if (insn_ra(i1) == lp.rx) {
+            lp.rs = insn_rb(i1);
+        } else if (insn_rb(i1) == lp.rx) {
+            lp.rs          = insn_ra(i1);
+            lp.cmp_swapped = true;
+        } else {
+            return false;
+        }
+
+        if (lp.rs == lp.rx || lp.rs == lp.ra || insn_ra(i2) != lp.crf * 4 + 2)
+            return false;
+
+        lp.kind      = VERIFY;
+        lp.num_insns = 4;
+        lp.fail_addr = addr + 8 + int16_t(i2 & 0xFFFC);
+        return true;
+    }
+
+    // l[bhw]zu rX,size(rA); add rS,rS,rX; bdnz .-8
+    switch (insn_op(i0)) {
+    case 35:
+        lp.size = 1;
+        break;
+    case 41:
+        lp.size = 2;
+        break;
+    case 33:
+        lp.size = 4;
+        break;
+    default:
+        return false;
+    }
+
+    if (insn_d(i0) != lp.size || lp.rx == lp.ra || !is_add(i1) || !is_bdnz(i2, -8))
+        return false;
+
+    lp.rs = insn_rd(i1);
+
+    if (!((insn_ra(i1) == lp.rs && insn_rb(i1) == lp.rx) ||
+          (insn_ra(i1) == lp.rx && insn_rb(i1) == lp.rs)) ||
+        lp.rs == lp.rx || lp.rs == lp.ra)
+        return false;
+
+    lp.kind      = SUM;
+    lp.num_insns = 3;
+    return true;
+}
+
+/** Return host pointer to the guest page containing va, nullptr if it's not in memory. */
+uint8_t* PostFastPath::map_page(uint32_t va, bool is_write)
+{
+    uint32_t pa;
+
+    if (!mmu_translate_data(va & ~0xFFFU, is_write, pa))
+        return nullptr;
+
+    AddressMapEntry* rgn = mem_ctrl_instance->find_range(pa);
+
+    if (!rgn || !rgn->mem_ptr || !(rgn->type & (RT_ROM | RT_RAM)) ||
+        pa + 0xFFFU > rgn->end || (is_write && !(rgn->type & RT_RAM)))
+        return nullptr;
+
+    uint8_t* host_ptr = rgn->mem_ptr + (pa - rgn->start);
+
+    // the ROM checksum must not see our hooks
+    if (rgn->type & RT_ROM) {
+        hle_read_unpatched(this->page_buf, host_ptr, sizeof(this->page_buf));
+        host_ptr = this->page_buf;
+    }
+
+    return host_ptr + (va & 0xFFFU);
+}
+
+bool PostFastPath::handle_call(int loop_idx)
+{
+    const PostLoop& lp = this->loops[loop_idx];
+
+    uint32_t ctr  = ppc_state.spr[SPR::CTR];
+    uint32_t ra   = ppc_state.gpr[lp.ra];
+    uint32_t ea   = lp.kind == FILL_INDEX ? ra : ra + lp.size;
+    bool     fill = lp.kind == FILL_UPDATE || lp.kind == FILL_INDEX;
+
+    // interrupts could be taken in the middle of the loop
+    if (!ctr || (ppc_state.msr & (MSR::EE | MSR::LE)) || (ea & (lp.size - 1))) {
+        this->num_fallbacks[lp.kind]++;
+        return false;
+    }
+
+    uint8_t* ptr = this->map_page(ea, fill);
+    if (!ptr) {
+        this->num_fallbacks[lp.kind]++;
+        return false;
+    }
+
+    // run up to the end of the current page
+    uint32_t iters = std::min(ctr, (0x1000U - (ea & 0xFFFU)) / lp.size);
+    uint32_t done  = 0;
+    uint64_t insns;
+    uint32_t next_pc;
+
+    if (lp.kind == VERIFY) {
+        uint32_t rs = ppc_state.gpr[lp.rs];
+        uint32_t val = 0;
+        bool     failed = false;
+
+        for (; done < iters; done++, ptr += 4) {
+            val = READ_DWORD_BE_A(ptr);
+            if (val != rs) {
+                failed = true;
+                break;
+            }
+        }
+
+        uint32_t a = lp.cmp_swapped ? rs : val;
+        uint32_t b = lp.cmp_swapped ? val : rs;
+
+        if (failed) {
+            ppc_state.gpr[lp.ra] = ra + (done + 1) * 4;
+            ppc_state.gpr[lp.rx] = val;
+            insns   = uint64_t(done) * lp.num_insns + 3;
+            next_pc = lp.fail_addr;
+        } else {
+            ppc_state.gpr[lp.ra] = ra + done * 4;
+            ppc_state.gpr[lp.rx] = val;
+            insns   = uint64_t(done) * lp.num_insns;
+            next_pc = 0;
+        }
+
+        // same CR update as cmpw/cmplw
+        uint32_t cmp_c;
+        if (a == b)
+            cmp_c = 0x20000000UL;
+        else if (lp.cmp_signed ? int32_t(a) > int32_t(b) : a > b)
+            cmp_c = 0x40000000UL;
+        else
+            cmp_c = 0x80000000UL;
+
+        uint32_t xercon = (ppc_state.spr[SPR::XER] & 0x80000000UL) >> 3;
+        int      shift  = lp.crf * 4;
+
+        ppc_state.cr = (ppc_state.cr & ~(0xF0000000UL >> shift)) |
+                       ((cmp_c + xercon) >> shift);
+    } else if (fill) {
+        // stw rA,0(rA) stores the current address, stwu rA,4(rA) the previous one
+        uint32_t rs   = ppc_state.gpr[lp.rs];
+        bool     self = lp.rs == lp.ra;
+        uint32_t adj  = lp.kind == FILL_UPDATE ? 4 : 0;
+
+        for (; done < iters; done++, ea += 4, ptr += 4)
+            WRITE_DWORD_BE_A(ptr, self ? ea - adj : rs);
+
+        ppc_state.gpr[lp.ra] = ra + done * 4;
+        insns   = uint64_t(done) * lp.num_insns;
+        next_pc = 0;
+    } else {
+        uint32_t sum = ppc_state.gpr[lp.rs];
+        uint32_t val = 0;
+
+        for (; done < iters; done++, ptr += lp.size) {
+            switch (lp.size) {
+            case 1:
+                val = *ptr;
+                break;
+            case 2:
+                val = READ_WORD_BE_A(ptr);
+                break;
+            default:
+                val = READ_DWORD_BE_A(ptr);
+            }
+            sum += val;
+        }
+
+        ppc_state.gpr[lp.rs] = sum;
+        ppc_state.gpr[lp.ra] = ra + done * lp.size;
+        ppc_state.gpr[lp.rx] = val;
+        insns   = uint64_t(done) * lp.num_insns;
+        next_pc = 0;
+    }
+
+    ppc_state.spr[SPR::CTR] = ctr - done;
+
+    if (!next_pc)
+        next_pc = (ctr == done) ? lp.addr + lp.num_insns * 4 : lp.addr;
+
+    // account for the skipped instructions, the hook itself is counted by the caller
+    g_icycles += insns - 1;
+
+    this->num_skipped += insns;
+    this->num_handled[lp.kind]++;
+
+    hle_resume_at(next_pc);
+
+    return true;
+}
+
+void PostFastPathProfile::populate_variables(std::vector<ProfileVar>& vars)
+{
+    PostFastPath* post_fp = PostFastPath::get_instance();
+
+    vars.clear();
+
+    vars.push_back({.name = "Hooked loops",
+                    .format = ProfileVarFmt::DEC,
+                    .value = uint64_t(post_fp->num_hooks)});
+
+    for (int i = 0; i < NUM_KINDS; i++) {
+        vars.push_back({.name = std::string(kind_names[i]) + " pages handled",
+                        .format = ProfileVarFmt::DEC,
+                        .value = post_fp->num_handled[i]});
+
+        vars.push_back({.name = std::string(kind_names[i]) + " fallbacks",
+                        .format = ProfileVarFmt::DEC,
+                        .value = post_fp->num_fallbacks[i]});
+    }
+
+    vars.push_back({.name = "Instructions skipped",
+                    .format = ProfileVarFmt::DEC,
+                    .value = post_fp->num_skipped});
+}
+
+void PostFastPathProfile::reset()
+{
+    PostFastPath* post_fp = PostFastPath::get_instance();
+
+    for (int i = 0; i < NUM_KINDS; i++) {
+        post_fp->num_handled[i]   = 0;
+        post_fp->num_fallbacks[i] = 0;
+    }
+
+    post_fp->num_skipped = 0;
+}
@@ -0,0 +1,120 @@
+/*
+DingusPPC - The Experimental PowerPC Macintosh emulator
+Copyright (C) 2018-23 divingkatae and maximum
+                      (theweirdo)     spatium
+
+(Contact divingkatae#1017 or powermax#2286 on Discord for more info)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file Fast path for the memory loops of the ROM power-on self-test.
+
+    Before the OS starts, the ROM fills and verifies every RAM bank with
+    test patterns and checksums itself. These loops consist of a few
+    instructions executed billions of times in total. They are found by
+    scanning the ROM for their exact instruction sequences:
+    - fill:   stwu rS,4(rA); bdnz  or  stw rS,0(rA); addi rA,rA,4; bdnz
+    - verify: lwzu rX,4(rA); cmp[l]w crN,rX,rS; bne crN,fail; bdnz
+    - sum:    l[bhw]zu rX,n(rA); add rS,rS,rX; bdnz
+
+    A hooked loop runs on the host up to the end of the current memory
+    page. Registers, CR, CTR, memory contents and the instruction counter
+    are left exactly as if the guest had executed these iterations, and
+    the CPU continues at the loop head, its exit or the failure branch.
+    Loops touching anything other than RAM or ROM (memory sizing probes of
+    absent banks, controller registers) and loops running with external
+    interrupts enabled are executed by the guest code.
+
+    The hooks replace the first instruction of every match in ROM. Guest
+    code reading the ROM as data sees the hook opcode, and nothing but the
+    instruction pattern tells a self-test loop from other code. The fast
+    path is therefore only enabled on request (--post-fast-path).
+ */
+
+#ifndef POST_FAST_PATH_H
+#define POST_FAST_PATH_H
+
+#include <utils/profiler.h>
+
+#include <cinttypes>
+#include <vector>
+
+namespace PostLoops {
+
+enum LoopKind : int {
+    FILL_UPDATE = 0,    // stwu rS,4(rA); bdnz
+    FILL_INDEX,         // stw rS,0(rA); addi rA,rA,4; bdnz
+    VERIFY,             // lwzu rX,4(rA); cmp[l]w crN,rX,rS; bne crN,fail; bdnz
+    SUM,                // l[bhw]zu rX,n(rA); add rS,rS,rX; bdnz
+    NUM_KINDS
+};
+
+typedef struct PostLoop {
+    uint32_t    addr;       // address of the first loop instruction
+    int         kind;
+    int         num_insns;  // instructions per iteration
+    int         ra, rs, rx;
+    int         size;       // access size in bytes
+    int         crf;        // CR field set by the comparison
+    bool        cmp_signed;
+    bool        cmp_swapped;// rS is the first comparison operand
+    uint32_t    fail_addr;  // target of bne
+} PostLoop;
+
+}; // namespace PostLoops
+
+class PostFastPath {
+public:
+    static PostFastPath* get_instance() {
+        if (!post_fp_obj) {
+            post_fp_obj = new PostFastPath();
+        }
+        return post_fp_obj;
+    };
+
+    void enable();
+
+    // statistics
+    uint64_t num_handled[PostLoops::NUM_KINDS]   = {};
+    uint64_t num_fallbacks[PostLoops::NUM_KINDS] = {};
+    uint64_t num_skipped = 0;   // guest instructions executed on the host
+
+    int      num_hooks = 0;
+
+private:
+    PostFastPath() {};  // private constructor to implement a singleton
+
+    bool match_loop(const uint8_t* code, uint32_t addr, PostLoops::PostLoop& lp);
+    bool handle_call(int loop_idx);
+    uint8_t* map_page(uint32_t va, bool is_write);
+
+    static PostFastPath* post_fp_obj;
+
+    bool                            enabled = false;
+    std::vector<PostLoops::PostLoop> loops;
+    uint8_t                         page_buf[4096];
+};
+
+/** Profile showing how much of the self-test ran on the host. */
+class PostFastPathProfile : public BaseProfile {
+public:
+    PostFastPathProfile() : BaseProfile("PostFastPath") {};
+
+    void populate_variables(std::vector<ProfileVar>& vars);
+
+    void reset(void);
+};
+
+#endif // POST_FAST_PATH_H
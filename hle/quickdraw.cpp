@@ -0,0 +1,1062 @@
+/*
+DingusPPC - The Experimental PowerPC Macintosh emulator
+Copyright (C) 2018-23 divingkatae and maximum
+                      (theweirdo)     spatium
+
+(Contact divingkatae#1017 or powermax#2286 on Discord for more info)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file High-level emulation of frequently used QuickDraw routines. */
+
+#include <core/timermanager.h>
+#include <cpu/ppc/ppcemu.h>
+#include <cpu/ppc/ppchle.h>
+#include <cpu/ppc/ppcmmu.h>
+#include <debugger/symbols.h>
+#include <devices/common/iotrace.h>
+#include <devices/common/mmiodevice.h>
+#include <devices/memctrl/memctrlbase.h>
+#include <hle/quickdraw.h>
+#include <loguru.hpp>
+#include <memaccess.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <memory>
+
+using namespace QuickDraw;
+
+QuickDrawHLE* QuickDrawHLE::qd_hle_obj = nullptr;
+
+namespace {
+
+/** Thrown when a call has to be executed by the guest code. */
+struct Fallback {};
+
+// Mac OS low memory globals.
+enum : uint32_t {
+    ScrnBase    = 0x824,
+    CrsrRect    = 0x83C,
+    DeviceList  = 0x8A8,
+    CrsrVis     = 0x8CC,
+    CrsrBusy    = 0x8CD,
+    CurrentA5   = 0x904,
+    TheGDevice  = 0xCC8,
+    ToolTable   = 0xE00,
+};
+
+// Traps of the QuickDraw bottleneck procedures used by the hooked routines.
+enum : uint16_t {
+    _StdRect    = 0xA8A0,
+    _StdRgn     = 0xA8D1,
+    _StdBits    = 0xA8EB,
+};
+
+// Field offsets of CGrafPort.
+enum : uint32_t {
+    portPixMap  = 2,
+    portVersion = 6,
+    visRgn      = 24,
+    clipRgn     = 28,
+    bkPixPat    = 32,
+    rgbFgColor  = 36,
+    rgbBkColor  = 42,
+    pnMode      = 56,
+    pnPixPat    = 58,
+    pnVis       = 66,
+    fgColor     = 80,
+    bkColor     = 84,
+    picSave     = 92,
+    rgnSave     = 96,
+    polySave    = 100,
+    grafProcs   = 104,
+};
+
+const int srcCopy = 0;
+const int patCopy = 8;
+
+const int MAX_SCANS = 240; // give up looking for entry points after two minutes
+
+const struct {
+    const char* name;
+    uint16_t    trap;
+    uint32_t    proc_info;  // expected Mixed Mode procedure information
+} qd_routines[NUM_ROUTINES] = {
+    {"CopyBits",    0xA8EC, 0x3BFC0},
+    {"FillRect",    0xA8A5, 0x003C0},
+    {"PaintRect",   0xA8A2, 0x000C0},
+    {"ScrollRect",  0xA8EF, 0x03AC0},
+};
+
+/** Return host pointer to guest data, throws Fallback if it's not in memory. */
+uint8_t* guest_ptr(uint32_t va, uint32_t size, bool is_write = false)
+{
+    uint32_t pa;
+
+    if ((va & 0xFFFU) + size > 0x1000U || !mmu_translate_data(va, is_write, pa))
+        throw Fallback();
+
+    AddressMapEntry* rgn = mem_ctrl_instance->find_range(pa);
+
+    if (!rgn || !rgn->mem_ptr || !(rgn->type & (RT_ROM | RT_RAM)) ||
+        pa + size - 1 > rgn->end || (is_write && !(rgn->type & RT_RAM)))
+        throw Fallback();
+
+    return rgn->mem_ptr + (pa - rgn->start);
+}
+
+inline uint8_t rd8(uint32_t va) {
+    return *guest_ptr(va, 1);
+}
+
+inline uint16_t rd16(uint32_t va) {
+    uint8_t* p = guest_ptr(va, 2);
+    return READ_WORD_BE_U(p);
+}
+
+inline uint32_t rd32(uint32_t va) {
+    uint8_t* p = guest_ptr(va, 4);
+    return READ_DWORD_BE_U(p);
+}
+
+inline uint32_t deref(uint32_t handle) {
+    uint32_t ptr = handle ? rd32(handle) : 0;
+    if (!ptr)
+        throw Fallback();
+    return ptr;
+}
+
+Rect read_rect(uint32_t va) {
+    return Rect{(int16_t)rd16(va),     (int16_t)rd16(va + 2),
+                (int16_t)rd16(va + 4), (int16_t)rd16(va + 6)};
+}
+
+inline bool empty_rect(const Rect& r) {
+    return r.left >= r.right || r.top >= r.bottom;
+}
+
+inline Rect sect_rect(const Rect& a, const Rect& b) {
+    return Rect{std::max(a.top, b.top), std::max(a.left, b.left),
+                std::min(a.bottom, b.bottom), std::min(a.right, b.right)};
+}
+
+inline Rect offset_rect(const Rect& r, int dh, int dv) {
+    return Rect{r.top + dv, r.left + dh, r.bottom + dv, r.right + dh};
+}
+
+inline bool contains(const Rect& outer, const Rect& inner) {
+    return inner.left >= outer.left && inner.right <= outer.right &&
+           inner.top >= outer.top && inner.bottom <= outer.bottom;
+}
+
+inline uint32_t trap_addr(uint16_t trap) {
+    return ToolTable + (trap & 0x3FF) * 4;
+}
+
+/** Intersect two lists of [x0, x1) pairs. */
+void sect_spans(const std::vector<int>& a, const std::vector<int>& b,
+                std::vector<int>& out)
+{
+    out.clear();
+
+    for (size_t i = 0, j = 0; i < a.size() && j < b.size();) {
+        int lo = std::max(a[i], b[j]);
+        int hi = std::min(a[i + 1], b[j + 1]);
+        if (lo < hi) {
+            out.push_back(lo);
+            out.push_back(hi);
+        }
+        if (a[i + 1] < b[j + 1])
+            i += 2;
+        else
+            j += 2;
+    }
+}
+
+/** Load a PixMap record, only 8, 16 and 32 bpp chunky pixel maps are supported. */
+PixMap load_pixmap(uint32_t pm_addr)
+{
+    PixMap pm;
+
+    uint16_t row_bytes = rd16(pm_addr + 4);
+    if (!(row_bytes & 0x8000)) // a 1-bit BitMap
+        throw Fallback();
+
+    pm.addr       = pm_addr;
+    pm.base_addr  = rd32(pm_addr);
+    pm.row_bytes  = row_bytes & 0x3FFF;
+    pm.bounds     = read_rect(pm_addr + 6);
+    pm.pixel_size = rd16(pm_addr + 32);
+    pm.pm_table   = rd32(pm_addr + 42);
+
+    uint16_t pm_version = rd16(pm_addr + 14);
+    uint16_t pixel_type = rd16(pm_addr + 30);
+
+    // plain and 32-bit clean base addresses only
+    if (pm_version != 0 && pm_version != 4)
+        throw Fallback();
+
+    switch (pm.pixel_size) {
+    case 8:
+        if (pixel_type != 0) // chunky
+            throw Fallback();
+        break;
+    case 16:
+    case 32:
+        if (pixel_type != 16) // RGBDirect
+            throw Fallback();
+        break;
+    default:
+        throw Fallback();
+    }
+
+    if (empty_rect(pm.bounds) ||
+        pm.row_bytes < uint32_t(pm.bounds.right - pm.bounds.left) * (pm.pixel_size >> 3))
+        throw Fallback();
+
+    return pm;
+}
+
+/** Return the PixMap behind a BitMap pointer. */
+uint32_t resolve_bitmap(uint32_t bm_addr)
+{
+    // portBits of a CGrafPort: portPixMap followed by portVersion
+    if ((rd16(bm_addr + 4) & 0xC000) == 0xC000)
+        return deref(rd32(bm_addr));
+
+    return bm_addr;
+}
+
+/** Return the PixMap of the current graphics device. */
+PixMap get_device_pixmap()
+{
+    uint32_t gd = deref(rd32(TheGDevice));
+    return load_pixmap(deref(rd32(gd + 22)));
+}
+
+inline uint32_t mmio_read(AddressMapEntry* rgn, uint32_t offset, int size)
+{
+    uint32_t value = rgn->devobj->read(rgn->start, offset, size);
+
+    if (io_trace_enabled)
+        IoTracer::get_instance()->trace_mmio(rgn->devobj, rgn->start, offset,
+                                             value, size, false);
+
+    return value;
+}
+
+inline void mmio_write(AddressMapEntry* rgn, uint32_t offset, uint32_t value, int size)
+{
+    if (io_trace_enabled)
+        IoTracer::get_instance()->trace_mmio(rgn->devobj, rgn->start, offset,
+                                             value, size, true);
+
+    rgn->devobj->write(rgn->start, offset, value, size);
+}
+
+} // anonymous namespace
+
+void Region::load(uint32_t rgn_handle)
+{
+    uint32_t rgn      = deref(rgn_handle);
+    uint32_t rgn_size = rd16(rgn);
+
+    this->bounds = read_rect(rgn + 2);
+
+    this->band_top.clear();
+    this->band_xs.clear();
+
+    if (rgn_size < 10)
+        throw Fallback();
+
+    this->rect_rgn = rgn_size == 10;
+    if (this->rect_rgn) {
+        this->rect_xs = {this->bounds.left, this->bounds.right};
+        return;
+    }
+
+    // Region data consists of scanlines, each listing the points where
+    // the inside/outside state flips with respect to the previous scanline.
+    std::vector<int> cur_xs, inv_xs, new_xs;
+
+    uint32_t pos = rgn + 10;
+    uint32_t end = rgn + rgn_size;
+
+    while (true) {
+        if (pos + 2 > end)
+            throw Fallback();
+        int y = (int16_t)rd16(pos);
+        pos += 2;
+        if (y == 0x7FFF)
+            break;
+        if (!this->band_top.empty() && y <= this->band_top.back())
+            throw Fallback();
+
+        inv_xs.clear();
+        while (true) {
+            if (pos + 2 > end)
+                throw Fallback();
+            int x = (int16_t)rd16(pos);
+            pos += 2;
+            if (x == 0x7FFF)
+                break;
+            if (!inv_xs.empty() && x <= inv_xs.back())
+                throw Fallback();
+            inv_xs.push_back(x);
+        }
+
+        new_xs.clear();
+        std::set_symmetric_difference(cur_xs.begin(), cur_xs.end(),
+                                      inv_xs.begin(), inv_xs.end(),
+                                      std::back_inserter(new_xs));
+        cur_xs.swap(new_xs);
+
+        if (cur_xs.size() & 1)
+            throw Fallback();
+
+        this->band_top.push_back(y);
+        this->band_xs.push_back(cur_xs);
+    }
+}
+
+const std::vector<int>& Region::row_spans(int y) const
+{
+    if (this->rect_rgn) {
+        if (y >= this->bounds.top && y < this->bounds.bottom)
+            return this->rect_xs;
+        return this->no_xs;
+    }
+
+    auto it = std::upper_bound(this->band_top.begin(), this->band_top.end(), y);
+    if (it == this->band_top.begin())
+        return this->no_xs;
+
+    return this->band_xs[it - this->band_top.begin() - 1];
+}
+
+void QuickDrawHLE::enable()
+{
+    if (this->enabled)
+        return;
+
+    this->enabled = true;
+
+    gProfilerObj->register_profile("QuickDrawHLE",
+        std::unique_ptr<BaseProfile>(new QuickDrawProfile()));
+
+    // the trap table gets populated while the guest OS is booting
+    this->scan_timer = TimerManager::get_instance()->add_cyclic_timer(
+        MSECS_TO_NSECS(500), [this]() {
+            this->scan_entry_points();
+    });
+}
+
+void QuickDrawHLE::scan_entry_points()
+{
+    for (int i = 0; i < NUM_ROUTINES; i++) {
+        if (this->hook_ids[i] >= 0)
+            continue;
+
+        try {
+            if (this->install_hook(i, rd32(trap_addr(qd_routines[i].trap))))
+                continue;
+        } catch (Fallback&) {
+        }
+
+        // the trap may be patched, try a routine descriptor known by name
+        uint32_t sym_addr;
+
+        if (SymbolTable::get_instance()->find_by_name(qd_routines[i].name, sym_addr)) {
+            try {
+                this->install_hook(i, sym_addr);
+            } catch (Fallback&) {
+            }
+        }
+    }
+
+    if (this->num_hooks == NUM_ROUTINES || ++this->scan_count >= MAX_SCANS) {
+        TimerManager::get_instance()->cancel_timer(this->scan_timer);
+        LOG_F(INFO, "QuickDraw HLE: %d of %d routines hooked", this->num_hooks,
+              NUM_ROUTINES);
+    }
+}
+
+bool QuickDrawHLE::install_hook(int routine, uint32_t desc_addr)
+{
+    // Native Toolbox routines are reached through a Mixed Mode routine
+    // descriptor holding a transition vector for the PowerPC code.
+    if (rd16(desc_addr) != 0xAAFE)
+        return false;
+
+    uint32_t code_addr = 0;
+    int      num_recs  = rd16(desc_addr + 10) + 1;
+
+    for (int i = 0; i < std::min(num_recs, 16); i++) {
+        uint32_t rec = desc_addr + 12 + i * 20;
+
+        if (rd32(rec) != qd_routines[routine].proc_info)
+            continue;
+        if ((rd8(rec + 5) & 0xF) != 1) // kPowerPCISA
+            continue;
+
+        uint16_t flags = rd16(rec + 6);
+        if (flags & 0x22) // kProcDescriptorIsIndex | kFragmentNeedsPreparing
+            continue;
+
+        uint32_t tvec = rd32(rec + 8);
+        if (flags & 1) // kProcDescriptorIsRelative
+            tvec += desc_addr;
+
+        code_addr = rd32(tvec);
+        break;
+    }
+
+    if (!code_addr)
+        return false;
+
+    // Our handlers bypass the bottleneck procedures so they must still be
+    // the ones from ROM. Remember them to detect later patches.
+    if (!this->num_hooks) {
+        uint32_t bottlenecks[3];
+        int      i = 0;
+
+        for (uint16_t trap : {_StdBits, _StdRect, _StdRgn}) {
+            bottlenecks[i] = rd32(trap_addr(trap));
+            AddressMapEntry* rgn = mem_ctrl_instance->find_range(bottlenecks[i]);
+            if (!rgn || !(rgn->type & RT_ROM))
+                return false;
+            i++;
+        }
+
+        this->std_bits_addr = bottlenecks[0];
+        this->std_rect_addr = bottlenecks[1];
+        this->std_rgn_addr  = bottlenecks[2];
+    }
+
+    int hook_id = hle_install_hook(code_addr, qd_routines[routine].name,
+        [this, routine]() {
+            return this->handle_call(routine);
+    });
+
+    if (hook_id < 0)
+        return false;
+
+    this->hook_ids[routine] = hook_id;
+    this->num_hooks++;
+
+    return true;
+}
+
+bool QuickDrawHLE::bottlenecks_unpatched()
+{
+    return rd32(trap_addr(_StdBits)) == this->std_bits_addr &&
+           rd32(trap_addr(_StdRect)) == this->std_rect_addr &&
+           rd32(trap_addr(_StdRgn))  == this->std_rgn_addr;
+}
+
+bool QuickDrawHLE::handle_call(int routine)
+{
+    bool handled = false;
+
+    this->chunks.clear();
+    this->src_rows.clear();
+    this->dst_pieces.clear();
+    this->piece_offs.clear();
+    this->row_pieces.clear();
+    this->fill_pieces.clear();
+    this->clip_rgns.clear();
+
+    // nothing may be written to the guest memory before the last Fallback
+    try {
+        if (this->bottlenecks_unpatched()) {
+            switch (routine) {
+            case COPY_BITS:
+                handled = this->copy_bits();
+                break;
+            case FILL_RECT:
+                handled = this->fill_rect();
+                break;
+            case PAINT_RECT:
+                handled = this->paint_rect();
+                break;
+            case SCROLL_RECT:
+                handled = this->scroll_rect();
+                break;
+            }
+        }
+    } catch (Fallback&) {
+        handled = false;
+    }
+
+    if (handled)
+        this->num_handled[routine]++;
+    else
+        this->num_fallbacks[routine]++;
+
+    return handled;
+}
+
+uint32_t QuickDrawHLE::get_port(PixMap& pix_map)
+{
+    uint32_t port = rd32(rd32(rd32(CurrentA5)));
+
+    if ((rd16(port + portVersion) & 0xC000) != 0xC000) // not a CGrafPort
+        throw Fallback();
+
+    if (rd32(port + grafProcs) || rd32(port + picSave) || rd32(port + rgnSave) ||
+        rd32(port + polySave))
+        throw Fallback();
+
+    pix_map = load_pixmap(deref(rd32(port + portPixMap)));
+
+    return port;
+}
+
+void QuickDrawHLE::get_screens()
+{
+    this->screen_bases.clear();
+    this->num_devices = 0;
+
+    uint32_t gd_handle = rd32(DeviceList);
+
+    for (; gd_handle && this->num_devices < 8; this->num_devices++) {
+        uint32_t gd = deref(gd_handle);
+        this->screen_bases.push_back(rd32(deref(rd32(gd + 22))));
+        gd_handle = rd32(gd + 30); // gdNextGD
+    }
+
+    this->screen_bases.push_back(rd32(ScrnBase));
+}
+
+void QuickDrawHLE::check_cursor(const PixMap& pix_map, const Rect& r)
+{
+    if (std::find(this->screen_bases.begin(), this->screen_bases.end(),
+                  pix_map.base_addr) == this->screen_bases.end())
+        return; // offscreen
+
+    // the guest code splits drawing that spans several screens
+    if (this->num_devices > 1 || rd8(CrsrBusy))
+        throw Fallback();
+
+    if (!rd8(CrsrVis))
+        return;
+
+    // the guest code would hide a software cursor drawn over the area
+    Rect global = offset_rect(r, -pix_map.bounds.left, -pix_map.bounds.top);
+    if (!empty_rect(sect_rect(global, read_rect(CrsrRect))))
+        throw Fallback();
+}
+
+uint32_t QuickDrawHLE::get_solid_color(uint32_t port, uint32_t pat_addr,
+                                       const PixMap& pix_map, bool erase)
+{
+    uint32_t pat_hi = rd32(pat_addr);
+    uint32_t pat_lo = rd32(pat_addr + 4);
+    bool     use_fg;
+
+    if (pat_hi == 0xFFFFFFFFU && pat_lo == 0xFFFFFFFFU && !erase)
+        use_fg = true;
+    else if (!pat_hi && !pat_lo)
+        use_fg = false;
+    else
+        throw Fallback();
+
+    // pixel values in the port are computed for the current device
+    PixMap dev_pm = get_device_pixmap();
+    if (dev_pm.pixel_size != pix_map.pixel_size)
+        throw Fallback();
+
+    uint32_t rgb   = port + (use_fg ? rgbFgColor : rgbBkColor);
+    uint16_t red   = rd16(rgb);
+    uint16_t green = rd16(rgb + 2);
+    uint16_t blue  = rd16(rgb + 4);
+    uint32_t pixel = rd32(port + (use_fg ? fgColor : bkColor));
+
+    switch (pix_map.pixel_size) {
+    case 8: {
+        uint32_t ctab = deref(dev_pm.pm_table);
+        if (pixel > rd16(ctab + 6)) // ctSize
+            throw Fallback();
+        uint32_t entry = ctab + 8 + pixel * 8;
+        if (rd16(entry + 2) != red || rd16(entry + 4) != green || rd16(entry + 6) != blue)
+            throw Fallback();
+        break;
+    }
+    case 16:
+        if (pixel != uint32_t(((red >> 11) << 10) | ((green >> 11) << 5) | (blue >> 11)))
+            throw Fallback();
+        break;
+    case 32:
+        if (pixel != uint32_t(((red >> 8) << 16) | ((green >> 8) << 8) | (blue >> 8)))
+            throw Fallback();
+        break;
+    }
+
+    return pixel;
+}
+
+void QuickDrawHLE::load_clip(uint32_t port, Rect& r, bool dst_is_port)
+{
+    this->vis_rgn.load(rd32(port + visRgn));
+    this->clip_rgn.load(rd32(port + clipRgn));
+
+    if (dst_is_port) {
+        r = sect_rect(r, this->vis_rgn.bbox());
+        r = sect_rect(r, this->clip_rgn.bbox());
+        if (!this->vis_rgn.is_rect())
+            this->clip_rgns.push_back(&this->vis_rgn);
+        if (!this->clip_rgn.is_rect())
+            this->clip_rgns.push_back(&this->clip_rgn);
+    } else if (!empty_rect(r)) {
+        // whether the port's regions apply or not, they mustn't clip anything
+        if (!this->vis_rgn.is_rect() || !this->clip_rgn.is_rect() ||
+            !contains(this->vis_rgn.bbox(), r) || !contains(this->clip_rgn.bbox(), r))
+            throw Fallback();
+    }
+}
+
+void QuickDrawHLE::build_spans(const Rect& r, int y, std::vector<int>& spans)
+{
+    spans.assign({r.left, r.right});
+
+    for (auto rgn : this->clip_rgns) {
+        sect_spans(spans, rgn->row_spans(y), this->tmp_spans);
+        spans.swap(this->tmp_spans);
+    }
+}
+
+PixSpan QuickDrawHLE::map_pixels(uint32_t va, uint32_t len, bool is_write)
+{
+    PixSpan span = {uint32_t(this->chunks.size()), 0, len};
+
+    while (len) {
+        uint32_t chunk_len = std::min(len, 0x1000U - (va & 0xFFFU));
+        uint32_t pa;
+
+        if (!mmu_translate_data(va, is_write, pa))
+            throw Fallback();
+
+        AddressMapEntry* rgn = mem_ctrl_instance->find_range(pa);
+        if (!rgn || pa + chunk_len - 1 > rgn->end)
+            throw Fallback();
+
+        if (rgn->type & RT_MMIO) {
+            this->chunks.push_back({nullptr, rgn, pa - rgn->start, chunk_len});
+            span.count++;
+        } else if (rgn->mem_ptr && ((rgn->type & RT_RAM) ||
+                   (!is_write && (rgn->type & RT_ROM)))) {
+            uint8_t* host_ptr = rgn->mem_ptr + (pa - rgn->start);
+            PixChunk* prev = span.count ? &this->chunks.back() : nullptr;
+
+            // merge physically contiguous pages
+            if (prev && prev->host_ptr && prev->host_ptr + prev->len == host_ptr) {
+                prev->len += chunk_len;
+            } else {
+                this->chunks.push_back({host_ptr, nullptr, 0, chunk_len});
+                span.count++;
+            }
+        } else {
+            throw Fallback();
+        }
+
+        va  += chunk_len;
+        len -= chunk_len;
+    }
+
+    return span;
+}
+
+uint8_t* QuickDrawHLE::host_pixels(const PixSpan& span)
+{
+    return span.count == 1 ? this->chunks[span.first].host_ptr : nullptr;
+}
+
+void QuickDrawHLE::read_pixels(const PixSpan& span, uint8_t* buf)
+{
+    for (uint32_t i = span.first; i < span.first + span.count; i++) {
+        PixChunk& chunk = this->chunks[i];
+
+        if (chunk.host_ptr) {
+            std::memcpy(buf, chunk.host_ptr, chunk.len);
+            buf += chunk.len;
+            continue;
+        }
+
+        uint32_t offset = chunk.offset;
+        uint32_t len    = chunk.len;
+
+        for (; len && ((chunk.rgn->start + offset) & 3); len--)
+            *buf++ = mmio_read(chunk.rgn, offset++, 1);
+        for (; len >= 4; len -= 4, offset += 4, buf += 4)
+            WRITE_DWORD_BE_U(buf, mmio_read(chunk.rgn, offset, 4));
+        for (; len; len--)
+            *buf++ = mmio_read(chunk.rgn, offset++, 1);
+    }
+}
+
+void QuickDrawHLE::write_pixels(const PixSpan& span, const uint8_t* buf)
+{
+    for (uint32_t i = span.first; i < span.first + span.count; i++) {
+        PixChunk& chunk = this->chunks[i];
+
+        if (chunk.host_ptr) {
+            std::memcpy(chunk.host_ptr, buf, chunk.len);
+            buf += chunk.len;
+            continue;
+        }
+
+        uint32_t offset = chunk.offset;
+        uint32_t len    = chunk.len;
+
+        for (; len && ((chunk.rgn->start + offset) & 3); len--)
+            mmio_write(chunk.rgn, offset++, *buf++, 1);
+        for (; len >= 4; len -= 4, offset += 4, buf += 4)
+            mmio_write(chunk.rgn, offset, READ_DWORD_BE_U(buf), 4);
+        for (; len; len--)
+            mmio_write(chunk.rgn, offset++, *buf++, 1);
+    }
+}
+
+void QuickDrawHLE::plan_copy(const PixMap& src, const PixMap& dst, const Rect& r,
+                             int dh, int dv)
+{
+    uint32_t bpp = dst.pixel_size >> 3;
+
+    // go from the bottom up when moving pixels down within the same bitmap
+    bool bottom_up = src.base_addr == dst.base_addr && dv > 0;
+
+    for (int i = 0; i < r.bottom - r.top; i++) {
+        int y = bottom_up ? r.bottom - 1 - i : r.top + i;
+
+        this->build_spans(r, y, this->spans);
+        if (this->spans.empty())
+            continue;
+
+        int x0 = this->spans.front();
+        int x1 = this->spans.back();
+
+        uint32_t src_row = src.base_addr + (y - dv - src.bounds.top) * src.row_bytes;
+        uint32_t dst_row = dst.base_addr + (y - dst.bounds.top) * dst.row_bytes;
+
+        // the whole source extent of the row is read before writing
+        // so that pieces of the same row can overlap their sources
+        this->src_rows.push_back(this->map_pixels(
+            src_row + (x0 - dh - src.bounds.left) * bpp, (x1 - x0) * bpp, false));
+
+        for (size_t k = 0; k < this->spans.size(); k += 2) {
+            this->dst_pieces.push_back(this->map_pixels(
+                dst_row + (this->spans[k] - dst.bounds.left) * bpp,
+                (this->spans[k + 1] - this->spans[k]) * bpp, true));
+            this->piece_offs.push_back((this->spans[k] - x0) * bpp);
+        }
+
+        this->row_pieces.push_back(uint32_t(this->spans.size() >> 1));
+    }
+}
+
+void QuickDrawHLE::plan_fill(const PixMap& dst, const Rect& r)
+{
+    uint32_t bpp = dst.pixel_size >> 3;
+
+    for (int y = r.top; y < r.bottom; y++) {
+        this->build_spans(r, y, this->spans);
+
+        uint32_t dst_row = dst.base_addr + (y - dst.bounds.top) * dst.row_bytes;
+
+        for (size_t k = 0; k < this->spans.size(); k += 2) {
+            this->fill_pieces.push_back(this->map_pixels(
+                dst_row + (this->spans[k] - dst.bounds.left) * bpp,
+                (this->spans[k + 1] - this->spans[k]) * bpp, true));
+        }
+    }
+}
+
+void QuickDrawHLE::exec_copy(int pixel_size)
+{
+    uint32_t max_len = 0;
+
+    for (auto& src_span : this->src_rows)
+        max_len = std::max(max_len, src_span.len);
+
+    this->row_buf.resize(max_len);
+
+    uint32_t piece = 0;
+
+    for (size_t row = 0; row < this->src_rows.size(); row++) {
+        const PixSpan& src_span = this->src_rows[row];
+        uint32_t num_pieces = this->row_pieces[row];
+        uint8_t* src_ptr = this->host_pixels(src_span);
+        uint8_t* dst_ptr = this->host_pixels(this->dst_pieces[piece]);
+
+        if (num_pieces == 1 && src_ptr && dst_ptr) {
+            std::memmove(dst_ptr, src_ptr, src_span.len);
+        } else {
+            this->read_pixels(src_span, this->row_buf.data());
+            for (uint32_t k = piece; k < piece + num_pieces; k++)
+                this->write_pixels(this->dst_pieces[k],
+                                   this->row_buf.data() + this->piece_offs[k]);
+        }
+
+        for (uint32_t k = piece; k < piece + num_pieces; k++)
+            this->num_pixels += this->dst_pieces[k].len / (pixel_size >> 3);
+
+        piece += num_pieces;
+    }
+}
+
+void QuickDrawHLE::exec_fill(uint32_t pixel, int pixel_size)
+{
+    uint32_t max_len = 0;
+
+    for (auto& span : this->fill_pieces)
+        max_len = std::max(max_len, span.len);
+
+    // one row worth of pixels in guest byte order
+    this->row_buf.resize(max_len);
+
+    uint8_t* p = this->row_buf.data();
+
+    switch (pixel_size) {
+    case 8:
+        std::memset(p, pixel, max_len);
+        break;
+    case 16:
+        for (uint32_t i = 0; i < max_len; i += 2)
+            WRITE_WORD_BE_U(&p[i], pixel);
+        break;
+    case 32:
+        for (uint32_t i = 0; i < max_len; i += 4)
+            WRITE_DWORD_BE_U(&p[i], pixel);
+        break;
+    }
+
+    for (auto& span : this->fill_pieces) {
+        uint8_t* dst_ptr = this->host_pixels(span);
+
+        if (dst_ptr && pixel_size == 8)
+            std::memset(dst_ptr, pixel, span.len);
+        else
+            this->write_pixels(span, p);
+
+        this->num_pixels += span.len / (pixel_size >> 3);
+    }
+}
+
+bool QuickDrawHLE::copy_bits()
+{
+    uint32_t src_bits = ppc_state.gpr[3];
+    uint32_t dst_bits = ppc_state.gpr[4];
+    Rect     src_rect = read_rect(ppc_state.gpr[5]);
+    Rect     dst_rect = read_rect(ppc_state.gpr[6]);
+    int      mode     = (int16_t)ppc_state.gpr[7];
+    uint32_t mask_rgn = ppc_state.gpr[8];
+
+    if (mode != srcCopy || mask_rgn)
+        return false;
+
+    PixMap port_pm;
+    uint32_t port = this->get_port(port_pm);
+
+    PixMap src = load_pixmap(resolve_bitmap(src_bits));
+    PixMap dst = load_pixmap(resolve_bitmap(dst_bits));
+
+    // no depth conversion and no stretching
+    if (src.pixel_size != dst.pixel_size || empty_rect(src_rect) ||
+        src_rect.right - src_rect.left != dst_rect.right - dst_rect.left ||
+        src_rect.bottom - src_rect.top != dst_rect.bottom - dst_rect.top ||
+        !contains(src.bounds, src_rect))
+        return false;
+
+    // black foreground and white background, srcCopy colorizes otherwise
+    if (rd16(port + rgbFgColor) || rd16(port + rgbFgColor + 2) || rd16(port + rgbFgColor + 4))
+        return false;
+    if ((rd16(port + rgbBkColor) & rd16(port + rgbBkColor + 2) &
+         rd16(port + rgbBkColor + 4)) != 0xFFFF)
+        return false;
+
+    // indexed pixels are copied as is only if the color tables match
+    if (src.pixel_size == 8 &&
+        rd32(deref(src.pm_table)) != rd32(deref(get_device_pixmap().pm_table)))
+        return false;
+
+    int dh = dst_rect.left - src_rect.left;
+    int dv = dst_rect.top  - src_rect.top;
+
+    Rect r = sect_rect(dst_rect, dst.bounds);
+
+    this->load_clip(port, r, dst_bits == port + portPixMap || dst.addr == port_pm.addr);
+
+    if (empty_rect(r))
+        return true; // everything clipped away
+
+    this->get_screens();
+    this->check_cursor(dst, r);
+    this->check_cursor(src, offset_rect(r, -dh, -dv));
+
+    this->plan_copy(src, dst, r, dh, dv);
+    this->exec_copy(dst.pixel_size);
+
+    return true;
+}
+
+bool QuickDrawHLE::fill_port_rect(uint32_t port, const PixMap& pix_map, Rect r,
+                                  uint32_t pixel)
+{
+    r = sect_rect(r, pix_map.bounds);
+
+    this->load_clip(port, r, true);
+
+    if (empty_rect(r))
+        return true;
+
+    this->get_screens();
+    this->check_cursor(pix_map, r);
+
+    this->plan_fill(pix_map, r);
+    this->exec_fill(pixel, pix_map.pixel_size);
+
+    return true;
+}
+
+bool QuickDrawHLE::fill_rect()
+{
+    Rect r = read_rect(ppc_state.gpr[3]);
+
+    PixMap pix_map;
+    uint32_t port  = this->get_port(pix_map);
+    uint32_t pixel = this->get_solid_color(port, ppc_state.gpr[4], pix_map, false);
+
+    return this->fill_port_rect(port, pix_map, r, pixel);
+}
+
+bool QuickDrawHLE::paint_rect()
+{
+    Rect r = read_rect(ppc_state.gpr[3]);
+
+    PixMap pix_map;
+    uint32_t port = this->get_port(pix_map);
+
+    if ((int16_t)rd16(port + pnMode) != patCopy || (int16_t)rd16(port + pnVis) < 0)
+        return false;
+
+    uint32_t pix_pat = deref(rd32(port + pnPixPat));
+    if (rd16(pix_pat) != 0) // not an old-style pattern
+        return false;
+
+    uint32_t pixel = this->get_solid_color(port, pix_pat + 20, pix_map, false);
+
+    return this->fill_port_rect(port, pix_map, r, pixel);
+}
+
+bool QuickDrawHLE::scroll_rect()
+{
+    Rect     r       = read_rect(ppc_state.gpr[3]);
+    int      dh      = (int16_t)ppc_state.gpr[4];
+    int      dv      = (int16_t)ppc_state.gpr[5];
+    uint32_t upd_rgn = ppc_state.gpr[6];
+
+    // the vacated area is a rectangle only when scrolling along one axis
+    if (!dh == !dv)
+        return false;
+
+    PixMap pix_map;
+    uint32_t port = this->get_port(pix_map);
+
+    uint32_t bk_pat = deref(rd32(port + bkPixPat));
+    if (rd16(bk_pat) != 0)
+        return false;
+
+    uint32_t pixel = this->get_solid_color(port, bk_pat + 20, pix_map, true);
+
+    this->load_clip(port, r, true);
+
+    // complex regions produce a complex update region
+    if (!this->clip_rgns.empty() || empty_rect(r) || !contains(pix_map.bounds, r))
+        return false;
+
+    Rect moved   = sect_rect(offset_rect(r, dh, dv), r);
+    Rect vacated = r;
+
+    if (!empty_rect(moved)) {
+        if (dh > 0)
+            vacated.right = r.left + dh;
+        else if (dh < 0)
+            vacated.left = r.right + dh;
+        else if (dv > 0)
+            vacated.bottom = r.top + dv;
+        else
+            vacated.top = r.bottom + dv;
+    }
+
+    uint8_t* rgn_ptr = guest_ptr(deref(upd_rgn), 10, true);
+
+    this->get_screens();
+    this->check_cursor(pix_map, r);
+
+    if (!empty_rect(moved))
+        this->plan_copy(pix_map, pix_map, moved, dh, dv);
+    this->plan_fill(pix_map, vacated);
+
+    this->exec_copy(pix_map.pixel_size);
+    this->exec_fill(pixel, pix_map.pixel_size);
+
+    // the update region becomes the vacated rectangle
+    WRITE_WORD_BE_U(rgn_ptr, 10);
+    WRITE_WORD_BE_U(rgn_ptr + 2, vacated.top);
+    WRITE_WORD_BE_U(rgn_ptr + 4, vacated.left);
+    WRITE_WORD_BE_U(rgn_ptr + 6, vacated.bottom);
+    WRITE_WORD_BE_U(rgn_ptr + 8, vacated.right);
+
+    return true;
+}
+
+void QuickDrawProfile::populate_variables(std::vector<ProfileVar>& vars)
+{
+    QuickDrawHLE* qd_hle = QuickDrawHLE::get_instance();
+
+    vars.clear();
+
+    vars.push_back({.name = "Hooked routines",
+                    .format = ProfileVarFmt::DEC,
+                    .value = uint64_t(qd_hle->num_hooks)});
+
+    for (int i = 0; i < NUM_ROUTINES; i++) {
+        vars.push_back({.name = std::string(qd_routines[i].name) + " handled",
+                        .format = ProfileVarFmt::DEC,
+                        .value = qd_hle->num_handled[i]});
+
+        vars.push_back({.name = std::string(qd_routines[i].name) + " fallbacks",
+                        .format = ProfileVarFmt::DEC,
+                        .value = qd_hle->num_fallbacks[i]});
+    }
+
+    vars.push_back({.name = "Pixels written",
+                    .format = ProfileVarFmt::DEC,
+                    .value = qd_hle->num_pixels});
+}
+
+void QuickDrawProfile::reset()
+{
+    QuickDrawHLE* qd_hle = QuickDrawHLE::get_instance();
+
+    for (int i = 0; i < NUM_ROUTINES; i++) {
+        qd_hle->num_handled[i]   = 0;
+        qd_hle->num_fallbacks[i] = 0;
+    }
+
+    qd_hle->num_pixels = 0;
+}
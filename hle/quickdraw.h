@@ -0,0 +1,205 @@
+/*
+DingusPPC - The Experimental PowerPC Macintosh emulator
+Copyright (C) 2018-23 divingkatae and maximum
+                      (theweirdo)     spatium
+
+(Contact divingkatae#1017 or powermax#2286 on Discord for more info)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file High-level emulation of frequently used QuickDraw routines.
+
+    Classic Mac OS spends a large share of its time in CopyBits, FillRect,
+    PaintRect and ScrollRect. When enabled, the native PowerPC implementations
+    of these routines are located through the Toolbox trap dispatch table or
+    the guest symbol table and hooked. The common cases are then performed
+    on the host:
+    - srcCopy transfers between pixel maps of the same depth
+    - solid pattern fills
+    - single-axis scrolls
+    clipped to the bitmap bounds and the visible and clipping regions.
+
+    Before touching guest memory, each handler checks that its result will
+    be identical to that of the guest code: color port without bottleneck
+    procedures, no picture/region/polygon recording, standard colors, the
+    cursor not in the way and all pixel rows accessible. Any call failing
+    these checks is executed by the guest code.
+ */
+
+#ifndef QUICKDRAW_HLE_H
+#define QUICKDRAW_HLE_H
+
+#include <utils/profiler.h>
+
+#include <cinttypes>
+#include <string>
+#include <vector>
+
+struct AddressMapEntry;
+
+namespace QuickDraw {
+
+enum Routine : int {
+    COPY_BITS = 0,
+    FILL_RECT,
+    PAINT_RECT,
+    SCROLL_RECT,
+    NUM_ROUTINES
+};
+
+typedef struct Rect {
+    int top, left, bottom, right;
+} Rect;
+
+typedef struct PixMap {
+    uint32_t    addr;       // guest address of the PixMap record
+    uint32_t    base_addr;
+    uint32_t    row_bytes;
+    Rect        bounds;
+    int         pixel_size;
+    uint32_t    pm_table;   // CTabHandle
+} PixMap;
+
+/** Region decoded into horizontal spans. */
+class Region {
+public:
+    void load(uint32_t rgn_handle);
+
+    bool is_rect() const { return this->rect_rgn; };
+    const Rect& bbox() const { return this->bounds; };
+
+    /** Return the [x0, x1) pairs covered by the region on row y. */
+    const std::vector<int>& row_spans(int y) const;
+
+private:
+    Rect    bounds;
+    bool    rect_rgn;
+
+    std::vector<int>                band_top;
+    std::vector<std::vector<int>>   band_xs;
+    std::vector<int>                rect_xs;
+    std::vector<int>                no_xs;
+};
+
+/** Span of guest pixel memory split into host accessible chunks. */
+typedef struct PixSpan {
+    uint32_t    first;      // index of the first chunk
+    uint32_t    count;      // number of chunks
+    uint32_t    len;        // total length in bytes
+} PixSpan;
+
+typedef struct PixChunk {
+    uint8_t*            host_ptr;   // nullptr for MMIO chunks
+    AddressMapEntry*    rgn;        // MMIO region
+    uint32_t            offset;     // offset into the MMIO region
+    uint32_t            len;
+} PixChunk;
+
+}; // namespace QuickDraw
+
+class QuickDrawHLE {
+public:
+    static QuickDrawHLE* get_instance() {
+        if (!qd_hle_obj) {
+            qd_hle_obj = new QuickDrawHLE();
+        }
+        return qd_hle_obj;
+    };
+
+    void enable();
+
+    // statistics
+    uint64_t num_handled[QuickDraw::NUM_ROUTINES]   = {};
+    uint64_t num_fallbacks[QuickDraw::NUM_ROUTINES] = {};
+    uint64_t num_pixels = 0;
+
+    int      num_hooks = 0;
+
+private:
+    QuickDrawHLE() {};  // private constructor to implement a singleton
+
+    void scan_entry_points();
+    bool install_hook(int routine, uint32_t desc_addr);
+    bool bottlenecks_unpatched();
+    bool handle_call(int routine);
+
+    bool copy_bits();
+    bool fill_rect();
+    bool paint_rect();
+    bool scroll_rect();
+    bool fill_port_rect(uint32_t port, const QuickDraw::PixMap& pix_map,
+                        QuickDraw::Rect r, uint32_t pixel);
+
+    // helpers shared by the handlers
+    uint32_t get_port(QuickDraw::PixMap& pix_map);
+    uint32_t get_solid_color(uint32_t port, uint32_t pat_addr,
+                             const QuickDraw::PixMap& pix_map, bool erase);
+    void get_screens();
+    void check_cursor(const QuickDraw::PixMap& pix_map, const QuickDraw::Rect& r);
+    void load_clip(uint32_t port, QuickDraw::Rect& r, bool dst_is_port);
+    void build_spans(const QuickDraw::Rect& r, int y, std::vector<int>& spans);
+
+    // pixel access, all rows are mapped before anything is written
+    QuickDraw::PixSpan map_pixels(uint32_t va, uint32_t len, bool is_write);
+    uint8_t* host_pixels(const QuickDraw::PixSpan& span);
+    void read_pixels(const QuickDraw::PixSpan& span, uint8_t* buf);
+    void write_pixels(const QuickDraw::PixSpan& span, const uint8_t* buf);
+
+    void plan_copy(const QuickDraw::PixMap& src, const QuickDraw::PixMap& dst,
+                   const QuickDraw::Rect& r, int dh, int dv);
+    void plan_fill(const QuickDraw::PixMap& dst, const QuickDraw::Rect& r);
+    void exec_copy(int pixel_size);
+    void exec_fill(uint32_t pixel, int pixel_size);
+
+    static QuickDrawHLE* qd_hle_obj;
+
+    bool        enabled     = false;
+    uint32_t    scan_timer  = 0;
+    int         scan_count  = 0;
+    int         hook_ids[QuickDraw::NUM_ROUTINES] = {-1, -1, -1, -1};
+
+    // bottleneck trap addresses recorded when the first hook was installed
+    uint32_t    std_bits_addr = 0;
+    uint32_t    std_rect_addr = 0;
+    uint32_t    std_rgn_addr  = 0;
+
+    // per-call state, kept here to reuse allocations
+    std::vector<uint32_t>           screen_bases;
+    int                             num_devices = 0;
+    QuickDraw::Region               vis_rgn;
+    QuickDraw::Region               clip_rgn;
+    std::vector<const QuickDraw::Region*> clip_rgns;
+    std::vector<int>                spans;
+    std::vector<int>                tmp_spans;
+    std::vector<QuickDraw::PixChunk> chunks;
+    std::vector<QuickDraw::PixSpan> src_rows;   // source extent of each row
+    std::vector<QuickDraw::PixSpan> dst_pieces; // destination spans of all rows
+    std::vector<uint32_t>           piece_offs; // offset of each piece in its row
+    std::vector<uint32_t>           row_pieces; // number of pieces of each row
+    std::vector<QuickDraw::PixSpan> fill_pieces;
+    std::vector<uint8_t>            row_buf;
+};
+
+/** Profile showing how many QuickDraw calls were handled on the host. */
+class QuickDrawProfile : public BaseProfile {
+public:
+    QuickDrawProfile() : BaseProfile("QuickDrawHLE") {};
+
+    void populate_variables(std::vector<ProfileVar>& vars);
+
+    void reset(void);
+};
+
+#endif // QUICKDRAW_HLE_H
@@ -19,6 +19,7 @@ You should have received a copy of the GNU General Public License
 along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 
+#include <cpu/ppc/ppcemu.h>
 #include <devices/common/hwcomponent.h>
 #include <loguru.hpp>
 #include <machines/machinebase.h>
@@ -78,6 +79,18 @@ HWComponent* MachineBase::get_comp_by_type(HWCompType type) {
     }
 }
 
+/* Look up a component by the name it reports via get_name(), which
+   can differ from the name it was registered under. */
+HWComponent* MachineBase::get_comp_by_dev_name(std::string dev_name) {
+    for (auto it = this->device_map.begin(); it != this->device_map.end(); it++) {
+        if (it->second->get_name() == dev_name) {
+            return it->second.get();
+        }
+    }
+
+    return nullptr;
+}
+
 int MachineBase::postinit_devices()
 {
     // Allow additional devices to be registered by device_postinit, in which
@@ -97,3 +110,31 @@ int MachineBase::postinit_devices()
 
     return 0;
 }
+
+void MachineBase::request_reset()
+{
+    this->reset_requested = true;
+    power_on = false;
+}
+
+void MachineBase::request_power_off()
+{
+    this->power_off_requested = true;
+    power_on = false;
+}
+
+/* Return all devices and the CPU to their power-on state. Memory, ROM,
+   NVRAM and attached images are left as they are, like on a real restart. */
+void MachineBase::reset()
+{
+    LOG_F(INFO, "Resetting machine %s", this->name.c_str());
+
+    for (auto it = this->device_map.begin(); it != this->device_map.end(); it++) {
+        it->second->reset();
+    }
+
+    ppc_cpu_reset();
+
+    this->reset_requested = false;
+    power_on = true;
+}
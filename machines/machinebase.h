@@ -42,10 +42,23 @@ public:
     void add_device(std::string name, std::unique_ptr<HWComponent> dev_obj);
     HWComponent* get_comp_by_name(std::string name);
     HWComponent* get_comp_by_type(HWCompType type);
+    HWComponent* get_comp_by_dev_name(std::string dev_name);
     int postinit_devices();
 
+    // Warm reset support. request_reset() stops the CPU at the next
+    // opportunity, the execution loop then calls reset() and resumes.
+    void request_reset();
+    bool reset_pending() { return this->reset_requested; };
+    void reset();
+
+    // Guest initiated power off, the execution loop exits for good.
+    void request_power_off();
+    bool power_off_pending() { return this->power_off_requested; };
+
 private:
     std::string name;
+    bool        reset_requested = false;
+    bool        power_off_requested = false;
     std::map<std::string, std::unique_ptr<HWComponent>> device_map;
 };
 
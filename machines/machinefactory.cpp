@@ -24,6 +24,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
     Author: Max Poliakovski
  */
 
+#include <cpu/ppc/ppcemu.h>
 #include <devices/common/hwcomponent.h>
 #include <devices/deviceregistry.h>
 #include <devices/memctrl/memctrlbase.h>
@@ -33,10 +34,14 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <machines/machinefactory.h>
 #include <machines/machineproperties.h>
 #include <memaccess.h>
+#include <utils/phasetimer.h>
 
+#include <algorithm>
 #include <cinttypes>
 #include <cstring>
 #include <fstream>
+#include <functional>
+#include <future>
 #include <tuple>
 #include <iostream>
 #include <iomanip>
@@ -81,6 +86,7 @@ static const map<string, string> PropHelp = {
     {"fdd_wr_prot",     "toggles floppy disk's write protection"},
     {"hdd_img",         "specifies path to hard disk image"},
     {"hdd_wr_prot",     "toggles hard disk's write protection"},
+    {"hdd_sync",        "when hard disk writes are committed to the host disk"},
     {"cdr_config",      "CD-ROM device path in [bus]:[device#] format"},
     {"cdr_img",         "specifies path to CD-ROM image"},
     {"mon_id",          "specifies which monitor to emulate"},
@@ -88,6 +94,7 @@ static const map<string, string> PropHelp = {
     {"pci_B1",          "insert a PCI device into B1 slot"},
     {"pci_C1",          "insert a PCI device into C1 slot"},
     {"serial_backend",  "specifies the backend for the serial port"},
+    {"enet_switch",     "name of the virtual Ethernet switch to connect to"},
     {"emmo",            "enables/disables factory HW tests during startup"},
 };
 
@@ -123,6 +130,8 @@ void MachineFactory::create_device(string& dev_name, DeviceDescription& dev)
 
 int MachineFactory::create(string& mach_id)
 {
+    PhaseTimer phase("Machine creation");
+
     auto it = get_registry().find(mach_id);
     if (it == get_registry().end()) {
         LOG_F(ERROR, "Unknown machine id %s", mach_id.c_str());
@@ -328,13 +337,29 @@ bail_out:
     return machine_name;
 }
 
-/* Read ROM file content and transfer it to the dedicated ROM region */
-int MachineFactory::load_boot_rom(string& rom_filepath) {
+/* The checksum of Old World ROMs covers the 68k ROM image only, i.e. the
+   16-bit words following the checksum up to the PowerPC part starting at
+   3 MB (see ConfigInfo in machine_name_from_rom). */
+uint32_t MachineFactory::calc_rom_checksum(const uint8_t* rom_data, size_t rom_size)
+{
+    size_t   csum_end = std::min<size_t>(rom_size, 0x300000UL);
+    uint32_t checksum = 0;
+
+    for (size_t offset = 4; offset + 1 < csum_end; offset += 2)
+        checksum += READ_WORD_BE_A(&rom_data[offset]);
+
+    return checksum;
+}
+
+/* Read ROM file content into memory and verify its checksum.
+   This doesn't touch the machine object and may run on any thread. */
+int MachineFactory::read_boot_rom(string& rom_filepath, vector<uint8_t>& rom_data,
+                                  uint32_t& rom_load_addr)
+{
+    PhaseTimer phase("ROM load");
+
     ifstream rom_file;
     size_t   file_size;
-    int      result = 0;
-    uint32_t rom_load_addr;
-    AddressMapEntry *rom_reg;
 
     rom_file.open(rom_filepath, ios::in | ios::binary);
     if (rom_file.fail()) {
@@ -353,37 +378,64 @@ int MachineFactory::load_boot_rom(string& rom_filepath) {
         rom_load_addr = 0xFFF00000UL;
     } else {
         LOG_F(ERROR, "Unxpected ROM File size: %zu bytes.", file_size);
-        result = -1;
+        rom_file.close();
+        return -1;
     }
 
-    if (!result) {
-        unsigned char* sysrom_mem = new unsigned char[file_size];
+    rom_data.resize(file_size);
+    rom_file.read((char*)rom_data.data(), file_size);
+    rom_file.close();
 
-        rom_file.seekg(0, ios::beg);
-        rom_file.read((char*)sysrom_mem, file_size);
+    // Old World ROMs start with a checksum of their 68k ROM image
+    if (file_size == 0x400000UL) {
+        uint32_t stored_sum = READ_DWORD_BE_A(rom_data.data());
+        uint32_t calc_sum   = calc_rom_checksum(rom_data.data(), file_size);
 
-        MemCtrlBase* mem_ctrl = dynamic_cast<MemCtrlBase*>(
-            gMachineObj->get_comp_by_type(HWCompType::MEM_CTRL));
+        if (calc_sum != stored_sum)
+            LOG_F(WARNING, "ROM checksum mismatch: expected 0x%08X, got 0x%08X",
+                  stored_sum, calc_sum);
+        else
+            LOG_F(INFO, "ROM checksum: 0x%08X", calc_sum);
+    }
 
-        if ((rom_reg = mem_ctrl->find_rom_region())) {
-            mem_ctrl->set_data(rom_load_addr, sysrom_mem, (uint32_t)file_size);
-        } else {
-            LOG_F(ERROR, "Could not locate physical ROM region!");
-            result = -1;
-        }
+    return 0;
+}
 
-        delete[] sysrom_mem;
+/* Transfer ROM content to the dedicated ROM region */
+int MachineFactory::load_boot_rom(vector<uint8_t>& rom_data, uint32_t rom_load_addr) {
+    MemCtrlBase* mem_ctrl = dynamic_cast<MemCtrlBase*>(
+        gMachineObj->get_comp_by_type(HWCompType::MEM_CTRL));
+
+    if (!mem_ctrl->find_rom_region()) {
+        LOG_F(ERROR, "Could not locate physical ROM region!");
+        return -1;
     }
 
-    rom_file.close();
+    mem_ctrl->set_data(rom_load_addr, rom_data.data(), (uint32_t)rom_data.size());
 
-    return result;
+    return 0;
 }
 
+
 int MachineFactory::create_machine_for_id(string& id, string& rom_filepath) {
-    if (MachineFactory::create(id) < 0 || load_boot_rom(rom_filepath) < 0) {
+    vector<uint8_t> rom_data;
+    uint32_t        rom_load_addr;
+
+    // The boot ROM and CPU opcode tables don't depend on the machine
+    // object so prepare them while the devices get constructed.
+    auto rom_done = std::async(std::launch::async, read_boot_rom,
+                               std::ref(rom_filepath), std::ref(rom_data),
+                               std::ref(rom_load_addr));
+
+    ppc_prebuild_opcode_tables();
+
+    int result = MachineFactory::create(id);
+
+    if (rom_done.get() < 0 || result < 0) {
         return -1;
     }
 
-    return 0;
+    PhaseTimer phase("ROM transfer");
+
+    return load_boot_rom(rom_data, rom_load_addr);
 }
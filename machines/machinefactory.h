@@ -29,6 +29,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include <machines/machineproperties.h>
 
+#include <cinttypes>
 #include <map>
 #include <string>
 #include <vector>
@@ -54,6 +55,9 @@ public:
 
     static string machine_name_from_rom(string& rom_filepath);
 
+    /** Compute the checksum stored in the first 4 bytes of Old World ROMs. */
+    static uint32_t calc_rom_checksum(const uint8_t* rom_data, size_t rom_size);
+
     static int create(string& mach_id);
     static int create_machine_for_id(string& id, string& rom_filepath);
 
@@ -68,7 +72,9 @@ private:
     static void print_settings(PropMap& p);
     static void list_device_settings(DeviceDescription& dev);
     static void get_device_settings(DeviceDescription& dev, map<string, string> &settings);
-    static int  load_boot_rom(string& rom_filepath);
+    static int  read_boot_rom(string& rom_filepath, vector<uint8_t>& rom_data,
+                              uint32_t& rom_load_addr);
+    static int  load_boot_rom(vector<uint8_t>& rom_data, uint32_t rom_load_addr);
 
     static map<string, MachineDescription> & get_registry() {
         static map<string, MachineDescription> machine_registry;
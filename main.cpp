@@ -26,8 +26,22 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <core/timermanager.h>
 #include <cpu/ppc/ppcemu.h>
 #include <debugger/debugger.h>
+#include <debugger/perfmap.h>
+#include <debugger/symbols.h>
+#include <devices/common/hwcomponent.h>
+#include <devices/common/iotrace.h>
+#include <devices/memctrl/memctrlbase.h>
+#include <devices/video/rfbserver.h>
+#include <hle/mixedmode.h>
+#include <hle/ofaccel.h>
+#include <hle/postfast.h>
+#include <hle/quickdraw.h>
 #include <machines/machinebase.h>
 #include <machines/machinefactory.h>
+#include <utils/coldpages.h>
+#include <utils/hostmem.h>
+#include <utils/pageheat.h>
+#include <utils/phasetimer.h>
 #include <utils/profiler.h>
 #include <main.h>
 
@@ -35,19 +49,34 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <csignal>
 #include <cstring>
 #include <iostream>
+#include <set>
 #include <CLI11.hpp>
 #include <loguru.hpp>
 
 using namespace std;
 
+// exit status after the guest powered the machine off
+static int power_off_status = 0;
+
 void sigint_handler(int signum) {
+    int status = 0;
+
     enter_debugger();
 
+    if (gMachineObj && gMachineObj->power_off_pending()) {
+        LOG_F(INFO, "Guest powered the machine off");
+        status = power_off_status;
+    }
+
     LOG_F(INFO, "Shutting down...");
 
+    RfbServer::get_instance()->stop();
+    IoTracer::get_instance()->stop();
+    PageHeatTracker::get_instance()->stop();
+    PerfMap::get_instance()->stop();
     delete gMachineObj.release();
     cleanup();
-    exit(0);
+    exit(status);
 }
 
 void sigabrt_handler(int signum) {
@@ -75,8 +104,29 @@ int main(int argc, char** argv) {
     app.allow_extras();
 
     bool   realtime_enabled, debugger_enabled;
+    bool   qd_hle_enabled = false;
+    bool   of_accel_enabled = false;
+    bool   mm_accel_enabled = false;
+    bool   post_fast_path_enabled = false;
+    bool   perf_map = false;
+    uint32_t zero_scan_secs = 0;
+    uint32_t cold_page_secs = 0;
+    uint32_t cold_page_age = 3;
+    uint32_t cold_pool_mb = 0;
+    uint32_t pc_sample_usecs = 0;
+    uint32_t page_heat_msecs = 0;
+    int    exit_status = 0;
+    int    rfb_port = 0;
+    string rfb_addr("127.0.0.1");
     string machine_str;
     string bootrom_path("bootrom.bin");
+    string mem_layout_path;
+    string io_trace_path;
+    string page_heat_path;
+    vector<string> io_trace_srcs;
+    vector<string> symbol_maps;
+    string symbol_dir;
+    string jitdump_dir;
 
     app.add_flag("-r,--realtime", realtime_enabled,
         "Run the emulator in real-time");
@@ -87,6 +137,74 @@ int main(int argc, char** argv) {
     app.add_option("-b,--bootrom", bootrom_path, "Specifies BootROM path")
         ->check(CLI::ExistingFile);
 
+    app.add_option("--zero-scan", zero_scan_secs,
+        "Return all-zero guest RAM pages to the host every N seconds");
+
+    app.add_option("--cold-pages", cold_page_secs,
+        "Compress guest RAM pages left unused, scanning every N seconds");
+
+    app.add_option("--cold-page-age", cold_page_age,
+        "Scans without access before RAM pages get compressed (default: 3)");
+
+    app.add_option("--cold-pool-mb", cold_pool_mb,
+        "Limit compressed RAM storage to N megabytes (default: no limit)");
+
+    app.add_option("--page-heat", page_heat_msecs,
+        "Track guest page heat and working sets in windows of N ms (virtual time)");
+
+    app.add_option("--page-heat-file", page_heat_path,
+        "Write the page heat report to this file on exit");
+
+    app.add_option("--export-mem", mem_layout_path,
+        "Back guest RAM/VRAM with shared memory and write its layout to this file");
+
+    app.add_option("--io-trace", io_trace_path,
+        "Capture device MMIO, DMA and interrupt activity to this file");
+
+    app.add_option("--io-trace-src", io_trace_srcs,
+        "Comma-separated device and DMA channel names to capture (default: all)")
+        ->delimiter(',');
+
+    app.add_option("--symbols", symbol_maps,
+        "Load guest symbols from this map file (may be repeated)")
+        ->check(CLI::ExistingFile);
+
+    app.add_option("--symbol-dir", symbol_dir,
+        "Directory with symbol maps named after the ROM checksum")
+        ->check(CLI::ExistingDirectory);
+
+    app.add_option("--pc-sample", pc_sample_usecs,
+        "Sample guest PC every N microseconds for the GuestCode profile");
+
+    app.add_flag("--perf-map", perf_map,
+        "Attribute host perf samples to guest code via /tmp/perf-<pid>.map");
+
+    app.add_option("--perf-jitdump", jitdump_dir,
+        "Also write a jitdump for perf inject --jit to this directory (implies --perf-map)")
+        ->check(CLI::ExistingDirectory);
+
+    app.add_flag("--qd-hle", qd_hle_enabled,
+        "Perform common QuickDraw operations on the host");
+
+    app.add_flag("--post-fast-path", post_fast_path_enabled,
+        "Run the memory loops of the ROM self-test on the host (patches ROM code)");
+
+    app.add_flag("--of-accel", of_accel_enabled,
+        "Execute Open Firmware Forth primitives on the host");
+
+    app.add_flag("--mm-accel", mm_accel_enabled,
+        "Shortcut native to native CallUniversalProc calls");
+
+    app.add_option("--power-off-status", power_off_status,
+        "Exit status reported when the guest powers the machine off (default: 0)");
+
+    app.add_option("--rfb-port", rfb_port,
+        "Serve the screen to VNC clients on this TCP port")
+        ->check(CLI::Range(1, 65535));
+
+    app.add_option("--rfb-addr", rfb_addr,
+        "Address the VNC server listens on (default: 127.0.0.1)");
+
     CLI::Option* machine_opt = app.add_option("-m,--machine",
         machine_str, "Specify machine ID");
 
@@ -163,18 +281,123 @@ int main(int argc, char** argv) {
     cout << "BootROM path: " << bootrom_path << endl;
     cout << "Execution mode: " << execution_mode << endl;
 
-    if (!init()) {
-        LOG_F(ERROR, "Cannot initialize");
-        return 1;
+    {
+        PhaseTimer phase("Host init");
+
+        if (!init()) {
+            LOG_F(ERROR, "Cannot initialize");
+            return 1;
+        }
     }
 
     // initialize global profiler object
     gProfilerObj.reset(new Profiler());
 
+    gProfilerObj->register_profile("Startup",
+        std::unique_ptr<BaseProfile>(new PhaseProfile()));
+
+    // must be selected before guest memory gets allocated
+    host_mem_set_export(!mem_layout_path.empty());
+
     if (MachineFactory::create_machine_for_id(machine_str, bootrom_path) < 0) {
         goto bail;
     }
 
+    if (MemCtrlBase* mem_ctrl = dynamic_cast<MemCtrlBase*>(
+            gMachineObj->get_comp_by_type(HWCompType::MEM_CTRL))) {
+        gProfilerObj->register_profile("HostMem",
+            std::unique_ptr<BaseProfile>(new HostMemProfile(mem_ctrl)));
+
+        if (host_mem_export_enabled())
+            mem_ctrl->write_mem_layout(mem_layout_path);
+
+        if (zero_scan_secs) {
+            TimerManager::get_instance()->add_cyclic_timer(
+                uint64_t(zero_scan_secs) * ONE_BILLION_NS, [mem_ctrl] {
+                    mem_ctrl->release_zero_pages();
+            });
+        }
+
+        if (cold_page_secs && mem_ctrl->enable_cold_pages()) {
+            ColdPageCompactor::get_instance()->set_thresholds(
+                cold_page_age, uint64_t(cold_pool_mb) << 20);
+
+            gProfilerObj->register_profile("ColdPages",
+                std::unique_ptr<BaseProfile>(new ColdPageProfile()));
+
+            TimerManager::get_instance()->add_cyclic_timer(
+                uint64_t(cold_page_secs) * ONE_BILLION_NS, [] {
+                    ColdPageCompactor::get_instance()->scan();
+            });
+        }
+
+        if (page_heat_msecs && PageHeatTracker::get_instance()->start(mem_ctrl, page_heat_path)) {
+            TimerManager::get_instance()->add_cyclic_timer(
+                MSECS_TO_NSECS(uint64_t(page_heat_msecs)), [] {
+                    PageHeatTracker::get_instance()->end_window(get_virt_time_ns());
+            });
+        }
+
+        // collect guest symbols for the debugger, the GuestCode profile and HLE
+        if (debugger_enabled || pc_sample_usecs || !symbol_maps.empty() ||
+            !symbol_dir.empty() || perf_map || !jitdump_dir.empty() || mm_accel_enabled) {
+            PhaseTimer phase("Symbol loading");
+
+            SymbolTable* sym_table = SymbolTable::get_instance();
+
+            if (AddressMapEntry* rom_entry = mem_ctrl->find_rom_region())
+                sym_table->scan_guest_memory(rom_entry->start,
+                                             rom_entry->end - rom_entry->start + 1);
+
+            if (!symbol_dir.empty())
+                sym_table->load_rom_map(symbol_dir);
+
+            for (auto& map_path : symbol_maps)
+                sym_table->load_map_file(map_path);
+        }
+    }
+
+    if (pc_sample_usecs) {
+        gProfilerObj->register_profile("GuestCode",
+            std::unique_ptr<BaseProfile>(new GuestCodeProfile()));
+
+        TimerManager::get_instance()->add_cyclic_timer(
+            USECS_TO_NSECS(uint64_t(pc_sample_usecs)), [] {
+                SymbolTable::get_instance()->record_sample(ppc_state.pc);
+        });
+    }
+
+    // must come before HLE hooks get installed so the ROM checksum is intact
+    if (perf_map || !jitdump_dir.empty()) {
+        if (!PerfMap::get_instance()->start(jitdump_dir))
+            goto bail;
+    }
+
+    if (post_fast_path_enabled)
+        PostFastPath::get_instance()->enable();
+
+    if (qd_hle_enabled)
+        QuickDrawHLE::get_instance()->enable();
+
+    if (of_accel_enabled)
+        OfForthAccel::get_instance()->enable();
+
+    if (mm_accel_enabled)
+        MixedModeAccel::get_instance()->enable();
+
+    log_phase_timings();
+
+    if (!io_trace_path.empty()) {
+        set<string> srcs(io_trace_srcs.begin(), io_trace_srcs.end());
+        if (!IoTracer::get_instance()->start(io_trace_path, machine_str, srcs))
+            goto bail;
+    }
+
+    if (rfb_port) {
+        if (!RfbServer::get_instance()->start(rfb_addr, rfb_port))
+            goto bail;
+    }
+
     // graceful handling of fatal errors
     loguru::set_fatal_handler([](const loguru::Message& message) {
         // Make sure the reason for the failure is visible (it may have been
@@ -199,7 +422,12 @@ int main(int argc, char** argv) {
 
     switch (execution_mode) {
     case interpreter:
-        ppc_exec();
+        for (;;) {
+            ppc_exec();
+            if (!gMachineObj->reset_pending())
+                break;
+            gMachineObj->reset();
+        }
         break;
     case debugger:
         enter_debugger();
@@ -209,12 +437,21 @@ int main(int argc, char** argv) {
         return 1;
     }
 
+    if (gMachineObj->power_off_pending()) {
+        LOG_F(INFO, "Guest powered the machine off");
+        exit_status = power_off_status;
+    }
+
 bail:
     LOG_F(INFO, "Cleaning up...");
 
+    RfbServer::get_instance()->stop();
+    IoTracer::get_instance()->stop();
+    PageHeatTracker::get_instance()->stop();
+    PerfMap::get_instance()->stop();
     delete gMachineObj.release();
 
     cleanup();
 
-    return 0;
+    return exit_status;
 }
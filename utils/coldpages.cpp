@@ -0,0 +1,639 @@
+/*
+DingusPPC - The Experimental PowerPC Macintosh emulator
+Copyright (C) 2018-23 divingkatae and maximum
+                      (theweirdo)     spatium
+
+(Contact divingkatae#1017 or powermax#2286 on Discord for more info)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file Compressed storage for cold guest RAM pages. */
+
+#include <utils/coldpages.h>
+#include <loguru.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__linux__) && !defined(__EMSCRIPTEN__)
+#define COLD_PAGES_SUPPORTED
+#include <csignal>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+ColdPageCompactor* ColdPageCompactor::cold_pages_obj = nullptr;
+
+namespace {
+
+const int    HASH_BITS  = 12;
+const size_t SLOT_ALIGN = 64;
+const size_t ARENA_SIZE = 1 << 20;
+
+inline uint32_t read_u32(const uint8_t* p) {
+    uint32_t val;
+    std::memcpy(&val, p, 4);
+    return val;
+}
+
+inline uint8_t* put_length(uint8_t* op, size_t len) {
+    for (; len >= 255; len -= 255)
+        *op++ = 255;
+    *op++ = (uint8_t)len;
+    return op;
+}
+
+/** Compress len bytes at src using the LZ4 block format.
+    Returns the compressed size or 0 if it doesn't fit into cap bytes.
+    The input may not exceed 64 KB.
+ */
+size_t lz_compress(const uint8_t* src, size_t len, uint8_t* dst, size_t cap)
+{
+    uint16_t table[1 << HASH_BITS] = {};
+
+    const uint8_t* ip     = src;
+    const uint8_t* anchor = src;
+    const uint8_t* end    = src + len;
+    const uint8_t* limit  = len > 12 ? end - 12 : src; // last match must start before
+    uint8_t*       op     = dst;
+    uint8_t*       op_end = dst + cap;
+
+    // emit literals up to lit_end followed by a match (none if mlen is 0)
+    auto emit = [&](const uint8_t* lit_end, size_t offset, size_t mlen) {
+        size_t lit = lit_end - anchor;
+
+        if ((size_t)(op_end - op) < lit + lit / 255 + mlen / 255 + 5)
+            return false;
+
+        uint8_t* token = op++;
+        *token = uint8_t(std::min(lit, size_t(15)) << 4);
+        if (lit >= 15)
+            op = put_length(op, lit - 15);
+        std::memcpy(op, anchor, lit);
+        op += lit;
+
+        if (!mlen)
+            return true;
+
+        *op++  = offset & 0xFF;
+        *op++  = uint8_t(offset >> 8);
+        mlen  -= 4;
+        *token |= uint8_t(std::min(mlen, size_t(15)));
+        if (mlen >= 15)
+            op = put_length(op, mlen - 15);
+        return true;
+    };
+
+    while (ip < limit) {
+        uint32_t seq = read_u32(ip);
+        uint32_t h   = (seq * 2654435761U) >> (32 - HASH_BITS);
+
+        const uint8_t* ref = src + table[h];
+        table[h] = uint16_t(ip - src);
+
+        if (ref < ip && read_u32(ref) == seq) {
+            size_t offset = ip - ref;
+
+            const uint8_t* match_end = ip + 4;
+            while (match_end < end - 5 && *match_end == match_end[-offset])
+                match_end++;
+
+            if (!emit(ip, offset, match_end - ip))
+                return 0;
+
+            ip = anchor = match_end;
+        } else {
+            ip++;
+        }
+    }
+
+    if (!emit(end, 0, 0))
+        return 0;
+
+    return op - dst;
+}
+
+bool lz_decompress(const uint8_t* src, size_t len, uint8_t* dst, size_t dst_len)
+{
+    const uint8_t* ip   = src;
+    const uint8_t* iend = src + len;
+    uint8_t*       op   = dst;
+    uint8_t*       oend = dst + dst_len;
+
+    auto get_length = [&](size_t& val) {
+        uint8_t b;
+        do {
+            if (ip >= iend)
+                return false;
+            b = *ip++;
+            val += b;
+        } while (b == 255);
+        return true;
+    };
+
+    while (ip < iend) {
+        uint8_t token = *ip++;
+
+        size_t lit = token >> 4;
+        if (lit == 15 && !get_length(lit))
+            return false;
+        if (lit > (size_t)(iend - ip) || lit > (size_t)(oend - op))
+            return false;
+        std::memcpy(op, ip, lit);
+        op += lit;
+        ip += lit;
+
+        if (ip == iend)
+            break;
+
+        if (iend - ip < 2)
+            return false;
+        size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (!offset || offset > (size_t)(op - dst))
+            return false;
+
+        size_t mlen = token & 15;
+        if (mlen == 15 && !get_length(mlen))
+            return false;
+        mlen += 4;
+        if (mlen > (size_t)(oend - op))
+            return false;
+
+        // matches may overlap their own output
+        for (const uint8_t* ref = op - offset; mlen; mlen--)
+            *op++ = *ref++;
+    }
+
+    return op == oend;
+}
+
+inline bool is_zero_page(const uint8_t* page, size_t page_size) {
+    const uint64_t* p   = reinterpret_cast<const uint64_t*>(page);
+    const uint64_t* end = p + page_size / sizeof(uint64_t);
+
+    for (; p < end; p += 4) {
+        if (p[0] | p[1] | p[2] | p[3])
+            return false;
+    }
+
+    return true;
+}
+
+inline size_t slot_size(size_t len) {
+    return (len + SLOT_ALIGN - 1) & ~(SLOT_ALIGN - 1);
+}
+
+#ifdef COLD_PAGES_SUPPORTED
+
+struct sigaction old_segv_act;
+
+void segv_handler(int sig, siginfo_t* info, void* ctx)
+{
+    if (ColdPageCompactor::get_instance()->handle_fault(static_cast<uint8_t*>(info->si_addr)))
+        return;
+
+    // not ours: reinstate the previous handler and let the access fault again
+    sigaction(SIGSEGV, &old_segv_act, nullptr);
+}
+
+#endif
+
+} // anonymous namespace
+
+void ColdPageCompactor::set_thresholds(uint32_t cold_scans, uint64_t max_pool)
+{
+    this->cold_scans = std::max(cold_scans, 1U);
+    this->max_pool   = max_pool;
+}
+
+bool ColdPageCompactor::add_region(uint8_t* mem_ptr, size_t size)
+{
+#ifdef COLD_PAGES_SUPPORTED
+    this->page_size = sysconf(_SC_PAGESIZE);
+
+    if (this->page_size > 65536 || (uintptr_t)mem_ptr % this->page_size ||
+        size % this->page_size) {
+        LOG_F(WARNING, "ColdPages: can't track region at %p", mem_ptr);
+        return false;
+    }
+
+    int slot = -1;
+    for (int i = 0; i < MAX_REGIONS; i++) {
+        if (!this->regions[i]) {
+            slot = i;
+            break;
+        }
+    }
+    if (slot < 0) {
+        LOG_F(WARNING, "ColdPages: too many regions");
+        return false;
+    }
+
+    size_t blk_size = this->page_size * BLOCK_PAGES;
+
+    TrackedRegion* rgn = new TrackedRegion;
+    rgn->mem_ptr    = mem_ptr;
+    rgn->size       = size;
+    rgn->num_blocks = (size + blk_size - 1) / blk_size;
+    rgn->block_state.resize(rgn->num_blocks, BLK_HOT);
+    rgn->block_age.resize(rgn->num_blocks, 0);
+    rgn->pages.resize(size / this->page_size, PageSlot{nullptr, 0, 0, 0});
+
+    // one free list per slot size, pages compressing worse than 3/4 stay resident
+    this->free_lists.resize(slot_size(this->page_size * 3 / 4) / SLOT_ALIGN, nullptr);
+
+    if (!this->active) {
+        struct sigaction act = {};
+        act.sa_sigaction = segv_handler;
+        act.sa_flags     = SA_SIGINFO;
+        sigemptyset(&act.sa_mask);
+        if (sigaction(SIGSEGV, &act, &old_segv_act)) {
+            LOG_F(ERROR, "ColdPages: can't install the fault handler");
+            delete rgn;
+            return false;
+        }
+    }
+
+    this->lock();
+    this->regions[slot] = rgn;
+    this->stats.tracked += size;
+    this->active = true;
+    this->unlock();
+
+    LOG_F(INFO, "ColdPages: tracking %zu KB at %p", size >> 10, mem_ptr);
+
+    return true;
+#else
+    LOG_F(WARNING, "ColdPages: not supported on this platform");
+    return false;
+#endif
+}
+
+void ColdPageCompactor::remove_region(uint8_t* mem_ptr)
+{
+    this->lock();
+
+    for (int i = 0; i < MAX_REGIONS; i++) {
+        TrackedRegion* rgn = this->regions[i];
+        if (!rgn || rgn->mem_ptr != mem_ptr)
+            continue;
+
+        for (size_t blk = 0; blk < rgn->num_blocks; blk++) {
+            if (rgn->block_state[blk] != BLK_HOT)
+                this->restore_block(*rgn, blk);
+        }
+
+        this->stats.tracked -= rgn->size;
+        this->regions[i] = nullptr;
+        delete rgn;
+    }
+
+    this->active = std::any_of(std::begin(this->regions), std::end(this->regions),
+        [](TrackedRegion* rgn) { return rgn != nullptr; });
+
+    this->unlock();
+}
+
+ColdPageCompactor::TrackedRegion* ColdPageCompactor::find_region(const uint8_t* addr)
+{
+    for (TrackedRegion* rgn : this->regions) {
+        if (rgn && addr >= rgn->mem_ptr && addr < rgn->mem_ptr + rgn->size)
+            return rgn;
+    }
+
+    return nullptr;
+}
+
+uint8_t* ColdPageCompactor::pool_alloc(size_t len)
+{
+    size_t    size = slot_size(len);
+    uint8_t*& head = this->free_lists[size / SLOT_ALIGN - 1];
+
+    this->stats.pool_used += size;
+
+    if (head) {
+        uint8_t* data = head;
+        std::memcpy(&head, data, sizeof(uint8_t*));
+        return data;
+    }
+
+    if (this->arena_left < size) {
+        // the tail of the previous arena is lost, it's smaller than a page
+        this->arena_ptr  = new uint8_t[ARENA_SIZE];
+        this->arena_left = ARENA_SIZE;
+        this->arenas.push_back(this->arena_ptr);
+        this->stats.pool_reserved += ARENA_SIZE;
+    }
+
+    uint8_t* data = this->arena_ptr;
+    this->arena_ptr  += size;
+    this->arena_left -= size;
+    return data;
+}
+
+void ColdPageCompactor::pool_free(uint8_t* data, size_t len)
+{
+    size_t    size = slot_size(len);
+    uint8_t*& head = this->free_lists[size / SLOT_ALIGN - 1];
+
+    std::memcpy(data, &head, sizeof(uint8_t*));
+    head = data;
+
+    this->stats.pool_used -= size;
+}
+
+#ifdef COLD_PAGES_SUPPORTED
+
+/* Make a block accessible again and decompress its pages.
+   Must be called with the lock held, it runs in the fault handler. */
+void ColdPageCompactor::restore_block(TrackedRegion& rgn, size_t blk)
+{
+    size_t   blk_size = this->page_size * BLOCK_PAGES;
+    uint8_t* blk_ptr  = rgn.mem_ptr + blk * blk_size;
+    size_t   blk_len  = std::min(blk_size, rgn.size - blk * blk_size);
+
+    if (mprotect(blk_ptr, blk_len, PROT_READ | PROT_WRITE))
+        ABORT_F("ColdPages: can't unprotect %p", blk_ptr);
+
+    size_t first_page = blk * BLOCK_PAGES;
+    size_t last_page  = first_page + blk_len / this->page_size;
+
+    for (size_t pg = first_page; pg < last_page; pg++) {
+        PageSlot& slot = rgn.pages[pg];
+
+        if (slot.incompressible) {
+            slot.incompressible = 0;
+            this->stats.incompressible--;
+        }
+
+        if (!slot.compressed)
+            continue;
+
+        // released pages read back as zeros so all-zero pages need no work
+        if (slot.len) {
+            if (!lz_decompress(slot.data, slot.len, rgn.mem_ptr + pg * this->page_size,
+                               this->page_size))
+                ABORT_F("ColdPages: corrupted data for page %p",
+                        rgn.mem_ptr + pg * this->page_size);
+            this->pool_free(slot.data, slot.len);
+        }
+
+        slot = PageSlot{nullptr, 0, 0, 0};
+
+        this->stats.compressed -= this->page_size;
+        this->stats.decompressions++;
+    }
+
+    rgn.block_state[blk] = BLK_HOT;
+    rgn.block_age[blk]   = 0;
+}
+
+/* Compress the pages of a protected block into the pool and release them.
+   The block stays watched if the pool limit doesn't allow finishing it. */
+void ColdPageCompactor::compress_block(TrackedRegion& rgn, size_t blk, uint8_t* buf)
+{
+    size_t   blk_size = this->page_size * BLOCK_PAGES;
+    uint8_t* blk_ptr  = rgn.mem_ptr + blk * blk_size;
+    size_t   blk_len  = std::min(blk_size, rgn.size - blk * blk_size);
+    size_t   max_len  = this->page_size * 3 / 4;
+    bool     finished = true;
+
+    mprotect(blk_ptr, blk_len, PROT_READ);
+
+    size_t first_page = blk * BLOCK_PAGES;
+    size_t last_page  = first_page + blk_len / this->page_size;
+
+    for (size_t pg = first_page; pg < last_page; pg++) {
+        PageSlot& slot = rgn.pages[pg];
+        uint8_t*  page = rgn.mem_ptr + pg * this->page_size;
+
+        if (slot.compressed || slot.incompressible)
+            continue;
+
+        if (is_zero_page(page, this->page_size)) {
+            slot.compressed = 1;
+        } else {
+            size_t len = lz_compress(page, this->page_size, buf, max_len);
+            if (!len) {
+                slot.incompressible = 1;
+                this->stats.incompressible++;
+                continue;
+            }
+
+            if (this->max_pool && this->stats.pool_used + slot_size(len) > this->max_pool) {
+                finished = false;
+                break;
+            }
+
+            slot.data = this->pool_alloc(len);
+            slot.len  = uint16_t(len);
+            slot.compressed = 1;
+            std::memcpy(slot.data, buf, len);
+        }
+
+        this->stats.compressed += this->page_size;
+    }
+
+    // hand the compressed pages back to the host
+    size_t run_start = 0, run_len = 0;
+
+    for (size_t pg = first_page; pg <= last_page; pg++) {
+        if (pg < last_page && rgn.pages[pg].compressed) {
+            if (!run_len)
+                run_start = pg;
+            run_len++;
+            continue;
+        }
+        if (run_len) {
+            madvise(rgn.mem_ptr + run_start * this->page_size, run_len * this->page_size,
+                    MADV_DONTNEED);
+            run_len = 0;
+        }
+    }
+
+    mprotect(blk_ptr, blk_len, PROT_NONE);
+
+    if (finished)
+        rgn.block_state[blk] = BLK_COLD;
+}
+
+bool ColdPageCompactor::handle_fault(uint8_t* addr)
+{
+    if (!this->active)
+        return false;
+
+    this->lock();
+
+    TrackedRegion* rgn = this->find_region(addr);
+
+    if (rgn) {
+        size_t blk = (addr - rgn->mem_ptr) / (this->page_size * BLOCK_PAGES);
+
+        // another thread may have restored the block in the meantime
+        if (rgn->block_state[blk] != BLK_HOT) {
+            this->stats.faults++;
+            this->restore_block(*rgn, blk);
+        }
+    }
+
+    this->unlock();
+
+    return rgn != nullptr;
+}
+
+void ColdPageCompactor::scan()
+{
+    if (!this->active)
+        return;
+
+    std::vector<uint8_t> buf(this->page_size);
+
+    size_t blk_size = this->page_size * BLOCK_PAGES;
+
+    for (TrackedRegion* rgn : this->regions) {
+        if (!rgn)
+            continue;
+
+        // revoke access to the blocks touched since the last scan
+        this->lock();
+
+        size_t run_start = 0, run_len = 0;
+
+        for (size_t blk = 0; blk <= rgn->num_blocks; blk++) {
+            if (blk < rgn->num_blocks && rgn->block_state[blk] == BLK_HOT) {
+                rgn->block_state[blk] = BLK_WATCHED;
+                rgn->block_age[blk]   = 0;
+                if (!run_len)
+                    run_start = blk;
+                run_len++;
+                continue;
+            }
+            if (run_len) {
+                size_t len = std::min(run_len * blk_size, rgn->size - run_start * blk_size);
+                mprotect(rgn->mem_ptr + run_start * blk_size, len, PROT_NONE);
+                run_len = 0;
+            }
+        }
+
+        this->unlock();
+
+        // compress blocks that stayed untouched long enough, one block at a time
+        // so that faults from other threads don't wait for the whole scan
+        for (size_t blk = 0; blk < rgn->num_blocks; blk++) {
+            this->lock();
+
+            if (rgn->block_state[blk] == BLK_WATCHED) {
+                if (rgn->block_age[blk] < 255)
+                    rgn->block_age[blk]++;
+                if (rgn->block_age[blk] > this->cold_scans)
+                    this->compress_block(*rgn, blk, buf.data());
+            }
+
+            this->unlock();
+        }
+    }
+
+    this->lock();
+    this->stats.scans++;
+    this->unlock();
+
+    LOG_F(9, "ColdPages: %llu KB compressed into %llu KB",
+          (unsigned long long)(this->stats.compressed >> 10),
+          (unsigned long long)(this->stats.pool_used >> 10));
+}
+
+void ColdPageCompactor::prepare(uint8_t* host_ptr, size_t len)
+{
+    this->lock();
+
+    TrackedRegion* rgn = this->find_region(host_ptr);
+
+    if (rgn) {
+        size_t blk_size = this->page_size * BLOCK_PAGES;
+        size_t offset   = host_ptr - rgn->mem_ptr;
+        size_t last_blk = std::min((offset + len + blk_size - 1) / blk_size, rgn->num_blocks);
+
+        for (size_t blk = offset / blk_size; blk < last_blk; blk++) {
+            if (rgn->block_state[blk] != BLK_HOT)
+                this->restore_block(*rgn, blk);
+        }
+    }
+
+    this->unlock();
+}
+
+#else // COLD_PAGES_SUPPORTED
+
+void ColdPageCompactor::restore_block(TrackedRegion& rgn, size_t blk) {}
+void ColdPageCompactor::compress_block(TrackedRegion& rgn, size_t blk, uint8_t* buf) {}
+bool ColdPageCompactor::handle_fault(uint8_t* addr) { return false; }
+void ColdPageCompactor::scan() {}
+void ColdPageCompactor::prepare(uint8_t* host_ptr, size_t len) {}
+
+#endif // COLD_PAGES_SUPPORTED
+
+void ColdPageCompactor::get_stats(ColdPageStats& stats)
+{
+    this->lock();
+    stats = this->stats;
+    this->unlock();
+}
+
+void ColdPageProfile::populate_variables(std::vector<ProfileVar>& vars)
+{
+    ColdPageStats stats;
+
+    ColdPageCompactor::get_instance()->get_stats(stats);
+
+    vars.clear();
+
+    vars.push_back({.name = "Tracked RAM (KB)",
+                    .format = ProfileVarFmt::DEC,
+                    .value = stats.tracked >> 10});
+
+    vars.push_back({.name = "Compressed RAM (KB)",
+                    .format = ProfileVarFmt::DEC,
+                    .value = stats.compressed >> 10});
+
+    vars.push_back({.name = "Pool used (KB)",
+                    .format = ProfileVarFmt::DEC,
+                    .value = stats.pool_used >> 10});
+
+    vars.push_back({.name = "Pool reserved (KB)",
+                    .format = ProfileVarFmt::DEC,
+                    .value = stats.pool_reserved >> 10});
+
+    vars.push_back({.name = "Saved (KB)",
+                    .format = ProfileVarFmt::DEC,
+                    .value = (stats.compressed - std::min(stats.compressed,
+                              stats.pool_reserved)) >> 10});
+
+    vars.push_back({.name = "Incompressible pages",
+                    .format = ProfileVarFmt::DEC,
+                    .value = stats.incompressible});
+
+    vars.push_back({.name = "Access faults",
+                    .format = ProfileVarFmt::DEC,
+                    .value = stats.faults});
+
+    vars.push_back({.name = "Pages decompressed",
+                    .format = ProfileVarFmt::DEC,
+                    .value = stats.decompressions});
+
+    vars.push_back({.name = "Scans",
+                    .format = ProfileVarFmt::DEC,
+                    .value = stats.scans});
+}
@@ -0,0 +1,172 @@
+/*
+DingusPPC - The Experimental PowerPC Macintosh emulator
+Copyright (C) 2018-23 divingkatae and maximum
+                      (theweirdo)     spatium
+
+(Contact divingkatae#1017 or powermax#2286 on Discord for more info)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file Compressed storage for cold guest RAM pages.
+
+    Guest RAM is split into blocks of BLOCK_PAGES host pages. Each scan
+    revokes host access to the blocks touched since the previous scan;
+    the next access faults and the SIGSEGV handler restores access,
+    which marks the block as recently used. Blocks left untouched for
+    a number of scans are considered cold: their pages are compressed
+    into a side pool and returned to the host. The first access to a
+    cold block decompresses its pages in the fault handler.
+
+    Access is tracked per block rather than per page to keep the number
+    of distinct host mappings (vm.max_map_count) bounded.
+
+    Host system calls don't trigger the fault handler, so code passing
+    guest RAM to the OS must call cold_pages_prepare() first. DMA mappings
+    obtained through mmu_map_dma_mem() are prepared automatically.
+ */
+
+#ifndef COLD_PAGES_H
+#define COLD_PAGES_H
+
+#include <utils/profiler.h>
+
+#include <atomic>
+#include <cinttypes>
+#include <vector>
+
+/** Cumulative compactor statistics. */
+typedef struct ColdPageStats {
+    uint64_t tracked;           // bytes of guest RAM under tracking
+    uint64_t compressed;        // bytes of guest RAM held in the pool
+    uint64_t pool_used;         // bytes of pool slots in use
+    uint64_t pool_reserved;     // bytes of host memory reserved for the pool
+    uint64_t incompressible;    // pages left resident due to poor ratio
+    uint64_t faults;            // accesses to protected blocks
+    uint64_t decompressions;    // pages restored from the pool
+    uint64_t scans;
+} ColdPageStats;
+
+class ColdPageCompactor {
+public:
+    static ColdPageCompactor* get_instance() {
+        if (!cold_pages_obj) {
+            cold_pages_obj = new ColdPageCompactor();
+        }
+        return cold_pages_obj;
+    };
+
+    /* Blocks untouched for cold_scans scans get compressed. Compression
+       stops while the pool holds max_pool bytes (0 = no limit). */
+    void set_thresholds(uint32_t cold_scans, uint64_t max_pool);
+
+    // Track a private anonymous mapping holding guest RAM
+    bool add_region(uint8_t* mem_ptr, size_t size);
+
+    // Stop tracking a region, its contents are restored first
+    void remove_region(uint8_t* mem_ptr);
+
+    // Age tracked blocks and compress the cold ones
+    void scan();
+
+    // Make host memory accessible to code that can't fault (system calls)
+    void prepare(uint8_t* host_ptr, size_t len);
+
+    bool is_active() const { return this->active.load(std::memory_order_relaxed); };
+
+    void get_stats(ColdPageStats& stats);
+
+    // called from the SIGSEGV handler
+    bool handle_fault(uint8_t* addr);
+
+private:
+    ColdPageCompactor() {}; // private constructor to implement a singleton
+
+    static ColdPageCompactor* cold_pages_obj;
+
+    enum : uint8_t {
+        BLK_HOT,        // accessible, touched since the last scan
+        BLK_WATCHED,    // protected, age counts scans without access
+        BLK_COLD,       // protected, pages compressed
+    };
+
+    typedef struct PageSlot {
+        uint8_t*    data;   // compressed data, nullptr if resident
+        uint16_t    len;    // compressed size, 0 for an all-zero page
+        uint8_t     compressed;
+        uint8_t     incompressible;
+    } PageSlot;
+
+    typedef struct TrackedRegion {
+        uint8_t*                mem_ptr;
+        size_t                  size;
+        size_t                  num_blocks;
+        std::vector<uint8_t>    block_state;
+        std::vector<uint8_t>    block_age;
+        std::vector<PageSlot>   pages;
+    } TrackedRegion;
+
+    static const int MAX_REGIONS = 8;
+    static const int BLOCK_PAGES = 16;
+
+    void lock() {
+        while (this->spin.test_and_set(std::memory_order_acquire)) {}
+    };
+    void unlock() { this->spin.clear(std::memory_order_release); };
+
+    TrackedRegion* find_region(const uint8_t* addr);
+    void restore_block(TrackedRegion& rgn, size_t blk);
+    void compress_block(TrackedRegion& rgn, size_t blk, uint8_t* buf);
+    uint8_t* pool_alloc(size_t len);
+    void pool_free(uint8_t* data, size_t len);
+
+    std::atomic_flag    spin = ATOMIC_FLAG_INIT;
+    std::atomic<bool>   active{false};
+
+    // fixed-size table so the signal handler never sees it reallocated
+    TrackedRegion*      regions[MAX_REGIONS] = {};
+
+    size_t      page_size  = 4096;
+    uint32_t    cold_scans = 3;
+    uint64_t    max_pool   = 0;
+
+    // pool of compressed pages: arenas carved into 64-byte granular slots,
+    // freed slots are kept in per-size free lists (no allocation in the
+    // fault handler)
+    std::vector<uint8_t*>   arenas;
+    std::vector<uint8_t*>   free_lists;
+    uint8_t*                arena_ptr  = nullptr;
+    size_t                  arena_left = 0;
+
+    ColdPageStats stats = {};
+};
+
+// Fast check for hot paths before calling ColdPageCompactor::prepare()
+inline void cold_pages_prepare(uint8_t* host_ptr, size_t len) {
+    ColdPageCompactor* compactor = ColdPageCompactor::get_instance();
+    if (compactor->is_active())
+        compactor->prepare(host_ptr, len);
+}
+
+/** Profile reporting the cold page compactor activity. */
+class ColdPageProfile : public BaseProfile {
+public:
+    ColdPageProfile() : BaseProfile("ColdPages") {};
+
+    void populate_variables(std::vector<ProfileVar>& vars);
+
+    void reset(void) {}; // all values are either live or cumulative
+};
+
+#endif // COLD_PAGES_H
@@ -0,0 +1,154 @@
+/*
+DingusPPC - The Experimental PowerPC Macintosh emulator
+Copyright (C) 2018-23 divingkatae and maximum
+                      (theweirdo)     spatium
+
+(Contact divingkatae#1017 or powermax#2286 on Discord for more info)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file Host memory allocation for guest-visible memory. */
+
+#include <utils/hostmem.h>
+#include <loguru.hpp>
+
+#include <algorithm>
+#include <cinttypes>
+#include <string>
+#include <vector>
+
+#if (defined(__linux__) || defined(__APPLE__)) && !defined(__EMSCRIPTEN__)
+#define HOST_MMAP_SUPPORTED
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+static bool export_enabled = false;
+
+static std::vector<HostMemBlock> mem_blocks;
+
+void host_mem_set_export(bool enable) {
+#if defined(HOST_MMAP_SUPPORTED) && defined(__linux__)
+    export_enabled = enable;
+#else
+    if (enable)
+        LOG_F(WARNING, "Guest memory export isn't supported on this platform");
+#endif
+}
+
+bool host_mem_export_enabled() {
+    return export_enabled;
+}
+
+#if defined(HOST_MMAP_SUPPORTED) && defined(__linux__)
+static uint8_t* alloc_memfd(size_t size, const std::string& name, int& fd) {
+    fd = memfd_create(("dingusppc:" + name).c_str(), MFD_CLOEXEC);
+    if (fd < 0)
+        return nullptr;
+
+    if (ftruncate(fd, size)) {
+        close(fd);
+        return nullptr;
+    }
+
+    void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (ptr == MAP_FAILED) {
+        close(fd);
+        return nullptr;
+    }
+
+    return static_cast<uint8_t*>(ptr);
+}
+#endif
+
+/** Allocate zero-filled host memory for a guest memory block.
+    Private anonymous mappings are advised as mergeable so that KSM can
+    share identical pages (ROM copies, zero pages, system file contents)
+    between several emulator instances running on the same host.
+ */
+uint8_t* host_mem_alloc(size_t size, const std::string& name) {
+    HostMemBlock block = {name, nullptr, size, false, -1};
+
+#if defined(HOST_MMAP_SUPPORTED) && defined(__linux__)
+    if (export_enabled) {
+        block.mem_ptr = alloc_memfd(size, name, block.fd);
+        if (block.mem_ptr)
+            block.mapped = true;
+        else
+            LOG_F(WARNING, "Could not create memfd for %s, it won't be exported",
+                  name.c_str());
+    }
+#endif
+
+#ifdef HOST_MMAP_SUPPORTED
+    if (!block.mem_ptr) {
+        void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ptr != MAP_FAILED) {
+#ifdef MADV_MERGEABLE
+            if (madvise(ptr, size, MADV_MERGEABLE))
+                LOG_F(9, "MADV_MERGEABLE not available for %s", name.c_str());
+#endif
+            block.mem_ptr = static_cast<uint8_t*>(ptr);
+            block.mapped  = true;
+        } else {
+            LOG_F(WARNING, "mmap failed for %zu bytes of %s, using heap",
+                  size, name.c_str());
+        }
+    }
+#endif
+
+    if (!block.mem_ptr)
+        block.mem_ptr = new uint8_t[size]();
+
+    mem_blocks.push_back(block);
+
+    return block.mem_ptr;
+}
+
+void host_mem_free(uint8_t* mem_ptr) {
+    auto it = std::find_if(mem_blocks.begin(), mem_blocks.end(),
+        [mem_ptr](const HostMemBlock& block) { return block.mem_ptr == mem_ptr; });
+
+    if (it == mem_blocks.end()) {
+        if (mem_ptr)
+            LOG_F(ERROR, "Attempt to free unknown host memory block %p", mem_ptr);
+        return;
+    }
+
+#ifdef HOST_MMAP_SUPPORTED
+    if (it->mapped) {
+        munmap(it->mem_ptr, it->size);
+        if (it->fd >= 0)
+            close(it->fd);
+    } else
+#endif
+        delete[] it->mem_ptr;
+
+    mem_blocks.erase(it);
+}
+
+const HostMemBlock* host_mem_find(const uint8_t* host_addr) {
+    for (auto& block : mem_blocks) {
+        if (host_addr >= block.mem_ptr && host_addr < block.mem_ptr + block.size)
+            return &block;
+    }
+
+    return nullptr;
+}
+
+const std::vector<HostMemBlock>& host_mem_blocks() {
+    return mem_blocks;
+}
@@ -0,0 +1,66 @@
+/*
+DingusPPC - The Experimental PowerPC Macintosh emulator
+Copyright (C) 2018-23 divingkatae and maximum
+                      (theweirdo)     spatium
+
+(Contact divingkatae#1017 or powermax#2286 on Discord for more info)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file Host memory backing for guest-visible memory (RAM, ROM, VRAM).
+
+    Blocks are normally private anonymous mappings advised as mergeable
+    so that identical pages can be shared between emulator instances.
+    When export is enabled, blocks are backed by memfd objects instead
+    so that external tools can map guest memory read-only through
+    /proc/<pid>/fd/<fd> without pausing or copying from the emulator.
+ */
+
+#ifndef HOST_MEM_H
+#define HOST_MEM_H
+
+#include <cinttypes>
+#include <memory>
+#include <string>
+#include <vector>
+
+/** Describes a block of host memory holding guest-visible data. */
+typedef struct HostMemBlock {
+    std::string name;
+    uint8_t*    mem_ptr;
+    size_t      size;
+    bool        mapped; /* true if allocated with mmap, false for new[] */
+    int         fd;     /* backing memfd for exported blocks, -1 otherwise */
+} HostMemBlock;
+
+// Select memfd backing for all subsequent allocations
+extern void host_mem_set_export(bool enable);
+extern bool host_mem_export_enabled();
+
+extern uint8_t* host_mem_alloc(size_t size, const std::string& name);
+extern void     host_mem_free(uint8_t* mem_ptr);
+
+// Find the block containing the given host address, the returned pointer
+// is only valid until the next allocation or release
+extern const HostMemBlock* host_mem_find(const uint8_t* host_addr);
+extern const std::vector<HostMemBlock>& host_mem_blocks();
+
+struct HostMemDeleter {
+    void operator()(uint8_t* mem_ptr) const { host_mem_free(mem_ptr); }
+};
+
+typedef std::unique_ptr<uint8_t[], HostMemDeleter> HostMemPtr;
+
+#endif // HOST_MEM_H
@@ -29,18 +29,32 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <memory>
 #include <string>
 
+/** When guest writes are committed to stable host storage. */
+enum class WriteSync {
+    UNSAFE,         // never, for scratch images
+    WRITEBACK,      // when the guest flushes its write cache
+    WRITETHROUGH,   // after every write
+};
+
+/** Converts a "*_sync" property value into a policy. */
+WriteSync write_sync_from_str(const std::string& str);
+
 class ImgFile {
 public:
     ImgFile();
     ~ImgFile();
 
-    bool open(const std::string& img_path);
+    bool open(const std::string& img_path, WriteSync sync = WriteSync::UNSAFE);
     void close();
 
     size_t size() const;
 
     size_t read(void* buf, off_t offset, size_t length) const;
     size_t write(const void* buf, off_t offset, size_t length);
+
+    /** Handles a cache flush request from the guest.
+        Returns false if the data couldn't be committed. */
+    bool flush();
 private:
     class Impl; // Holds private fields
     std::unique_ptr<Impl> impl;
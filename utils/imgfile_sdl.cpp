@@ -21,28 +21,91 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include <utils/imgfile.h>
 
+#include <fcntl.h>
 #include <fstream>
 
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+WriteSync write_sync_from_str(const std::string& str)
+{
+    if (str == "unsafe")
+        return WriteSync::UNSAFE;
+    if (str == "writethrough")
+        return WriteSync::WRITETHROUGH;
+    return WriteSync::WRITEBACK;
+}
+
 class ImgFile::Impl {
 public:
     std::fstream stream;
+    WriteSync    sync    = WriteSync::UNSAFE;
+    int          sync_fd = -1; // host descriptor used for committing data
 };
 
+// Pushes buffered data to the OS and waits until it reaches the disk.
+static bool host_sync(std::fstream& stream, int fd)
+{
+    stream.clear(); // a short read must not fail the flush
+    if (!stream.flush())
+        return false;
+#if defined(_WIN32)
+    return _commit(fd) == 0;
+#elif defined(__linux__)
+    return fdatasync(fd) == 0;
+#else
+    return fsync(fd) == 0;
+#endif
+}
+
 ImgFile::ImgFile(): impl(std::make_unique<Impl>())
 {
 
 }
 
-ImgFile::~ImgFile() = default;
+ImgFile::~ImgFile()
+{
+    this->close();
+}
 
-bool ImgFile::open(const std::string &img_path)
+bool ImgFile::open(const std::string &img_path, WriteSync sync)
 {
     impl->stream.open(img_path, std::ios::in | std::ios::out | std::ios::binary);
-    return !impl->stream.fail();
+    if (impl->stream.fail())
+        return false;
+
+    impl->sync = sync;
+
+    // fstream doesn't expose its descriptor so open a second one for syncing
+    if (sync != WriteSync::UNSAFE) {
+#ifdef _WIN32
+        impl->sync_fd = _open(img_path.c_str(), _O_RDWR | _O_BINARY);
+#else
+        impl->sync_fd = ::open(img_path.c_str(), O_RDWR);
+#endif
+        if (impl->sync_fd < 0) {
+            impl->stream.close();
+            return false;
+        }
+    }
+
+    return true;
 }
 
 void ImgFile::close()
 {
+    if (impl->sync_fd >= 0) {
+        host_sync(impl->stream, impl->sync_fd);
+#ifdef _WIN32
+        _close(impl->sync_fd);
+#else
+        ::close(impl->sync_fd);
+#endif
+        impl->sync_fd = -1;
+    }
     impl->stream.close();
 }
 
@@ -61,7 +124,25 @@ size_t ImgFile::read(void* buf, off_t offset, size_t length) const
 
 size_t ImgFile::write(const void* buf, off_t offset, size_t length)
 {
-    impl->stream.seekg(offset, std::ios::beg);
+    impl->stream.clear(); // a short read must not fail the write
+    impl->stream.seekp(offset, std::ios::beg);
     impl->stream.write((const char *)buf, length);
-    return impl->stream.gcount();
+    if (impl->stream.fail())
+        return 0;
+
+    if (impl->sync == WriteSync::WRITETHROUGH && !host_sync(impl->stream, impl->sync_fd))
+        return 0;
+
+    return length;
+}
+
+bool ImgFile::flush()
+{
+    if (impl->sync == WriteSync::UNSAFE) {
+        // hand buffered data to the OS but don't wait for the disk
+        impl->stream.clear();
+        return !impl->stream.flush().fail();
+    }
+
+    return host_sync(impl->stream, impl->sync_fd);
 }
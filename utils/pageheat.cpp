@@ -0,0 +1,343 @@
+/*
+DingusPPC - The Experimental PowerPC Macintosh emulator
+Copyright (C) 2018-23 divingkatae and maximum
+                      (theweirdo)     spatium
+
+(Contact divingkatae#1017 or powermax#2286 on Discord for more info)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file Guest physical page heat and working set tracking. */
+
+#include <cpu/ppc/ppcemu.h>
+#include <cpu/ppc/ppcmmu.h>
+#include <devices/common/hwcomponent.h>
+#include <devices/common/mmiodevice.h>
+#include <devices/memctrl/memctrlbase.h>
+#include <utils/pageheat.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <loguru.hpp>
+
+using namespace std;
+
+bool page_heat_enabled = false;
+
+PageHeatTracker* PageHeatTracker::page_heat_obj = nullptr;
+
+bool PageHeatTracker::start(MemCtrlBase* mem_ctrl, const string& out_path)
+{
+    if (page_heat_enabled)
+        return true;
+
+    this->regions.clear();
+    this->last_rgn = nullptr;
+
+    for (AddressMapEntry* entry : mem_ctrl->get_address_map()) {
+        // mirrors share host memory with the region they reflect
+        if (entry->type & (RT_MMIO | RT_MIRROR) || !entry->mem_ptr)
+            continue;
+
+        HeatRegion rgn;
+
+        if (entry->type & RT_ROM) {
+            rgn.name = "ROM";
+            rgn.kind = "ROM";
+        } else if (entry->devobj) {
+            rgn.name = entry->devobj->get_name();
+            rgn.kind = "VRAM";
+        } else {
+            rgn.name = "RAM";
+            rgn.kind = "RAM";
+        }
+
+        // keep region names unique for the debugger
+        for (auto& other : this->regions) {
+            if (other.name == rgn.name) {
+                char suffix[16];
+                snprintf(suffix, sizeof(suffix), "@%X", entry->start);
+                rgn.name += suffix;
+                break;
+            }
+        }
+
+        rgn.phys_start = entry->start;
+        rgn.mem_ptr    = entry->mem_ptr;
+        rgn.num_pages  = ((size_t)entry->end - entry->start + 1) >> PAGE_BITS;
+        rgn.cur_access.assign(rgn.num_pages, 0);
+        rgn.read_wins.assign(rgn.num_pages, 0);
+        rgn.write_wins.assign(rgn.num_pages, 0);
+        rgn.exec_wins.assign(rgn.num_pages, 0);
+        rgn.peak = {};
+
+        this->regions.push_back(std::move(rgn));
+    }
+
+    if (this->regions.empty()) {
+        LOG_F(ERROR, "PageHeat: no memory regions to track");
+        return false;
+    }
+
+    this->out_path = out_path;
+    this->history.clear();
+    this->num_windows  = 0;
+    this->win_start_ns = get_virt_time_ns();
+
+    for (auto& rgn : this->regions)
+        LOG_F(INFO, "PageHeat: tracking %s (%s) at 0x%X, %zu pages", rgn.name.c_str(),
+              rgn.kind, rgn.phys_start, rgn.num_pages);
+
+    page_heat_enabled = true;
+
+    // make the first access to every page go through a refill
+    tlb_flush_mem_entries();
+
+    return true;
+}
+
+void PageHeatTracker::stop()
+{
+    if (!page_heat_enabled)
+        return;
+
+    page_heat_enabled = false;
+
+    if (!this->out_path.empty() && this->write_report(this->out_path))
+        LOG_F(INFO, "PageHeat: report written to %s", this->out_path.c_str());
+}
+
+PageHeatTracker::HeatRegion* PageHeatTracker::find_region(const uint8_t* host_va)
+{
+    if (this->last_rgn && host_va >= this->last_rgn->mem_ptr &&
+        host_va < this->last_rgn->mem_ptr + (this->last_rgn->num_pages << PAGE_BITS))
+        return this->last_rgn;
+
+    for (auto& rgn : this->regions) {
+        if (host_va >= rgn.mem_ptr && host_va < rgn.mem_ptr + (rgn.num_pages << PAGE_BITS)) {
+            this->last_rgn = &rgn;
+            return &rgn;
+        }
+    }
+
+    return nullptr;
+}
+
+void PageHeatTracker::record(const uint8_t* host_va, uint8_t access)
+{
+    HeatRegion* rgn = this->find_region(host_va);
+
+    if (rgn)
+        rgn->cur_access[(host_va - rgn->mem_ptr) >> PAGE_BITS] |= access;
+}
+
+void PageHeatTracker::end_window(uint64_t now_ns)
+{
+    if (!page_heat_enabled)
+        return;
+
+    HeatWindow win;
+
+    win.index     = this->num_windows++;
+    win.start_ns  = this->win_start_ns;
+    win.length_ns = now_ns - this->win_start_ns;
+
+    for (auto& rgn : this->regions) {
+        HeatWindowUsage usage = {};
+
+        for (size_t pg = 0; pg < rgn.num_pages; pg++) {
+            uint8_t access = rgn.cur_access[pg];
+            if (!access)
+                continue;
+
+            usage.touched++;
+
+            // saturate instead of wrapping on very long runs
+            if ((access & HEAT_READ) && rgn.read_wins[pg] != UINT16_MAX)
+                rgn.read_wins[pg]++;
+            if (access & HEAT_WRITE) {
+                usage.written++;
+                if (rgn.write_wins[pg] != UINT16_MAX)
+                    rgn.write_wins[pg]++;
+            }
+            if (access & HEAT_EXEC) {
+                usage.executed++;
+                if (rgn.exec_wins[pg] != UINT16_MAX)
+                    rgn.exec_wins[pg]++;
+            }
+        }
+
+        std::fill(rgn.cur_access.begin(), rgn.cur_access.end(), 0);
+
+        rgn.peak.touched  = std::max(rgn.peak.touched,  usage.touched);
+        rgn.peak.written  = std::max(rgn.peak.written,  usage.written);
+        rgn.peak.executed = std::max(rgn.peak.executed, usage.executed);
+
+        win.usage.push_back(usage);
+    }
+
+    this->history.push_back(std::move(win));
+    if (this->history.size() > MAX_HISTORY)
+        this->history.pop_front();
+
+    this->win_start_ns = now_ns;
+
+    tlb_flush_mem_entries();
+    tlb_refill_cur_itlb();
+}
+
+void PageHeatTracker::reset()
+{
+    for (auto& rgn : this->regions) {
+        std::fill(rgn.cur_access.begin(), rgn.cur_access.end(), 0);
+        std::fill(rgn.read_wins.begin(),  rgn.read_wins.end(),  0);
+        std::fill(rgn.write_wins.begin(), rgn.write_wins.end(), 0);
+        std::fill(rgn.exec_wins.begin(),  rgn.exec_wins.end(),  0);
+        rgn.peak = {};
+    }
+
+    this->history.clear();
+    this->num_windows  = 0;
+    this->win_start_ns = get_virt_time_ns();
+
+    if (page_heat_enabled)
+        tlb_flush_mem_entries();
+}
+
+void PageHeatTracker::print_summary()
+{
+    if (this->regions.empty()) {
+        cout << "Page heat tracking is not active (see --page-heat)." << endl;
+        return;
+    }
+
+    cout << dec << this->num_windows << " windows closed";
+    if (!this->history.empty())
+        cout << ", last one lasted " << this->history.back().length_ns / 1000 << " us";
+    cout << endl;
+
+    for (size_t i = 0; i < this->regions.size(); i++) {
+        HeatRegion& rgn = this->regions[i];
+
+        size_t ever = 0;
+        for (size_t pg = 0; pg < rgn.num_pages; pg++) {
+            if (rgn.read_wins[pg] || rgn.write_wins[pg] || rgn.exec_wins[pg])
+                ever++;
+        }
+
+        uint64_t sum_touched = 0;
+        for (auto& win : this->history)
+            sum_touched += win.usage[i].touched;
+
+        HeatWindowUsage last = {};
+        if (!this->history.empty())
+            last = this->history.back().usage[i];
+
+        printf("%-12s %-4s 0x%08X %7zu KB\n", rgn.name.c_str(), rgn.kind, rgn.phys_start,
+               rgn.num_pages << (PAGE_BITS - 10));
+        printf("    working set: last %u KB (written %u KB, code %u KB), peak %u KB, "
+               "average %llu KB\n",
+               last.touched << (PAGE_BITS - 10), last.written << (PAGE_BITS - 10),
+               last.executed << (PAGE_BITS - 10), rgn.peak.touched << (PAGE_BITS - 10),
+               this->history.empty() ? 0ULL :
+                   (unsigned long long)((sum_touched << (PAGE_BITS - 10)) / this->history.size()));
+        printf("    touched since start: %zu KB\n", ever << (PAGE_BITS - 10));
+    }
+}
+
+void PageHeatTracker::print_heat_map(const string& rgn_name)
+{
+    static const char shades[] = " .:-=+*#%@";
+    static const int  COLUMNS  = 64;
+    static const int  MAX_ROWS = 32;
+
+    for (auto& rgn : this->regions) {
+        if (!rgn_name.empty() && rgn.name != rgn_name)
+            continue;
+
+        size_t pages_per_cell = std::max<size_t>(
+            1, (rgn.num_pages + COLUMNS * MAX_ROWS - 1) / (COLUMNS * MAX_ROWS));
+        size_t num_cells = (rgn.num_pages + pages_per_cell - 1) / pages_per_cell;
+        uint64_t wins    = std::max<uint64_t>(this->num_windows, 1);
+
+        printf("%s (%s), %zu KB per cell, shade = share of windows with access\n",
+               rgn.name.c_str(), rgn.kind, pages_per_cell << (PAGE_BITS - 10));
+
+        for (size_t cell = 0; cell < num_cells; cell++) {
+            if (!(cell % COLUMNS))
+                printf("%08X |", uint32_t(rgn.phys_start + ((cell * pages_per_cell) << PAGE_BITS)));
+
+            uint32_t hottest = 0;
+            for (size_t pg = cell * pages_per_cell;
+                 pg < std::min(rgn.num_pages, (cell + 1) * pages_per_cell); pg++) {
+                uint32_t heat = std::max({rgn.read_wins[pg], rgn.write_wins[pg],
+                                          rgn.exec_wins[pg]});
+                hottest = std::max(hottest, heat);
+            }
+
+            int shade = hottest ? 1 + int((hottest * (sizeof(shades) - 3)) / wins) : 0;
+            putchar(shades[std::min<int>(shade, sizeof(shades) - 2)]);
+
+            if (cell % COLUMNS == COLUMNS - 1 || cell == num_cells - 1)
+                printf("|\n");
+        }
+        return;
+    }
+
+    cout << "Unknown region " << rgn_name << endl;
+}
+
+bool PageHeatTracker::write_report(const string& path)
+{
+    FILE* out = fopen(path.c_str(), "w");
+    if (!out) {
+        LOG_F(ERROR, "PageHeat: could not open %s", path.c_str());
+        return false;
+    }
+
+    fprintf(out, "# DingusPPC page heat, %d byte pages, %llu windows\n",
+            1 << PAGE_BITS, (unsigned long long)this->num_windows);
+
+    fprintf(out, "# region <name> <kind> <phys start> <pages>\n");
+    for (auto& rgn : this->regions)
+        fprintf(out, "region %s %s 0x%08X %zu\n", rgn.name.c_str(), rgn.kind,
+                rgn.phys_start, rgn.num_pages);
+
+    fprintf(out, "# window <index> <start ns> <length ns> "
+                 "then <touched> <written> <executed> pages per region\n");
+    for (auto& win : this->history) {
+        fprintf(out, "window %llu %llu %llu", (unsigned long long)win.index,
+                (unsigned long long)win.start_ns, (unsigned long long)win.length_ns);
+        for (auto& usage : win.usage)
+            fprintf(out, " %u %u %u", usage.touched, usage.written, usage.executed);
+        fprintf(out, "\n");
+    }
+
+    fprintf(out, "# page <phys addr> <region> <read windows> <write windows> <exec windows>\n");
+    for (auto& rgn : this->regions) {
+        for (size_t pg = 0; pg < rgn.num_pages; pg++) {
+            if (!rgn.read_wins[pg] && !rgn.write_wins[pg] && !rgn.exec_wins[pg])
+                continue;
+            fprintf(out, "page 0x%08X %s %u %u %u\n",
+                    uint32_t(rgn.phys_start + (pg << PAGE_BITS)), rgn.name.c_str(),
+                    rgn.read_wins[pg], rgn.write_wins[pg], rgn.exec_wins[pg]);
+        }
+    }
+
+    fclose(out);
+
+    return true;
+}
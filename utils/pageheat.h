@@ -0,0 +1,136 @@
+/*
+DingusPPC - The Experimental PowerPC Macintosh emulator
+Copyright (C) 2018-23 divingkatae and maximum
+                      (theweirdo)     spatium
+
+(Contact divingkatae#1017 or powermax#2286 on Discord for more info)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file Guest physical page heat and working set tracking.
+
+    Time is divided into windows. At the start of each window all SoftTLB
+    entries for memory pages are revoked so the first access to every page
+    in the window goes through a TLB refill, which records a read, write
+    or instruction fetch for the physical page. DTLB entries filled by a
+    read are set up to take the PTE.C update path on their first write so
+    that writes to pages already read in the window get recorded too.
+    The interpreter doesn't translate instruction addresses while it stays
+    within a page, so the page being executed gets refilled explicitly.
+
+    At the end of a window the pages touched in it make up the working set
+    of the window. Per-page counts of windows with reads, writes and
+    fetches form the heat map. Pages are attributed to the RAM, VRAM
+    (device memory mapped as RAM) and ROM regions of the memory controller.
+
+    When disabled, the only cost is a branch in the TLB refill paths.
+ */
+
+#ifndef PAGE_HEAT_H
+#define PAGE_HEAT_H
+
+#include <cinttypes>
+#include <deque>
+#include <string>
+#include <vector>
+
+class MemCtrlBase;
+
+enum HeatAccess : uint8_t {
+    HEAT_READ  = 1 << 0,
+    HEAT_WRITE = 1 << 1,
+    HEAT_EXEC  = 1 << 2,
+};
+
+/** Pages of one region touched during a window. */
+typedef struct HeatWindowUsage {
+    uint32_t touched;
+    uint32_t written;
+    uint32_t executed;
+} HeatWindowUsage;
+
+/** Working set of a closed window, one entry per tracked region. */
+typedef struct HeatWindow {
+    uint64_t    index;
+    uint64_t    start_ns;   // virtual time when the window was opened
+    uint64_t    length_ns;
+    std::vector<HeatWindowUsage> usage;
+} HeatWindow;
+
+class PageHeatTracker {
+public:
+    static PageHeatTracker* get_instance() {
+        if (!page_heat_obj) {
+            page_heat_obj = new PageHeatTracker();
+        }
+        return page_heat_obj;
+    };
+
+    // Start tracking the memory regions of mem_ctrl, the report gets written
+    // to out_path (if not empty) by stop()
+    bool start(MemCtrlBase* mem_ctrl, const std::string& out_path);
+    void stop();
+
+    // Close the current window and open a new one
+    void end_window(uint64_t now_ns);
+
+    // Clear accumulated heat and window history
+    void reset();
+
+    // Record an access to the page containing host_va
+    void record(const uint8_t* host_va, uint8_t access);
+
+    // Debugger output
+    void print_summary();
+    void print_heat_map(const std::string& rgn_name);
+
+    bool write_report(const std::string& path);
+
+private:
+    PageHeatTracker() {}; // private constructor to implement a singleton
+
+    static PageHeatTracker* page_heat_obj;
+
+    static const int    PAGE_BITS    = 12;
+    static const size_t MAX_HISTORY  = 4096;
+
+    typedef struct HeatRegion {
+        std::string             name;
+        const char*             kind;   // "RAM", "VRAM" or "ROM"
+        uint32_t                phys_start;
+        uint8_t*                mem_ptr;
+        size_t                  num_pages;
+        std::vector<uint8_t>    cur_access; // HeatAccess bits in the open window
+        std::vector<uint16_t>   read_wins;  // windows with reads per page
+        std::vector<uint16_t>   write_wins;
+        std::vector<uint16_t>   exec_wins;
+        HeatWindowUsage         peak;
+    } HeatRegion;
+
+    HeatRegion* find_region(const uint8_t* host_va);
+
+    std::vector<HeatRegion> regions;
+    HeatRegion*             last_rgn = nullptr;
+
+    std::deque<HeatWindow>  history;
+    uint64_t                num_windows  = 0;
+    uint64_t                win_start_ns = 0;
+    std::string             out_path;
+};
+
+// checked in the TLB refill paths so that disabled tracking costs only a branch
+extern bool page_heat_enabled;
+
+#endif // PAGE_HEAT_H
@@ -0,0 +1,80 @@
+/*
+DingusPPC - The Experimental PowerPC Macintosh emulator
+Copyright (C) 2018-23 divingkatae and maximum
+                      (theweirdo)     spatium
+
+(Contact divingkatae#1017 or powermax#2286 on Discord for more info)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file Wall clock timing of named startup phases. */
+
+#include <utils/phasetimer.h>
+#include <loguru.hpp>
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace std::chrono;
+
+static std::mutex                   phase_mutex;
+static std::vector<PhaseInfo>       phases;
+static steady_clock::time_point     first_start;
+
+PhaseTimer::PhaseTimer(const std::string& name) {
+    this->name  = name;
+    this->start = steady_clock::now();
+
+    std::lock_guard<std::mutex> lock(phase_mutex);
+
+    if (first_start == steady_clock::time_point())
+        first_start = this->start;
+}
+
+PhaseTimer::~PhaseTimer() {
+    auto end = steady_clock::now();
+
+    std::lock_guard<std::mutex> lock(phase_mutex);
+
+    phases.push_back({this->name,
+        (uint64_t)duration_cast<microseconds>(this->start - first_start).count(),
+        (uint64_t)duration_cast<microseconds>(end - this->start).count()});
+}
+
+std::vector<PhaseInfo> get_phase_timings() {
+    std::lock_guard<std::mutex> lock(phase_mutex);
+
+    return phases;
+}
+
+void log_phase_timings() {
+    for (auto& phase : get_phase_timings()) {
+        LOG_F(INFO, "Phase %-24s started at %8.3f ms, took %8.3f ms",
+              phase.name.c_str(), phase.start_us / 1000.0,
+              phase.duration_us / 1000.0);
+    }
+}
+
+void PhaseProfile::populate_variables(std::vector<ProfileVar>& vars) {
+    vars.clear();
+
+    for (auto& phase : get_phase_timings()) {
+        vars.push_back({.name = phase.name + " (us)",
+                        .format = ProfileVarFmt::DEC,
+                        .value = phase.duration_us});
+    }
+}
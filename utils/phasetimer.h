@@ -0,0 +1,68 @@
+/*
+DingusPPC - The Experimental PowerPC Macintosh emulator
+Copyright (C) 2018-23 divingkatae and maximum
+                      (theweirdo)     spatium
+
+(Contact divingkatae#1017 or powermax#2286 on Discord for more info)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file Wall clock timing of named startup phases.
+
+    Phases may overlap and can be timed from several threads at once,
+    e.g. when the boot ROM is loaded while devices are being constructed.
+ */
+
+#ifndef PHASE_TIMER_H
+#define PHASE_TIMER_H
+
+#include <utils/profiler.h>
+
+#include <chrono>
+#include <cinttypes>
+#include <string>
+#include <vector>
+
+/** Measures the time spent in the enclosing scope and records it as a phase. */
+class PhaseTimer {
+public:
+    PhaseTimer(const std::string& name);
+    ~PhaseTimer();
+
+private:
+    std::string name;
+    std::chrono::steady_clock::time_point start;
+};
+
+typedef struct PhaseInfo {
+    std::string name;
+    uint64_t    start_us;   /* offset from the start of the first phase */
+    uint64_t    duration_us;
+} PhaseInfo;
+
+extern std::vector<PhaseInfo> get_phase_timings();
+extern void log_phase_timings();
+
+/** Profile presenting the recorded phase timings. */
+class PhaseProfile : public BaseProfile {
+public:
+    PhaseProfile() : BaseProfile("Startup") {};
+
+    void populate_variables(std::vector<ProfileVar>& vars);
+
+    void reset(void) {}; // startup happens only once
+};
+
+#endif // PHASE_TIMER_H